@@ -142,6 +142,33 @@ size_t MEM_lockfree_get_peak_memory(void) ATTR_WARN_UNUSED_RESULT;
 const char *MEM_lockfree_name_ptr(void *vmemh);
 #endif
 
+/* Prototypes for slab allocator functions */
+size_t MEM_slab_allocN_len(const void *vmemh) ATTR_WARN_UNUSED_RESULT;
+void MEM_slab_freeN(void *vmemh);
+void *MEM_slab_dupallocN(const void *vmemh) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+void *MEM_slab_reallocN_id(void *vmemh, size_t len, const char *UNUSED(str)) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_ALLOC_SIZE(2);
+void *MEM_slab_recallocN_id(void *vmemh, size_t len, const char *UNUSED(str)) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_ALLOC_SIZE(2);
+void *MEM_slab_callocN(size_t len, const char *UNUSED(str)) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_ALLOC_SIZE(1) ATTR_NONNULL(2);
+void *MEM_slab_mallocN(size_t len, const char *UNUSED(str)) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_ALLOC_SIZE(1) ATTR_NONNULL(2);
+void *MEM_slab_mallocN_aligned(size_t len, size_t alignment, const char *UNUSED(str)) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_ALLOC_SIZE(1) ATTR_NONNULL(3);
+void *MEM_slab_mapallocN(size_t len, const char *UNUSED(str)) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_ALLOC_SIZE(1) ATTR_NONNULL(2);
+void MEM_slab_printmemlist_pydict(void);
+void MEM_slab_printmemlist(void);
+void MEM_slab_callbackmemlist(void (*func)(void *));
+void MEM_slab_printmemlist_stats(void);
+void MEM_slab_set_error_callback(void (*func)(const char *));
+bool MEM_slab_check_memory_integrity(void);
+void MEM_slab_set_lock_callback(void (*lock)(void), void (*unlock)(void));
+void MEM_slab_set_memory_debug(void);
+size_t MEM_slab_get_memory_in_use(void);
+size_t MEM_slab_get_mapped_memory_in_use(void);
+unsigned int MEM_slab_get_memory_blocks_in_use(void);
+void MEM_slab_reset_peak_memory(void);
+size_t MEM_slab_get_peak_memory(void) ATTR_WARN_UNUSED_RESULT;
+#ifndef NDEBUG
+const char *MEM_slab_name_ptr(void *vmemh);
+#endif
+
 /* Prototypes for fully guarded allocator functions */
 size_t MEM_guarded_allocN_len(const void *vmemh) ATTR_WARN_UNUSED_RESULT;
 void MEM_guarded_freeN(void *vmemh);
@@ -0,0 +1,649 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file guardedalloc/intern/mallocn_slab_impl.c
+ *  \ingroup MEM
+ *
+ * Size-class slab allocator, a drop-in alternative to the lock-free allocator
+ * for workloads doing many small allocations (BMesh operators, depsgraph building, file reading).
+ *
+ * - Blocks up to #SLAB_SLOT_SIZE_MAX (including the #MemHead) are taken from slabs,
+ *   one set of slabs per size class, classes are spaced by #SLAB_SLOT_ALIGN bytes.
+ * - Each thread keeps a small cache of free slots per class, so the common case takes no locks,
+ *   the cache is refilled from (and spilled to) the classes shared free list in batches.
+ * - Larger, aligned and mapped blocks are passed on to the lock-free allocator.
+ *
+ * The #MemHead keeps its single 'size_t', the size class is stored in its top byte,
+ * so #MEM_allocN_len and the memory counters behave the same as with the lock-free allocator.
+ *
+ * Memory used by slabs is never given back to the system, freed slots are only reused.
+ */
+
+#include <stdlib.h>
+#include <string.h> /* memcpy */
+#include <stdarg.h>
+#include <sys/types.h>
+
+#if !defined(WIN32)
+#  include <pthread.h>
+#endif
+
+#include "MEM_guardedalloc.h"
+
+/* to ensure strict conversions */
+#include "../../source/blender/blenlib/BLI_strict_flags.h"
+
+#include "atomic_ops.h"
+#include "mallocn_intern.h"
+
+typedef struct MemHead {
+	/* Length of allocated memory block, the top byte stores the slab class (when non-zero). */
+	size_t len;
+} MemHead;
+
+/* Slots are a multiple of this size (so the pointers returned have the same alignment as malloc). */
+#define SLAB_SLOT_ALIGN 16
+/* Largest slot (including #MemHead), larger blocks use the lock-free allocator. */
+#define SLAB_SLOT_SIZE_MAX 1024
+#define SLAB_CLASS_NUM (SLAB_SLOT_SIZE_MAX / SLAB_SLOT_ALIGN)
+/* Memory allocated at once for new slots of a class. */
+#define SLAB_CHUNK_SIZE (64 * 1024)
+/* Bytes moved between the thread cache and the shared free list at once. */
+#define SLAB_BATCH_SIZE (8 * 1024)
+
+#define SLAB_CLASS_SHIFT ((sizeof(size_t) * 8) - 8)
+#define SLAB_CLASS_MASK ((size_t)0xff << SLAB_CLASS_SHIFT)
+/* Flags used by the lock-free allocator (never set for slab blocks). */
+#define SLAB_LEN_FLAG_MASK ((size_t)3)
+
+#define MEMHEAD_FROM_PTR(ptr) (((MemHead *)ptr) - 1)
+#define PTR_FROM_MEMHEAD(memhead) (memhead + 1)
+/* Zero when the block isn't from a slab, otherwise the class index + 1. */
+#define MEMHEAD_SLAB_CLASS(memhead) ((unsigned int)(((memhead)->len & SLAB_CLASS_MASK) >> SLAB_CLASS_SHIFT))
+
+#ifdef _MSC_VER
+#  define SLAB_THREAD_LOCAL __declspec(thread)
+#else
+#  define SLAB_THREAD_LOCAL __thread
+#endif
+
+/* Free slots are linked through their first bytes. */
+typedef struct SlabFreeSlot {
+	struct SlabFreeSlot *next;
+} SlabFreeSlot;
+
+typedef struct SlabChunk {
+	struct SlabChunk *next;
+} SlabChunk;
+
+typedef struct SlabClass {
+	uint32_t lock;
+	unsigned int free_len;
+	SlabFreeSlot *free_first;
+	/* Slots not yet handed out from the most recent chunk. */
+	char *chunk_next;
+	unsigned int chunk_slots_remain;
+	SlabChunk *chunks;
+} SlabClass;
+
+typedef struct SlabThreadCache {
+	unsigned int free_len[SLAB_CLASS_NUM];
+	SlabFreeSlot *free_first[SLAB_CLASS_NUM];
+	bool is_registered;
+} SlabThreadCache;
+
+static SlabClass slab_classes[SLAB_CLASS_NUM];
+static SLAB_THREAD_LOCAL SlabThreadCache slab_thread_cache;
+
+/* Only the blocks allocated from slabs, see #MEM_slab_get_memory_in_use. */
+static unsigned int totblock = 0;
+static size_t mem_in_use = 0, peak_mem = 0;
+static bool malloc_debug_memset = false;
+
+static void (*error_callback)(const char *) = NULL;
+
+#if !defined(WIN32)
+static pthread_key_t slab_thread_key;
+static pthread_once_t slab_thread_key_once = PTHREAD_ONCE_INIT;
+#endif
+
+MEM_INLINE void update_maximum(size_t *maximum_value, size_t value)
+{
+	size_t prev_value = *maximum_value;
+	while (prev_value < value) {
+		if (atomic_cas_z(maximum_value, prev_value, value) != prev_value) {
+			break;
+		}
+	}
+}
+
+#ifdef __GNUC__
+__attribute__ ((format(printf, 1, 2)))
+#endif
+static void print_error(const char *str, ...)
+{
+	char buf[512];
+	va_list ap;
+
+	va_start(ap, str);
+	vsnprintf(buf, sizeof(buf), str, ap);
+	va_end(ap);
+	buf[sizeof(buf) - 1] = '\0';
+
+	if (error_callback) {
+		error_callback(buf);
+	}
+}
+
+/* -------------------------------------------------------------------- */
+
+/** \name Slab Classes
+ * \{ */
+
+MEM_INLINE unsigned int slab_class_index(size_t len)
+{
+	return (unsigned int)((len + sizeof(MemHead) + (SLAB_SLOT_ALIGN - 1)) / SLAB_SLOT_ALIGN) - 1;
+}
+
+MEM_INLINE size_t slab_class_slot_size(unsigned int index)
+{
+	return (size_t)(index + 1) * SLAB_SLOT_ALIGN;
+}
+
+MEM_INLINE unsigned int slab_class_batch_len(unsigned int index)
+{
+	const unsigned int batch_len = (unsigned int)(SLAB_BATCH_SIZE / slab_class_slot_size(index));
+	return batch_len > 4 ? batch_len : 4;
+}
+
+static void slab_class_lock(SlabClass *slab_class)
+{
+	while (atomic_cas_uint32(&slab_class->lock, 0, 1) != 0) {
+		/* pass */
+	}
+}
+
+static void slab_class_unlock(SlabClass *slab_class)
+{
+	atomic_cas_uint32(&slab_class->lock, 1, 0);
+}
+
+/**
+ * Take up to \a batch_len slots from the shared free list (or new chunks),
+ * returned as a linked list, \a r_len is set to the number of slots.
+ */
+static SlabFreeSlot *slab_class_take(unsigned int index, unsigned int batch_len, unsigned int *r_len)
+{
+	SlabClass *slab_class = &slab_classes[index];
+	SlabFreeSlot *first = NULL;
+	unsigned int len = 0;
+
+	slab_class_lock(slab_class);
+
+	while (len < batch_len && slab_class->free_first) {
+		SlabFreeSlot *slot = slab_class->free_first;
+		slab_class->free_first = slot->next;
+		slot->next = first;
+		first = slot;
+		len++;
+	}
+	slab_class->free_len -= len;
+
+	if (len < batch_len) {
+		const size_t slot_size = slab_class_slot_size(index);
+
+		if (slab_class->chunk_slots_remain == 0) {
+			/* Chunks are a multiple of the slot size, with room for the chunk header,
+			 * the first slot starts at #SLAB_SLOT_ALIGN so the slots stay aligned. */
+			const unsigned int chunk_slots = (unsigned int)((SLAB_CHUNK_SIZE - SLAB_SLOT_ALIGN) / slot_size);
+			SlabChunk *chunk = malloc(SLAB_SLOT_ALIGN + (chunk_slots * slot_size));
+			if (chunk != NULL) {
+				chunk->next = slab_class->chunks;
+				slab_class->chunks = chunk;
+				slab_class->chunk_next = (char *)chunk + SLAB_SLOT_ALIGN;
+				slab_class->chunk_slots_remain = chunk_slots;
+			}
+		}
+
+		while (len < batch_len && slab_class->chunk_slots_remain != 0) {
+			SlabFreeSlot *slot = (SlabFreeSlot *)slab_class->chunk_next;
+			slab_class->chunk_next += slot_size;
+			slab_class->chunk_slots_remain--;
+			slot->next = first;
+			first = slot;
+			len++;
+		}
+	}
+
+	slab_class_unlock(slab_class);
+
+	*r_len = len;
+	return first;
+}
+
+/**
+ * Give \a len slots starting at \a first back to the shared free list.
+ */
+static void slab_class_give(unsigned int index, SlabFreeSlot *first, SlabFreeSlot *last, unsigned int len)
+{
+	SlabClass *slab_class = &slab_classes[index];
+
+	slab_class_lock(slab_class);
+	last->next = slab_class->free_first;
+	slab_class->free_first = first;
+	slab_class->free_len += len;
+	slab_class_unlock(slab_class);
+}
+
+/** \} */
+
+
+/* -------------------------------------------------------------------- */
+
+/** \name Thread Cache
+ *
+ * Slots freed by a thread go to its own cache, even when another thread allocated them.
+ * When a thread exits its cache is returned to the shared free lists
+ * (on WIN32 there is no exit callback, the cached slots of exited threads aren't reused).
+ * \{ */
+
+static void slab_thread_cache_flush(SlabThreadCache *cache)
+{
+	unsigned int index;
+
+	for (index = 0; index < SLAB_CLASS_NUM; index++) {
+		SlabFreeSlot *first = cache->free_first[index];
+		if (first) {
+			SlabFreeSlot *last = first;
+			while (last->next) {
+				last = last->next;
+			}
+			slab_class_give(index, first, last, cache->free_len[index]);
+			cache->free_first[index] = NULL;
+			cache->free_len[index] = 0;
+		}
+	}
+}
+
+#if !defined(WIN32)
+static void slab_thread_exit_cb(void *value)
+{
+	SlabThreadCache *cache = value;
+	slab_thread_cache_flush(cache);
+	/* Register again if other exit callbacks free memory, pthreads calls us once more. */
+	cache->is_registered = false;
+}
+
+static void slab_thread_key_create(void)
+{
+	pthread_key_create(&slab_thread_key, slab_thread_exit_cb);
+}
+#endif
+
+MEM_INLINE SlabThreadCache *slab_thread_cache_get(void)
+{
+	SlabThreadCache *cache = &slab_thread_cache;
+
+	if (UNLIKELY(!cache->is_registered)) {
+		cache->is_registered = true;
+#if !defined(WIN32)
+		pthread_once(&slab_thread_key_once, slab_thread_key_create);
+		pthread_setspecific(slab_thread_key, cache);
+#endif
+	}
+	return cache;
+}
+
+static void *slab_slot_alloc(unsigned int index)
+{
+	SlabThreadCache *cache = slab_thread_cache_get();
+	SlabFreeSlot *slot = cache->free_first[index];
+
+	if (UNLIKELY(slot == NULL)) {
+		unsigned int len;
+		slot = slab_class_take(index, slab_class_batch_len(index), &len);
+		if (UNLIKELY(slot == NULL)) {
+			return NULL;
+		}
+		cache->free_len[index] = len;
+	}
+
+	cache->free_first[index] = slot->next;
+	cache->free_len[index]--;
+	return slot;
+}
+
+static void slab_slot_free(unsigned int index, void *ptr)
+{
+	SlabThreadCache *cache = slab_thread_cache_get();
+	SlabFreeSlot *slot = ptr;
+	const unsigned int batch_len = slab_class_batch_len(index);
+
+	slot->next = cache->free_first[index];
+	cache->free_first[index] = slot;
+	cache->free_len[index]++;
+
+	/* Spill a batch when the cache holds too many free slots,
+	 * keeping one batch cached so alternating alloc/free don't hit the lock each time. */
+	if (UNLIKELY(cache->free_len[index] >= batch_len * 2)) {
+		SlabFreeSlot *last = slot;
+		unsigned int i;
+		for (i = 1; i < batch_len; i++) {
+			last = last->next;
+		}
+		cache->free_first[index] = last->next;
+		cache->free_len[index] -= batch_len;
+		slab_class_give(index, slot, last, batch_len);
+	}
+}
+
+/** \} */
+
+
+/* -------------------------------------------------------------------- */
+
+/** \name Allocator API
+ * \{ */
+
+MEM_INLINE bool slab_len_is_small(size_t len)
+{
+	return (len + sizeof(MemHead)) <= SLAB_SLOT_SIZE_MAX;
+}
+
+size_t MEM_slab_allocN_len(const void *vmemh)
+{
+	if (vmemh) {
+		return MEMHEAD_FROM_PTR(vmemh)->len & ~(SLAB_CLASS_MASK | SLAB_LEN_FLAG_MASK);
+	}
+	else {
+		return 0;
+	}
+}
+
+void MEM_slab_freeN(void *vmemh)
+{
+	MemHead *memh;
+	unsigned int slab_class;
+	size_t len;
+
+	if (vmemh == NULL) {
+		print_error("Attempt to free NULL pointer\n");
+#ifdef WITH_ASSERT_ABORT
+		abort();
+#endif
+		return;
+	}
+
+	memh = MEMHEAD_FROM_PTR(vmemh);
+	slab_class = MEMHEAD_SLAB_CLASS(memh);
+
+	if (slab_class == 0) {
+		MEM_lockfree_freeN(vmemh);
+		return;
+	}
+
+	len = MEM_slab_allocN_len(vmemh);
+
+	atomic_sub_and_fetch_u(&totblock, 1);
+	atomic_sub_and_fetch_z(&mem_in_use, len);
+
+	if (UNLIKELY(malloc_debug_memset && len)) {
+		memset(vmemh, 255, len);
+	}
+
+	slab_slot_free(slab_class - 1, memh);
+}
+
+static void *slab_mallocN_ex(size_t len, const char *str, const bool use_calloc)
+{
+	const unsigned int index = slab_class_index(len);
+	MemHead *memh = slab_slot_alloc(index);
+
+	if (LIKELY(memh)) {
+		if (use_calloc) {
+			memset(memh + 1, 0, len);
+		}
+		else if (UNLIKELY(malloc_debug_memset && len)) {
+			memset(memh + 1, 255, len);
+		}
+
+		memh->len = len | ((size_t)(index + 1) << SLAB_CLASS_SHIFT);
+		atomic_add_and_fetch_u(&totblock, 1);
+		update_maximum(&peak_mem, atomic_add_and_fetch_z(&mem_in_use, len) + MEM_lockfree_get_memory_in_use());
+
+		return PTR_FROM_MEMHEAD(memh);
+	}
+	print_error("%s returns null: len=" SIZET_FORMAT " in %s, total %u\n",
+	            use_calloc ? "Calloc" : "Malloc", SIZET_ARG(len), str, (unsigned int)mem_in_use);
+	return NULL;
+}
+
+/* Blocks passed on to the lock-free allocator still count towards the combined peak. */
+MEM_INLINE void *slab_lockfree_result(void *ptr)
+{
+	update_maximum(&peak_mem, mem_in_use + MEM_lockfree_get_memory_in_use());
+	return ptr;
+}
+
+void *MEM_slab_callocN(size_t len, const char *str)
+{
+	len = SIZET_ALIGN_4(len);
+
+	if (LIKELY(slab_len_is_small(len))) {
+		return slab_mallocN_ex(len, str, true);
+	}
+	return slab_lockfree_result(MEM_lockfree_callocN(len, str));
+}
+
+void *MEM_slab_mallocN(size_t len, const char *str)
+{
+	len = SIZET_ALIGN_4(len);
+
+	if (LIKELY(slab_len_is_small(len))) {
+		return slab_mallocN_ex(len, str, false);
+	}
+	return slab_lockfree_result(MEM_lockfree_mallocN(len, str));
+}
+
+void *MEM_slab_mallocN_aligned(size_t len, size_t alignment, const char *str)
+{
+	return slab_lockfree_result(MEM_lockfree_mallocN_aligned(len, alignment, str));
+}
+
+void *MEM_slab_mapallocN(size_t len, const char *str)
+{
+	return slab_lockfree_result(MEM_lockfree_mapallocN(len, str));
+}
+
+void *MEM_slab_dupallocN(const void *vmemh)
+{
+	void *newp = NULL;
+	if (vmemh) {
+		if (MEMHEAD_SLAB_CLASS(MEMHEAD_FROM_PTR(vmemh)) == 0) {
+			return slab_lockfree_result(MEM_lockfree_dupallocN(vmemh));
+		}
+		else {
+			const size_t prev_size = MEM_slab_allocN_len(vmemh);
+			newp = MEM_slab_mallocN(prev_size, "dupli_malloc");
+			if (newp) {
+				memcpy(newp, vmemh, prev_size);
+			}
+		}
+	}
+	return newp;
+}
+
+static void *slab_reallocN_ex(void *vmemh, size_t len, const char *str, const bool use_calloc)
+{
+	void *newp = NULL;
+
+	if (vmemh) {
+		const size_t old_len = MEM_slab_allocN_len(vmemh);
+
+		if (MEMHEAD_SLAB_CLASS(MEMHEAD_FROM_PTR(vmemh)) != 0) {
+			/* Growing within the same slot (lengths are rounded up to the slot size). */
+			const unsigned int index = MEMHEAD_SLAB_CLASS(MEMHEAD_FROM_PTR(vmemh)) - 1;
+			const size_t len_align = SIZET_ALIGN_4(len);
+			if (slab_class_index(len_align) == index) {
+				MemHead *memh = MEMHEAD_FROM_PTR(vmemh);
+				if (use_calloc && len_align > old_len) {
+					memset((char *)vmemh + old_len, 0, len_align - old_len);
+				}
+				memh->len = len_align | ((size_t)(index + 1) << SLAB_CLASS_SHIFT);
+				atomic_add_and_fetch_z(&mem_in_use, len_align);
+				atomic_sub_and_fetch_z(&mem_in_use, old_len);
+				return vmemh;
+			}
+		}
+		else if (MEMHEAD_FROM_PTR(vmemh)->len & SLAB_LEN_FLAG_MASK) {
+			/* Aligned or mapped. */
+			return slab_lockfree_result(use_calloc ?
+			                            MEM_lockfree_recallocN_id(vmemh, len, str) :
+			                            MEM_lockfree_reallocN_id(vmemh, len, str));
+		}
+
+		newp = use_calloc ? MEM_slab_callocN(len, "recalloc") : MEM_slab_mallocN(len, "realloc");
+
+		if (newp) {
+			if (len < old_len) {
+				/* shrink */
+				memcpy(newp, vmemh, len);
+			}
+			else {
+				/* grow (or remain same size), new bytes are zeroed by calloc */
+				memcpy(newp, vmemh, old_len);
+			}
+		}
+
+		MEM_slab_freeN(vmemh);
+	}
+	else {
+		newp = use_calloc ? MEM_slab_callocN(len, str) : MEM_slab_mallocN(len, str);
+	}
+
+	return newp;
+}
+
+void *MEM_slab_reallocN_id(void *vmemh, size_t len, const char *str)
+{
+	return slab_reallocN_ex(vmemh, len, str, false);
+}
+
+void *MEM_slab_recallocN_id(void *vmemh, size_t len, const char *str)
+{
+	return slab_reallocN_ex(vmemh, len, str, true);
+}
+
+void MEM_slab_printmemlist_pydict(void)
+{
+}
+
+void MEM_slab_printmemlist(void)
+{
+}
+
+/* unused */
+void MEM_slab_callbackmemlist(void (*func)(void *))
+{
+	(void) func;  /* Ignored. */
+}
+
+void MEM_slab_printmemlist_stats(void)
+{
+	size_t slab_reserved = 0;
+	unsigned int index;
+
+	for (index = 0; index < SLAB_CLASS_NUM; index++) {
+		SlabChunk *chunk;
+		for (chunk = slab_classes[index].chunks; chunk; chunk = chunk->next) {
+			slab_reserved += SLAB_CHUNK_SIZE;
+		}
+	}
+
+	printf("\ntotal memory len: %.3f MB\n",
+	       (double)MEM_slab_get_memory_in_use() / (double)(1024 * 1024));
+	printf("peak memory len: %.3f MB\n",
+	       (double)peak_mem / (double)(1024 * 1024));
+	printf("slab memory len: %.3f MB (%.3f MB reserved)\n",
+	       (double)mem_in_use / (double)(1024 * 1024),
+	       (double)slab_reserved / (double)(1024 * 1024));
+	printf("\nFor more detailed per-block statistics run Blender with memory debugging command line argument.\n");
+}
+
+void MEM_slab_set_error_callback(void (*func)(const char *))
+{
+	error_callback = func;
+	MEM_lockfree_set_error_callback(func);
+}
+
+bool MEM_slab_check_memory_integrity(void)
+{
+	return true;
+}
+
+void MEM_slab_set_lock_callback(void (*lock)(void), void (*unlock)(void))
+{
+	MEM_lockfree_set_lock_callback(lock, unlock);
+}
+
+void MEM_slab_set_memory_debug(void)
+{
+	malloc_debug_memset = true;
+	MEM_lockfree_set_memory_debug();
+}
+
+size_t MEM_slab_get_memory_in_use(void)
+{
+	return mem_in_use + MEM_lockfree_get_memory_in_use();
+}
+
+size_t MEM_slab_get_mapped_memory_in_use(void)
+{
+	return MEM_lockfree_get_mapped_memory_in_use();
+}
+
+unsigned int MEM_slab_get_memory_blocks_in_use(void)
+{
+	return totblock + MEM_lockfree_get_memory_blocks_in_use();
+}
+
+void MEM_slab_reset_peak_memory(void)
+{
+	peak_mem = MEM_slab_get_memory_in_use();
+}
+
+size_t MEM_slab_get_peak_memory(void)
+{
+	return peak_mem;
+}
+
+#ifndef NDEBUG
+const char *MEM_slab_name_ptr(void *vmemh)
+{
+	if (vmemh) {
+		return "unknown block name ptr";
+	}
+	else {
+		return "MEM_slab_name_ptr(NULL)";
+	}
+}
+#endif  /* NDEBUG */
+
+/** \} */
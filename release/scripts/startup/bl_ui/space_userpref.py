@@ -357,6 +357,7 @@ class USERPREF_PT_edit(Panel):
 
         col.label(text="Undo:")
         col.prop(edit, "use_global_undo")
+        col.prop(edit, "use_global_undo_legacy")
         col.prop(edit, "undo_steps", text="Steps")
         col.prop(edit, "undo_memory_limit", text="Memory Limit")
 
@@ -1051,6 +1052,7 @@ class USERPREF_PT_file(Panel):
         col.label(text="Save & Load:")
         col.prop(paths, "use_relative_paths")
         col.prop(paths, "use_file_compression")
+        col.prop(paths, "use_load_packed_deferred")
         col.prop(paths, "use_load_ui")
         col.prop(paths, "use_filter_files")
         col.prop(paths, "show_hidden_files_datablocks")
@@ -31,6 +31,7 @@ extern "C" {
 struct bContext;
 struct Scene;
 struct Main;
+struct MemFile;
 
 #define BKE_UNDO_STR_MAX 64
 
@@ -44,6 +45,7 @@ extern void          BKE_undo_number(struct bContext *C, int nr);
 extern const char   *BKE_undo_get_name(int nr, bool *r_active);
 extern const char   *BKE_undo_get_name_last(void);
 extern bool          BKE_undo_save_file(const char *filename);
+extern bool          BKE_undo_memfile_copy(struct MemFile *r_memfile);
 extern struct Main  *BKE_undo_get_main(struct Scene **r_scene);
 
 extern void          BKE_undo_callback_wm_kill_jobs_set(void (*callback)(struct bContext *C));
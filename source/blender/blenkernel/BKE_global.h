@@ -180,6 +180,9 @@ enum {
 /* On write, restore paths after editing them (G_FILE_RELATIVE_REMAP) */
 #define G_FILE_SAVE_COPY         (1 << 27)
 #define G_FILE_GLSL_NO_ENV_LIGHTING (1 << 28)
+/* Write independently compressed blocks instead of a single gzip stream (G_FILE_COMPRESS),
+ * (de)compressed in parallel, not readable by older versions. */
+#define G_FILE_COMPRESS_FRAMES   (1 << 29)
 
 #define G_FILE_FLAGS_RUNTIME (G_FILE_NO_UI | G_FILE_RELATIVE_REMAP | G_FILE_MESH_COMPAT | G_FILE_SAVE_COPY)
 
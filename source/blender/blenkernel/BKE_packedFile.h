@@ -64,6 +64,11 @@ int writePackedFile(struct ReportList *reports, const char *filename, struct Pac
 /* free */
 void freePackedFile(struct PackedFile *pf);
 
+/* deferred loading */
+bool BKE_packedfile_ensure_data(struct PackedFile *pf, struct ReportList *reports);
+bool BKE_packedfile_ensure_data_all(struct Main *bmain, struct ReportList *reports);
+bool BKE_packedfile_has_deferred(struct Main *bmain);
+
 /* info */
 int countPackedFiles(struct Main *bmain);
 int checkPackedFile(const char *filename, struct PackedFile *pf);
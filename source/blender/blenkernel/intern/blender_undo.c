@@ -40,7 +40,9 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "DNA_object_types.h"
 #include "DNA_scene_types.h"
+#include "DNA_userdef_types.h"
 
 #include "BLI_fileops.h"
 #include "BLI_listbase.h"
@@ -58,6 +60,7 @@
 #include "BKE_context.h"
 #include "BKE_global.h"
 #include "BKE_image.h"
+#include "BKE_library.h"
 #include "BKE_main.h"
 #include "RE_pipeline.h"
 
@@ -95,8 +98,13 @@ void BKE_undo_callback_wm_kill_jobs_set(void (*callback)(struct bContext *C))
 	undo_wm_job_kill_callback = callback;
 }
 
-static int read_undosave(bContext *C, UndoElem *uel)
+/**
+ * \param uel_active: The step the current main was last read from or written to (can be NULL),
+ * unchanged data-blocks it has in common with \a uel are kept.
+ */
+static int read_undosave(bContext *C, UndoElem *uel, UndoElem *uel_active)
 {
+	MemFile *memfile_active = (uel_active && !(U.uiflag2 & USER_GLOBALUNDO_LEGACY)) ? &uel_active->memfile : NULL;
 	char mainstr[sizeof(G.main->name)];
 	int success = 0, fileflags;
 
@@ -111,7 +119,7 @@ static int read_undosave(bContext *C, UndoElem *uel)
 	if (UNDO_DISK)
 		success = (BKE_blendfile_read(C, uel->str, NULL, 0) != BKE_BLENDFILE_READ_FAIL);
 	else
-		success = BKE_blendfile_read_from_memfile(C, &uel->memfile, NULL, 0);
+		success = BKE_blendfile_read_from_memfile(C, &uel->memfile, memfile_active, NULL, 0);
 
 	/* restore */
 	BLI_strncpy(G.main->name, mainstr, sizeof(G.main->name)); /* restore */
@@ -125,6 +133,24 @@ static int read_undosave(bContext *C, UndoElem *uel)
 	return success;
 }
 
+/**
+ * Objects in a mode (edit, sculpt, paint...) are changed without tagging them,
+ * never share or keep their undo data.
+ */
+static void undo_tag_changed_modes(Main *bmain)
+{
+	Object *ob;
+
+	for (ob = bmain->object.first; ob; ob = ob->id.next) {
+		if (ob->mode != OB_MODE_OBJECT) {
+			ob->id.tag |= LIB_TAG_UNDO_CHANGED;
+			if (ob->data) {
+				((ID *)ob->data)->tag |= LIB_TAG_UNDO_CHANGED;
+			}
+		}
+	}
+}
+
 /* name can be a dynamic string */
 void BKE_undo_write(bContext *C, const char *name)
 {
@@ -191,13 +217,25 @@ void BKE_undo_write(bContext *C, const char *name)
 		BLI_strncpy(curundo->str, filepath, sizeof(curundo->str));
 	}
 	else {
+		Main *bmain = CTX_data_main(C);
 		MemFile *prevfile = NULL;
 
 		if (curundo->prev) prevfile = &(curundo->prev->memfile);
 
+		/* data-blocks without #LIB_TAG_UNDO_CHANGED share the undo data of the previous step */
+		if (U.uiflag2 & USER_GLOBALUNDO_LEGACY) {
+			BKE_main_id_tag_all(bmain, LIB_TAG_UNDO_CHANGED, true);
+		}
+		else {
+			undo_tag_changed_modes(bmain);
+		}
+
 		memused = MEM_get_memory_in_use();
-		/* success = */ /* UNUSED */ BLO_write_file_mem(CTX_data_main(C), prevfile, &curundo->memfile, G.fileflags);
+		/* success = */ /* UNUSED */ BLO_write_file_mem(bmain, prevfile, &curundo->memfile, G.fileflags);
 		curundo->undosize = MEM_get_memory_in_use() - memused;
+
+		BKE_main_id_tag_all(bmain, LIB_TAG_UNDO_CHANGED, false);
+		undo_tag_changed_modes(bmain);
 	}
 
 	if (U.undomemory != 0) {
@@ -233,7 +271,7 @@ void BKE_undo_step(bContext *C, int step)
 {
 
 	if (step == 0) {
-		read_undosave(C, curundo);
+		read_undosave(C, curundo, curundo);
 	}
 	else if (step == 1) {
 		/* curundo should never be NULL, after restart or load file it should call undo_save */
@@ -243,7 +281,7 @@ void BKE_undo_step(bContext *C, int step)
 		else {
 			if (G.debug & G_DEBUG) printf("undo %s\n", curundo->name);
 			curundo = curundo->prev;
-			read_undosave(C, curundo);
+			read_undosave(C, curundo, curundo->next);
 		}
 	}
 	else {
@@ -253,7 +291,7 @@ void BKE_undo_step(bContext *C, int step)
 			// XXX error("No redo available");
 		}
 		else {
-			read_undosave(C, curundo->next);
+			read_undosave(C, curundo->next, curundo);
 			curundo = curundo->next;
 			if (G.debug & G_DEBUG) printf("redo %s\n", curundo->name);
 		}
@@ -277,8 +315,10 @@ void BKE_undo_reset(void)
 /* based on index nr it does a restore */
 void BKE_undo_number(bContext *C, int nr)
 {
+	UndoElem *uel_active = curundo;
+
 	curundo = BLI_findlink(&undobase, nr);
-	BKE_undo_step(C, 0);
+	read_undosave(C, curundo, uel_active);
 }
 
 /* go back to the last occurance of name in stack */
@@ -287,8 +327,10 @@ void BKE_undo_name(bContext *C, const char *name)
 	UndoElem *uel = BLI_rfindstring(&undobase, name, offsetof(UndoElem, name));
 
 	if (uel && uel->prev) {
+		UndoElem *uel_active = curundo;
+
 		curundo = uel->prev;
-		BKE_undo_step(C, 0);
+		read_undosave(C, curundo, uel_active);
 	}
 }
 
@@ -386,11 +428,31 @@ bool BKE_undo_save_file(const char *filename)
 	return true;
 }
 
+/**
+ * Copy of the current undo step, which stays valid when undo steps are added or freed
+ * (for writing it to disk in another thread, see #BLO_write_file_from_snapshot).
+ *
+ * \return success.
+ */
+bool BKE_undo_memfile_copy(MemFile *r_memfile)
+{
+	if ((U.uiflag & USER_GLOBALUNDO) == 0) {
+		return false;
+	}
+
+	if (curundo == NULL) {
+		return false;
+	}
+
+	BLO_memfile_copy(r_memfile, &curundo->memfile);
+	return true;
+}
+
 /* sets curscene */
 Main *BKE_undo_get_main(Scene **r_scene)
 {
 	Main *mainp = NULL;
-	BlendFileData *bfd = BLO_read_from_memfile(G.main, G.main->name, &curundo->memfile, NULL, BLO_READ_SKIP_NONE);
+	BlendFileData *bfd = BLO_read_from_memfile(G.main, G.main->name, &curundo->memfile, NULL, NULL, BLO_READ_SKIP_NONE);
 
 	if (bfd) {
 		mainp = bfd->main;
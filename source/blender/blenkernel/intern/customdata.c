@@ -2808,9 +2808,14 @@ void CustomData_bmesh_free_block_data(CustomData *data, void *block)
 		memset(block, 0, data->totsize);
 }
 
-static void CustomData_bmesh_alloc_block(CustomData *data, void **block)
+/**
+ * Allocate an uninitialized block, data is expected to be copied into it afterwards.
+ *
+ * \note Allocating from the pool is not thread-safe, this allows to allocate the blocks up-front
+ * and copy the data into them from multiple threads.
+ */
+void CustomData_bmesh_alloc_block(CustomData *data, void **block)
 {
-
 	if (*block)
 		CustomData_bmesh_free_block(data, block);
 
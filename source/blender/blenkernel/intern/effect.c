@@ -178,8 +178,11 @@ static void add_object_to_effectors(ListBase **effectors, struct EvaluationConte
 
 	eff = new_effector_cache(eval_ctx, scene, ob, NULL, ob->pd);
 
-	/* make sure imat is up to date */
-	invert_m4_m4(ob->imat, ob->obmat);
+	/* make sure imat is up to date, effectors which are not used for
+	 * simulation are only looked up (from multiple threads during depsgraph
+	 * build), the object is not to be modified then */
+	if (for_simulation)
+		invert_m4_m4(ob->imat, ob->obmat);
 
 	BLI_addtail(*effectors, eff);
 }
@@ -208,7 +211,8 @@ static void add_particles_to_effectors(ListBase **effectors, struct EvaluationCo
 	}
 }
 
-/* returns ListBase handle with objects taking part in the effecting */
+/* returns ListBase handle with objects taking part in the effecting,
+ * objects are only modified when for_simulation is set */
 ListBase *pdInitEffectors(struct EvaluationContext *eval_ctx, Scene *scene, Object *ob_src, ParticleSystem *psys_src,
                           EffectorWeights *weights, bool for_simulation)
 {
@@ -164,9 +164,12 @@ static VFontData *vfont_get_data(Main *bmain, VFont *vfont)
 		else {
 			if (vfont->packedfile) {
 				pf = vfont->packedfile;
+				if (!BKE_packedfile_ensure_data(pf, NULL)) {
+					pf = NULL;
+				}
 
 				/* We need to copy a tmp font to memory unless it is already there */
-				if (vfont->temp_pf == NULL) {
+				if (pf && vfont->temp_pf == NULL) {
 					vfont->temp_pf = dupPackedFile(pf);
 				}
 			}
@@ -3464,7 +3464,7 @@ static ImBuf *load_image_single(
 		flag |= imbuf_alpha_flags_for_image(ima);
 
 		imapf = BLI_findlink(&ima->packedfiles, view_id);
-		if (imapf->packedfile) {
+		if (imapf->packedfile && BKE_packedfile_ensure_data(imapf->packedfile, NULL)) {
 			ibuf = IMB_ibImageFromMemory(
 			       (unsigned char *)imapf->packedfile->data, imapf->packedfile->size, flag,
 			       ima->colorspace_settings.name, "<packed data>");
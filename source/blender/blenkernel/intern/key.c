@@ -85,7 +85,7 @@ void BKE_key_free(Key *key)
 	BKE_animdata_free((ID *)key, false);
 
 	while ((kb = BLI_pophead(&key->block))) {
-		if (kb->data)
+		if (kb->data && (kb->flag & KEYBLOCK_DATA_NOFREE) == 0)
 			MEM_freeN(kb->data);
 		MEM_freeN(kb);
 	}
@@ -96,7 +96,7 @@ void BKE_key_free_nolib(Key *key)
 	KeyBlock *kb;
 
 	while ((kb = BLI_pophead(&key->block))) {
-		if (kb->data)
+		if (kb->data && (kb->flag & KEYBLOCK_DATA_NOFREE) == 0)
 			MEM_freeN(kb->data);
 		MEM_freeN(kb);
 	}
@@ -151,7 +151,11 @@ Key *BKE_key_add(ID *id)    /* common function */
 	return key;
 }
 
-Key *BKE_key_copy(Main *bmain, const Key *key)
+/**
+ * \param reference: Reference key-block data of \a key instead of duplicating it,
+ * such key-blocks are tagged with KEYBLOCK_DATA_NOFREE. The copy must not outlive \a key.
+ */
+Key *BKE_key_copy_ex(Main *bmain, const Key *key, const bool reference)
 {
 	Key *keyn;
 	KeyBlock *kbn, *kb;
@@ -164,7 +168,15 @@ Key *BKE_key_copy(Main *bmain, const Key *key)
 	kbn = keyn->block.first;
 	while (kbn) {
 		
-		if (kbn->data) kbn->data = MEM_dupallocN(kbn->data);
+		if (kbn->data) {
+			if (reference) {
+				kbn->flag |= KEYBLOCK_DATA_NOFREE;
+			}
+			else {
+				kbn->data = MEM_dupallocN(kbn->data);
+				kbn->flag &= ~KEYBLOCK_DATA_NOFREE;
+			}
+		}
 		if (kb == key->refkey) keyn->refkey = kbn;
 		
 		kbn = kbn->next;
@@ -176,6 +188,11 @@ Key *BKE_key_copy(Main *bmain, const Key *key)
 	return keyn;
 }
 
+Key *BKE_key_copy(Main *bmain, const Key *key)
+{
+	return BKE_key_copy_ex(bmain, key, false);
+}
+
 Key *BKE_key_copy_nolib(Key *key)
 {
 	Key *keyn;
@@ -192,6 +209,7 @@ Key *BKE_key_copy_nolib(Key *key)
 	while (kbn) {
 		
 		if (kbn->data) kbn->data = MEM_dupallocN(kbn->data);
+		kbn->flag &= ~KEYBLOCK_DATA_NOFREE;
 		if (kb == key->refkey) keyn->refkey = kbn;
 		
 		kbn = kbn->next;
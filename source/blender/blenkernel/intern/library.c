@@ -964,6 +964,7 @@ void *BKE_libblock_alloc(Main *bmain, short type, const char *name)
 		BLI_addtail(lb, id);
 		id->us = 1;
 		id->icon_id = 0;
+		id->tag |= LIB_TAG_UNDO_CHANGED;
 		*( (short *)id->name) = type;
 		new_id(lb, id, name);
 		/* alphabetic insertion: is in new_id */
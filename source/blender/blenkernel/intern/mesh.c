@@ -540,11 +540,17 @@ Mesh *BKE_mesh_add(Main *bmain, const char *name)
 	return me;
 }
 
-Mesh *BKE_mesh_copy(Main *bmain, const Mesh *me)
+/**
+ * \param reference: Reference geometry arrays of \a me instead of duplicating them.
+ * Shared layers are tagged with CD_FLAG_NOFREE, whoever modifies them is to use
+ * CustomData_duplicate_referenced_layer() first. The copy must not outlive \a me.
+ */
+Mesh *BKE_mesh_copy_ex(Main *bmain, const Mesh *me, const bool reference)
 {
 	Mesh *men;
 	int a;
 	const int do_tessface = ((me->totface != 0) && (me->totpoly == 0)); /* only do tessface if we have no polys */
+	const int alloctype = reference ? CD_REFERENCE : CD_DUPLICATE;
 	
 	men = BKE_libblock_copy(bmain, &me->id);
 	
@@ -554,12 +560,12 @@ Mesh *BKE_mesh_copy(Main *bmain, const Mesh *me)
 	}
 	id_us_plus((ID *)men->texcomesh);
 
-	CustomData_copy(&me->vdata, &men->vdata, CD_MASK_MESH, CD_DUPLICATE, men->totvert);
-	CustomData_copy(&me->edata, &men->edata, CD_MASK_MESH, CD_DUPLICATE, men->totedge);
-	CustomData_copy(&me->ldata, &men->ldata, CD_MASK_MESH, CD_DUPLICATE, men->totloop);
-	CustomData_copy(&me->pdata, &men->pdata, CD_MASK_MESH, CD_DUPLICATE, men->totpoly);
+	CustomData_copy(&me->vdata, &men->vdata, CD_MASK_MESH, alloctype, men->totvert);
+	CustomData_copy(&me->edata, &men->edata, CD_MASK_MESH, alloctype, men->totedge);
+	CustomData_copy(&me->ldata, &men->ldata, CD_MASK_MESH, alloctype, men->totloop);
+	CustomData_copy(&me->pdata, &men->pdata, CD_MASK_MESH, alloctype, men->totpoly);
 	if (do_tessface) {
-		CustomData_copy(&me->fdata, &men->fdata, CD_MASK_MESH, CD_DUPLICATE, men->totface);
+		CustomData_copy(&me->fdata, &men->fdata, CD_MASK_MESH, alloctype, men->totface);
 	}
 	else {
 		mesh_tessface_clear_intern(men, false);
@@ -574,7 +580,7 @@ Mesh *BKE_mesh_copy(Main *bmain, const Mesh *me)
 	men->bb = MEM_dupallocN(men->bb);
 
 	if (me->key) {
-		men->key = BKE_key_copy(bmain, me->key);
+		men->key = BKE_key_copy_ex(bmain, me->key, reference);
 		men->key->from = (ID *)men;
 	}
 
@@ -583,6 +589,11 @@ Mesh *BKE_mesh_copy(Main *bmain, const Mesh *me)
 	return men;
 }
 
+Mesh *BKE_mesh_copy(Main *bmain, const Mesh *me)
+{
+	return BKE_mesh_copy_ex(bmain, me, false);
+}
+
 BMesh *BKE_mesh_to_bmesh(
         Mesh *me, Object *ob,
         const bool add_key_index, const struct BMeshCreateParams *params)
@@ -2104,7 +2115,7 @@ void BKE_mesh_calc_normals_split_ex(Mesh *mesh, MLoopNorSpaceArray *r_lnors_spac
 	bool free_polynors = false;
 
 	if (CustomData_has_layer(&mesh->ldata, CD_NORMAL)) {
-		r_loopnors = CustomData_get_layer(&mesh->ldata, CD_NORMAL);
+		r_loopnors = CustomData_duplicate_referenced_layer(&mesh->ldata, CD_NORMAL, mesh->totloop);
 		memset(r_loopnors, 0, sizeof(float[3]) * mesh->totloop);
 	}
 	else {
@@ -54,6 +54,7 @@
 #include "BLI_path_util.h"
 #include "BLI_string.h"
 #include "BLI_string_utils.h"
+#include "BLI_trace.h"
 
 #include "BLT_translation.h"
 
@@ -742,7 +743,12 @@ struct DerivedMesh *modwrap_applyModifier(
 	if (mti->dependsOnNormals && mti->dependsOnNormals(md)) {
 		DM_ensure_normals(dm);
 	}
-	return mti->applyModifier(md, eval_ctx, ob, dm, flag);
+
+	BLI_TRACE_BEGIN("modifier", md->name);
+	dm = mti->applyModifier(md, eval_ctx, ob, dm, flag);
+	BLI_TRACE_END();
+
+	return dm;
 }
 
 struct DerivedMesh *modwrap_applyModifierEM(
@@ -757,7 +763,12 @@ struct DerivedMesh *modwrap_applyModifierEM(
 	if (mti->dependsOnNormals && mti->dependsOnNormals(md)) {
 		DM_ensure_normals(dm);
 	}
-	return mti->applyModifierEM(md, eval_ctx, ob, em, dm, flag);
+
+	BLI_TRACE_BEGIN("modifier", md->name);
+	dm = mti->applyModifierEM(md, eval_ctx, ob, em, dm, flag);
+	BLI_TRACE_END();
+
+	return dm;
 }
 
 void modwrap_deformVerts(
@@ -772,7 +783,10 @@ void modwrap_deformVerts(
 	if (dm && mti->dependsOnNormals && mti->dependsOnNormals(md)) {
 		DM_ensure_normals(dm);
 	}
+
+	BLI_TRACE_BEGIN("modifier", md->name);
 	mti->deformVerts(md, eval_ctx, ob, dm, vertexCos, numVerts, flag);
+	BLI_TRACE_END();
 }
 
 void modwrap_deformVertsEM(
@@ -786,6 +800,9 @@ void modwrap_deformVertsEM(
 	if (dm && mti->dependsOnNormals && mti->dependsOnNormals(md)) {
 		DM_ensure_normals(dm);
 	}
+
+	BLI_TRACE_BEGIN("modifier", md->name);
 	mti->deformVertsEM(md, eval_ctx, ob, em, dm, vertexCos, numVerts);
+	BLI_TRACE_END();
 }
 /* end modifier callback wrappers */
@@ -59,6 +59,8 @@
 #include "BKE_report.h"
 #include "BKE_sound.h"
 
+#include "BLO_readfile.h"
+
 int seekPackedFile(PackedFile *pf, int offset, int whence)
 {
 	int oldseek = -1, seek = 0;
@@ -98,7 +100,7 @@ void rewindPackedFile(PackedFile *pf)
 
 int readPackedFile(PackedFile *pf, void *data, int size)
 { 
-	if ((pf != NULL) && (size >= 0) && (data != NULL)) {
+	if ((pf != NULL) && (size >= 0) && (data != NULL) && BKE_packedfile_ensure_data(pf, NULL)) {
 		if (size + pf->seek > pf->size) {
 			size = pf->size - pf->seek;
 		}
@@ -145,7 +147,8 @@ int countPackedFiles(Main *bmain)
 void freePackedFile(PackedFile *pf)
 {
 	if (pf) {
-		MEM_freeN(pf->data);
+		MEM_SAFE_FREE(pf->data);
+		MEM_SAFE_FREE(pf->lazy);
 		MEM_freeN(pf);
 	}
 	else
@@ -158,10 +161,130 @@ PackedFile *dupPackedFile(const PackedFile *pf_src)
 
 	pf_dst       = MEM_dupallocN(pf_src);
 	pf_dst->data = MEM_dupallocN(pf_src->data);
+	pf_dst->lazy = MEM_dupallocN(pf_src->lazy);
 
 	return pf_dst;
 }
 
+/**
+ * Read data which wasn't loaded with the .blend file (see #BLO_READ_DEFER_PACKED),
+ * call before accessing #PackedFile.data.
+ *
+ * \return false when the data couldn't be read (the file it was loaded from was moved or overwritten),
+ * #PackedFile.data is NULL then and the deferred reference is kept.
+ */
+bool BKE_packedfile_ensure_data(PackedFile *pf, ReportList *reports)
+{
+	void *data;
+
+	if (pf->lazy == NULL) {
+		return true;
+	}
+
+	data = MEM_mallocN((size_t)MAX2(pf->size, 1), "PackedFile.data");
+	if (!BLO_packedfile_lazy_read(pf->lazy, data, pf->size)) {
+		BKE_reportf(reports, RPT_ERROR, "Packed data is no longer available in '%s'", pf->lazy->filepath);
+		MEM_freeN(data);
+		return false;
+	}
+
+	pf->data = data;
+	MEM_freeN(pf->lazy);
+	pf->lazy = NULL;
+
+	return true;
+}
+
+/**
+ * Read all deferred packed data which is written with \a bmain,
+ * so the file the data was loaded from can be overwritten.
+ *
+ * \return false when some data couldn't be read, the failures are reported.
+ */
+bool BKE_packedfile_ensure_data_all(Main *bmain, ReportList *reports)
+{
+	Image *ima;
+	VFont *vfont;
+	bSound *sound;
+	Library *lib;
+	bool ok = true;
+
+	for (ima = bmain->image.first; ima; ima = ima->id.next) {
+		if (!ID_IS_LINKED_DATABLOCK(ima)) {
+			ImagePackedFile *imapf;
+			for (imapf = ima->packedfiles.first; imapf; imapf = imapf->next) {
+				if (imapf->packedfile && !BKE_packedfile_ensure_data(imapf->packedfile, reports)) {
+					ok = false;
+				}
+			}
+		}
+	}
+
+	for (vfont = bmain->vfont.first; vfont; vfont = vfont->id.next) {
+		if (vfont->packedfile && !ID_IS_LINKED_DATABLOCK(vfont) &&
+		    !BKE_packedfile_ensure_data(vfont->packedfile, reports))
+		{
+			ok = false;
+		}
+	}
+
+	for (sound = bmain->sound.first; sound; sound = sound->id.next) {
+		if (sound->packedfile && !ID_IS_LINKED_DATABLOCK(sound) &&
+		    !BKE_packedfile_ensure_data(sound->packedfile, reports))
+		{
+			ok = false;
+		}
+	}
+
+	for (lib = bmain->library.first; lib; lib = lib->id.next) {
+		if (lib->packedfile && !BKE_packedfile_ensure_data(lib->packedfile, reports)) {
+			ok = false;
+		}
+	}
+
+	return ok;
+}
+
+/**
+ * \return true when some packed data of \a bmain hasn't been read yet (see #BKE_packedfile_ensure_data_all).
+ */
+bool BKE_packedfile_has_deferred(Main *bmain)
+{
+	Image *ima;
+	VFont *vfont;
+	bSound *sound;
+	Library *lib;
+
+	for (ima = bmain->image.first; ima; ima = ima->id.next) {
+		ImagePackedFile *imapf;
+		for (imapf = ima->packedfiles.first; imapf; imapf = imapf->next) {
+			if (imapf->packedfile && imapf->packedfile->lazy) {
+				return true;
+			}
+		}
+	}
+
+	for (vfont = bmain->vfont.first; vfont; vfont = vfont->id.next) {
+		if (vfont->packedfile && vfont->packedfile->lazy) {
+			return true;
+		}
+	}
+
+	for (sound = bmain->sound.first; sound; sound = sound->id.next) {
+		if (sound->packedfile && sound->packedfile->lazy) {
+			return true;
+		}
+	}
+
+	for (lib = bmain->library.first; lib; lib = lib->id.next) {
+		if (lib->packedfile && lib->packedfile->lazy) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 PackedFile *newPackedFileMemory(void *mem, int memlen)
 {
 	PackedFile *pf = MEM_callocN(sizeof(*pf), "PackedFile");
@@ -300,6 +423,10 @@ int writePackedFile(ReportList *reports, const char *filename, PackedFile *pf, i
 	char tempname[FILE_MAX];
 /*      void *data; */
 	
+	if (!BKE_packedfile_ensure_data(pf, reports)) {
+		return RET_ERROR;
+	}
+
 	if (guimode) {} //XXX  waitcursor(1);
 	
 	BLI_strncpy(name, filename, sizeof(name));
@@ -380,6 +507,9 @@ int checkPackedFile(const char *filename, PackedFile *pf)
 	else if (st.st_size != pf->size) {
 		ret_val = PF_DIFFERS;
 	}
+	else if (!BKE_packedfile_ensure_data(pf, NULL)) {
+		ret_val = PF_DIFFERS;
+	}
 	else {
 		/* we'll have to compare the two... */
 
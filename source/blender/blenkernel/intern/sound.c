@@ -383,7 +383,7 @@ void BKE_sound_load(struct Main *bmain, bSound *sound)
 			BLI_path_abs(fullpath, ID_BLEND_PATH(bmain, &sound->id));
 
 			/* but we need a packed file then */
-			if (pf)
+			if (pf && BKE_packedfile_ensure_data(pf, NULL))
 				sound->handle = AUD_Sound_bufferFile((unsigned char *) pf->data, pf->size);
 			/* or else load it from disk */
 			else
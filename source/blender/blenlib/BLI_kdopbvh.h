@@ -85,6 +85,8 @@ typedef struct BVHTreeRayHit {
 enum {
 	/* calculate IsectRayPrecalc data */
 	BVH_RAYCAST_WATERTIGHT		= (1 << 0),
+	/* traverse consecutive rays together (#BLI_bvhtree_ray_cast_batch only) */
+	BVH_RAYCAST_PACKET			= (1 << 1),
 };
 #define BVH_RAYCAST_DEFAULT (BVH_RAYCAST_WATERTIGHT)
 #define BVH_RAYCAST_DIST_MAX (FLT_MAX / 2.0f)
@@ -155,6 +157,15 @@ void BLI_bvhtree_ray_cast_all(
         BVHTree *tree, const float co[3], const float dir[3], float radius, float hit_dist,
         BVHTree_RayCastCallback callback, void *userdata);
 
+/* batched queries: threaded, callbacks must be thread-safe, results must be initialized */
+void BLI_bvhtree_ray_cast_batch(
+        BVHTree *tree, const BVHTreeRay *rays, BVHTreeRayHit *hits, const int rays_len,
+        BVHTree_RayCastCallback callback, void *userdata,
+        int flag);
+void BLI_bvhtree_find_nearest_batch(
+        BVHTree *tree, const float (*co)[3], BVHTreeNearest *nearest, const int co_len,
+        BVHTree_NearestPointCallback callback, void *userdata);
+
 float BLI_bvhtree_bb_raycast(const float bv[6], const float light_start[3], const float light_end[3], float pos[3]);
 
 /* range query */
@@ -0,0 +1,49 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+#ifndef __BLI_MPMC_QUEUE_H__
+#define __BLI_MPMC_QUEUE_H__
+
+/** \file BLI_mpmc_queue.h
+ *  \ingroup bli
+ */
+
+#include "BLI_compiler_attrs.h"
+
+typedef struct MPMCQueue MPMCQueue;
+
+MPMCQueue   *BLI_mpmc_queue_new(const size_t elem_size, const unsigned int capacity) ATTR_WARN_UNUSED_RESULT;
+void         BLI_mpmc_queue_free(MPMCQueue *queue) ATTR_NONNULL();
+
+bool         BLI_mpmc_queue_try_push(MPMCQueue *queue, const void *item) ATTR_NONNULL();
+bool         BLI_mpmc_queue_try_pop(MPMCQueue *queue, void *r_item) ATTR_NONNULL();
+
+bool         BLI_mpmc_queue_push(MPMCQueue *queue, const void *item) ATTR_NONNULL();
+bool         BLI_mpmc_queue_pop(MPMCQueue *queue, void *r_item) ATTR_NONNULL();
+bool         BLI_mpmc_queue_pop_timeout(MPMCQueue *queue, void *r_item, int ms) ATTR_NONNULL();
+
+void         BLI_mpmc_queue_nowait(MPMCQueue *queue) ATTR_NONNULL();
+void         BLI_mpmc_queue_wait_empty(MPMCQueue *queue) ATTR_NONNULL();
+
+unsigned int BLI_mpmc_queue_size(const MPMCQueue *queue) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL();
+bool         BLI_mpmc_queue_is_empty(const MPMCQueue *queue) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL();
+unsigned int BLI_mpmc_queue_capacity(const MPMCQueue *queue) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL();
+
+#endif  /* __BLI_MPMC_QUEUE_H__ */
@@ -49,4 +49,29 @@ __attribute__((nonnull(1, 5)))
 #endif
 ;
 
+/* Threaded sorting, see: sort_parallel.c */
+
+/* Key types for #BLI_radix_sort_by_key */
+typedef enum eBLISortKeyType {
+	BLI_SORT_KEY_UINT    = 0,
+	BLI_SORT_KEY_INT     = 1,
+	BLI_SORT_KEY_FLOAT   = 2,
+	BLI_SORT_KEY_UINT64  = 3,
+	/* pointer or uintptr_t, compared by address */
+	BLI_SORT_KEY_PTR     = 4,
+} eBLISortKeyType;
+
+void BLI_radix_sort_uint(unsigned int *data, size_t n);
+void BLI_radix_sort_int(int *data, size_t n);
+void BLI_radix_sort_float(float *data, size_t n);
+void BLI_radix_sort_by_key(
+        void *data, size_t n, size_t es,
+        size_t key_offset, eBLISortKeyType key_type);
+
+void BLI_mergesort_r(void *a, size_t n, size_t es, BLI_sort_cmp_t cmp, void *thunk)
+#ifdef __GNUC__
+__attribute__((nonnull(1, 4)))
+#endif
+;
+
 #endif  /* __BLI_SORT_H__ */
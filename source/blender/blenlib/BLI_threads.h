@@ -159,6 +159,7 @@ typedef pthread_cond_t ThreadCondition;
 void BLI_condition_init(ThreadCondition *cond);
 void BLI_condition_wait(ThreadCondition *cond, ThreadMutex *mutex);
 void BLI_condition_wait_global_mutex(ThreadCondition *cond, const int type);
+bool BLI_condition_wait_timeout(ThreadCondition *cond, ThreadMutex *mutex, int ms);
 void BLI_condition_notify_one(ThreadCondition *cond);
 void BLI_condition_notify_all(ThreadCondition *cond);
 void BLI_condition_end(ThreadCondition *cond);
@@ -170,6 +171,7 @@ void BLI_condition_end(ThreadCondition *cond);
 typedef struct ThreadQueue ThreadQueue;
 
 ThreadQueue *BLI_thread_queue_init(void);
+ThreadQueue *BLI_thread_queue_init_lockfree(const unsigned int capacity);
 void BLI_thread_queue_free(ThreadQueue *queue);
 
 void BLI_thread_queue_push(ThreadQueue *queue, void *work);
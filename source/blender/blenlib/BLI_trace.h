@@ -0,0 +1,68 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+#ifndef __BLI_TRACE_H__
+#define __BLI_TRACE_H__
+
+/** \file BLI_trace.h
+ *  \ingroup bli
+ *  \brief Low overhead scoped profiling, written as Chrome trace JSON.
+ *
+ * Usage:
+ * \code{.c}
+ * BLI_TRACE_BEGIN("modifier", md->name);
+ * ...
+ * BLI_TRACE_END();
+ * \endcode
+ *
+ * When tracing isn't enabled (see #BLI_trace_init) the macros only test a global flag.
+ * Each thread records into its own ring buffer, so only the most recent events are kept.
+ */
+
+#include "BLI_compiler_attrs.h"
+#include "BLI_utildefines.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Don't access directly, use the macros. */
+extern bool BLI_trace_use;
+
+void BLI_trace_init(const char *filepath) ATTR_NONNULL();
+void BLI_trace_exit(void);
+bool BLI_trace_is_enabled(void);
+bool BLI_trace_write(const char *filepath) ATTR_NONNULL();
+
+/* \a category must be a static string, \a name is copied (and may be truncated). */
+void BLI_trace_begin(const char *category, const char *name) ATTR_NONNULL(1);
+void BLI_trace_end(void);
+
+#define BLI_TRACE_BEGIN(category, name) \
+	{ if (UNLIKELY(BLI_trace_use)) { BLI_trace_begin(category, name); } } (void)0
+
+#define BLI_TRACE_END() \
+	{ if (UNLIKELY(BLI_trace_use)) { BLI_trace_end(); } } (void)0
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __BLI_TRACE_H__ */
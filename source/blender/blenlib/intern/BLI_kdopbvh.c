@@ -44,6 +44,8 @@
  *   #BLI_bvhtree_overlap, #BVHOverlapData_Shared, #BVHOverlapData_Thread
  * - Range Query:
  *   #BLI_bvhtree_range_query
+ * - Batched queries (many rays/points against the same tree, threaded):
+ *   #BLI_bvhtree_ray_cast_batch, #BLI_bvhtree_find_nearest_batch
  */
 
 #include <assert.h>
@@ -56,6 +58,7 @@
 #include "BLI_kdopbvh.h"
 #include "BLI_math.h"
 #include "BLI_task.h"
+#include "BLI_threads.h"
 
 #include "BLI_strict_flags.h"
 
@@ -80,6 +83,9 @@
 #  define KDOPBVH_THREAD_LEAF_THRESHOLD 1024
 #endif
 
+/* Number of rays traversed together by #BVH_RAYCAST_PACKET (must fit in the bits of an int). */
+#define KDOPBVH_RAY_PACKET_SIZE 8
+
 
 /* -------------------------------------------------------------------- */
 
@@ -527,6 +533,73 @@ static void refit_kdop_hull(const BVHTree *tree, BVHNode *node, int start, int e
 
 }
 
+typedef struct BVHRefitData {
+	const BVHTree *tree;
+	BVHNode *node;
+	int start;
+} BVHRefitData;
+
+typedef struct BVHRefitData_Chunk {
+	float bv[26];
+} BVHRefitData_Chunk;
+
+static void refit_kdop_hull_task_cb(void *userdata, void *userdata_chunk, const int j, const int UNUSED(thread_id))
+{
+	const BVHRefitData *data = userdata;
+	const BVHTree *tree = data->tree;
+	BVHRefitData_Chunk *chunk = userdata_chunk;
+	const float *node_bv = tree->nodes[data->start + j]->bv;
+	axis_t axis_iter;
+
+	for (axis_iter = tree->start_axis; axis_iter < tree->stop_axis; axis_iter++) {
+		if (node_bv[(2 * axis_iter)] < chunk->bv[(2 * axis_iter)])
+			chunk->bv[(2 * axis_iter)] = node_bv[(2 * axis_iter)];
+		if (node_bv[(2 * axis_iter) + 1] > chunk->bv[(2 * axis_iter) + 1])
+			chunk->bv[(2 * axis_iter) + 1] = node_bv[(2 * axis_iter) + 1];
+	}
+}
+
+static void refit_kdop_hull_finalize(void *userdata, void *userdata_chunk)
+{
+	const BVHRefitData *data = userdata;
+	const BVHTree *tree = data->tree;
+	const BVHRefitData_Chunk *chunk = userdata_chunk;
+	float *bv = data->node->bv;
+	axis_t axis_iter;
+
+	for (axis_iter = tree->start_axis; axis_iter < tree->stop_axis; axis_iter++) {
+		if (chunk->bv[(2 * axis_iter)] < bv[(2 * axis_iter)])
+			bv[(2 * axis_iter)] = chunk->bv[(2 * axis_iter)];
+		if (chunk->bv[(2 * axis_iter) + 1] > bv[(2 * axis_iter) + 1])
+			bv[(2 * axis_iter) + 1] = chunk->bv[(2 * axis_iter) + 1];
+	}
+}
+
+/**
+ * Threaded version of #refit_kdop_hull, used for the top levels of the tree
+ * where only a few branches each have to be fitted around a large number of leafs.
+ *
+ * \note Must not be called from within a task, see #non_recursive_bvh_div_nodes.
+ */
+static void refit_kdop_hull_threaded(const BVHTree *tree, BVHNode *node, int start, int end)
+{
+	BVHRefitData data = {.tree = tree, .node = node, .start = start};
+	BVHRefitData_Chunk chunk;
+	axis_t axis_iter;
+
+	node_minmax_init(tree, node);
+	/* Only the axes in use are initialized, these start at start_axis (not zero for 18-DOP's). */
+	for (axis_iter = tree->start_axis; axis_iter < tree->stop_axis; axis_iter++) {
+		chunk.bv[(2 * axis_iter)] =  FLT_MAX;
+		chunk.bv[(2 * axis_iter) + 1] = -FLT_MAX;
+	}
+
+	BLI_task_parallel_range_finalize(
+	        0, end - start, &data, &chunk, sizeof(chunk),
+	        refit_kdop_hull_task_cb, refit_kdop_hull_finalize,
+	        (end - start) > KDOPBVH_THREAD_LEAF_THRESHOLD, false);
+}
+
 /**
  * only supports x,y,z axis in the moment
  * but we should use a plain and simple function here for speed sake */
@@ -611,7 +684,7 @@ static void bvhtree_info(BVHTree *tree)
 	printf("nodes = %d, branches = %d, leafs = %d\n",
 	       tree->totbranch + tree->totleaf,  tree->totbranch, tree->totleaf);
 	printf("Memory per node = %ubytes\n",
-	       (uint)(sizeof(BVHNode) + sizeof(BVHNode *) * tree->tree_type + sizeof(float) * tree->axis));
+	       (uint)(sizeof(BVHNode) + sizeof(BVHNode *) * tree->tree_type + sizeof(float) * 2 * tree->stop_axis));
 	printf("BV memory = %ubytes\n",
 	       (uint)MEM_allocN_len(tree->nodebv));
 
@@ -796,6 +869,9 @@ typedef struct BVHDivNodesData {
 	int depth;
 	int i;
 	int first_of_next_level;
+
+	/* When set, each branch is handled serially but its bounds are fitted using threads. */
+	bool use_threaded_refit;
 } BVHDivNodesData;
 
 static void non_recursive_bvh_div_nodes_task_cb(void *userdata, const int j)
@@ -813,7 +889,12 @@ static void non_recursive_bvh_div_nodes_task_cb(void *userdata, const int j)
 
 	/* This calculates the bounding box of this branch
 	 * and chooses the largest axis as the axis to divide leafs */
-	refit_kdop_hull(data->tree, parent, parent_leafs_begin, parent_leafs_end);
+	if (data->use_threaded_refit) {
+		refit_kdop_hull_threaded(data->tree, parent, parent_leafs_begin, parent_leafs_end);
+	}
+	else {
+		refit_kdop_hull(data->tree, parent, parent_leafs_begin, parent_leafs_end);
+	}
 	split_axis = get_largest_axis(parent->bv);
 
 	/* Save split axis (this can be used on raytracing to speedup the query time) */
@@ -882,6 +963,8 @@ static void non_recursive_bvh_div_nodes(
 	const int tree_type   = tree->tree_type;
 	const int tree_offset = 2 - tree->tree_type; /* this value is 0 (on binary trees) and negative on the others */
 	const int num_branches = implicit_needed_branches(tree_type, num_leafs);
+	const bool use_threading = num_leafs > KDOPBVH_THREAD_LEAF_THRESHOLD;
+	const int num_threads = BLI_system_thread_count();
 
 	BVHBuildHelper data;
 	int depth;
@@ -910,6 +993,7 @@ static void non_recursive_bvh_div_nodes(
 		.tree = tree, .branches_array = branches_array, .leafs_array = leafs_array,
 		.tree_type = tree_type, .tree_offset = tree_offset, .data = &data,
 		.first_of_next_level = 0, .depth = 0, .i = 0,
+		.use_threaded_refit = false,
 	};
 
 	/* Loop tree levels (log N) loops */
@@ -922,10 +1006,19 @@ static void non_recursive_bvh_div_nodes(
 		cb_data.i = i;
 		cb_data.depth = depth;
 
-		if (true) {
+		if (use_threading && (i_stop - i) < num_threads) {
+			/* Top levels: too few branches to keep all threads busy,
+			 * but each of them covers many leafs, so thread the bounds fitting instead. */
+			cb_data.use_threaded_refit = true;
+			for (int i_task = i; i_task < i_stop; i_task++) {
+				non_recursive_bvh_div_nodes_task_cb(&cb_data, i_task);
+			}
+			cb_data.use_threaded_refit = false;
+		}
+		else if (true) {
 			BLI_task_parallel_range(
 			        i, i_stop, &cb_data, non_recursive_bvh_div_nodes_task_cb,
-			        num_leafs > KDOPBVH_THREAD_LEAF_THRESHOLD);
+			        use_threading);
 		}
 		else {
 			/* Less hassle for debugging. */
@@ -998,7 +1091,8 @@ BVHTree *BLI_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis)
 		numnodes = maxsize + implicit_needed_branches(tree_type, maxsize) + tree_type;
 
 		tree->nodes = MEM_callocN(sizeof(BVHNode *) * (size_t)numnodes, "BVHNodes");
-		tree->nodebv = MEM_callocN(sizeof(float) * (size_t)(axis * numnodes), "BVHNodeBV");
+		/* 18-DOP's use the axes from start_axis to stop_axis, more floats than 'axis'. */
+		tree->nodebv = MEM_callocN(sizeof(float) * (size_t)(2 * tree->stop_axis * numnodes), "BVHNodeBV");
 		tree->nodechild = MEM_callocN(sizeof(BVHNode *) * (size_t)(tree_type * numnodes), "BVHNodeBV");
 		tree->nodearray = MEM_callocN(sizeof(BVHNode) * (size_t)numnodes, "BVHNodeArray");
 		
@@ -1012,7 +1106,7 @@ BVHTree *BLI_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis)
 
 		/* link the dynamic bv and child links */
 		for (i = 0; i < numnodes; i++) {
-			tree->nodearray[i].bv = &tree->nodebv[i * axis];
+			tree->nodearray[i].bv = &tree->nodebv[i * 2 * tree->stop_axis];
 			tree->nodearray[i].children = &tree->nodechild[i * tree_type];
 		}
 		
@@ -1911,6 +2005,225 @@ void BLI_bvhtree_ray_cast_all(
 }
 
 
+/* -------------------------------------------------------------------- */
+
+/** \name BLI_bvhtree_ray_cast_batch / BLI_bvhtree_find_nearest_batch
+ *
+ * Run many independent queries against the same tree, split over threads.
+ * Callbacks are called from multiple threads so they must be thread-safe.
+ *
+ * \{ */
+
+typedef struct BVHRayCastBatchData {
+	BVHTree *tree;
+	const BVHTreeRay *rays;
+	BVHTreeRayHit *hits;
+	int rays_len;
+
+	BVHTree_RayCastCallback callback;
+	void *userdata;
+	int flag;
+} BVHRayCastBatchData;
+
+typedef struct BVHNearestBatchData {
+	BVHTree *tree;
+	const float (*co)[3];
+	BVHTreeNearest *nearest;
+
+	BVHTree_NearestPointCallback callback;
+	void *userdata;
+} BVHNearestBatchData;
+
+static void bvhtree_ray_cast_data_init(
+        BVHRayCastData *data, const BVHTree *tree, const BVHTreeRay *ray, const BVHTreeRayHit *hit,
+        BVHTree_RayCastCallback callback, void *userdata, int flag)
+{
+	BLI_ASSERT_UNIT_V3(ray->direction);
+
+	data->tree = tree;
+
+	data->callback = callback;
+	data->userdata = userdata;
+
+	copy_v3_v3(data->ray.origin,    ray->origin);
+	copy_v3_v3(data->ray.direction, ray->direction);
+	data->ray.radius = ray->radius;
+
+	bvhtree_ray_cast_data_precalc(data, flag);
+
+	memcpy(&data->hit, hit, sizeof(*hit));
+}
+
+/**
+ * Traverse the tree once for a packet of rays,
+ * \a ray_mask has a bit set for every ray in the packet still able to hit \a node.
+ *
+ * Works best for coherent rays (similar origin and direction),
+ * since the child order is picked from the first active ray.
+ */
+static void dfs_raycast_packet(BVHRayCastData *packet, BVHNode *node, unsigned int ray_mask)
+{
+	float dist[KDOPBVH_RAY_PACKET_SIZE];
+	unsigned int ray_mask_hit = 0;
+	int ray_lead = -1;
+	int i;
+
+	for (i = 0; i < KDOPBVH_RAY_PACKET_SIZE; i++) {
+		if (ray_mask & (1u << i)) {
+			BVHRayCastData *data = &packet[i];
+			dist[i] = (data->ray.radius == 0.0f) ? fast_ray_nearest_hit(data, node) : ray_nearest_hit(data, node->bv);
+			if (dist[i] < data->hit.dist) {
+				ray_mask_hit |= (1u << i);
+				if (ray_lead == -1) {
+					ray_lead = i;
+				}
+			}
+		}
+	}
+
+	if (ray_mask_hit == 0) {
+		return;
+	}
+
+	if (node->totnode == 0) {
+		for (i = 0; i < KDOPBVH_RAY_PACKET_SIZE; i++) {
+			if (ray_mask_hit & (1u << i)) {
+				BVHRayCastData *data = &packet[i];
+				if (data->callback) {
+					data->callback(data->userdata, node->index, &data->ray, &data->hit);
+				}
+				else {
+					data->hit.index = node->index;
+					data->hit.dist  = dist[i];
+					madd_v3_v3v3fl(data->hit.co, data->ray.origin, data->ray.direction, dist[i]);
+				}
+			}
+		}
+	}
+	else {
+		/* pick loop direction to dive into the tree (based on the lead ray direction and split axis) */
+		if (packet[ray_lead].ray_dot_axis[node->main_axis] > 0.0f) {
+			for (i = 0; i != node->totnode; i++) {
+				dfs_raycast_packet(packet, node->children[i], ray_mask_hit);
+			}
+		}
+		else {
+			for (i = node->totnode - 1; i >= 0; i--) {
+				dfs_raycast_packet(packet, node->children[i], ray_mask_hit);
+			}
+		}
+	}
+}
+
+static void bvhtree_ray_cast_batch_task_cb(void *userdata, const int i)
+{
+	const BVHRayCastBatchData *batch = userdata;
+	BVHNode *root = batch->tree->nodes[batch->tree->totleaf];
+	BVHRayCastData data;
+
+	bvhtree_ray_cast_data_init(
+	        &data, batch->tree, &batch->rays[i], &batch->hits[i],
+	        batch->callback, batch->userdata, batch->flag);
+
+	dfs_raycast(&data, root);
+
+	memcpy(&batch->hits[i], &data.hit, sizeof(data.hit));
+}
+
+static void bvhtree_ray_cast_batch_packet_task_cb(void *userdata, const int packet_index)
+{
+	const BVHRayCastBatchData *batch = userdata;
+	BVHNode *root = batch->tree->nodes[batch->tree->totleaf];
+	BVHRayCastData packet[KDOPBVH_RAY_PACKET_SIZE];
+	const int i_start = packet_index * KDOPBVH_RAY_PACKET_SIZE;
+	const int i_end = min_ii(i_start + KDOPBVH_RAY_PACKET_SIZE, batch->rays_len);
+	unsigned int ray_mask = 0;
+	int i;
+
+	for (i = i_start; i < i_end; i++) {
+		BVHRayCastData *data = &packet[i - i_start];
+		bvhtree_ray_cast_data_init(
+		        data, batch->tree, &batch->rays[i], &batch->hits[i],
+		        batch->callback, batch->userdata, batch->flag);
+		ray_mask |= (1u << (i - i_start));
+	}
+
+	dfs_raycast_packet(packet, root, ray_mask);
+
+	for (i = i_start; i < i_end; i++) {
+		memcpy(&batch->hits[i], &packet[i - i_start].hit, sizeof(packet[0].hit));
+	}
+}
+
+/**
+ * Cast an array of rays against the tree, using threads for large batches.
+ *
+ * \param rays: Ray origin, (unit length) direction and radius, \a isect_precalc is ignored.
+ * \param hits: Must be initialized by the caller,
+ * as when passing \a hit to #BLI_bvhtree_ray_cast_ex (index -1, dist #BVH_RAYCAST_DIST_MAX typically).
+ * \param callback: Called from multiple threads, must be thread-safe.
+ * \param flag: #BVH_RAYCAST_PACKET traverses the tree once for groups of consecutive rays,
+ * only useful when neighboring rays are coherent.
+ */
+void BLI_bvhtree_ray_cast_batch(
+        BVHTree *tree, const BVHTreeRay *rays, BVHTreeRayHit *hits, const int rays_len,
+        BVHTree_RayCastCallback callback, void *userdata,
+        int flag)
+{
+	BVHRayCastBatchData batch = {
+		.tree = tree, .rays = rays, .hits = hits, .rays_len = rays_len,
+		.callback = callback, .userdata = userdata, .flag = flag,
+	};
+	const bool use_threading = rays_len > KDOPBVH_THREAD_LEAF_THRESHOLD;
+
+	if (tree->nodes[tree->totleaf] == NULL || rays_len == 0) {
+		return;
+	}
+
+	if (flag & BVH_RAYCAST_PACKET) {
+		const int packets_len = (rays_len + KDOPBVH_RAY_PACKET_SIZE - 1) / KDOPBVH_RAY_PACKET_SIZE;
+		BLI_task_parallel_range(
+		        0, packets_len, &batch, bvhtree_ray_cast_batch_packet_task_cb,
+		        use_threading);
+	}
+	else {
+		BLI_task_parallel_range(
+		        0, rays_len, &batch, bvhtree_ray_cast_batch_task_cb,
+		        use_threading);
+	}
+}
+
+static void bvhtree_find_nearest_batch_task_cb(void *userdata, const int i)
+{
+	const BVHNearestBatchData *batch = userdata;
+
+	BLI_bvhtree_find_nearest(batch->tree, batch->co[i], &batch->nearest[i], batch->callback, batch->userdata);
+}
+
+/**
+ * Find the nearest node for an array of coordinates, using threads for large batches.
+ *
+ * \param nearest: Must be initialized by the caller,
+ * as when passing \a nearest to #BLI_bvhtree_find_nearest (index -1, dist_sq FLT_MAX typically).
+ * \param callback: Called from multiple threads, must be thread-safe.
+ */
+void BLI_bvhtree_find_nearest_batch(
+        BVHTree *tree, const float (*co)[3], BVHTreeNearest *nearest, const int co_len,
+        BVHTree_NearestPointCallback callback, void *userdata)
+{
+	BVHNearestBatchData batch = {
+		.tree = tree, .co = co, .nearest = nearest,
+		.callback = callback, .userdata = userdata,
+	};
+
+	BLI_task_parallel_range(
+	        0, co_len, &batch, bvhtree_find_nearest_batch_task_cb,
+	        co_len > KDOPBVH_THREAD_LEAF_THRESHOLD);
+}
+
+/** \} */
+
+
 /* -------------------------------------------------------------------- */
 
 /** \name BLI_bvhtree_range_query
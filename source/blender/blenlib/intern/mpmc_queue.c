@@ -0,0 +1,398 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenlib/intern/mpmc_queue.c
+ *  \ingroup bli
+ *
+ * \brief A bounded, lock-free, multi-producer/multi-consumer queue
+ * of fixed size elements (first-in-first-out).
+ *
+ * Based on Dmitry Vyukov's bounded MPMC queue: every cell stores a sequence number
+ * telling whether it's ready to be written or read for the current lap around the ring,
+ * so producers and consumers only contend on the head/tail counters.
+ *
+ * Blocking push/pop first spin on the non-blocking versions,
+ * then sleep on a condition, which is only signaled when there are sleeping threads.
+ */
+
+#include <string.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_math_base.h"
+#include "BLI_mpmc_queue.h"
+#include "BLI_threads.h"
+
+#include "PIL_time.h"
+
+#include "atomic_ops.h"
+
+#include "BLI_strict_flags.h"
+
+/* Number of tries before a blocking push/pop goes to sleep. */
+#define MPMC_SPIN_COUNT 64
+
+#define MPMC_CACHELINE_SIZE 64
+
+/* Each cell is followed by the element data, see #MPMC_CELL_DATA. */
+typedef struct MPMCQueueCell {
+	size_t sequence;
+} MPMCQueueCell;
+
+#define MPMC_CELL_DATA(cell) ((void *)((cell) + 1))
+
+struct MPMCQueue {
+	char *cells;
+	size_t cell_size;
+	size_t elem_size;
+	size_t mask;
+
+	/* keep the counters on their own cache lines */
+	char _pad0[MPMC_CACHELINE_SIZE];
+	size_t tail;  /* next push */
+	char _pad1[MPMC_CACHELINE_SIZE - sizeof(size_t)];
+	size_t head;  /* next pop */
+	char _pad2[MPMC_CACHELINE_SIZE - sizeof(size_t)];
+
+	/* only used by blocking calls */
+	ThreadMutex mutex;
+	ThreadCondition cond_pop;
+	ThreadCondition cond_push;
+	ThreadCondition cond_empty;
+	uint32_t waiters_pop;
+	uint32_t waiters_push;
+	uint32_t waiters_empty;
+	uint32_t nowait;
+};
+
+BLI_INLINE size_t load_z(const size_t *p)
+{
+	return *(const volatile size_t *)p;
+}
+
+/* Read a counter which is modified by other threads, acts as a full barrier. */
+BLI_INLINE uint32_t load_barrier_uint32(uint32_t *p)
+{
+	return atomic_fetch_and_add_uint32(p, 0);
+}
+
+BLI_INLINE MPMCQueueCell *queue_cell(const MPMCQueue *queue, const size_t pos)
+{
+	return (MPMCQueueCell *)(queue->cells + (pos & queue->mask) * queue->cell_size);
+}
+
+/**
+ * Create a new queue.
+ *
+ * \param elem_size: Size of the elements, items are copied in and out of the queue.
+ * \param capacity: Maximum number of elements, rounded up to a power of two.
+ */
+MPMCQueue *BLI_mpmc_queue_new(const size_t elem_size, const unsigned int capacity)
+{
+	MPMCQueue *queue = MEM_callocN(sizeof(*queue), "BLI_mpmc_queue_new");
+	const size_t cells_len = (size_t)power_of_2_max_u(MAX2(capacity, 2u));
+	size_t i;
+
+	queue->elem_size = elem_size;
+	/* keep the sequence numbers aligned */
+	queue->cell_size = sizeof(MPMCQueueCell) + ((elem_size + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1));
+	queue->mask = cells_len - 1;
+	queue->cells = MEM_mallocN_aligned(cells_len * queue->cell_size, MPMC_CACHELINE_SIZE, "MPMCQueue.cells");
+
+	for (i = 0; i < cells_len; i++) {
+		queue_cell(queue, i)->sequence = i;
+	}
+
+	BLI_mutex_init(&queue->mutex);
+	BLI_condition_init(&queue->cond_pop);
+	BLI_condition_init(&queue->cond_push);
+	BLI_condition_init(&queue->cond_empty);
+
+	return queue;
+}
+
+/**
+ * Assumes no other thread is using the queue anymore.
+ */
+void BLI_mpmc_queue_free(MPMCQueue *queue)
+{
+	BLI_condition_end(&queue->cond_empty);
+	BLI_condition_end(&queue->cond_push);
+	BLI_condition_end(&queue->cond_pop);
+	BLI_mutex_end(&queue->mutex);
+
+	MEM_freeN(queue->cells);
+	MEM_freeN(queue);
+}
+
+static void queue_notify(MPMCQueue *queue, ThreadCondition *cond, const bool all)
+{
+	BLI_mutex_lock(&queue->mutex);
+	if (all) {
+		BLI_condition_notify_all(cond);
+	}
+	else {
+		BLI_condition_notify_one(cond);
+	}
+	BLI_mutex_unlock(&queue->mutex);
+}
+
+/* Wake threads waiting on a push/pop, must not be called with the mutex locked. */
+static void queue_notify_pushed(MPMCQueue *queue)
+{
+	if (load_barrier_uint32(&queue->waiters_pop)) {
+		queue_notify(queue, &queue->cond_pop, false);
+	}
+}
+
+static void queue_notify_popped(MPMCQueue *queue)
+{
+	if (load_barrier_uint32(&queue->waiters_push)) {
+		queue_notify(queue, &queue->cond_push, false);
+	}
+	if (load_barrier_uint32(&queue->waiters_empty) && BLI_mpmc_queue_is_empty(queue)) {
+		queue_notify(queue, &queue->cond_empty, true);
+	}
+}
+
+static bool queue_try_push(MPMCQueue *queue, const void *item)
+{
+	MPMCQueueCell *cell;
+	size_t pos = load_z(&queue->tail);
+	intptr_t diff;
+
+	while (true) {
+		cell = queue_cell(queue, pos);
+		diff = (intptr_t)load_z(&cell->sequence) - (intptr_t)pos;
+		if (diff == 0) {
+			const size_t pos_prev = atomic_cas_z(&queue->tail, pos, pos + 1);
+			if (pos_prev == pos) {
+				break;
+			}
+			pos = pos_prev;
+		}
+		else if (diff < 0) {
+			/* the cell wasn't popped yet from the previous lap */
+			return false;
+		}
+		else {
+			pos = load_z(&queue->tail);
+		}
+	}
+
+	memcpy(MPMC_CELL_DATA(cell), item, queue->elem_size);
+	/* publish, sequence becomes 'pos + 1' */
+	atomic_add_and_fetch_z(&cell->sequence, 1);
+	return true;
+}
+
+static bool queue_try_pop(MPMCQueue *queue, void *r_item)
+{
+	MPMCQueueCell *cell;
+	size_t pos = load_z(&queue->head);
+	intptr_t diff;
+
+	while (true) {
+		cell = queue_cell(queue, pos);
+		diff = (intptr_t)load_z(&cell->sequence) - (intptr_t)(pos + 1);
+		if (diff == 0) {
+			const size_t pos_prev = atomic_cas_z(&queue->head, pos, pos + 1);
+			if (pos_prev == pos) {
+				break;
+			}
+			pos = pos_prev;
+		}
+		else if (diff < 0) {
+			/* the cell wasn't pushed yet */
+			return false;
+		}
+		else {
+			pos = load_z(&queue->head);
+		}
+	}
+
+	memcpy(r_item, MPMC_CELL_DATA(cell), queue->elem_size);
+	/* release the cell for the next lap, sequence becomes 'pos + mask + 1' */
+	atomic_add_and_fetch_z(&cell->sequence, queue->mask);
+	return true;
+}
+
+/**
+ * Push an element, never blocks.
+ *
+ * \return false when the queue is full.
+ */
+bool BLI_mpmc_queue_try_push(MPMCQueue *queue, const void *item)
+{
+	if (queue_try_push(queue, item)) {
+		queue_notify_pushed(queue);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Pop an element, never blocks.
+ *
+ * \return false when the queue is empty.
+ */
+bool BLI_mpmc_queue_try_pop(MPMCQueue *queue, void *r_item)
+{
+	if (queue_try_pop(queue, r_item)) {
+		queue_notify_popped(queue);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Push an element, waits while the queue is full.
+ *
+ * \return false when the queue is full and #BLI_mpmc_queue_nowait was called.
+ */
+bool BLI_mpmc_queue_push(MPMCQueue *queue, const void *item)
+{
+	int i;
+	bool ok;
+
+	for (i = 0; i < MPMC_SPIN_COUNT; i++) {
+		if (BLI_mpmc_queue_try_push(queue, item)) {
+			return true;
+		}
+	}
+
+	BLI_mutex_lock(&queue->mutex);
+	atomic_add_and_fetch_uint32(&queue->waiters_push, 1);
+	while (!(ok = queue_try_push(queue, item)) && !queue->nowait) {
+		BLI_condition_wait(&queue->cond_push, &queue->mutex);
+	}
+	atomic_sub_and_fetch_uint32(&queue->waiters_push, 1);
+	BLI_mutex_unlock(&queue->mutex);
+
+	if (ok) {
+		queue_notify_pushed(queue);
+	}
+
+	return ok;
+}
+
+static bool queue_pop_wait(MPMCQueue *queue, void *r_item, const int ms)
+{
+	const double time_start = (ms != -1) ? PIL_check_seconds_timer() : 0.0;
+	int i;
+	bool ok;
+
+	for (i = 0; i < MPMC_SPIN_COUNT; i++) {
+		if (BLI_mpmc_queue_try_pop(queue, r_item)) {
+			return true;
+		}
+	}
+
+	BLI_mutex_lock(&queue->mutex);
+	atomic_add_and_fetch_uint32(&queue->waiters_pop, 1);
+	while (!(ok = queue_try_pop(queue, r_item)) && !queue->nowait) {
+		if (ms == -1) {
+			BLI_condition_wait(&queue->cond_pop, &queue->mutex);
+		}
+		else {
+			const int ms_left = ms - (int)((PIL_check_seconds_timer() - time_start) * 1000.0);
+			if (ms_left <= 0 || !BLI_condition_wait_timeout(&queue->cond_pop, &queue->mutex, ms_left)) {
+				ok = queue_try_pop(queue, r_item);
+				break;
+			}
+		}
+	}
+	atomic_sub_and_fetch_uint32(&queue->waiters_pop, 1);
+	BLI_mutex_unlock(&queue->mutex);
+
+	if (ok) {
+		queue_notify_popped(queue);
+	}
+
+	return ok;
+}
+
+/**
+ * Pop an element, waits while the queue is empty.
+ *
+ * \return false when the queue is empty and #BLI_mpmc_queue_nowait was called.
+ */
+bool BLI_mpmc_queue_pop(MPMCQueue *queue, void *r_item)
+{
+	return queue_pop_wait(queue, r_item, -1);
+}
+
+/**
+ * Pop an element, waits at most \a ms milliseconds while the queue is empty.
+ *
+ * \return false when no element could be popped.
+ */
+bool BLI_mpmc_queue_pop_timeout(MPMCQueue *queue, void *r_item, int ms)
+{
+	return queue_pop_wait(queue, r_item, max_ii(ms, 0));
+}
+
+/**
+ * Wake up all waiting threads, from now on push and pop return instead of waiting.
+ */
+void BLI_mpmc_queue_nowait(MPMCQueue *queue)
+{
+	BLI_mutex_lock(&queue->mutex);
+	atomic_fetch_and_or_uint32(&queue->nowait, 1);
+	BLI_condition_notify_all(&queue->cond_pop);
+	BLI_condition_notify_all(&queue->cond_push);
+	BLI_mutex_unlock(&queue->mutex);
+}
+
+/**
+ * Wait until all elements have been popped.
+ */
+void BLI_mpmc_queue_wait_empty(MPMCQueue *queue)
+{
+	BLI_mutex_lock(&queue->mutex);
+	atomic_add_and_fetch_uint32(&queue->waiters_empty, 1);
+	while (!BLI_mpmc_queue_is_empty(queue)) {
+		BLI_condition_wait(&queue->cond_empty, &queue->mutex);
+	}
+	atomic_sub_and_fetch_uint32(&queue->waiters_empty, 1);
+	BLI_mutex_unlock(&queue->mutex);
+}
+
+/**
+ * \note Only approximate while other threads push or pop.
+ */
+unsigned int BLI_mpmc_queue_size(const MPMCQueue *queue)
+{
+	const size_t head = load_z(&queue->head);
+	const size_t tail = load_z(&queue->tail);
+	/* 'head' may have passed the 'tail' we read before it */
+	return (tail > head) ? (unsigned int)(tail - head) : 0;
+}
+
+bool BLI_mpmc_queue_is_empty(const MPMCQueue *queue)
+{
+	return BLI_mpmc_queue_size(queue) == 0;
+}
+
+unsigned int BLI_mpmc_queue_capacity(const MPMCQueue *queue)
+{
+	return (unsigned int)queue->mask + 1;
+}
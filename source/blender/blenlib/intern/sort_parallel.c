@@ -0,0 +1,486 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenlib/intern/sort_parallel.c
+ *  \ingroup bli
+ *
+ * Threaded sorting of large arrays.
+ *
+ * - Radix sort (LSD, 8 bits per pass) for integer, float and pointer keys.
+ *   Each pass counts digits per chunk, then scatters every chunk to its own
+ *   offsets, so the sort is stable and chunks can run in parallel.
+ *   Passes where all keys share the same digit are skipped.
+ *
+ * - Merge sort with a comparator. Chunks are sorted independently,
+ *   then merged in rounds, where each merge is split into equally sized
+ *   output segments (merge-path), so all threads stay busy in the final rounds.
+ *
+ * Both are stable and fall back to a single thread for small arrays.
+ */
+
+#include <string.h>
+#include <stdint.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_utildefines.h"
+
+#include "BLI_sort.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+
+#include "BLI_strict_flags.h"
+
+/* Minimum number of elements handled by one chunk (thread). */
+#define SORT_CHUNK_MIN 8192
+
+/* Runs of this length are insertion sorted before merging. */
+#define MERGESORT_RUN_LEN 16
+
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+
+/**
+ * Copy a single element, common sizes use fixed size copies.
+ */
+BLI_INLINE void elem_copy(void *dst, const void *src, const size_t es)
+{
+	switch (es) {
+		case 4:  memcpy(dst, src, 4);  break;
+		case 8:  memcpy(dst, src, 8);  break;
+		case 16: memcpy(dst, src, 16); break;
+		default: memcpy(dst, src, es); break;
+	}
+}
+
+static int sort_chunks_num(const size_t n)
+{
+	const size_t chunks_max = n / SORT_CHUNK_MIN;
+	if (chunks_max <= 1) {
+		return 1;
+	}
+	else {
+		const int num_threads = BLI_task_scheduler_num_threads(BLI_task_scheduler_get());
+		return (int)MIN2(chunks_max, (size_t)num_threads);
+	}
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Radix Sort
+ * \{ */
+
+typedef struct RadixSortData {
+	char *src;
+	char *dst;
+	size_t n, es;
+	size_t key_offset;
+	eBLISortKeyType key_type;
+
+	int chunks_num;
+	size_t chunk_len;
+
+	int shift;
+	/* chunks_num * RADIX_SIZE, counts, then offsets into 'dst' */
+	size_t *hist;
+} RadixSortData;
+
+/**
+ * Map keys to unsigned integers with the same order.
+ */
+BLI_INLINE uint64_t radix_key_get(const char *elem, const eBLISortKeyType key_type)
+{
+	switch (key_type) {
+		case BLI_SORT_KEY_UINT:
+			return *(const uint32_t *)elem;
+		case BLI_SORT_KEY_INT:
+			return (uint32_t)(*(const int32_t *)elem) ^ 0x80000000u;
+		case BLI_SORT_KEY_FLOAT:
+		{
+			/* flip all bits of negative numbers, only the sign bit of positive ones */
+			uint32_t u;
+			memcpy(&u, elem, sizeof(u));
+			return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+		}
+		case BLI_SORT_KEY_UINT64:
+			return *(const uint64_t *)elem;
+		case BLI_SORT_KEY_PTR:
+			return (uint64_t)(*(const uintptr_t *)elem);
+	}
+	BLI_assert(0);
+	return 0;
+}
+
+static size_t radix_key_size(const eBLISortKeyType key_type)
+{
+	switch (key_type) {
+		case BLI_SORT_KEY_UINT:
+		case BLI_SORT_KEY_INT:
+		case BLI_SORT_KEY_FLOAT:
+			return 4;
+		case BLI_SORT_KEY_UINT64:
+			return 8;
+		case BLI_SORT_KEY_PTR:
+			return sizeof(uintptr_t);
+	}
+	BLI_assert(0);
+	return 0;
+}
+
+BLI_INLINE void radix_chunk_range(const RadixSortData *data, const int chunk, size_t *r_start, size_t *r_end)
+{
+	*r_start = (size_t)chunk * data->chunk_len;
+	*r_end = (chunk == data->chunks_num - 1) ? data->n : *r_start + data->chunk_len;
+}
+
+static void radix_count_cb(void *userdata, const int chunk)
+{
+	const RadixSortData *data = userdata;
+	size_t *hist = &data->hist[(size_t)chunk * RADIX_SIZE];
+	const char *src = data->src + data->key_offset;
+	const size_t es = data->es;
+	const int shift = data->shift;
+	size_t i, i_end;
+
+	memset(hist, 0, sizeof(*hist) * RADIX_SIZE);
+	radix_chunk_range(data, chunk, &i, &i_end);
+	for (src += i * es; i < i_end; i++, src += es) {
+		hist[(radix_key_get(src, data->key_type) >> shift) & (RADIX_SIZE - 1)]++;
+	}
+}
+
+static void radix_scatter_cb(void *userdata, const int chunk)
+{
+	const RadixSortData *data = userdata;
+	size_t *offset = &data->hist[(size_t)chunk * RADIX_SIZE];
+	const char *src = data->src;
+	char *dst = data->dst;
+	const size_t es = data->es;
+	const size_t key_offset = data->key_offset;
+	const int shift = data->shift;
+	size_t i, i_end;
+
+	radix_chunk_range(data, chunk, &i, &i_end);
+	for (src += i * es; i < i_end; i++, src += es) {
+		const size_t digit = (radix_key_get(src + key_offset, data->key_type) >> shift) & (RADIX_SIZE - 1);
+		elem_copy(dst + offset[digit]++ * es, src, es);
+	}
+}
+
+/**
+ * Convert per chunk counts into destination offsets,
+ * digit major so equal digits keep their chunk order (stable).
+ *
+ * \return false when all keys share the same digit, the pass can be skipped.
+ */
+static bool radix_offsets_calc(RadixSortData *data)
+{
+	size_t *hist = data->hist;
+	size_t offset = 0;
+	int digit, chunk;
+
+	for (digit = 0; digit < RADIX_SIZE; digit++) {
+		size_t total = 0;
+		for (chunk = 0; chunk < data->chunks_num; chunk++) {
+			total += hist[(size_t)chunk * RADIX_SIZE + (size_t)digit];
+		}
+		if (total == data->n) {
+			return false;
+		}
+		for (chunk = 0; chunk < data->chunks_num; chunk++) {
+			size_t *h = &hist[(size_t)chunk * RADIX_SIZE + (size_t)digit];
+			const size_t count = *h;
+			*h = offset;
+			offset += count;
+		}
+	}
+	return true;
+}
+
+/**
+ * Stable sort of \a n elements of size \a es, by the key at \a key_offset.
+ */
+void BLI_radix_sort_by_key(
+        void *data, size_t n, size_t es,
+        size_t key_offset, eBLISortKeyType key_type)
+{
+	RadixSortData sd;
+	char *buf;
+	const int key_bits = (int)radix_key_size(key_type) * 8;
+
+	BLI_assert(key_offset + radix_key_size(key_type) <= es);
+
+	if (n < 2) {
+		return;
+	}
+
+	buf = MEM_mallocN(n * es, __func__);
+
+	sd.src = data;
+	sd.dst = buf;
+	sd.n = n;
+	sd.es = es;
+	sd.key_offset = key_offset;
+	sd.key_type = key_type;
+	sd.chunks_num = sort_chunks_num(n);
+	sd.chunk_len = n / (size_t)sd.chunks_num;
+	sd.hist = MEM_mallocN(sizeof(*sd.hist) * (size_t)sd.chunks_num * RADIX_SIZE, __func__);
+
+	for (sd.shift = 0; sd.shift < key_bits; sd.shift += RADIX_BITS) {
+		const bool use_threading = (sd.chunks_num > 1);
+
+		BLI_task_parallel_range(0, sd.chunks_num, &sd, radix_count_cb, use_threading);
+		if (radix_offsets_calc(&sd)) {
+			BLI_task_parallel_range(0, sd.chunks_num, &sd, radix_scatter_cb, use_threading);
+			SWAP(char *, sd.src, sd.dst);
+		}
+	}
+
+	if (sd.src != data) {
+		memcpy(data, sd.src, n * es);
+	}
+
+	MEM_freeN(sd.hist);
+	MEM_freeN(buf);
+}
+
+void BLI_radix_sort_uint(unsigned int *data, size_t n)
+{
+	BLI_radix_sort_by_key(data, n, sizeof(*data), 0, BLI_SORT_KEY_UINT);
+}
+
+void BLI_radix_sort_int(int *data, size_t n)
+{
+	BLI_radix_sort_by_key(data, n, sizeof(*data), 0, BLI_SORT_KEY_INT);
+}
+
+/**
+ * \note Orders -0.0 before 0.0, NaN's are sorted to the ends (by sign).
+ */
+void BLI_radix_sort_float(float *data, size_t n)
+{
+	BLI_radix_sort_by_key(data, n, sizeof(*data), 0, BLI_SORT_KEY_FLOAT);
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Merge Sort
+ * \{ */
+
+typedef struct MergeSortData {
+	char *src;
+	char *dst;
+	size_t n, es;
+	BLI_sort_cmp_t cmp;
+	void *thunk;
+
+	size_t chunk_len;
+	/* length of the sorted runs being merged */
+	size_t width;
+} MergeSortData;
+
+#define ELEM_PTR(base, i) ((base) + (i) * es)
+
+static void insertion_sort(char *a, const size_t n, const size_t es, BLI_sort_cmp_t cmp, void *thunk, char *tmp)
+{
+	size_t i, j;
+	for (i = 1; i < n; i++) {
+		if (cmp(ELEM_PTR(a, i - 1), ELEM_PTR(a, i), thunk) <= 0) {
+			continue;
+		}
+		elem_copy(tmp, ELEM_PTR(a, i), es);
+		for (j = i; j > 0 && cmp(ELEM_PTR(a, j - 1), tmp, thunk) > 0; j--) {
+			elem_copy(ELEM_PTR(a, j), ELEM_PTR(a, j - 1), es);
+		}
+		elem_copy(ELEM_PTR(a, j), tmp, es);
+	}
+}
+
+/**
+ * Merge \a a & \a b into \a dst, on equal elements \a a comes first.
+ */
+static void merge(
+        const char *a, size_t a_len, const char *b, size_t b_len, char *dst,
+        const size_t es, BLI_sort_cmp_t cmp, void *thunk)
+{
+	const char *a_end = ELEM_PTR(a, a_len);
+	const char *b_end = ELEM_PTR(b, b_len);
+
+	while (a != a_end && b != b_end) {
+		if (cmp(b, a, thunk) < 0) {
+			elem_copy(dst, b, es);
+			b += es;
+		}
+		else {
+			elem_copy(dst, a, es);
+			a += es;
+		}
+		dst += es;
+	}
+	if (a != a_end) {
+		memcpy(dst, a, (size_t)(a_end - a));
+	}
+	else if (b != b_end) {
+		memcpy(dst, b, (size_t)(b_end - b));
+	}
+}
+
+/**
+ * Find how many elements of \a a are in the first \a pos elements of the merge of \a a & \a b.
+ */
+static size_t merge_split(
+        const char *a, size_t a_len, const char *b, size_t b_len, size_t pos,
+        const size_t es, BLI_sort_cmp_t cmp, void *thunk)
+{
+	size_t lo = (pos > b_len) ? pos - b_len : 0;
+	size_t hi = MIN2(pos, a_len);
+
+	while (lo < hi) {
+		const size_t i = (lo + hi) / 2;
+		const size_t j = pos - i;
+		/* a[i] comes before b[j - 1], so more of 'a' is needed */
+		if (j > 0 && cmp(ELEM_PTR(a, i), ELEM_PTR(b, j - 1), thunk) <= 0) {
+			lo = i + 1;
+		}
+		else {
+			hi = i;
+		}
+	}
+	return lo;
+}
+
+/**
+ * Serial merge sort of \a a, using \a buf (same size) as scratch space.
+ * Result is in \a a.
+ */
+static void mergesort_serial(
+        char *a, char *buf, const size_t n,
+        const size_t es, BLI_sort_cmp_t cmp, void *thunk)
+{
+	char *src = a, *dst = buf;
+	size_t i, width;
+
+	for (i = 0; i < n; i += MERGESORT_RUN_LEN) {
+		insertion_sort(ELEM_PTR(a, i), MIN2((size_t)MERGESORT_RUN_LEN, n - i), es, cmp, thunk, buf);
+	}
+
+	for (width = MERGESORT_RUN_LEN; width < n; width *= 2) {
+		for (i = 0; i < n; i += 2 * width) {
+			const size_t a_len = MIN2(width, n - i);
+			const size_t b_len = MIN2(width, n - i - a_len);
+			merge(ELEM_PTR(src, i), a_len, ELEM_PTR(src, i + a_len), b_len, ELEM_PTR(dst, i), es, cmp, thunk);
+		}
+		SWAP(char *, src, dst);
+	}
+
+	if (src != a) {
+		memcpy(a, src, n * es);
+	}
+}
+
+static void mergesort_chunk_cb(void *userdata, const int chunk)
+{
+	const MergeSortData *data = userdata;
+	const size_t es = data->es;
+	const size_t start = (size_t)chunk * data->chunk_len;
+	const size_t len = MIN2(data->chunk_len, data->n - start);
+
+	mergesort_serial(ELEM_PTR(data->src, start), ELEM_PTR(data->dst, start), len, es, data->cmp, data->thunk);
+}
+
+/**
+ * Merge one output segment (of chunk length) of a merge round,
+ * since the merged width is always a multiple of the chunk length segments never span two merges.
+ */
+static void mergesort_segment_cb(void *userdata, const int segment)
+{
+	const MergeSortData *data = userdata;
+	const size_t es = data->es;
+	const size_t n = data->n;
+	const size_t seg_start = (size_t)segment * data->chunk_len;
+	const size_t seg_end = MIN2(seg_start + data->chunk_len, n);
+	const size_t pair_start = seg_start - (seg_start % (2 * data->width));
+	const size_t a_len = MIN2(data->width, n - pair_start);
+	const size_t b_len = MIN2(data->width, n - pair_start - a_len);
+	const char *a = ELEM_PTR(data->src, pair_start);
+	const char *b = ELEM_PTR(a, a_len);
+
+	const size_t pos_start = seg_start - pair_start;
+	const size_t pos_end = seg_end - pair_start;
+	const size_t a_start = merge_split(a, a_len, b, b_len, pos_start, es, data->cmp, data->thunk);
+	const size_t a_end = merge_split(a, a_len, b, b_len, pos_end, es, data->cmp, data->thunk);
+	const size_t b_start = pos_start - a_start;
+	const size_t b_end = pos_end - a_end;
+
+	merge(ELEM_PTR(a, a_start), a_end - a_start,
+	      ELEM_PTR(b, b_start), b_end - b_start,
+	      ELEM_PTR(data->dst, seg_start), es, data->cmp, data->thunk);
+}
+
+/**
+ * Stable sort with a comparator (glibc qsort_r argument order),
+ * threaded for large arrays.
+ */
+void BLI_mergesort_r(void *a, size_t n, size_t es, BLI_sort_cmp_t cmp, void *thunk)
+{
+	MergeSortData sd;
+	char *buf;
+	int chunks_num;
+
+	if (n < 2) {
+		return;
+	}
+
+	buf = MEM_mallocN(n * es, __func__);
+	chunks_num = sort_chunks_num(n);
+
+	if (chunks_num == 1) {
+		mergesort_serial(a, buf, n, es, cmp, thunk);
+		MEM_freeN(buf);
+		return;
+	}
+
+	sd.src = a;
+	sd.dst = buf;
+	sd.n = n;
+	sd.es = es;
+	sd.cmp = cmp;
+	sd.thunk = thunk;
+	sd.chunk_len = n / (size_t)chunks_num;
+	/* the last chunk may be longer, add one to keep all segments in range */
+	chunks_num = (int)((n + sd.chunk_len - 1) / sd.chunk_len);
+
+	BLI_task_parallel_range(0, chunks_num, &sd, mergesort_chunk_cb, true);
+
+	for (sd.width = sd.chunk_len; sd.width < n; sd.width *= 2) {
+		BLI_task_parallel_range(0, chunks_num, &sd, mergesort_segment_cb, true);
+		SWAP(char *, sd.src, sd.dst);
+	}
+
+	if (sd.src != a) {
+		memcpy(a, sd.src, n * es);
+	}
+
+	MEM_freeN(buf);
+}
+
+#undef ELEM_PTR
+
+/** \} */
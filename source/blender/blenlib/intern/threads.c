@@ -37,6 +37,7 @@
 
 #include "BLI_listbase.h"
 #include "BLI_gsqueue.h"
+#include "BLI_mpmc_queue.h"
 #include "BLI_task.h"
 #include "BLI_threads.h"
 
@@ -611,6 +612,54 @@ void BLI_condition_wait_global_mutex(ThreadCondition *cond, const int type)
 	pthread_cond_wait(cond, global_mutex_from_type(type));
 }
 
+static void wait_timeout(struct timespec *timeout, int ms)
+{
+	ldiv_t div_result;
+	long sec, usec, x;
+
+#ifdef WIN32
+	{
+		struct _timeb now;
+		_ftime(&now);
+		sec = now.time;
+		usec = now.millitm * 1000; /* microsecond precision would be better */
+	}
+#else
+	{
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		sec = now.tv_sec;
+		usec = now.tv_usec;
+	}
+#endif
+
+	/* add current time + millisecond offset */
+	div_result = ldiv(ms, 1000);
+	timeout->tv_sec = sec + div_result.quot;
+
+	x = usec + (div_result.rem * 1000);
+
+	if (x >= 1000000) {
+		timeout->tv_sec++;
+		x -= 1000000;
+	}
+
+	timeout->tv_nsec = x * 1000;
+}
+
+/**
+ * Wait with a timeout in milliseconds.
+ *
+ * \return false when the timeout was reached.
+ */
+bool BLI_condition_wait_timeout(ThreadCondition *cond, ThreadMutex *mutex, int ms)
+{
+	struct timespec timeout;
+
+	wait_timeout(&timeout, ms);
+	return (pthread_cond_timedwait(cond, mutex, &timeout) != ETIMEDOUT);
+}
+
 void BLI_condition_notify_one(ThreadCondition *cond)
 {
 	pthread_cond_signal(cond);
@@ -630,6 +679,8 @@ void BLI_condition_end(ThreadCondition *cond)
 
 struct ThreadQueue {
 	GSQueue *queue;
+	/* used instead of 'queue' (and the mutex) when not NULL */
+	MPMCQueue *lockfree;
 	pthread_mutex_t mutex;
 	pthread_cond_t push_cond;
 	pthread_cond_t finish_cond;
@@ -651,8 +702,28 @@ ThreadQueue *BLI_thread_queue_init(void)
 	return queue;
 }
 
+/**
+ * Same as #BLI_thread_queue_init, but based on a lock-free queue,
+ * holding at most \a capacity elements (pushing waits while it's full).
+ */
+ThreadQueue *BLI_thread_queue_init_lockfree(const unsigned int capacity)
+{
+	ThreadQueue *queue;
+
+	queue = MEM_callocN(sizeof(ThreadQueue), "ThreadQueue");
+	queue->lockfree = BLI_mpmc_queue_new(sizeof(void *), capacity);
+
+	return queue;
+}
+
 void BLI_thread_queue_free(ThreadQueue *queue)
 {
+	if (queue->lockfree) {
+		BLI_mpmc_queue_free(queue->lockfree);
+		MEM_freeN(queue);
+		return;
+	}
+
 	/* destroy everything, assumes no one is using queue anymore */
 	pthread_cond_destroy(&queue->finish_cond);
 	pthread_cond_destroy(&queue->push_cond);
@@ -665,6 +736,11 @@ void BLI_thread_queue_free(ThreadQueue *queue)
 
 void BLI_thread_queue_push(ThreadQueue *queue, void *work)
 {
+	if (queue->lockfree) {
+		BLI_mpmc_queue_push(queue->lockfree, &work);
+		return;
+	}
+
 	pthread_mutex_lock(&queue->mutex);
 
 	BLI_gsqueue_push(queue->queue, &work);
@@ -678,6 +754,11 @@ void *BLI_thread_queue_pop(ThreadQueue *queue)
 {
 	void *work = NULL;
 
+	if (queue->lockfree) {
+		BLI_mpmc_queue_pop(queue->lockfree, &work);
+		return work;
+	}
+
 	/* wait until there is work */
 	pthread_mutex_lock(&queue->mutex);
 	while (BLI_gsqueue_is_empty(queue->queue) && !queue->nowait)
@@ -696,47 +777,17 @@ void *BLI_thread_queue_pop(ThreadQueue *queue)
 	return work;
 }
 
-static void wait_timeout(struct timespec *timeout, int ms)
-{
-	ldiv_t div_result;
-	long sec, usec, x;
-
-#ifdef WIN32
-	{
-		struct _timeb now;
-		_ftime(&now);
-		sec = now.time;
-		usec = now.millitm * 1000; /* microsecond precision would be better */
-	}
-#else
-	{
-		struct timeval now;
-		gettimeofday(&now, NULL);
-		sec = now.tv_sec;
-		usec = now.tv_usec;
-	}
-#endif
-
-	/* add current time + millisecond offset */
-	div_result = ldiv(ms, 1000);
-	timeout->tv_sec = sec + div_result.quot;
-
-	x = usec + (div_result.rem * 1000);
-
-	if (x >= 1000000) {
-		timeout->tv_sec++;
-		x -= 1000000;
-	}
-
-	timeout->tv_nsec = x * 1000;
-}
-
 void *BLI_thread_queue_pop_timeout(ThreadQueue *queue, int ms)
 {
 	double t;
 	void *work = NULL;
 	struct timespec timeout;
 
+	if (queue->lockfree) {
+		BLI_mpmc_queue_pop_timeout(queue->lockfree, &work, ms);
+		return work;
+	}
+
 	t = PIL_check_seconds_timer();
 	wait_timeout(&timeout, ms);
 
@@ -766,6 +817,10 @@ int BLI_thread_queue_size(ThreadQueue *queue)
 {
 	int size;
 
+	if (queue->lockfree) {
+		return (int)BLI_mpmc_queue_size(queue->lockfree);
+	}
+
 	pthread_mutex_lock(&queue->mutex);
 	size = BLI_gsqueue_size(queue->queue);
 	pthread_mutex_unlock(&queue->mutex);
@@ -777,6 +832,10 @@ bool BLI_thread_queue_is_empty(ThreadQueue *queue)
 {
 	bool is_empty;
 
+	if (queue->lockfree) {
+		return BLI_mpmc_queue_is_empty(queue->lockfree);
+	}
+
 	pthread_mutex_lock(&queue->mutex);
 	is_empty = BLI_gsqueue_is_empty(queue->queue);
 	pthread_mutex_unlock(&queue->mutex);
@@ -786,6 +845,11 @@ bool BLI_thread_queue_is_empty(ThreadQueue *queue)
 
 void BLI_thread_queue_nowait(ThreadQueue *queue)
 {
+	if (queue->lockfree) {
+		BLI_mpmc_queue_nowait(queue->lockfree);
+		return;
+	}
+
 	pthread_mutex_lock(&queue->mutex);
 
 	queue->nowait = 1;
@@ -797,6 +861,11 @@ void BLI_thread_queue_nowait(ThreadQueue *queue)
 
 void BLI_thread_queue_wait_finish(ThreadQueue *queue)
 {
+	if (queue->lockfree) {
+		BLI_mpmc_queue_wait_empty(queue->lockfree);
+		return;
+	}
+
 	/* wait for finish condition */
 	pthread_mutex_lock(&queue->mutex);
 
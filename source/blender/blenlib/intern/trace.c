@@ -0,0 +1,298 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenlib/intern/trace.c
+ *  \ingroup bli
+ *
+ * Scoped profiling events, see #BLI_TRACE_BEGIN.
+ *
+ * Each thread lazily allocates a #TraceThread the first time it records an event,
+ * nested scopes are kept on a small stack and written to the threads ring buffer once they end
+ * (as Chrome trace 'complete' events), so wrapping the ring never leaves unbalanced events.
+ *
+ * Recording takes no locks, the global lock is only used to register new threads.
+ * Writing the trace isn't thread-safe, it's expected to run when no other thread records events
+ * (typically on exit).
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "DNA_listBase.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_fileops.h"
+#include "BLI_listbase.h"
+#include "BLI_string.h"
+#include "BLI_threads.h"
+#include "BLI_trace.h"  /* own include */
+
+#include "PIL_time.h"
+
+#include "BLI_strict_flags.h"
+
+/* Number of completed events kept per thread (older ones are overwritten). */
+#define TRACE_EVENTS_PER_THREAD (1u << 14)
+/* Maximum nesting depth of scopes, deeper scopes are ignored. */
+#define TRACE_STACK_DEPTH 64
+#define TRACE_NAME_LEN 64
+
+typedef struct TraceEvent {
+	const char *category;
+	double time_start;
+	double time_duration;
+	char name[TRACE_NAME_LEN];
+} TraceEvent;
+
+typedef struct TraceThread {
+	struct TraceThread *next, *prev;
+	int thread_index;
+	bool is_main;
+
+	/* Total events recorded, the ring index is (events_len % TRACE_EVENTS_PER_THREAD). */
+	unsigned int events_len;
+	TraceEvent *events;
+
+	/* Scopes which began but didn't end yet. */
+	int stack_len;
+	TraceEvent stack[TRACE_STACK_DEPTH];
+} TraceThread;
+
+bool BLI_trace_use = false;
+
+static struct {
+	char filepath[1024];
+	double time_init;
+	ListBase threads;
+	int threads_len;
+	SpinLock lock;
+} g_trace = {{0}};
+
+static ThreadLocal(TraceThread *) trace_thread_local;
+
+/* -------------------------------------------------------------------- */
+
+/** \name Init/Exit
+ * \{ */
+
+/**
+ * Enable tracing, events are written to \a filepath by #BLI_trace_exit.
+ * Only call once per session (from the main thread).
+ */
+void BLI_trace_init(const char *filepath)
+{
+	if (BLI_trace_use) {
+		return;
+	}
+
+	BLI_strncpy(g_trace.filepath, filepath, sizeof(g_trace.filepath));
+	g_trace.time_init = PIL_check_seconds_timer();
+	BLI_listbase_clear(&g_trace.threads);
+	g_trace.threads_len = 0;
+	BLI_spin_init(&g_trace.lock);
+	BLI_thread_local_create(trace_thread_local);
+
+	BLI_trace_use = true;
+}
+
+/**
+ * Write the trace (when enabled) and free all buffers.
+ * Must be called from the main thread once all other threads are done.
+ */
+void BLI_trace_exit(void)
+{
+	TraceThread *trace_thread, *trace_thread_next;
+
+	if (!BLI_trace_use) {
+		return;
+	}
+
+	BLI_trace_use = false;
+
+	if (BLI_trace_write(g_trace.filepath)) {
+		printf("Profile written to '%s'\n", g_trace.filepath);
+	}
+	else {
+		printf("Error: failed to write profile '%s'\n", g_trace.filepath);
+	}
+
+	for (trace_thread = g_trace.threads.first; trace_thread; trace_thread = trace_thread_next) {
+		trace_thread_next = trace_thread->next;
+		MEM_freeN(trace_thread->events);
+		MEM_freeN(trace_thread);
+	}
+	BLI_listbase_clear(&g_trace.threads);
+
+	BLI_spin_end(&g_trace.lock);
+	BLI_thread_local_delete(trace_thread_local);
+}
+
+bool BLI_trace_is_enabled(void)
+{
+	return BLI_trace_use;
+}
+
+/** \} */
+
+
+/* -------------------------------------------------------------------- */
+
+/** \name Recording
+ * \{ */
+
+static TraceThread *trace_thread_ensure(void)
+{
+	TraceThread *trace_thread = BLI_thread_local_get(trace_thread_local);
+
+	if (UNLIKELY(trace_thread == NULL)) {
+		trace_thread = MEM_callocN(sizeof(*trace_thread), __func__);
+		trace_thread->events = MEM_mallocN(sizeof(*trace_thread->events) * TRACE_EVENTS_PER_THREAD, __func__);
+		trace_thread->is_main = BLI_thread_is_main() != 0;
+
+		BLI_spin_lock(&g_trace.lock);
+		trace_thread->thread_index = g_trace.threads_len++;
+		BLI_addtail(&g_trace.threads, trace_thread);
+		BLI_spin_unlock(&g_trace.lock);
+
+		BLI_thread_local_set(trace_thread_local, trace_thread);
+	}
+
+	return trace_thread;
+}
+
+void BLI_trace_begin(const char *category, const char *name)
+{
+	TraceThread *trace_thread = trace_thread_ensure();
+
+	if (LIKELY(trace_thread->stack_len < TRACE_STACK_DEPTH)) {
+		TraceEvent *event = &trace_thread->stack[trace_thread->stack_len];
+		event->category = category;
+		BLI_strncpy(event->name, name ? name : category, sizeof(event->name));
+		event->time_start = PIL_check_seconds_timer();
+	}
+
+	/* Keep counting when too deep, so begin/end stay balanced. */
+	trace_thread->stack_len++;
+}
+
+void BLI_trace_end(void)
+{
+	TraceThread *trace_thread = trace_thread_ensure();
+
+	if (UNLIKELY(trace_thread->stack_len == 0)) {
+		/* Tracing was enabled within a scope. */
+		return;
+	}
+
+	trace_thread->stack_len--;
+
+	if (LIKELY(trace_thread->stack_len < TRACE_STACK_DEPTH)) {
+		TraceEvent *event = &trace_thread->events[trace_thread->events_len % TRACE_EVENTS_PER_THREAD];
+		*event = trace_thread->stack[trace_thread->stack_len];
+		event->time_duration = PIL_check_seconds_timer() - event->time_start;
+		trace_thread->events_len++;
+	}
+}
+
+/** \} */
+
+
+/* -------------------------------------------------------------------- */
+
+/** \name Chrome Trace JSON Output
+ *
+ * See the "Trace Event Format" document from the Chromium project,
+ * the output can be loaded in 'chrome://tracing'.
+ * \{ */
+
+static void trace_write_string(FILE *fp, const char *str)
+{
+	fputc('"', fp);
+	for (; *str; str++) {
+		const char c = *str;
+		if (c == '"' || c == '\\') {
+			fputc('\\', fp);
+			fputc(c, fp);
+		}
+		else if ((unsigned char)c < 0x20) {
+			fprintf(fp, "\\u%04x", (unsigned int)c);
+		}
+		else {
+			fputc(c, fp);
+		}
+	}
+	fputc('"', fp);
+}
+
+static void trace_write_event(FILE *fp, const TraceThread *trace_thread, const TraceEvent *event)
+{
+	fputs(",\n{\"name\":", fp);
+	trace_write_string(fp, event->name);
+	fputs(",\"cat\":", fp);
+	trace_write_string(fp, event->category);
+	fprintf(fp, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+	        trace_thread->thread_index,
+	        (event->time_start - g_trace.time_init) * 1e6,
+	        event->time_duration * 1e6);
+}
+
+/**
+ * Write all recorded events, may be called multiple times.
+ */
+bool BLI_trace_write(const char *filepath)
+{
+	FILE *fp = BLI_fopen(filepath, "w");
+	TraceThread *trace_thread;
+
+	if (fp == NULL) {
+		return false;
+	}
+
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", fp);
+	fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Blender\"}}", fp);
+
+	for (trace_thread = g_trace.threads.first; trace_thread; trace_thread = trace_thread->next) {
+		const unsigned int events_len = MIN2(trace_thread->events_len, TRACE_EVENTS_PER_THREAD);
+		const unsigned int events_first = trace_thread->events_len - events_len;
+		unsigned int i;
+
+		if (trace_thread->is_main) {
+			fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"Main\"}}",
+			        trace_thread->thread_index);
+		}
+		else {
+			fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+			        "\"args\":{\"name\":\"Thread %d\"}}",
+			        trace_thread->thread_index, trace_thread->thread_index);
+		}
+
+		for (i = 0; i < events_len; i++) {
+			trace_write_event(fp, trace_thread, &trace_thread->events[(events_first + i) % TRACE_EVENTS_PER_THREAD]);
+		}
+	}
+
+	fputs("\n]}\n", fp);
+
+	return (fclose(fp) == 0);
+}
+
+/** \} */
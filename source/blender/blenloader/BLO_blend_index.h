@@ -0,0 +1,76 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+#ifndef __BLO_BLEND_INDEX_H__
+#define __BLO_BLEND_INDEX_H__
+
+/** \file BLO_blend_index.h
+ *  \ingroup blenloader
+ *  \brief Persistent index of the data-blocks stored in .blend files.
+ *
+ * Listing the contents of a library means scanning the whole .blend file.
+ * The index keeps the names, types and preview images of a file's data-blocks
+ * in a small cache file, which stays valid as long as the .blend file's
+ * size, modification & change times and inode don't change.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct BlendHandle;
+struct LinkNode;
+struct ReportList;
+
+typedef struct BlendIndexEntry {
+	char name[64];  /* MAX_ID_NAME - 2 */
+	short idcode;
+	short pad[3];
+	/* Size of the ICON_SIZE_PREVIEW preview, zero when the data-block has none. */
+	unsigned int preview_w, preview_h;
+	/* Only set when the index was loaded with previews. */
+	unsigned int *preview_rect;
+} BlendIndexEntry;
+
+typedef struct BlendIndex {
+	char filepath[1024];  /* 1024 = FILE_MAX */
+
+	BlendIndexEntry *entries;  /* in file order */
+	int entries_num;
+} BlendIndex;
+
+BlendIndex *BLO_blendindex_get(const char *filepath, const bool use_previews, struct ReportList *reports);
+BlendIndex *BLO_blendindex_get_from_handle(struct BlendHandle *bh, const char *filepath, const bool use_previews);
+bool BLO_blendindex_ensure(const char *filepath);
+void BLO_blendindex_free(BlendIndex *index);
+void BLO_blendindex_cache_cleanup(void);
+
+unsigned int *BLO_blendindex_get_preview(
+        const char *filepath, const short idcode, const char *name, unsigned int *r_w, unsigned int *r_h);
+
+const BlendIndexEntry *BLO_blendindex_find(const BlendIndex *index, const short idcode, const char *name);
+
+struct LinkNode *BLO_blendindex_get_datablock_names(const BlendIndex *index, const short idcode, int *r_tot_names);
+struct LinkNode *BLO_blendindex_get_linkable_groups(const BlendIndex *index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __BLO_BLEND_INDEX_H__ */
@@ -87,6 +87,8 @@ typedef enum eBLOReadSkip {
 	BLO_READ_SKIP_NONE          = 0,
 	BLO_READ_SKIP_USERDEF       = (1 << 0),
 	BLO_READ_SKIP_DATA          = (1 << 1),
+	/* Don't read packed file data, it's read from the file on first use (see BKE_packedfile_ensure_data). */
+	BLO_READ_DEFER_PACKED       = (1 << 2),
 } eBLOReadSkip;
 #define BLO_READ_SKIP_ALL \
 	(BLO_READ_SKIP_USERDEF | BLO_READ_SKIP_DATA)
@@ -98,7 +100,7 @@ BlendFileData *BLO_read_from_memory(
         const void *mem, int memsize,
         struct ReportList *reports, eBLOReadSkip skip_flag);
 BlendFileData *BLO_read_from_memfile(
-        struct Main *oldmain, const char *filename, struct MemFile *memfile,
+        struct Main *oldmain, const char *filename, struct MemFile *memfile, struct MemFile *memfile_active,
         struct ReportList *reports, eBLOReadSkip skip_flag);
 
 void BLO_blendfiledata_free(BlendFileData *bfd);
@@ -151,6 +153,9 @@ void BLO_update_defaults_startup_blend(struct Main *mainvar);
 
 struct BlendThumbnail *BLO_thumbnail_from_file(const char *filepath);
 
+struct PackedFileLazy;
+bool BLO_packedfile_lazy_read(const struct PackedFileLazy *lazy, void *r_data, const int size);
+
 #ifdef __cplusplus
 } 
 #endif
@@ -33,25 +33,39 @@
  *  \ingroup blenloader
  */
 
+struct GHash;
+struct ID;
+
 typedef struct {
 	void *next, *prev;
 	
 	char *buf;
 	unsigned int ident, size;
 	
+	/* Address of the ID this chunk was written for (chunks never span multiple ID's),
+	 * NULL for data not owned by an ID (file header, libraries, DNA...). */
+	const void *id;
 } MemFileChunk;
 
 typedef struct MemFile {
 	ListBase chunks;
 	unsigned int size;
+	/* ID address -> first chunk of the ID, created on demand (see #BLO_memfile_id_chunk_find). */
+	struct GHash *id_chunk_map;
 } MemFile;
 
 /* actually only used writefile.c */
-extern void memfile_chunk_add(MemFile *compare, MemFile *current, const char *buf, unsigned int size);
+extern void memfile_chunk_add(
+        MemFile *memfile, const char *buf, unsigned int size,
+        MemFileChunk **compchunk_step, const void *id);
+extern void memfile_chunk_add_shared(MemFile *memfile, const MemFileChunk *compchunk);
 
 /* exports */
 extern void BLO_memfile_free(MemFile *memfile);
 extern void BLO_memfile_merge(MemFile *first, MemFile *second);
+extern void BLO_memfile_copy(MemFile *dst, const MemFile *src);
+extern MemFileChunk *BLO_memfile_id_chunk_find(MemFile *memfile, const void *id);
+extern bool BLO_memfile_id_is_reusable(const struct ID *id);
 
 #endif
 
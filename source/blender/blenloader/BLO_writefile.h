@@ -43,6 +43,12 @@ extern bool BLO_write_file(
         struct ReportList *reports, const struct BlendThumbnail *thumb);
 extern bool BLO_write_file_mem(
         struct Main *mainvar, struct MemFile *compare, struct MemFile *current, int write_flags);
+extern bool BLO_write_file_snapshot(
+        struct Main *mainvar, const char *filepath, int write_flags,
+        const struct BlendThumbnail *thumb, struct ReportList *reports, struct MemFile *r_snapshot);
+extern bool BLO_write_file_from_snapshot(
+        struct MemFile *snapshot, const char *filepath, const int write_flags,
+        struct ReportList *reports);
 
 #endif
 
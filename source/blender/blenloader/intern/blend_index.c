@@ -0,0 +1,857 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenloader/intern/blend_index.c
+ *  \ingroup blenloader
+ *
+ * Persistent index of the data-blocks of .blend files, see BLO_blend_index.h.
+ *
+ * Index files are stored in the user data-files directory, one per indexed .blend file,
+ * named after the MD5 of its path. They are written to a temporary file first and renamed,
+ * so concurrent readers (file browser listing, thumbnail threads...) never see partial data.
+ * Index files of changed or removed .blend files are removed by #BLO_blendindex_cache_cleanup.
+ *
+ * Layout, in native byte order (the index is a local cache, other platforms just rebuild it):
+ *
+ * - #BlendIndexHeader
+ * - #BlendIndexHeader.entries_num #BlendIndexEntryDisk
+ * - The preview of each entry that has one, in entry order (preview_w * preview_h unsigned ints).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_fileops.h"
+#include "BLI_fileops_types.h"
+#include "BLI_ghash.h"
+#include "BLI_hash_md5.h"
+#include "BLI_linklist.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+#include "BLI_threads.h"
+
+#include "DNA_genfile.h"
+#include "DNA_ID.h"
+#include "DNA_sdna_types.h"
+
+#include "BKE_appdir.h"
+#include "BKE_idcode.h"
+#include "BKE_main.h"
+
+#include "BLO_blend_defs.h"
+#include "BLO_blend_index.h"
+#include "BLO_readfile.h"
+
+#include "readfile.h"
+
+#ifdef WIN32
+#  include "BLI_winstuff.h"
+#endif
+
+#define BLENDINDEX_MAGIC "BLENDIDX"
+#define BLENDINDEX_VERSION 2
+#define BLENDINDEX_DIR "blend_index"
+
+/* Temporary files left by writes that didn't finish are removed after this many seconds. */
+#define BLENDINDEX_TEMP_FILE_AGE_MAX (60 * 60)
+
+/* Sanity limit for previews read back from the index. */
+#define BLENDINDEX_PREVIEW_SIZE_MAX 1024
+
+/**
+ * Identifies a version of the indexed .blend file.
+ * Times only have a resolution of seconds, the inode changes on every save from Blender
+ * (files are written to a temporary file and renamed), ctime when the file is changed in place.
+ */
+typedef struct BlendIndexStamp {
+	uint64_t size;
+	int64_t mtime;
+	int64_t ctime;
+	uint64_t inode;
+} BlendIndexStamp;
+
+typedef struct BlendIndexHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t entry_size;  /* sizeof(BlendIndexEntryDisk), rejects indices written with another layout */
+
+	/* Stamp of the indexed .blend file. */
+	BlendIndexStamp stamp;
+	char filepath[FILE_MAX];
+
+	uint32_t entries_num;
+	uint32_t pad;
+} BlendIndexHeader;
+
+typedef struct BlendIndexEntryDisk {
+	char name[64];
+	int16_t idcode;
+	int16_t pad;
+	uint32_t preview_w, preview_h;
+} BlendIndexEntryDisk;
+
+/* -------------------------------------------------------------------- */
+/** \name Index File Location
+ * \{ */
+
+static ThreadMutex blendindex_dir_lock = BLI_MUTEX_INITIALIZER;
+static char blendindex_dir[FILE_MAX] = "";
+
+static ThreadMutex blendindex_cleanup_lock = BLI_MUTEX_INITIALIZER;
+static bool blendindex_cleanup_done = false;
+
+/* Thread-safe, BKE_appdir uses static buffers. */
+static bool blendindex_dir_get(char r_dir[FILE_MAX])
+{
+	bool ok;
+
+	BLI_mutex_lock(&blendindex_dir_lock);
+	if (blendindex_dir[0] == '\0') {
+		const char *dir = BKE_appdir_folder_id_create(BLENDER_USER_DATAFILES, BLENDINDEX_DIR);
+		if (dir) {
+			BLI_strncpy(blendindex_dir, dir, sizeof(blendindex_dir));
+		}
+	}
+	BLI_strncpy(r_dir, blendindex_dir, FILE_MAX);
+	ok = (r_dir[0] != '\0');
+	BLI_mutex_unlock(&blendindex_dir_lock);
+
+	return ok;
+}
+
+static bool blendindex_path_get(const char *filepath, char r_index_path[FILE_MAX])
+{
+	char dir[FILE_MAX];
+	char hexdigest[33];
+	unsigned char digest[16];
+
+	if (!blendindex_dir_get(dir)) {
+		return false;
+	}
+
+	BLI_hash_md5_buffer(filepath, strlen(filepath), digest);
+	BLI_hash_md5_to_hexdigest(digest, hexdigest);
+	BLI_join_dirfile(r_index_path, FILE_MAX, dir, hexdigest);
+
+	return true;
+}
+
+static bool blendindex_file_stamp(const char *filepath, BlendIndexStamp *r_stamp)
+{
+	BLI_stat_t st;
+
+	if (BLI_stat(filepath, &st) != 0 || !S_ISREG(st.st_mode)) {
+		return false;
+	}
+
+	r_stamp->size = (uint64_t)st.st_size;
+	r_stamp->mtime = (int64_t)st.st_mtime;
+	r_stamp->ctime = (int64_t)st.st_ctime;
+	/* Always zero on Windows. */
+	r_stamp->inode = (uint64_t)st.st_ino;
+	return true;
+}
+
+static bool blendindex_stamp_equal(const BlendIndexStamp *a, const BlendIndexStamp *b)
+{
+	return ((a->size == b->size) &&
+	        (a->mtime == b->mtime) &&
+	        (a->ctime == b->ctime) &&
+	        (a->inode == b->inode));
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Building the Index from a .blend File
+ * \{ */
+
+/**
+ * Reads the ICON_SIZE_PREVIEW image of the #PreviewImage stored in \a bhead,
+ * its rects are stored in the following DATA blocks (see write_previews).
+ *
+ * \return The last block used by the preview, NULL at the end of the file.
+ */
+static BHead *blendindex_scan_preview(FileData *fd, BHead *bhead, BlendIndexEntry *entry)
+{
+	PreviewImage *prv = BLO_library_read_struct(fd, bhead, "PreviewImage");
+	int i;
+
+	if (prv == NULL) {
+		return bhead;
+	}
+
+	for (i = 0; i < NUM_ICON_SIZES; i++) {
+		if (prv->rect[i] && prv->w[i] && prv->h[i]) {
+			bhead = blo_nextbhead(fd, bhead);
+			if (bhead == NULL) {
+				break;
+			}
+			if (i == ICON_SIZE_PREVIEW) {
+				const size_t len = (size_t)prv->w[i] * (size_t)prv->h[i] * sizeof(unsigned int);
+
+				/* Don't trust 'broken' files, see BLO_blendhandle_get_previews. */
+				if (bhead->code == DATA && (size_t)bhead->len == len) {
+					entry->preview_w = prv->w[i];
+					entry->preview_h = prv->h[i];
+					entry->preview_rect = MEM_mallocN(len, __func__);
+					memcpy(entry->preview_rect, bhead + 1, len);
+				}
+			}
+		}
+	}
+
+	MEM_freeN(prv);
+	return bhead;
+}
+
+/* Always reads the previews, they are needed to write the index file. */
+static BlendIndex *blendindex_scan_fd(FileData *fd, const char *filepath)
+{
+	BlendIndex *index;
+	BlendIndexEntry *entry = NULL;
+	BHead *bhead;
+	int entries_alloc = 64;
+	int sdna_nr_preview;
+
+	index = MEM_callocN(sizeof(*index), __func__);
+	BLI_strncpy(index->filepath, filepath, sizeof(index->filepath));
+	index->entries = MEM_mallocN(sizeof(*index->entries) * (size_t)entries_alloc, __func__);
+
+	sdna_nr_preview = DNA_struct_find_nr(fd->filesdna, "PreviewImage");
+
+	for (bhead = blo_firstbhead(fd); bhead; bhead = blo_nextbhead(fd, bhead)) {
+		if (bhead->code == ENDB) {
+			break;
+		}
+		else if (bhead->code == DATA) {
+			/* Only the first PreviewImage after the ID belongs to it. */
+			if (entry && bhead->SDNAnr == sdna_nr_preview) {
+				bhead = blendindex_scan_preview(fd, bhead, entry);
+				entry = NULL;
+				if (bhead == NULL) {
+					break;
+				}
+			}
+		}
+		else if (bhead->code != ID_ID && BKE_idcode_is_valid(bhead->code)) {
+			if (index->entries_num == entries_alloc) {
+				entries_alloc *= 2;
+				index->entries = MEM_reallocN(index->entries, sizeof(*index->entries) * (size_t)entries_alloc);
+			}
+			entry = &index->entries[index->entries_num++];
+			memset(entry, 0, sizeof(*entry));
+			BLI_strncpy(entry->name, bhead_id_name(fd, bhead) + 2, sizeof(entry->name));
+			entry->idcode = (short)bhead->code;
+		}
+		else {
+			entry = NULL;
+		}
+	}
+
+	return index;
+}
+
+static BlendIndex *blendindex_scan(const char *filepath, ReportList *reports)
+{
+	FileData *fd = blo_openblenderfile(filepath, reports);
+	BlendIndex *index;
+
+	if (fd == NULL) {
+		return NULL;
+	}
+
+	index = blendindex_scan_fd(fd, filepath);
+	blo_freefiledata(fd);
+
+	return index;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Index File Reading & Writing
+ * \{ */
+
+static FILE *blendindex_file_open(
+        const char *index_path, const char *filepath, const BlendIndexStamp *stamp,
+        BlendIndexHeader *r_header)
+{
+	FILE *fp = BLI_fopen(index_path, "rb");
+
+	if (fp == NULL) {
+		return NULL;
+	}
+
+	if (fread(r_header, sizeof(*r_header), 1, fp) != 1) {
+		fclose(fp);
+		return NULL;
+	}
+	r_header->filepath[sizeof(r_header->filepath) - 1] = '\0';
+
+	if (!STREQLEN(r_header->magic, BLENDINDEX_MAGIC, sizeof(r_header->magic)) ||
+	    (r_header->version != BLENDINDEX_VERSION) ||
+	    (r_header->entry_size != sizeof(BlendIndexEntryDisk)) ||
+	    !blendindex_stamp_equal(&r_header->stamp, stamp) ||
+	    /* Guard against MD5 collisions. */
+	    !STREQ(r_header->filepath, filepath) ||
+	    /* Each ID takes more than a BHead in the .blend file. */
+	    ((uint64_t)r_header->entries_num > stamp->size / sizeof(BHead4)))
+	{
+		fclose(fp);
+		return NULL;
+	}
+
+	return fp;
+}
+
+/* Reads the entries, \a fp is at the end of the header. */
+static BlendIndex *blendindex_file_read_entries(FILE *fp, const BlendIndexHeader *header, const char *filepath)
+{
+	BlendIndex *index;
+	BlendIndexEntryDisk *entries_disk;
+	bool ok = true;
+	int i;
+
+	index = MEM_callocN(sizeof(*index), __func__);
+	BLI_strncpy(index->filepath, filepath, sizeof(index->filepath));
+
+	if (header->entries_num == 0) {
+		return index;
+	}
+
+	entries_disk = MEM_mallocN(sizeof(*entries_disk) * header->entries_num, __func__);
+	if (fread(entries_disk, sizeof(*entries_disk), header->entries_num, fp) != header->entries_num) {
+		ok = false;
+	}
+	else {
+		index->entries = MEM_callocN(sizeof(*index->entries) * header->entries_num, __func__);
+		index->entries_num = (int)header->entries_num;
+
+		for (i = 0; i < index->entries_num; i++) {
+			BlendIndexEntry *entry = &index->entries[i];
+
+			if ((entries_disk[i].preview_w > BLENDINDEX_PREVIEW_SIZE_MAX) ||
+			    (entries_disk[i].preview_h > BLENDINDEX_PREVIEW_SIZE_MAX))
+			{
+				ok = false;
+				break;
+			}
+			BLI_strncpy(entry->name, entries_disk[i].name, sizeof(entry->name));
+			entry->idcode = entries_disk[i].idcode;
+			entry->preview_w = entries_disk[i].preview_w;
+			entry->preview_h = entries_disk[i].preview_h;
+		}
+	}
+	MEM_freeN(entries_disk);
+
+	if (!ok) {
+		BLO_blendindex_free(index);
+		return NULL;
+	}
+
+	return index;
+}
+
+/* Reads the preview of \a entry, \a fp is at the start of its preview data. */
+static bool blendindex_file_read_preview(FILE *fp, BlendIndexEntry *entry)
+{
+	const size_t len = (size_t)entry->preview_w * (size_t)entry->preview_h;
+
+	if (len == 0) {
+		return true;
+	}
+
+	entry->preview_rect = MEM_mallocN(len * sizeof(unsigned int), __func__);
+	if (fread(entry->preview_rect, sizeof(unsigned int), len, fp) != len) {
+		MEM_SAFE_FREE(entry->preview_rect);
+		return false;
+	}
+
+	return true;
+}
+
+static BlendIndex *blendindex_file_read(
+        const char *index_path, const char *filepath, const BlendIndexStamp *stamp,
+        const bool use_previews)
+{
+	BlendIndexHeader header;
+	BlendIndex *index;
+	FILE *fp;
+	int i;
+
+	fp = blendindex_file_open(index_path, filepath, stamp, &header);
+	if (fp == NULL) {
+		return NULL;
+	}
+
+	index = blendindex_file_read_entries(fp, &header, filepath);
+
+	if (index && use_previews) {
+		for (i = 0; i < index->entries_num; i++) {
+			if (!blendindex_file_read_preview(fp, &index->entries[i])) {
+				BLO_blendindex_free(index);
+				index = NULL;
+				break;
+			}
+		}
+	}
+
+	fclose(fp);
+
+	return index;
+}
+
+/* Reads a single preview, skipping the previews stored before it. */
+static unsigned int *blendindex_file_read_single_preview(
+        const char *index_path, const char *filepath, const BlendIndexStamp *stamp,
+        const short idcode, const char *name, unsigned int *r_w, unsigned int *r_h, bool *r_is_valid)
+{
+	BlendIndexHeader header;
+	BlendIndex *index;
+	BlendIndexEntry *entry = NULL;
+	unsigned int *rect = NULL;
+	FILE *fp;
+	int i;
+
+	*r_is_valid = false;
+
+	fp = blendindex_file_open(index_path, filepath, stamp, &header);
+	if (fp == NULL) {
+		return NULL;
+	}
+
+	index = blendindex_file_read_entries(fp, &header, filepath);
+	if (index) {
+		*r_is_valid = true;
+
+		for (i = 0; i < index->entries_num; i++) {
+			BlendIndexEntry *entry_iter = &index->entries[i];
+
+			if (entry_iter->idcode == idcode && STREQ(entry_iter->name, name)) {
+				entry = entry_iter;
+				break;
+			}
+			/* A single preview is at most a few MB, fine for fseek on all platforms. */
+			if (fseek(fp, (long)(entry_iter->preview_w * entry_iter->preview_h * sizeof(unsigned int)), SEEK_CUR)) {
+				*r_is_valid = false;
+				break;
+			}
+		}
+
+		if (entry && *r_is_valid) {
+			if (blendindex_file_read_preview(fp, entry)) {
+				rect = entry->preview_rect;
+				*r_w = entry->preview_w;
+				*r_h = entry->preview_h;
+				entry->preview_rect = NULL;
+			}
+			else {
+				*r_is_valid = false;
+			}
+		}
+
+		BLO_blendindex_free(index);
+	}
+
+	fclose(fp);
+
+	return rect;
+}
+
+static void blendindex_file_write(
+        const BlendIndex *index, const char *index_path, const BlendIndexStamp *stamp)
+{
+	BlendIndexHeader header = {{0}};
+	char tempname[FILE_MAX + 32];
+	FILE *fp;
+	bool ok = true;
+	int i;
+
+	/* Unique per index, several threads may index the same file. */
+	BLI_snprintf(tempname, sizeof(tempname), "%s@%p", index_path, (const void *)index);
+
+	fp = BLI_fopen(tempname, "wb");
+	if (fp == NULL) {
+		return;
+	}
+
+	memcpy(header.magic, BLENDINDEX_MAGIC, sizeof(header.magic));
+	header.version = BLENDINDEX_VERSION;
+	header.entry_size = sizeof(BlendIndexEntryDisk);
+	header.stamp = *stamp;
+	BLI_strncpy(header.filepath, index->filepath, sizeof(header.filepath));
+	header.entries_num = (uint32_t)index->entries_num;
+
+	ok = (fwrite(&header, sizeof(header), 1, fp) == 1);
+
+	for (i = 0; ok && i < index->entries_num; i++) {
+		const BlendIndexEntry *entry = &index->entries[i];
+		BlendIndexEntryDisk entry_disk = {{0}};
+
+		BLI_strncpy(entry_disk.name, entry->name, sizeof(entry_disk.name));
+		entry_disk.idcode = entry->idcode;
+		if (entry->preview_rect) {
+			entry_disk.preview_w = entry->preview_w;
+			entry_disk.preview_h = entry->preview_h;
+		}
+		ok = (fwrite(&entry_disk, sizeof(entry_disk), 1, fp) == 1);
+	}
+
+	for (i = 0; ok && i < index->entries_num; i++) {
+		const BlendIndexEntry *entry = &index->entries[i];
+
+		if (entry->preview_rect) {
+			const size_t len = (size_t)entry->preview_w * (size_t)entry->preview_h;
+			ok = (fwrite(entry->preview_rect, sizeof(unsigned int), len, fp) == len);
+		}
+	}
+
+	if (fclose(fp) != 0) {
+		ok = false;
+	}
+
+	if (!ok || BLI_rename(tempname, index_path) != 0) {
+		BLI_delete(tempname, false, false);
+	}
+}
+
+static void blendindex_free_previews(BlendIndex *index)
+{
+	int i;
+
+	for (i = 0; i < index->entries_num; i++) {
+		MEM_SAFE_FREE(index->entries[i].preview_rect);
+	}
+}
+
+/**
+ * \return true when \a index_path is an index of another version of its .blend file,
+ * or the .blend file was moved or removed.
+ */
+static bool blendindex_file_is_stale(const char *index_path)
+{
+	BlendIndexHeader header;
+	BlendIndexStamp stamp;
+	FILE *fp;
+	bool ok;
+
+	fp = BLI_fopen(index_path, "rb");
+	if (fp == NULL) {
+		/* Removed meanwhile, or not ours to remove. */
+		return false;
+	}
+	ok = (fread(&header, sizeof(header), 1, fp) == 1);
+	fclose(fp);
+
+	if (!ok) {
+		return true;
+	}
+	header.filepath[sizeof(header.filepath) - 1] = '\0';
+
+	return (!STREQLEN(header.magic, BLENDINDEX_MAGIC, sizeof(header.magic)) ||
+	        (header.version != BLENDINDEX_VERSION) ||
+	        (header.entry_size != sizeof(BlendIndexEntryDisk)) ||
+	        !blendindex_file_stamp(header.filepath, &stamp) ||
+	        !blendindex_stamp_equal(&header.stamp, &stamp));
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Public API
+ * \{ */
+
+/**
+ * Remove index files of .blend files which have changed or no longer exist,
+ * and temporary files left by writes that didn't finish.
+ *
+ * Only does this once per session, later calls return immediately.
+ */
+void BLO_blendindex_cache_cleanup(void)
+{
+	char dir[FILE_MAX];
+	struct direntry *files;
+	unsigned int files_num, i;
+	const int64_t time_now = (int64_t)time(NULL);
+
+	BLI_mutex_lock(&blendindex_cleanup_lock);
+	if (blendindex_cleanup_done) {
+		BLI_mutex_unlock(&blendindex_cleanup_lock);
+		return;
+	}
+	blendindex_cleanup_done = true;
+	BLI_mutex_unlock(&blendindex_cleanup_lock);
+
+	if (!blendindex_dir_get(dir)) {
+		return;
+	}
+
+	files_num = BLI_filelist_dir_contents(dir, &files);
+
+	for (i = 0; i < files_num; i++) {
+		const struct direntry *file = &files[i];
+		bool is_stale;
+
+		if (!S_ISREG(file->type)) {
+			continue;
+		}
+
+		/* See blendindex_file_write, recent ones may still be written. */
+		if (strchr(file->relname, '@')) {
+			is_stale = (time_now - (int64_t)file->s.st_mtime) > BLENDINDEX_TEMP_FILE_AGE_MAX;
+		}
+		else {
+			is_stale = blendindex_file_is_stale(file->path);
+		}
+
+		if (is_stale) {
+			BLI_delete(file->path, false, false);
+		}
+	}
+
+	BLI_filelist_free(files, files_num);
+}
+
+static BlendIndex *blendindex_get_ex(
+        const char *filepath, FileData *fd, const bool use_previews, ReportList *reports)
+{
+	char index_path[FILE_MAX];
+	BlendIndex *index;
+	BlendIndexStamp stamp;
+	bool use_cache;
+
+	use_cache = (blendindex_file_stamp(filepath, &stamp) &&
+	             blendindex_path_get(filepath, index_path));
+
+	if (use_cache) {
+		index = blendindex_file_read(index_path, filepath, &stamp, use_previews);
+		if (index) {
+			return index;
+		}
+	}
+
+	index = fd ? blendindex_scan_fd(fd, filepath) : blendindex_scan(filepath, reports);
+	if (index == NULL) {
+		return NULL;
+	}
+
+	if (use_cache) {
+		blendindex_file_write(index, index_path, &stamp);
+	}
+
+	if (!use_previews) {
+		blendindex_free_previews(index);
+	}
+
+	return index;
+}
+
+/**
+ * Get the index of a .blend file, from the index cache when it is up to date,
+ * otherwise the file is scanned and the cache updated.
+ *
+ * Thread-safe, can be called from jobs.
+ *
+ * \param filepath Absolute path of the .blend file.
+ * \param use_previews Load the ICON_SIZE_PREVIEW previews too (#BlendIndexEntry.preview_rect).
+ * \param reports Report errors in opening the .blend file (can be NULL).
+ * \return The index, or NULL when the .blend file can't be read.
+ */
+BlendIndex *BLO_blendindex_get(const char *filepath, const bool use_previews, ReportList *reports)
+{
+	return blendindex_get_ex(filepath, NULL, use_previews, reports);
+}
+
+/**
+ * Same as #BLO_blendindex_get, for callers that already opened the file:
+ * when the cache is out of date \a bh is scanned instead of opening the file again.
+ *
+ * \param bh Handle of the .blend file at \a filepath.
+ */
+BlendIndex *BLO_blendindex_get_from_handle(BlendHandle *bh, const char *filepath, const bool use_previews)
+{
+	return blendindex_get_ex(filepath, (FileData *)bh, use_previews, NULL);
+}
+
+/**
+ * Make sure the cached index of a .blend file is up to date, without loading it.
+ *
+ * \return false when the file could not be indexed.
+ */
+bool BLO_blendindex_ensure(const char *filepath)
+{
+	char index_path[FILE_MAX];
+	BlendIndexHeader header;
+	BlendIndex *index;
+	BlendIndexStamp stamp;
+	FILE *fp;
+
+	if (!blendindex_file_stamp(filepath, &stamp) ||
+	    !blendindex_path_get(filepath, index_path))
+	{
+		return false;
+	}
+
+	fp = blendindex_file_open(index_path, filepath, &stamp, &header);
+	if (fp) {
+		fclose(fp);
+		return true;
+	}
+
+	index = blendindex_scan(filepath, NULL);
+	if (index == NULL) {
+		return false;
+	}
+
+	blendindex_file_write(index, index_path, &stamp);
+	BLO_blendindex_free(index);
+
+	return true;
+}
+
+/**
+ * Get the ICON_SIZE_PREVIEW preview of a single data-block,
+ * only that preview is read when the cached index is up to date.
+ *
+ * \return The preview (to be freed with MEM_freeN), or NULL when the data-block has none.
+ */
+unsigned int *BLO_blendindex_get_preview(
+        const char *filepath, const short idcode, const char *name, unsigned int *r_w, unsigned int *r_h)
+{
+	char index_path[FILE_MAX];
+	BlendIndex *index;
+	BlendIndexEntry *entry;
+	unsigned int *rect = NULL;
+	BlendIndexStamp stamp;
+
+	*r_w = *r_h = 0;
+
+	if (blendindex_file_stamp(filepath, &stamp) &&
+	    blendindex_path_get(filepath, index_path))
+	{
+		bool is_valid;
+
+		rect = blendindex_file_read_single_preview(
+		        index_path, filepath, &stamp, idcode, name, r_w, r_h, &is_valid);
+		if (is_valid) {
+			return rect;
+		}
+	}
+
+	/* No valid index, build it. */
+	index = BLO_blendindex_get(filepath, true, NULL);
+	if (index == NULL) {
+		return NULL;
+	}
+
+	entry = (BlendIndexEntry *)BLO_blendindex_find(index, idcode, name);
+	if (entry && entry->preview_rect) {
+		rect = entry->preview_rect;
+		*r_w = entry->preview_w;
+		*r_h = entry->preview_h;
+		entry->preview_rect = NULL;
+	}
+
+	BLO_blendindex_free(index);
+
+	return rect;
+}
+
+void BLO_blendindex_free(BlendIndex *index)
+{
+	blendindex_free_previews(index);
+	MEM_SAFE_FREE(index->entries);
+	MEM_freeN(index);
+}
+
+const BlendIndexEntry *BLO_blendindex_find(const BlendIndex *index, const short idcode, const char *name)
+{
+	int i;
+
+	for (i = 0; i < index->entries_num; i++) {
+		const BlendIndexEntry *entry = &index->entries[i];
+
+		if (entry->idcode == idcode && STREQ(entry->name, name)) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Same as #BLO_blendhandle_get_datablock_names.
+ *
+ * \return A BLI_linklist of strings. The string links should be freed with malloc.
+ */
+LinkNode *BLO_blendindex_get_datablock_names(const BlendIndex *index, const short idcode, int *r_tot_names)
+{
+	LinkNode *names = NULL;
+	int tot = 0;
+	int i;
+
+	for (i = 0; i < index->entries_num; i++) {
+		const BlendIndexEntry *entry = &index->entries[i];
+
+		if (entry->idcode == idcode) {
+			BLI_linklist_prepend(&names, strdup(entry->name));
+			tot++;
+		}
+	}
+
+	*r_tot_names = tot;
+	return names;
+}
+
+/**
+ * Same as #BLO_blendhandle_get_linkable_groups.
+ *
+ * \return A BLI_linklist of strings. The string links should be freed with malloc.
+ */
+LinkNode *BLO_blendindex_get_linkable_groups(const BlendIndex *index)
+{
+	GSet *gathered = BLI_gset_ptr_new(__func__);
+	LinkNode *names = NULL;
+	int i;
+
+	for (i = 0; i < index->entries_num; i++) {
+		const BlendIndexEntry *entry = &index->entries[i];
+
+		if (BKE_idcode_is_linkable(entry->idcode)) {
+			const char *str = BKE_idcode_to_name(entry->idcode);
+
+			if (BLI_gset_add(gathered, (void *)str)) {
+				BLI_linklist_prepend(&names, strdup(str));
+			}
+		}
+	}
+
+	BLI_gset_free(gathered, NULL);
+
+	return names;
+}
+
+/** \} */
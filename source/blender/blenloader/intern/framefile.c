@@ -0,0 +1,560 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenloader/intern/framefile.c
+ *  \ingroup blenloader
+ *
+ * Block compressed .blend container, see framefile.h for the layout.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <limits.h>
+
+#include "zlib.h"
+
+#ifdef WIN32
+#  include <io.h>
+#  include "BLI_winstuff.h"
+#else
+#  include <unistd.h>
+#endif
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_endian_switch.h"
+#include "BLI_fileops.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+
+#include "BKE_global.h"  /* for ENDIAN_ORDER */
+
+#include "framefile.h"
+
+#define FRAMEFILE_VERSION 1
+/* Large enough for zlib's window not to matter, small enough to balance over threads. */
+#define FRAMEFILE_FRAME_SIZE (1 << 20)
+/* Same speed/size trade-off as regular compressed files (gzip "wb1"). */
+#define FRAMEFILE_COMPRESS_LEVEL 1
+
+#define FRAMEFILE_HEADER_SIZE (FRAMEFILE_MAGIC_LEN + 8)
+#define FRAMEFILE_FOOTER_SIZE 16
+
+typedef struct FrameFileEntry {
+	uint64_t offset;
+	uint32_t size_compressed;
+	uint32_t size;
+} FrameFileEntry;
+
+/* -------------------------------------------------------------------- */
+/** \name Utilities
+ * \{ */
+
+static void framefile_entries_endian_switch(FrameFileEntry *frames, const unsigned int frames_num)
+{
+	if (ENDIAN_ORDER == B_ENDIAN) {
+		unsigned int i;
+		for (i = 0; i < frames_num; i++) {
+			BLI_endian_switch_uint64(&frames[i].offset);
+			BLI_endian_switch_uint32(&frames[i].size_compressed);
+			BLI_endian_switch_uint32(&frames[i].size);
+		}
+	}
+}
+
+static void framefile_put_uint32(char *buf, uint32_t value)
+{
+	if (ENDIAN_ORDER == B_ENDIAN) {
+		BLI_endian_switch_uint32(&value);
+	}
+	memcpy(buf, &value, sizeof(value));
+}
+
+static void framefile_put_uint64(char *buf, uint64_t value)
+{
+	if (ENDIAN_ORDER == B_ENDIAN) {
+		BLI_endian_switch_uint64(&value);
+	}
+	memcpy(buf, &value, sizeof(value));
+}
+
+static uint32_t framefile_get_uint32(const char *buf)
+{
+	uint32_t value;
+	memcpy(&value, buf, sizeof(value));
+	if (ENDIAN_ORDER == B_ENDIAN) {
+		BLI_endian_switch_uint32(&value);
+	}
+	return value;
+}
+
+static uint64_t framefile_get_uint64(const char *buf)
+{
+	uint64_t value;
+	memcpy(&value, buf, sizeof(value));
+	if (ENDIAN_ORDER == B_ENDIAN) {
+		BLI_endian_switch_uint64(&value);
+	}
+	return value;
+}
+
+/* read() and write() may handle less than requested, loop until done. */
+static bool framefile_write_all(int file, const char *buf, size_t buf_len)
+{
+	while (buf_len) {
+		const int len = (int)write(file, buf, (unsigned int)MIN2(buf_len, (size_t)INT_MAX));
+		if (len <= 0) {
+			return false;
+		}
+		buf += len;
+		buf_len -= (size_t)len;
+	}
+	return true;
+}
+
+static bool framefile_read_all(int file, char *buf, size_t buf_len)
+{
+	while (buf_len) {
+		const int len = (int)read(file, buf, (unsigned int)MIN2(buf_len, (size_t)INT_MAX));
+		if (len <= 0) {
+			return false;
+		}
+		buf += len;
+		buf_len -= (size_t)len;
+	}
+	return true;
+}
+
+static bool framefile_read_at(int file, uint64_t offset, char *buf, size_t buf_len)
+{
+	return (lseek(file, (off_t)offset, SEEK_SET) != -1) && framefile_read_all(file, buf, buf_len);
+}
+
+bool blo_framefile_has_magic(const char magic[FRAMEFILE_MAGIC_LEN])
+{
+	return (memcmp(magic, FRAMEFILE_MAGIC, FRAMEFILE_MAGIC_LEN) == 0);
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Writing
+ *
+ * Data is collected into a batch of frames, which are compressed in parallel
+ * once the batch is full and then written in order.
+ * \{ */
+
+struct FrameFileWriter {
+	int file;
+	uint64_t file_offset;
+
+	/* uncompressed data of the frames in the batch */
+	char *batch;
+	size_t batch_len;
+	unsigned int batch_frames_max;
+
+	/* compressed data per frame in the batch */
+	char **compressed;
+	uLongf *compressed_len;
+	bool *compressed_ok;
+
+	FrameFileEntry *frames;
+	unsigned int frames_num, frames_alloc;
+
+	bool error;
+};
+
+static void framefile_compress_cb(void *userdata, const int index)
+{
+	FrameFileWriter *ffw = userdata;
+	const size_t offset = (size_t)index * FRAMEFILE_FRAME_SIZE;
+	const size_t len = MIN2(ffw->batch_len - offset, (size_t)FRAMEFILE_FRAME_SIZE);
+
+	ffw->compressed_len[index] = compressBound(FRAMEFILE_FRAME_SIZE);
+	ffw->compressed_ok[index] = (compress2(
+	        (Bytef *)ffw->compressed[index], &ffw->compressed_len[index],
+	        (const Bytef *)ffw->batch + offset, (uLong)len, FRAMEFILE_COMPRESS_LEVEL) == Z_OK);
+}
+
+static void framefile_writer_flush(FrameFileWriter *ffw)
+{
+	const unsigned int batch_frames = (unsigned int)((ffw->batch_len + FRAMEFILE_FRAME_SIZE - 1) / FRAMEFILE_FRAME_SIZE);
+	unsigned int i;
+
+	if (batch_frames == 0 || ffw->error) {
+		return;
+	}
+
+	BLI_task_parallel_range(0, (int)batch_frames, ffw, framefile_compress_cb, batch_frames > 1);
+
+	if (ffw->frames_num + batch_frames > ffw->frames_alloc) {
+		ffw->frames_alloc = (ffw->frames_num + batch_frames) * 2;
+		ffw->frames = MEM_reallocN(ffw->frames, sizeof(*ffw->frames) * ffw->frames_alloc);
+	}
+
+	for (i = 0; i < batch_frames; i++) {
+		FrameFileEntry *frame = &ffw->frames[ffw->frames_num++];
+
+		if (!ffw->compressed_ok[i] ||
+		    !framefile_write_all(ffw->file, ffw->compressed[i], (size_t)ffw->compressed_len[i]))
+		{
+			ffw->error = true;
+			return;
+		}
+
+		frame->offset = ffw->file_offset;
+		frame->size_compressed = (uint32_t)ffw->compressed_len[i];
+		frame->size = (uint32_t)MIN2(ffw->batch_len - (size_t)i * FRAMEFILE_FRAME_SIZE, (size_t)FRAMEFILE_FRAME_SIZE);
+		ffw->file_offset += frame->size_compressed;
+	}
+
+	ffw->batch_len = 0;
+}
+
+FrameFileWriter *blo_framefile_writer_open(const char *filepath)
+{
+	FrameFileWriter *ffw;
+	char header[FRAMEFILE_HEADER_SIZE];
+	unsigned int i;
+	int file;
+
+	file = BLI_open(filepath, O_BINARY | O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (file == -1) {
+		return NULL;
+	}
+
+	memcpy(header, FRAMEFILE_MAGIC, FRAMEFILE_MAGIC_LEN);
+	framefile_put_uint32(&header[FRAMEFILE_MAGIC_LEN], FRAMEFILE_VERSION);
+	framefile_put_uint32(&header[FRAMEFILE_MAGIC_LEN + 4], FRAMEFILE_FRAME_SIZE);
+	if (!framefile_write_all(file, header, sizeof(header))) {
+		close(file);
+		return NULL;
+	}
+
+	ffw = MEM_callocN(sizeof(*ffw), __func__);
+	ffw->file = file;
+	ffw->file_offset = FRAMEFILE_HEADER_SIZE;
+
+	/* a couple of frames per thread so uneven frames still balance */
+	ffw->batch_frames_max = (unsigned int)BLI_system_thread_count() * 2;
+	ffw->batch = MEM_mallocN((size_t)ffw->batch_frames_max * FRAMEFILE_FRAME_SIZE, "FrameFileWriter.batch");
+	ffw->compressed = MEM_mallocN(sizeof(*ffw->compressed) * ffw->batch_frames_max, __func__);
+	ffw->compressed_len = MEM_mallocN(sizeof(*ffw->compressed_len) * ffw->batch_frames_max, __func__);
+	ffw->compressed_ok = MEM_mallocN(sizeof(*ffw->compressed_ok) * ffw->batch_frames_max, __func__);
+	for (i = 0; i < ffw->batch_frames_max; i++) {
+		ffw->compressed[i] = MEM_mallocN(compressBound(FRAMEFILE_FRAME_SIZE), "FrameFileWriter.compressed");
+	}
+
+	return ffw;
+}
+
+bool blo_framefile_writer_write(FrameFileWriter *ffw, const char *data, size_t data_len)
+{
+	const size_t batch_size = (size_t)ffw->batch_frames_max * FRAMEFILE_FRAME_SIZE;
+
+	while (data_len && !ffw->error) {
+		const size_t len = MIN2(data_len, batch_size - ffw->batch_len);
+
+		memcpy(ffw->batch + ffw->batch_len, data, len);
+		ffw->batch_len += len;
+		data += len;
+		data_len -= len;
+
+		if (ffw->batch_len == batch_size) {
+			framefile_writer_flush(ffw);
+		}
+	}
+
+	return !ffw->error;
+}
+
+/**
+ * Write the remaining frames and the seek table, frees \a ffw.
+ *
+ * \return false when any write failed.
+ */
+bool blo_framefile_writer_close(FrameFileWriter *ffw)
+{
+	char footer[FRAMEFILE_FOOTER_SIZE];
+	bool ok;
+	unsigned int i;
+
+	framefile_writer_flush(ffw);
+
+	if (!ffw->error) {
+		const uint64_t table_offset = ffw->file_offset;
+
+		framefile_entries_endian_switch(ffw->frames, ffw->frames_num);
+		if (ffw->frames_num &&
+		    !framefile_write_all(ffw->file, (const char *)ffw->frames, sizeof(*ffw->frames) * ffw->frames_num))
+		{
+			ffw->error = true;
+		}
+
+		framefile_put_uint64(&footer[0], table_offset);
+		framefile_put_uint32(&footer[8], ffw->frames_num);
+		memcpy(&footer[12], FRAMEFILE_MAGIC_END, 4);
+		if (!ffw->error && !framefile_write_all(ffw->file, footer, sizeof(footer))) {
+			ffw->error = true;
+		}
+	}
+
+	ok = (close(ffw->file) != -1) && !ffw->error;
+
+	for (i = 0; i < ffw->batch_frames_max; i++) {
+		MEM_freeN(ffw->compressed[i]);
+	}
+	MEM_freeN(ffw->compressed);
+	MEM_freeN(ffw->compressed_len);
+	MEM_freeN(ffw->compressed_ok);
+	MEM_freeN(ffw->batch);
+	MEM_SAFE_FREE(ffw->frames);
+	MEM_freeN(ffw);
+
+	return ok;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Reading
+ * \{ */
+
+struct FrameFileReader {
+	int file;
+	size_t size;
+	unsigned int frame_size;
+
+	FrameFileEntry *frames;
+	unsigned int frames_num;
+	/* frames are stored from the end of the header up to the seek table */
+	uint64_t table_offset;
+
+	/* last frame decompressed by #blo_framefile_reader_read, reading is mostly sequential */
+	char *frame_cache;
+	int frame_cache_index;
+};
+
+/**
+ * \return NULL when \a filepath isn't a valid block compressed file.
+ */
+FrameFileReader *blo_framefile_reader_open(const char *filepath)
+{
+	FrameFileReader *ffr;
+	char header[FRAMEFILE_HEADER_SIZE], footer[FRAMEFILE_FOOTER_SIZE];
+	uint64_t table_offset;
+	size_t file_size;
+	unsigned int frame_size, frames_num, i;
+	int file;
+
+	file = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
+	if (file == -1) {
+		return NULL;
+	}
+
+	file_size = BLI_file_descriptor_size(file);
+	if ((file_size == (size_t)-1) || (file_size < FRAMEFILE_HEADER_SIZE + FRAMEFILE_FOOTER_SIZE) ||
+	    !framefile_read_all(file, header, sizeof(header)) ||
+	    !blo_framefile_has_magic(header) ||
+	    (framefile_get_uint32(&header[FRAMEFILE_MAGIC_LEN]) != FRAMEFILE_VERSION) ||
+	    !framefile_read_at(file, file_size - FRAMEFILE_FOOTER_SIZE, footer, sizeof(footer)) ||
+	    (memcmp(&footer[12], FRAMEFILE_MAGIC_END, 4) != 0))
+	{
+		close(file);
+		return NULL;
+	}
+
+	frame_size = framefile_get_uint32(&header[FRAMEFILE_MAGIC_LEN + 4]);
+	table_offset = framefile_get_uint64(&footer[0]);
+	frames_num = framefile_get_uint32(&footer[8]);
+
+	if ((frame_size == 0) ||
+	    (table_offset < FRAMEFILE_HEADER_SIZE) ||
+	    (table_offset + (uint64_t)frames_num * sizeof(FrameFileEntry) != file_size - FRAMEFILE_FOOTER_SIZE))
+	{
+		close(file);
+		return NULL;
+	}
+
+	ffr = MEM_callocN(sizeof(*ffr), __func__);
+	ffr->file = file;
+	ffr->frame_size = frame_size;
+	ffr->frames_num = frames_num;
+	ffr->table_offset = table_offset;
+	ffr->frame_cache_index = -1;
+
+	if (frames_num) {
+		ffr->frames = MEM_mallocN(sizeof(*ffr->frames) * frames_num, "FrameFileReader.frames");
+		if (!framefile_read_at(file, table_offset, (char *)ffr->frames, sizeof(*ffr->frames) * frames_num)) {
+			blo_framefile_reader_close(ffr);
+			return NULL;
+		}
+		framefile_entries_endian_switch(ffr->frames, frames_num);
+	}
+
+	/* all frames but the last are full, so offsets into the file can be mapped to frames */
+	for (i = 0; i < frames_num; i++) {
+		const FrameFileEntry *frame = &ffr->frames[i];
+		if ((frame->offset < FRAMEFILE_HEADER_SIZE) ||
+		    (frame->offset + frame->size_compressed > table_offset) ||
+		    (frame->size > frame_size) ||
+		    ((i != frames_num - 1) && (frame->size != frame_size)))
+		{
+			blo_framefile_reader_close(ffr);
+			return NULL;
+		}
+		ffr->size += frame->size;
+	}
+
+	return ffr;
+}
+
+/**
+ * \return The size of the (decompressed) .blend file.
+ */
+size_t blo_framefile_reader_size(const FrameFileReader *ffr)
+{
+	return ffr->size;
+}
+
+static bool framefile_frame_decompress(
+        const FrameFileEntry *frame, const char *data_compressed, char *r_data)
+{
+	uLongf len = frame->size;
+
+	return (uncompress((Bytef *)r_data, &len, (const Bytef *)data_compressed, frame->size_compressed) == Z_OK) &&
+	       (len == frame->size);
+}
+
+/**
+ * Random access read, only the frames overlapping the range are decompressed.
+ *
+ * \return The number of bytes read, less than \a buf_len at the end of the file or on error.
+ */
+size_t blo_framefile_reader_read(FrameFileReader *ffr, size_t offset, void *buf, size_t buf_len)
+{
+	char *buf_iter = buf;
+	size_t len_read = 0;
+
+	while (len_read < buf_len && offset < ffr->size) {
+		const unsigned int frame_index = (unsigned int)(offset / ffr->frame_size);
+		const FrameFileEntry *frame = &ffr->frames[frame_index];
+		const size_t frame_offset = offset - (size_t)frame_index * ffr->frame_size;
+		const size_t len = MIN2(buf_len - len_read, frame->size - frame_offset);
+
+		if (ffr->frame_cache_index != (int)frame_index) {
+			char *data_compressed = MEM_mallocN(frame->size_compressed, __func__);
+			bool ok;
+
+			if (ffr->frame_cache == NULL) {
+				ffr->frame_cache = MEM_mallocN(ffr->frame_size, "FrameFileReader.frame_cache");
+			}
+
+			ok = framefile_read_at(ffr->file, frame->offset, data_compressed, frame->size_compressed) &&
+			     framefile_frame_decompress(frame, data_compressed, ffr->frame_cache);
+			MEM_freeN(data_compressed);
+
+			if (!ok) {
+				ffr->frame_cache_index = -1;
+				break;
+			}
+			ffr->frame_cache_index = (int)frame_index;
+		}
+
+		memcpy(buf_iter, ffr->frame_cache + frame_offset, len);
+		buf_iter += len;
+		offset += len;
+		len_read += len;
+	}
+
+	return len_read;
+}
+
+typedef struct FrameFileDecompressData {
+	const FrameFileReader *ffr;
+	const char *data_compressed;
+	char *data;
+	bool error;
+} FrameFileDecompressData;
+
+static void framefile_decompress_cb(void *userdata, const int index)
+{
+	FrameFileDecompressData *data = userdata;
+	const FrameFileReader *ffr = data->ffr;
+	const FrameFileEntry *frame = &ffr->frames[index];
+
+	if (!framefile_frame_decompress(
+	        frame, data->data_compressed + (frame->offset - FRAMEFILE_HEADER_SIZE),
+	        data->data + (size_t)index * ffr->frame_size))
+	{
+		/* only ever set, no need to synchronize */
+		data->error = true;
+	}
+}
+
+/**
+ * Decompress the whole file, frames are decompressed in parallel.
+ *
+ * \return The .blend file data (owned by the caller) or NULL on error.
+ */
+void *blo_framefile_reader_read_all(FrameFileReader *ffr, size_t *r_size)
+{
+	FrameFileDecompressData data = {NULL};
+	size_t size_compressed;
+
+	if (ffr->frames_num == 0) {
+		return NULL;
+	}
+
+	size_compressed = (size_t)(ffr->table_offset - FRAMEFILE_HEADER_SIZE);
+
+	data.ffr = ffr;
+	data.data_compressed = MEM_mallocN(size_compressed, __func__);
+	data.data = MEM_mallocN(ffr->size, "FrameFileReader.data");
+
+	if (framefile_read_at(ffr->file, FRAMEFILE_HEADER_SIZE, (char *)data.data_compressed, size_compressed)) {
+		BLI_task_parallel_range(0, (int)ffr->frames_num, &data, framefile_decompress_cb, ffr->frames_num > 1);
+	}
+	else {
+		data.error = true;
+	}
+
+	MEM_freeN((void *)data.data_compressed);
+
+	if (data.error) {
+		MEM_freeN(data.data);
+		return NULL;
+	}
+
+	*r_size = ffr->size;
+	return data.data;
+}
+
+void blo_framefile_reader_close(FrameFileReader *ffr)
+{
+	close(ffr->file);
+	MEM_SAFE_FREE(ffr->frames);
+	MEM_SAFE_FREE(ffr->frame_cache);
+	MEM_freeN(ffr);
+}
+
+/** \} */
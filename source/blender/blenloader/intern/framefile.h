@@ -0,0 +1,62 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenloader/intern/framefile.h
+ *  \ingroup blenloader
+ *
+ * Block compressed container for .blend files.
+ *
+ * The file is split into frames which are compressed independently (zlib),
+ * so compression and decompression run in parallel and any part of the file
+ * can be read without decompressing what comes before it.
+ *
+ * Layout, all integers are little endian:
+ *
+ * - Header: #FRAMEFILE_MAGIC (8 bytes), version (uint32), frame size (uint32).
+ * - Frames: one zlib stream per frame, each holds 'frame size' bytes of the .blend file
+ *   (the last frame may be shorter).
+ * - Seek table: per frame, offset in the file (uint64), compressed size (uint32), size (uint32).
+ * - Footer: seek table offset (uint64), number of frames (uint32), #FRAMEFILE_MAGIC_END (4 bytes).
+ */
+
+#ifndef __FRAMEFILE_H__
+#define __FRAMEFILE_H__
+
+#define FRAMEFILE_MAGIC "BLENDFRM"
+#define FRAMEFILE_MAGIC_LEN 8
+#define FRAMEFILE_MAGIC_END "BFRM"
+
+typedef struct FrameFileWriter FrameFileWriter;
+typedef struct FrameFileReader FrameFileReader;
+
+/* writing */
+FrameFileWriter *blo_framefile_writer_open(const char *filepath);
+bool blo_framefile_writer_write(FrameFileWriter *ffw, const char *data, size_t data_len);
+bool blo_framefile_writer_close(FrameFileWriter *ffw);
+
+/* reading */
+bool blo_framefile_has_magic(const char magic[FRAMEFILE_MAGIC_LEN]);
+FrameFileReader *blo_framefile_reader_open(const char *filepath);
+size_t blo_framefile_reader_size(const FrameFileReader *ffr);
+size_t blo_framefile_reader_read(FrameFileReader *ffr, size_t offset, void *buf, size_t buf_len);
+void *blo_framefile_reader_read_all(FrameFileReader *ffr, size_t *r_size);
+void blo_framefile_reader_close(FrameFileReader *ffr);
+
+#endif  /* __FRAMEFILE_H__ */
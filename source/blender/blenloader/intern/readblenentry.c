@@ -367,9 +367,11 @@ BlendFileData *BLO_read_from_memory(
  *
  * \param oldmain old main, from which we will keep libraries and other datablocks that should not have changed.
  * \param filename current file, only for retrieving library data.
+ * \param memfile_active the memfile \a oldmain was last written to (can be NULL),
+ * unchanged ID's which are the same in \a memfile are kept instead of being read again.
  */
 BlendFileData *BLO_read_from_memfile(
-        Main *oldmain, const char *filename, MemFile *memfile,
+        Main *oldmain, const char *filename, MemFile *memfile, MemFile *memfile_active,
         ReportList *reports, eBLOReadSkip skip_flags)
 {
 	BlendFileData *bfd = NULL;
@@ -389,6 +391,11 @@ BlendFileData *BLO_read_from_memfile(
 		blo_split_main(&old_mainlist, oldmain);
 		/* add the library pointers in oldmap lookup */
 		blo_add_library_pointer_map(&old_mainlist, fd);
+
+		/* makes lookup of unchanged data in old main */
+		if (memfile_active) {
+			blo_make_undo_reuse_map(fd, oldmain, memfile_active);
+		}
 		
 		/* makes lookup of existing images in old main */
 		blo_make_image_pointer_map(fd, oldmain);
@@ -412,6 +419,9 @@ BlendFileData *BLO_read_from_memfile(
 		/* ensures relinked sounds are not freed */
 		blo_end_sound_pointer_map(fd, oldmain);
 
+		/* ensures kept data has its users */
+		blo_end_undo_reuse_map(fd);
+
 		/* Still in-use libraries have already been moved from oldmain to new mainlist,
 		 * but oldmain itself shall *never* be 'transferred' to new mainlist! */
 		BLI_assert(old_mainlist.first == oldmain);
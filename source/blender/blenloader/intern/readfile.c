@@ -45,6 +45,7 @@
 #include "BLI_utildefines.h"
 #ifndef WIN32
 #  include <unistd.h> // for read close
+#  include <sys/mman.h> // for mmap
 #else
 #  include <io.h> // for open close read
 #  include "winsock2.h"
@@ -117,7 +118,11 @@
 #include "BLI_blenlib.h"
 #include "BLI_math.h"
 #include "BLI_threads.h"
+#include "BLI_task.h"
 #include "BLI_mempool.h"
+#include "BLI_ghash.h"
+#include "BLI_sort.h"
+#include "BLI_trace.h"
 
 #include "BLT_translation.h"
 
@@ -146,6 +151,7 @@
 #include "BKE_multires.h"
 #include "BKE_node.h" // for tree type defines
 #include "BKE_object.h"
+#include "BKE_packedFile.h"
 #include "BKE_paint.h"
 #include "BKE_particle.h"
 #include "BKE_pointcache.h"
@@ -171,6 +177,7 @@
 #include "RE_engine.h"
 
 #include "readfile.h"
+#include "framefile.h"
 
 
 #include <errno.h>
@@ -231,6 +238,13 @@
 /* Use GHash for restoring pointers by name */
 #define USE_GHASH_RESTORE_POINTER
 
+/* Map uncompressed files into memory instead of reading them into BHead copies,
+ * struct data is then read straight from the mapping.
+ * Not on Windows, where mapping is limited to 4GB (see mmap_win.c). */
+#ifndef WIN32
+#  define USE_MMAP_READ
+#endif
+
 /***/
 
 typedef struct OldNew {
@@ -244,8 +258,18 @@ typedef struct OldNewMap {
 	int nentries, entriessize;
 	bool sorted;
 	int lasthit;
+
+	/* Open addressing table of (entry index + 1) keyed by the old address,
+	 * built on the first full lookup, see #oldnewmap_hash_ensure. */
+	int *hash;
+	unsigned int hash_mask;
+	/* Number of entries added to the table so far. */
+	int hash_len;
 } OldNewMap;
 
+/* Below this many entries a linear search is cheaper than building the table. */
+#define OLDNEWMAP_HASH_MIN 64
+
 
 /* local prototypes */
 static void *read_struct(FileData *fd, BHead *bh, const char *blockname);
@@ -305,10 +329,21 @@ static int verg_oldnewmap(const void *v1, const void *v2)
 }
 
 
+static void oldnewmap_hash_free(OldNewMap *onm)
+{
+	MEM_SAFE_FREE(onm->hash);
+	onm->hash_mask = 0;
+	onm->hash_len = 0;
+}
+
 static void oldnewmap_sort(FileData *fd) 
 {
 	BLI_assert(fd->libmap->sorted == false);
-	qsort(fd->libmap->entries, fd->libmap->nentries, sizeof(OldNew), verg_oldnewmap);
+	/* indices change, sorted maps use a binary search instead */
+	oldnewmap_hash_free(fd->libmap);
+	BLI_radix_sort_by_key(
+	        fd->libmap->entries, (size_t)fd->libmap->nentries, sizeof(OldNew),
+	        offsetof(OldNew, old), BLI_SORT_KEY_PTR);
 	fd->libmap->sorted = 1;
 }
 
@@ -335,27 +370,88 @@ void blo_do_versions_oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void
 	oldnewmap_insert(onm, oldaddr, newaddr, nr);
 }
 
+static void oldnewmap_hash_insert(OldNewMap *onm, const int index)
+{
+	unsigned int slot = BLI_ghashutil_ptrhash(onm->entries[index].old) & onm->hash_mask;
+
+	while (onm->hash[slot] != 0) {
+		slot = (slot + 1) & onm->hash_mask;
+	}
+	onm->hash[slot] = index + 1;
+}
+
+/**
+ * Add entries inserted since the last full lookup to the table,
+ * growing it to keep the load factor at or below a half.
+ */
+static void oldnewmap_hash_ensure(OldNewMap *onm)
+{
+	int i;
+
+	if (onm->hash_len == onm->nentries) {
+		return;
+	}
+
+	if ((onm->hash == NULL) || ((unsigned int)onm->nentries * 2 > onm->hash_mask + 1)) {
+		const unsigned int hash_size = power_of_2_max_u((unsigned int)onm->entriessize * 2);
+		MEM_SAFE_FREE(onm->hash);
+		onm->hash = MEM_callocN(sizeof(*onm->hash) * hash_size, "OldNewMap.hash");
+		onm->hash_mask = hash_size - 1;
+		onm->hash_len = 0;
+	}
+
+	for (i = onm->hash_len; i < onm->nentries; i++) {
+		oldnewmap_hash_insert(onm, i);
+	}
+	onm->hash_len = onm->nentries;
+}
+
 /**
  * Do a full search (no state).
  *
- * \param lasthit: Use as a reference position to avoid a full search
- * from either end of the array, giving more efficient lookups.
+ * \param lasthit: Use as a reference position, the first match after it is returned,
+ * otherwise the last match before it (matching a linear search from \a lasthit).
  *
- * \note This would seem an ideal case for hash or btree lookups.
- * However the data is written in-order, using the \a lasthit will normally avoid calling this function.
- * Creating a btree/hash structure adds overhead for the common-case to optimize the corner-case
- * (since most entries will never be retrieved).
- * So just keep full lookups as a fall-back.
+ * \note The data is written in-order, using the \a lasthit will normally avoid calling this function.
+ * Small maps are searched linearly, larger ones use a hash of the old addresses
+ * since files with many ID's or large arrays of pointers make the linear search quadratic.
  */
-static int oldnewmap_lookup_entry_full(const OldNewMap *onm, const void *addr, int lasthit)
+static int oldnewmap_lookup_entry_full(OldNewMap *onm, const void *addr, int lasthit)
 {
 	const int nentries = onm->nentries;
 	const OldNew *entries = onm->entries;
 	int i;
 
-	/* search relative to lasthit where possible */
-	if (lasthit >= 0 && lasthit < nentries) {
+	if (!(lasthit >= 0 && lasthit < nentries)) {
+		/* search backwards (full) */
+		lasthit = nentries;
+	}
 
+	if (nentries >= OLDNEWMAP_HASH_MIN) {
+		/* duplicate addresses are possible, resolve them the same way as the linear search */
+		int i_next = INT_MAX, i_prev = -1;
+		unsigned int slot;
+
+		oldnewmap_hash_ensure(onm);
+
+		slot = BLI_ghashutil_ptrhash(addr) & onm->hash_mask;
+		while ((i = onm->hash[slot]) != 0) {
+			i -= 1;
+			if (entries[i].old == addr) {
+				if (i > lasthit) {
+					i_next = min_ii(i_next, i);
+				}
+				else {
+					i_prev = max_ii(i_prev, i);
+				}
+			}
+			slot = (slot + 1) & onm->hash_mask;
+		}
+
+		return (i_next != INT_MAX) ? i_next : i_prev;
+	}
+
+	if (lasthit != nentries) {
 		/* search forwards */
 		i = lasthit;
 		while (++i != nentries) {
@@ -366,19 +462,14 @@ static int oldnewmap_lookup_entry_full(const OldNewMap *onm, const void *addr, i
 
 		/* search backwards */
 		i = lasthit + 1;
-		while (i--) {
-			if (entries[i].old == addr) {
-				return i;
-			}
-		}
 	}
 	else {
-		/* search backwards (full) */
 		i = nentries;
-		while (i--) {
-			if (entries[i].old == addr) {
-				return i;
-			}
+	}
+
+	while (i--) {
+		if (entries[i].old == addr) {
+			return i;
 		}
 	}
 
@@ -434,7 +525,6 @@ static void *oldnewmap_liblookup(OldNewMap *onm, const void *addr, const void *l
 		}
 	}
 	else {
-		/* note, this can be a bottle neck when loading some files */
 		const int i = oldnewmap_lookup_entry_full(onm, addr, -1);
 		if (i != -1) {
 			OldNew *entry = &onm->entries[i];
@@ -466,10 +556,13 @@ static void oldnewmap_clear(OldNewMap *onm)
 {
 	onm->nentries = 0;
 	onm->lasthit = 0;
+	/* maps are cleared for every ID, don't keep a table sized for the largest one */
+	oldnewmap_hash_free(onm);
 }
 
 static void oldnewmap_free(OldNewMap *onm) 
 {
+	MEM_SAFE_FREE(onm->hash);
 	MEM_freeN(onm->entries);
 	MEM_freeN(onm);
 }
@@ -729,6 +822,105 @@ static void bh8_from_bh4(BHead *bhead, BHead4 *bhead4)
 	}
 }
 
+#ifdef USE_MMAP_READ
+
+/**
+ * BHead's can point into the mapping when they are stored in the file exactly as in memory.
+ * Otherwise they're read (copied) from the mapping as from any other file.
+ */
+static bool bhead_index_use(const FileData *fd)
+{
+	return (fd->mmap_data != NULL) &&
+	       ((fd->flags & (FD_FLAGS_SWITCH_ENDIAN | FD_FLAGS_POINTSIZE_DIFFERS)) == 0);
+}
+
+/**
+ * Add the next BHead in the mapping to the index.
+ *
+ * \note BHead's in the file are only 4 byte aligned,
+ * all platforms we map files on support unaligned access.
+ */
+static BHead *get_bhead_mmap(FileData *fd)
+{
+	BHead *bhead;
+
+	if (fd->eof || (fd->mmap_size - fd->mmap_seek) < sizeof(BHead)) {
+		fd->eof = 1;
+		return NULL;
+	}
+
+	bhead = (BHead *)(fd->mmap_data + fd->mmap_seek);
+
+	/* make sure people are not trying to pass bad blend files */
+	if ((bhead->len < 0) || ((size_t)bhead->len > fd->mmap_size - fd->mmap_seek - sizeof(BHead))) {
+		fd->eof = 1;
+		return NULL;
+	}
+	fd->mmap_seek += sizeof(BHead) + (size_t)bhead->len;
+
+	if (UNLIKELY(fd->bhead_index_len == fd->bhead_index_alloc)) {
+		fd->bhead_index_alloc = max_ii(fd->bhead_index_alloc * 2, 1024);
+		fd->bhead_index = MEM_reallocN(fd->bhead_index, sizeof(*fd->bhead_index) * (size_t)fd->bhead_index_alloc);
+	}
+	fd->bhead_index_hint = fd->bhead_index_len;
+	fd->bhead_index[fd->bhead_index_len++] = bhead;
+
+	return bhead;
+}
+
+/**
+ * \return the position of \a bhead in the index, BHead's are indexed in file (address) order.
+ */
+static int bhead_index_find(FileData *fd, const BHead *bhead)
+{
+	BHead **bhead_index = fd->bhead_index;
+	int lo = 0, hi = fd->bhead_index_len - 1;
+
+	if (bhead_index[fd->bhead_index_hint] == bhead) {
+		return fd->bhead_index_hint;
+	}
+
+	while (lo <= hi) {
+		const int mid = (lo + hi) / 2;
+		if (bhead_index[mid] == bhead) {
+			return mid;
+		}
+		else if ((const char *)bhead_index[mid] < (const char *)bhead) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid - 1;
+		}
+	}
+
+	BLI_assert(!"BHead not found in the index");
+	return -1;
+}
+
+/**
+ * Free struct data read ahead which was never taken by #read_struct
+ * (blocks skipped while reading or ID types which aren't supported).
+ */
+static void bhead_data_free(FileData *fd)
+{
+	int i;
+
+	if (fd->bhead_data == NULL) {
+		return;
+	}
+
+	for (i = 0; i < fd->bhead_data_len; i++) {
+		if (fd->bhead_data[i]) {
+			MEM_freeN(fd->bhead_data[i]);
+		}
+	}
+	MEM_freeN(fd->bhead_data);
+	fd->bhead_data = NULL;
+	fd->bhead_data_len = 0;
+}
+
+#endif  /* USE_MMAP_READ */
+
 static BHeadN *get_bhead(FileData *fd)
 {
 	BHeadN *new_bhead = NULL;
@@ -834,6 +1026,16 @@ BHead *blo_firstbhead(FileData *fd)
 	BHeadN *new_bhead;
 	BHead *bhead = NULL;
 	
+#ifdef USE_MMAP_READ
+	if (bhead_index_use(fd)) {
+		if (fd->bhead_index_len == 0) {
+			return get_bhead_mmap(fd);
+		}
+		fd->bhead_index_hint = 0;
+		return fd->bhead_index[0];
+	}
+#endif
+
 	/* Rewind the file
 	 * Read in a new block if necessary
 	 */
@@ -849,10 +1051,25 @@ BHead *blo_firstbhead(FileData *fd)
 	return(bhead);
 }
 
-BHead *blo_prevbhead(FileData *UNUSED(fd), BHead *thisblock)
+BHead *blo_prevbhead(FileData *fd, BHead *thisblock)
 {
-	BHeadN *bheadn = (BHeadN *)POINTER_OFFSET(thisblock, -offsetof(BHeadN, bhead));
-	BHeadN *prev = bheadn->prev;
+	BHeadN *bheadn, *prev;
+
+#ifdef USE_MMAP_READ
+	if (bhead_index_use(fd)) {
+		const int index = bhead_index_find(fd, thisblock);
+		if (index > 0) {
+			fd->bhead_index_hint = index - 1;
+			return fd->bhead_index[index - 1];
+		}
+		return NULL;
+	}
+#else
+	UNUSED_VARS(fd);
+#endif
+
+	bheadn = (BHeadN *)POINTER_OFFSET(thisblock, -offsetof(BHeadN, bhead));
+	prev = bheadn->prev;
 	
 	return (prev) ? &prev->bhead : NULL;
 }
@@ -862,6 +1079,20 @@ BHead *blo_nextbhead(FileData *fd, BHead *thisblock)
 	BHeadN *new_bhead = NULL;
 	BHead *bhead = NULL;
 	
+#ifdef USE_MMAP_READ
+	if (bhead_index_use(fd)) {
+		if (thisblock) {
+			const int index = bhead_index_find(fd, thisblock);
+			if (index == fd->bhead_index_len - 1) {
+				return get_bhead_mmap(fd);
+			}
+			fd->bhead_index_hint = index + 1;
+			return fd->bhead_index[index + 1];
+		}
+		return NULL;
+	}
+#endif
+
 	if (thisblock) {
 		/* bhead is actually a sub part of BHeadN
 		 * We calculate the BHeadN pointer from the BHead pointer below */
@@ -1010,6 +1241,29 @@ static int fd_read_from_file(FileData *filedata, void *buffer, unsigned int size
 	return readsize;
 }
 
+#ifdef USE_MMAP_READ
+static int fd_read_from_mmap(FileData *filedata, void *buffer, unsigned int size)
+{
+	/* don't read more bytes then there are available in the mapping */
+	const size_t readsize = MIN2((size_t)size, filedata->mmap_size - filedata->mmap_seek);
+
+	memcpy(buffer, filedata->mmap_data + filedata->mmap_seek, readsize);
+	filedata->mmap_seek += readsize;
+
+	return (int)readsize;
+}
+#endif
+
+static int fd_read_from_framefile(FileData *filedata, void *buffer, unsigned int size)
+{
+	const size_t readsize = blo_framefile_reader_read(filedata->framefile, filedata->framefile_seek, buffer, size);
+
+	filedata->framefile_seek += readsize;
+	filedata->seek += (int)readsize;
+
+	return (int)readsize;
+}
+
 static int fd_read_gzip_from_file(FileData *filedata, void *buffer, unsigned int size)
 {
 	int readsize = gzread(filedata->gzfiledes, buffer, size);
@@ -1045,9 +1299,16 @@ static int fd_read_from_memfile(FileData *filedata, void *buffer, unsigned int s
 	if (size == 0) return 0;
 	
 	if (seek != (unsigned int)filedata->seek) {
-		chunk = filedata->memfile->chunks.first;
-		seek = 0;
-		
+		/* Skipping forward (undo skips the data of reused ID's) continues from the current chunk,
+		 * reading a memfile always starts at 0 so this never uses a chunk of another memfile. */
+		if (chunk && seek < (unsigned int)filedata->seek) {
+			seek = offset;
+		}
+		else {
+			chunk = filedata->memfile->chunks.first;
+			seek = 0;
+		}
+
 		while (chunk) {
 			if (seek + chunk->size > (unsigned) filedata->seek) break;
 			seek += chunk->size;
@@ -1133,11 +1394,170 @@ static FileData *blo_decode_and_check(FileData *fd, ReportList *reports)
 	return fd;
 }
 
+#ifdef USE_MMAP_READ
+/**
+ * Check all BHead lengths in a mapped file fit in the mapping,
+ * reading past the end of a mapping raises SIGBUS instead of a read error.
+ *
+ * \return false for truncated or invalid files, these are read as a stream.
+ */
+static bool blo_mmap_bheads_check(const char *data, const size_t size)
+{
+	size_t bhead_size;
+	bool switch_endian;
+	size_t seek;
+
+	if ((size < SIZEOFBLENDERHEADER) || !STREQLEN(data, "BLENDER", 7)) {
+		return false;
+	}
+
+	bhead_size = (data[7] == '_') ? sizeof(BHead4) : sizeof(BHead8);
+	switch_endian = (((data[8] == 'v') ? L_ENDIAN : B_ENDIAN) != ENDIAN_ORDER);
+
+	for (seek = SIZEOFBLENDERHEADER; (size - seek) >= bhead_size; ) {
+		/* 'code' and 'len' are at the same offset in BHead4 & BHead8,
+		 * codes are stored as characters (see #switch_endian_bh4) */
+		int code, len;
+		memcpy(&code, data + seek, sizeof(code));
+		memcpy(&len, data + seek + sizeof(code), sizeof(len));
+		if (switch_endian) {
+			BLI_endian_switch_int32(&len);
+		}
+
+		if ((len < 0) || ((size_t)len > size - seek - bhead_size)) {
+			return false;
+		}
+		seek += bhead_size + (size_t)len;
+
+		if (code == ENDB) {
+			return true;
+		}
+	}
+
+	/* no ENDB, truncated file */
+	return false;
+}
+
+/**
+ * Map an uncompressed file.
+ *
+ * \return NULL for compressed or truncated files, or when mapping fails (these are read as a stream).
+ */
+static FileData *blo_openblenderfile_mmap(const char *filepath)
+{
+	FileData *fd = NULL;
+	char magic[FRAMEFILE_MAGIC_LEN];
+	size_t size;
+	int file;
+
+	file = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
+	if (file == -1) {
+		return NULL;
+	}
+
+	size = BLI_file_descriptor_size(file);
+	if ((size != (size_t)-1) && (size > SIZEOFBLENDERHEADER) &&
+	    (read(file, magic, sizeof(magic)) == sizeof(magic)) &&
+	    !((unsigned char)magic[0] == 0x1f && (unsigned char)magic[1] == 0x8b) &&
+	    !blo_framefile_has_magic(magic))
+	{
+		/* private, so writing to BHead's (code patching) never changes the file */
+		void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+		if ((mem != MAP_FAILED) &&
+		    /* also check the file didn't change size while it was checked */
+		    !(blo_mmap_bheads_check(mem, size) && (BLI_file_descriptor_size(file) == size)))
+		{
+			munmap(mem, size);
+			mem = MAP_FAILED;
+		}
+		if (mem != MAP_FAILED) {
+			fd = filedata_new();
+			fd->mmap_data = mem;
+			fd->mmap_size = size;
+			fd->read = fd_read_from_mmap;
+		}
+	}
+
+	/* the mapping stays valid */
+	close(file);
+
+	return fd;
+}
+#endif
+
+/**
+ * Open a block compressed file (see: G_FILE_COMPRESS_FRAMES).
+ *
+ * \note Linking from a library decompresses the whole file too: BHead's are spread over all frames
+ * and reading the file scans all of them, only the decompression itself is done in parallel.
+ *
+ * \param use_stream: Decompress frames as they're read, instead of decompressing the whole file up-front
+ * (in parallel), for reading only the header.
+ * \return NULL for any other kind of file.
+ */
+static FileData *blo_openblenderfile_framefile(const char *filepath, const bool use_stream)
+{
+	FrameFileReader *ffr;
+	FileData *fd;
+
+	ffr = blo_framefile_reader_open(filepath);
+	if (ffr == NULL) {
+		return NULL;
+	}
+
+	fd = filedata_new();
+
+#ifdef USE_MMAP_READ
+	if (!use_stream) {
+		size_t size;
+		char *data = blo_framefile_reader_read_all(ffr, &size);
+		if (data) {
+			blo_framefile_reader_close(ffr);
+			fd->mmap_data = data;
+			fd->mmap_size = size;
+			fd->flags |= FD_FLAGS_MMAP_IS_ALLOC;
+			fd->read = fd_read_from_mmap;
+			return fd;
+		}
+	}
+#else
+	UNUSED_VARS(use_stream);
+#endif
+
+	fd->framefile = ffr;
+	fd->read = fd_read_from_framefile;
+
+	return fd;
+}
+
 /* cannot be called with relative paths anymore! */
 /* on each new library added, it now checks for the current FileData and expands relativeness */
 FileData *blo_openblenderfile(const char *filepath, ReportList *reports)
 {
 	gzFile gzfile;
+
+#ifdef USE_MMAP_READ
+	{
+		FileData *fd = blo_openblenderfile_mmap(filepath);
+		if (fd) {
+			/* needed for library_append and read_libraries */
+			BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
+
+			return blo_decode_and_check(fd, reports);
+		}
+	}
+#endif
+
+	{
+		FileData *fd = blo_openblenderfile_framefile(filepath, false);
+		if (fd) {
+			/* needed for library_append and read_libraries */
+			BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
+
+			return blo_decode_and_check(fd, reports);
+		}
+	}
+
 	errno = 0;
 	gzfile = BLI_gzopen(filepath, "rb");
 	
@@ -1164,15 +1584,21 @@ FileData *blo_openblenderfile(const char *filepath, ReportList *reports)
  */
 static FileData *blo_openblenderfile_minimal(const char *filepath)
 {
-	gzFile gzfile;
-	errno = 0;
-	gzfile = BLI_gzopen(filepath, "rb");
+	FileData *fd = blo_openblenderfile_framefile(filepath, true);
 
-	if (gzfile != (gzFile)Z_NULL) {
-		FileData *fd = filedata_new();
-		fd->gzfiledes = gzfile;
-		fd->read = fd_read_gzip_from_file;
+	if (fd == NULL) {
+		gzFile gzfile;
+		errno = 0;
+		gzfile = BLI_gzopen(filepath, "rb");
+
+		if (gzfile != (gzFile)Z_NULL) {
+			fd = filedata_new();
+			fd->gzfiledes = gzfile;
+			fd->read = fd_read_gzip_from_file;
+		}
+	}
 
+	if (fd) {
 		decode_blender_header(fd);
 
 		if (fd->flags & FD_FLAGS_FILE_OK) {
@@ -1297,6 +1723,24 @@ void blo_freefiledata(FileData *fd)
 		// Free all BHeadN data blocks
 		BLI_freelistN(&fd->listbase);
 
+#ifdef USE_MMAP_READ
+		bhead_data_free(fd);
+		if (fd->bhead_index) {
+			MEM_freeN(fd->bhead_index);
+		}
+		if (fd->mmap_data) {
+			if (fd->flags & FD_FLAGS_MMAP_IS_ALLOC) {
+				MEM_freeN(fd->mmap_data);
+			}
+			else {
+				munmap(fd->mmap_data, fd->mmap_size);
+			}
+		}
+#endif
+		if (fd->framefile) {
+			blo_framefile_reader_close(fd->framefile);
+		}
+
 		if (fd->filesdna)
 			DNA_sdna_free(fd->filesdna);
 		if (fd->compflags)
@@ -1314,10 +1758,16 @@ void blo_freefiledata(FileData *fd)
 			oldnewmap_free(fd->soundmap);
 		if (fd->packedmap)
 			oldnewmap_free(fd->packedmap);
+		if (fd->packedlazymap)
+			oldnewmap_free(fd->packedlazymap);
 		if (fd->libmap && !(fd->flags & FD_FLAGS_NOT_MY_LIBMAP))
 			oldnewmap_free(fd->libmap);
 		if (fd->bheadmap)
 			MEM_freeN(fd->bheadmap);
+		if (fd->undo_reuse_map)
+			BLI_ghash_free(fd->undo_reuse_map, NULL, NULL);
+		if (fd->undo_reuse)
+			MEM_freeN(fd->undo_reuse);
 		
 #ifdef USE_GHASH_BHEAD
 		if (fd->bhead_idname_hash) {
@@ -1443,6 +1893,46 @@ BlendThumbnail *BLO_thumbnail_from_file(const char *filepath)
 	return data;
 }
 
+static bool packedfile_lazy_bhead_check(const PackedFileLazy *lazy, const BHead *bhead, const int size)
+{
+	return (bhead->code == DATA) && (bhead->SDNAnr == 0) && (bhead->len == ((size + 3) & ~3)) &&
+	       ((uint64_t)(uintptr_t)bhead->old == lazy->old);
+}
+
+/**
+ * Read packed file data which wasn't read with the rest of the file (see #BLO_READ_DEFER_PACKED).
+ *
+ * \return false when the file can't be read or doesn't contain the data anymore
+ * (overwritten since it was loaded).
+ */
+bool BLO_packedfile_lazy_read(const PackedFileLazy *lazy, void *r_data, const int size)
+{
+	BHead bhead;
+	bool ok = false;
+
+	if (lazy->is_framed) {
+		FrameFileReader *ffr = blo_framefile_reader_open(lazy->filepath);
+		if (ffr) {
+			ok = (blo_framefile_reader_read(ffr, (size_t)lazy->offset, &bhead, sizeof(bhead)) == sizeof(bhead)) &&
+			     packedfile_lazy_bhead_check(lazy, &bhead, size) &&
+			     (blo_framefile_reader_read(ffr, (size_t)lazy->offset + sizeof(bhead), r_data, (size_t)size) == (size_t)size);
+			blo_framefile_reader_close(ffr);
+		}
+	}
+	else {
+		const int file = BLI_open(lazy->filepath, O_BINARY | O_RDONLY, 0);
+		if (file != -1) {
+			ok = (lseek(file, (off_t)lazy->offset, SEEK_SET) != -1) &&
+			     (read(file, &bhead, sizeof(bhead)) == sizeof(bhead)) &&
+			     packedfile_lazy_bhead_check(lazy, &bhead, size) &&
+			     (read(file, r_data, (size_t)size) == size);
+			close(file);
+		}
+	}
+
+	return ok;
+}
+
 /* ************** OLD POINTERS ******************* */
 
 static void *newdataadr(FileData *fd, const void *adr)		/* only direct databocks */
@@ -1865,6 +2355,185 @@ void blo_add_library_pointer_map(ListBase *old_mainlist, FileData *fd)
 	fd->old_mainlist = old_mainlist;
 }
 
+/* undo file support: keep unchanged ID's of the old main instead of reading them again */
+
+typedef struct UndoReuseID {
+	ID *id;
+	/* offset in the memfile after the ID and its data */
+	int seek_end;
+	/* unchanged, and only uses ID's which are unchanged too */
+	bool is_valid;
+	/* moved into the new main by read_libblock */
+	bool is_reused;
+} UndoReuseID;
+
+typedef struct UndoReuseCheckData {
+	GHash *reuse_map;
+	bool is_valid;
+} UndoReuseCheckData;
+
+static int undo_reuse_check_cb(void *user_data, ID *UNUSED(id_self), ID **id_pointer, int UNUSED(cb_flag))
+{
+	UndoReuseCheckData *data = user_data;
+	ID *id = *id_pointer;
+
+	if (id) {
+		UndoReuseID *reuse = BLI_ghash_lookup(data->reuse_map, id);
+		if ((reuse == NULL) || !reuse->is_valid) {
+			data->is_valid = false;
+			return IDWALK_RET_STOP_ITER;
+		}
+	}
+	return IDWALK_RET_NOP;
+}
+
+static int undo_reuse_user_cb(void *UNUSED(user_data), ID *UNUSED(id_self), ID **id_pointer, int cb_flag)
+{
+	ID *id = *id_pointer;
+
+	if (id) {
+		if (cb_flag & IDWALK_CB_USER) {
+			id_us_plus_no_lib(id);
+		}
+		else if (cb_flag & IDWALK_CB_USER_ONE) {
+			id_us_ensure_real(id);
+		}
+	}
+	return IDWALK_RET_NOP;
+}
+
+/* Check the first memfile chunk of an ID was written from 'id' (and not from another ID at the same address). */
+static bool undo_reuse_chunk_is_id(const MemFileChunk *chunk, const ID *id)
+{
+	const BHead *bh = (const BHead *)chunk->buf;
+
+	return ((chunk->size >= sizeof(BHead) + sizeof(ID)) &&
+	        (bh->old == id) && (bh->code == GS(id->name)) &&
+	        STREQ(((const ID *)(bh + 1))->name, id->name));
+}
+
+/**
+ * Find the local ID's of \a oldmain which can be kept as is when reading \a fd->memfile.
+ *
+ * These are ID's which were not changed since \a memfile_active was written (see #LIB_TAG_UNDO_CHANGED),
+ * that are written to the exact same chunks in both memfiles (so they are the same in the state being read),
+ * and which only use ID's that can be kept too.
+ */
+void blo_make_undo_reuse_map(FileData *fd, Main *oldmain, MemFile *memfile_active)
+{
+	ListBase *lbarray[MAX_LIBARRAY];
+	MemFileChunk *chunk;
+	UndoReuseID *reuse;
+	int seek = 0;
+	int i, a;
+	bool changed;
+
+	BLI_assert(fd->memfile != NULL);
+
+	fd->undo_reuse_len = 0;
+	a = set_listbasepointers(oldmain, lbarray);
+	while (a--) {
+		ID *id;
+		for (id = lbarray[a]->first; id; id = id->next) {
+			if (BLO_memfile_id_is_reusable(id)) {
+				fd->undo_reuse_len++;
+			}
+		}
+	}
+
+	if (fd->undo_reuse_len == 0) {
+		return;
+	}
+
+	fd->undo_reuse = MEM_callocN(sizeof(*fd->undo_reuse) * fd->undo_reuse_len, __func__);
+	fd->undo_reuse_map = BLI_ghash_ptr_new_ex(__func__, fd->undo_reuse_len);
+
+	reuse = fd->undo_reuse;
+	a = set_listbasepointers(oldmain, lbarray);
+	while (a--) {
+		ID *id;
+		for (id = lbarray[a]->first; id; id = id->next) {
+			if (BLO_memfile_id_is_reusable(id)) {
+				reuse->id = id;
+				BLI_ghash_insert(fd->undo_reuse_map, id, reuse);
+				reuse++;
+			}
+		}
+	}
+
+	/* Compare the chunks of each ID in both memfiles, shared chunks have the same buffer. */
+	chunk = fd->memfile->chunks.first;
+	while (chunk) {
+		const void *chunk_id = chunk->id;
+		const MemFileChunk *chunk_active;
+		bool is_equal;
+
+		reuse = chunk_id ? BLI_ghash_lookup(fd->undo_reuse_map, chunk_id) : NULL;
+		if (reuse == NULL) {
+			seek += chunk->size;
+			chunk = chunk->next;
+			continue;
+		}
+
+		chunk_active = BLO_memfile_id_chunk_find(memfile_active, chunk_id);
+		is_equal = (reuse->seek_end == 0) && undo_reuse_chunk_is_id(chunk, reuse->id);
+
+		for (; chunk && (chunk->id == chunk_id); chunk = chunk->next) {
+			if (chunk_active && (chunk_active->id == chunk_id) &&
+			    (chunk_active->buf == chunk->buf) && (chunk_active->size == chunk->size))
+			{
+				chunk_active = chunk_active->next;
+			}
+			else {
+				is_equal = false;
+			}
+			seek += chunk->size;
+		}
+
+		if (chunk_active && (chunk_active->id == chunk_id)) {
+			is_equal = false;
+		}
+
+		reuse->is_valid = is_equal;
+		reuse->seek_end = seek;
+	}
+
+	/* Only keep ID's which use kept ID's. */
+	do {
+		changed = false;
+		for (i = 0, reuse = fd->undo_reuse; i < fd->undo_reuse_len; i++, reuse++) {
+			if (reuse->is_valid) {
+				UndoReuseCheckData data = {fd->undo_reuse_map, true};
+				BKE_library_foreach_ID_link(NULL, reuse->id, undo_reuse_check_cb, &data, IDWALK_READONLY);
+				if (!data.is_valid) {
+					reuse->is_valid = false;
+					changed = true;
+				}
+			}
+		}
+	} while (changed);
+}
+
+/* Add the users kept ID's have of each other, since they are not linked again (see: lib_link_all). */
+void blo_end_undo_reuse_map(FileData *fd)
+{
+	UndoReuseID *reuse;
+	int i;
+
+	for (i = 0, reuse = fd->undo_reuse; i < fd->undo_reuse_len; i++, reuse++) {
+		if (reuse->is_reused) {
+			BKE_library_foreach_ID_link(NULL, reuse->id, undo_reuse_user_cb, NULL, IDWALK_READONLY);
+		}
+	}
+
+	if (fd->undo_reuse_map) {
+		BLI_ghash_free(fd->undo_reuse_map, NULL, NULL);
+		fd->undo_reuse_map = NULL;
+	}
+	MEM_SAFE_FREE(fd->undo_reuse);
+	fd->undo_reuse_len = 0;
+}
+
 
 /* ********** END OLD POINTERS ****************** */
 /* ********** READ FILE ****************** */
@@ -1885,7 +2554,8 @@ static void switch_endian_structs(const struct SDNA *filesdna, BHead *bhead)
 	}
 }
 
-static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
+/* Only reads from 'fd', so this can run in parallel when no endian switch is needed. */
+static void *read_struct_data(const FileData *fd, BHead *bh, const char *blockname)
 {
 	void *temp = NULL;
 	
@@ -1909,6 +2579,22 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
 	return temp;
 }
 
+static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
+{
+#ifdef USE_MMAP_READ
+	if (fd->bhead_data) {
+		const int index = bhead_index_find(fd, bh);
+		if (index != -1 && index < fd->bhead_data_len && fd->bhead_data[index]) {
+			void *temp = fd->bhead_data[index];
+			fd->bhead_data[index] = NULL;
+			return temp;
+		}
+	}
+#endif
+
+	return read_struct_data(fd, bh, blockname);
+}
+
 typedef void (*link_list_cb)(FileData *fd, void *data);
 
 static void link_list_ex(FileData *fd, ListBase *lb, link_list_cb callback)		/* only direct data */
@@ -2317,12 +3003,71 @@ static void direct_link_paint_curve(FileData *fd, PaintCurve *pc)
 
 /* ************ READ PACKEDFILE *************** */
 
+#ifdef USE_MMAP_READ
+
+/**
+ * Packed file data is always written directly after its #PackedFile (see writefile.c),
+ * with #BLO_READ_DEFER_PACKED that block isn't read.
+ */
+static bool read_packedfile_data_is_deferred(const FileData *fd, const BHead *bhead_prev, const BHead *bhead)
+{
+	const void *data_old;
+
+	if ((bhead_prev == NULL) || (bhead_prev->code != DATA) ||
+	    (bhead_prev->SDNAnr != fd->packedfile_sdna_nr) || (bhead_prev->nr != 1) ||
+	    (bhead->code != DATA) || (bhead->SDNAnr != 0))
+	{
+		return false;
+	}
+
+	memcpy(&data_old, (const char *)(bhead_prev + 1) + fd->packedfile_data_offset, sizeof(data_old));
+	return (data_old == bhead->old);
+}
+
+static void read_packedfile_defer_init(FileData *fd)
+{
+	fd->packedfile_sdna_nr = DNA_struct_find_nr(fd->filesdna, "PackedFile");
+	if (fd->packedfile_sdna_nr != -1) {
+		fd->packedfile_data_offset = DNA_elem_offset(fd->filesdna, "PackedFile", "void", "*data");
+		fd->packedlazymap = oldnewmap_new();
+	}
+}
+
+static PackedFileLazy *packedfile_lazy_new(FileData *fd, const BHead *bhead)
+{
+	PackedFileLazy *lazy = MEM_callocN(sizeof(*lazy), "PackedFileLazy");
+
+	BLI_strncpy(lazy->filepath, fd->relabase, sizeof(lazy->filepath));
+	lazy->offset = (uint64_t)((const char *)bhead - fd->mmap_data);
+	lazy->old = (uint64_t)(uintptr_t)bhead->old;
+	lazy->is_framed = (fd->flags & FD_FLAGS_MMAP_IS_ALLOC) != 0;
+
+	return lazy;
+}
+
+#endif  /* USE_MMAP_READ */
+
 static PackedFile *direct_link_packedfile(FileData *fd, PackedFile *oldpf)
 {
 	PackedFile *pf = newpackedadr(fd, oldpf);
 
 	if (pf) {
+		const void *data_old = pf->data;
+
 		pf->data = newpackedadr(fd, pf->data);
+		/* undo keeps deferred data deferred (see write_packedfile) */
+		pf->lazy = newdataadr(fd, pf->lazy);
+
+#ifdef USE_MMAP_READ
+		if ((pf->data == NULL) && (pf->lazy == NULL) && fd->packedlazymap) {
+			const BHead *bhead = oldnewmap_lookup_and_inc(fd->packedlazymap, data_old, false);
+			if (bhead) {
+				pf->lazy = packedfile_lazy_new(fd, bhead);
+			}
+		}
+#else
+		UNUSED_VARS(data_old);
+#endif
 	}
 	
 	return pf;
@@ -8312,10 +9057,22 @@ static const char *dataname(short id_code)
 
 static BHead *read_data_into_oldnewmap(FileData *fd, BHead *bhead, const char *allocname)
 {
+	BHead *bhead_prev = bhead;
+
 	bhead = blo_nextbhead(fd, bhead);
 	
 	while (bhead && bhead->code==DATA) {
 		void *data;
+
+#ifdef USE_MMAP_READ
+		if (fd->packedlazymap && read_packedfile_data_is_deferred(fd, bhead_prev, bhead)) {
+			oldnewmap_insert(fd->packedlazymap, bhead->old, bhead, 0);
+			bhead_prev = bhead;
+			bhead = blo_nextbhead(fd, bhead);
+			continue;
+		}
+#endif
+
 #if 0
 		/* XXX DUMB DEBUGGING OPTION TO GIVE NAMES for guarded malloc errors */
 		short *sp = fd->filesdna->structs[bhead->SDNAnr];
@@ -8331,12 +9088,50 @@ static BHead *read_data_into_oldnewmap(FileData *fd, BHead *bhead, const char *a
 			oldnewmap_insert(fd->datamap, bhead->old, data, 0);
 		}
 		
+		bhead_prev = bhead;
 		bhead = blo_nextbhead(fd, bhead);
 	}
 	
 	return bhead;
 }
 
+/* Undo: move an unchanged ID from the old main instead of reading it, skipping its data. */
+static BHead *read_libblock_undo_reuse(
+        FileData *fd, Main *main, BHead *bhead, UndoReuseID *reuse, const short tag, ID **r_id)
+{
+	Main *oldmain = fd->old_mainlist->first;
+	ID *id = reuse->id;
+	BHeadN *bheadn;
+
+	BLI_assert(bhead->old == id);
+
+	BLI_remlink(which_libbase(oldmain, GS(id->name)), id);
+	BLI_addtail(which_libbase(main, GS(id->name)), id);
+	oldnewmap_insert(fd->libmap, bhead->old, id, bhead->code);
+
+	id->tag = tag;
+	id->us = ID_FAKE_USERS(id);
+	id->newid = NULL;
+	reuse->is_reused = true;
+
+	if (r_id) {
+		*r_id = id;
+	}
+
+	/* Memfiles are read in BHeadN's (no index), when the data wasn't read yet jump over it. */
+	bheadn = (BHeadN *)POINTER_OFFSET(bhead, -offsetof(BHeadN, bhead));
+	if (bheadn->next == NULL) {
+		fd->seek = reuse->seek_end;
+		return blo_nextbhead(fd, bhead);
+	}
+
+	do {
+		bhead = blo_nextbhead(fd, bhead);
+	} while (bhead && (bhead->code == DATA));
+
+	return bhead;
+}
+
 static BHead *read_libblock(FileData *fd, Main *main, BHead *bhead, const short tag, ID **r_id)
 {
 	/* this routine reads a libblock and its direct data. Use link functions to connect it all
@@ -8413,6 +9208,13 @@ static BHead *read_libblock(FileData *fd, Main *main, BHead *bhead, const short
 		}
 	}
 
+	if (fd->undo_reuse_map && (bhead->code != ID_ID)) {
+		UndoReuseID *reuse = BLI_ghash_lookup(fd->undo_reuse_map, bhead->old);
+		if (reuse && reuse->is_valid) {
+			return read_libblock_undo_reuse(fd, main, bhead, reuse, tag, r_id);
+		}
+	}
+
 	/* read libblock */
 	id = read_struct(fd, bhead, "lib block");
 
@@ -8437,7 +9239,7 @@ static BHead *read_libblock(FileData *fd, Main *main, BHead *bhead, const short
 	if (!id)
 		return blo_nextbhead(fd, bhead);
 	
-	id->tag = tag | LIB_TAG_NEED_LINK;
+	id->tag = tag | LIB_TAG_NEED_LINK | LIB_TAG_UNDO_CHANGED;
 	id->lib = main->curlib;
 	id->us = ID_FAKE_USERS(id);
 	id->icon_id = 0;
@@ -8828,6 +9630,89 @@ static BHead *read_userdef(BlendFileData *bfd, FileData *fd, BHead *bhead)
 	return bhead;
 }
 
+#ifdef USE_MMAP_READ
+
+typedef struct ReadStructPrefetchData {
+	FileData *fd;
+	/* allocation name per BHead, NULL for blocks not read ahead */
+	const char **names;
+} ReadStructPrefetchData;
+
+static void read_struct_prefetch_cb(
+        void *userdata, void *UNUSED(userdata_chunk), const int index, const int UNUSED(thread_id))
+{
+	ReadStructPrefetchData *data = userdata;
+	FileData *fd = data->fd;
+
+	if (data->names[index]) {
+		fd->bhead_data[index] = read_struct_data(fd, fd->bhead_index[index], data->names[index]);
+	}
+}
+
+/**
+ * Reconstruct the struct data of all ID blocks and their direct data in parallel,
+ * #read_struct then takes the result instead of converting the block itself.
+ *
+ * Only for mapped files, where all blocks can be indexed up-front and read without side effects.
+ * Linking (#lib_link_all) remains single threaded, it changes user counts
+ * and other ID's while looking up pointers.
+ */
+static void read_struct_prefetch(FileData *fd)
+{
+	ReadStructPrefetchData data;
+	const char *owner_name = NULL;
+	BHead *bhead;
+	int i;
+
+	if (!bhead_index_use(fd) || fd->memfile || (fd->skip_flags & BLO_READ_SKIP_DATA)) {
+		return;
+	}
+
+	for (bhead = blo_firstbhead(fd); bhead && bhead->code != ENDB; bhead = blo_nextbhead(fd, bhead)) {
+		/* pass */
+	}
+
+	if (fd->bhead_index_len == 0) {
+		return;
+	}
+
+	data.fd = fd;
+	data.names = MEM_mallocN(sizeof(*data.names) * (size_t)fd->bhead_index_len, __func__);
+
+	/* same allocation names as read_libblock and read_data_into_oldnewmap */
+	for (i = 0; i < fd->bhead_index_len; i++) {
+		const int code = fd->bhead_index[i]->code;
+
+		if (code == DATA) {
+			data.names[i] = owner_name;
+			if (fd->packedlazymap && (i != 0) &&
+			    read_packedfile_data_is_deferred(fd, fd->bhead_index[i - 1], fd->bhead_index[i]))
+			{
+				data.names[i] = NULL;
+			}
+		}
+		else if (ELEM(code, DNA1, TEST, REND, GLOB, USER, ENDB)) {
+			data.names[i] = owner_name = NULL;
+		}
+		else {
+			data.names[i] = "lib block";
+			owner_name = dataname((code == ID_SCRN) ? ID_SCR : (short)code);
+		}
+	}
+
+	fd->bhead_data = MEM_callocN(sizeof(*fd->bhead_data) * (size_t)fd->bhead_index_len, __func__);
+	fd->bhead_data_len = fd->bhead_index_len;
+
+	/* block sizes vary a lot (a single ID vs. a mesh vertex array) */
+	BLI_task_parallel_range_ex(0, fd->bhead_index_len, &data, NULL, 0, read_struct_prefetch_cb, true, true);
+
+	MEM_freeN(data.names);
+
+	fd->bhead_index_hint = 0;
+}
+
+#endif  /* USE_MMAP_READ */
+
 BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
 {
 	BHead *bhead = blo_firstbhead(fd);
@@ -8844,6 +9729,8 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
 	bfd->type = BLENFILETYPE_BLEND;
 	BLI_strncpy(bfd->main->name, filepath, sizeof(bfd->main->name));
 
+	BLI_TRACE_BEGIN("readfile", "read_file");
+
 	if (G.background) {
 		/* We only read & store .blend thumbnail in background mode
 		 * (because we cannot re-generate it, no OpenGL available).
@@ -8862,6 +9749,17 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
 		}
 	}
 
+#ifdef USE_MMAP_READ
+	if ((fd->skip_flags & BLO_READ_DEFER_PACKED) && bhead_index_use(fd) && (fd->memfile == NULL)) {
+		read_packedfile_defer_init(fd);
+	}
+
+	BLI_TRACE_BEGIN("readfile", "read_struct_prefetch");
+	read_struct_prefetch(fd);
+	BLI_TRACE_END();
+#endif
+
+	BLI_TRACE_BEGIN("readfile", "read_libblocks");
 	while (bhead) {
 		switch (bhead->code) {
 		case DATA:
@@ -8909,18 +9807,28 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
 			}
 		}
 	}
+#ifdef USE_MMAP_READ
+	bhead_data_free(fd);
+#endif
+	BLI_TRACE_END();
 	
 	/* do before read_libraries, but skip undo case */
 	if (fd->memfile == NULL) {
+		BLI_TRACE_BEGIN("readfile", "do_versions");
 		do_versions(fd, NULL, bfd->main);
 		do_versions_userdef(fd, bfd);
+		BLI_TRACE_END();
 	}
 	
+	BLI_TRACE_BEGIN("readfile", "read_libraries");
 	read_libraries(fd, &mainlist);
+	BLI_TRACE_END();
 	
 	blo_join_main(&mainlist);
 	
+	BLI_TRACE_BEGIN("readfile", "lib_link_all");
 	lib_link_all(fd, bfd->main);
+	BLI_TRACE_END();
 
 	/* Skip in undo case. */
 	if (fd->memfile == NULL) {
@@ -8942,6 +9850,8 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
 	
 	fd->mainlist = NULL;  /* Safety, this is local variable, shall not be used afterward. */
 
+	BLI_TRACE_END();
+
 	return bfd;
 }
 
@@ -10704,11 +11614,14 @@ static void read_libraries(FileData *basefd, ListBase *mainlist)
 						        basefd->reports, RPT_INFO, TIP_("Read packed library:  '%s', parent '%s'"),
 						        mainptr->curlib->name,
 						        library_parent_filepath(mainptr->curlib));
-						fd = blo_openblendermemory(pf->data, pf->size, basefd->reports);
-						
+						if (BKE_packedfile_ensure_data(pf, basefd->reports)) {
+							fd = blo_openblendermemory(pf->data, pf->size, basefd->reports);
+						}
 						
-						/* needed for library_append and read_libraries */
-						BLI_strncpy(fd->relabase, mainptr->curlib->filepath, sizeof(fd->relabase));
+						if (fd) {
+							/* needed for library_append and read_libraries */
+							BLI_strncpy(fd->relabase, mainptr->curlib->filepath, sizeof(fd->relabase));
+						}
 					}
 					else {
 						blo_reportf_wrap(
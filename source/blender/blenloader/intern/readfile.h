@@ -45,6 +45,8 @@ struct Object;
 struct PartEff;
 struct View3D;
 struct Key;
+struct GHash;
+struct UndoReuseID;
 
 typedef struct FileData {
 	// linked list of BHeadN's
@@ -63,6 +65,25 @@ typedef struct FileData {
 	// variables needed for reading from file
 	int filedes;
 	gzFile gzfiledes;
+	/* block compressed files (see: framefile.h), when not decompressed into 'mmap_data' */
+	struct FrameFileReader *framefile;
+	size_t framefile_seek;
+
+	/* Uncompressed files which don't need BHead conversion are mapped (see: USE_MMAP_READ),
+	 * BHead's point into the mapping instead of being copied into 'listbase'.
+	 * Block compressed files are decompressed into an allocation used the same way
+	 * (see: FD_FLAGS_MMAP_IS_ALLOC). */
+	char *mmap_data;
+	size_t mmap_size, mmap_seek;
+	/* BHead's read so far, in file order */
+	struct BHead **bhead_index;
+	int bhead_index_len, bhead_index_alloc;
+	/* index of the BHead last returned, iteration is mostly sequential */
+	int bhead_index_hint;
+	/* Struct data read ahead in parallel, matching 'bhead_index' (see: read_struct_prefetch),
+	 * entries are taken (set to NULL) by read_struct. */
+	void **bhead_data;
+	int bhead_data_len;
 
 	// now only in use for library appending
 	char relabase[FILE_MAX];
@@ -92,6 +113,9 @@ typedef struct FileData {
 	struct OldNewMap *movieclipmap;
 	struct OldNewMap *soundmap;
 	struct OldNewMap *packedmap;
+	/* Packed file data which isn't read (BLO_READ_DEFER_PACKED), maps the old data pointer to its BHead. */
+	struct OldNewMap *packedlazymap;
+	int packedfile_sdna_nr, packedfile_data_offset;
 	
 	struct BHeadSort *bheadmap;
 	int tot_bheadmap;
@@ -102,6 +126,12 @@ typedef struct FileData {
 	ListBase *mainlist;
 	ListBase *old_mainlist;  /* Used for undo. */
 
+	/* Undo: ID's of the old main which are unchanged and kept instead of being read again,
+	 * maps their address to an #UndoReuseID (see: blo_make_undo_reuse_map). */
+	struct UndoReuseID *undo_reuse;
+	int undo_reuse_len;
+	struct GHash *undo_reuse_map;
+
 	/* ick ick, used to return
 	 * data through streamglue.
 	 */
@@ -122,6 +152,7 @@ enum {
 	FD_FLAGS_FILE_OK               = 1 << 3,
 	FD_FLAGS_NOT_MY_BUFFER         = 1 << 4,
 	FD_FLAGS_NOT_MY_LIBMAP         = 1 << 5,  /* XXX Unused in practice (checked once but never set). */
+	FD_FLAGS_MMAP_IS_ALLOC         = 1 << 6,
 };
 
 #define SIZEOFBLENDERHEADER 12
@@ -147,6 +178,8 @@ void blo_end_sound_pointer_map(FileData *fd, Main *oldmain);
 void blo_make_packed_pointer_map(FileData *fd, Main *oldmain);
 void blo_end_packed_pointer_map(FileData *fd, Main *oldmain);
 void blo_add_library_pointer_map(ListBase *old_mainlist, FileData *fd);
+void blo_make_undo_reuse_map(FileData *fd, Main *oldmain, struct MemFile *memfile_active);
+void blo_end_undo_reuse_map(FileData *fd);
 
 void blo_freefiledata(FileData *fd);
 
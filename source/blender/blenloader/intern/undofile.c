@@ -37,9 +37,14 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "DNA_ID.h"
 #include "DNA_listBase.h"
+#include "DNA_object_types.h"
 
 #include "BLI_blenlib.h"
+#include "BLI_ghash.h"
+
+#include "BKE_node.h"
 
 #include "BLO_undofile.h"
 
@@ -55,6 +60,10 @@ void BLO_memfile_free(MemFile *memfile)
 			MEM_freeN(chunk->buf);
 		MEM_freeN(chunk);
 	}
+	if (memfile->id_chunk_map) {
+		BLI_ghash_free(memfile->id_chunk_map, NULL, NULL);
+		memfile->id_chunk_map = NULL;
+	}
 	memfile->size = 0;
 }
 
@@ -62,44 +71,77 @@ void BLO_memfile_free(MemFile *memfile)
 /* result is that 'first' is being freed */
 void BLO_memfile_merge(MemFile *first, MemFile *second)
 {
+	/* Chunks of 'second' sharing a buffer with 'first' take over its ownership.
+	 * Shared chunks don't have to be at the same position in both lists (see #memfile_chunk_add_shared),
+	 * and multiple chunks may share one buffer, only one of them becomes the owner. */
+	GSet *buf_shared = BLI_gset_ptr_new(__func__);
 	MemFileChunk *fc, *sc;
-	
-	fc = first->chunks.first;
-	sc = second->chunks.first;
-	while (fc || sc) {
-		if (fc && sc) {
-			if (sc->ident) {
+
+	for (sc = second->chunks.first; sc; sc = sc->next) {
+		if (sc->ident) {
+			if (BLI_gset_add(buf_shared, sc->buf)) {
 				sc->ident = 0;
-				fc->ident = 1;
 			}
 		}
-		if (fc) fc = fc->next;
-		if (sc) sc = sc->next;
 	}
+	for (fc = first->chunks.first; fc; fc = fc->next) {
+		if (BLI_gset_haskey(buf_shared, fc->buf)) {
+			fc->ident = 1;
+		}
+	}
+	BLI_gset_free(buf_shared, NULL);
 	
 	BLO_memfile_free(first);
 }
 
-void memfile_chunk_add(MemFile *compare, MemFile *current, const char *buf, unsigned int size)
+/**
+ * Copy \a src into the empty \a dst, without sharing any data (so \a src can be freed while \a dst is used).
+ */
+void BLO_memfile_copy(MemFile *dst, const MemFile *src)
 {
-	static MemFileChunk *compchunk = NULL;
+	const MemFileChunk *chunk;
+
+	BLI_assert(BLI_listbase_is_empty(&dst->chunks));
+
+	for (chunk = src->chunks.first; chunk; chunk = chunk->next) {
+		MemFileChunk *compchunk = NULL;
+		memfile_chunk_add(dst, chunk->buf, chunk->size, &compchunk, chunk->id);
+	}
+}
+
+/**
+ * Add a chunk of written data to \a memfile,
+ * sharing the buffer of the chunk at \a compchunk_step when it's identical.
+ *
+ * \param compchunk_step: Chunk of the previous memfile to compare against, advanced to the next chunk.
+ * Only chunks written for the same \a id are compared.
+ */
+void memfile_chunk_add(
+        MemFile *memfile, const char *buf, unsigned int size,
+        MemFileChunk **compchunk_step, const void *id)
+{
+	MemFileChunk *compchunk = *compchunk_step;
 	MemFileChunk *curchunk;
 	
-	/* this function inits when compare != NULL or when current == NULL  */
-	if (compare) {
-		compchunk = compare->chunks.first;
-		return;
+	if (id) {
+		/* Chunks of an ID are contiguous, stop comparing past them. */
+		if (compchunk && compchunk->id != id) {
+			compchunk = NULL;
+		}
 	}
-	if (current == NULL) {
-		compchunk = NULL;
-		return;
+	else {
+		/* Data not owned by an ID, skip over ID's (which may be added, removed or reused). */
+		while (compchunk && compchunk->id) {
+			compchunk = compchunk->next;
+		}
 	}
 	
 	curchunk = MEM_mallocN(sizeof(MemFileChunk), "MemFileChunk");
 	curchunk->size = size;
 	curchunk->buf = NULL;
 	curchunk->ident = 0;
-	BLI_addtail(&current->chunks, curchunk);
+	curchunk->id = id;
+	BLI_addtail(&memfile->chunks, curchunk);
 	
 	/* we compare compchunk with buf */
 	if (compchunk) {
@@ -111,12 +153,90 @@ void memfile_chunk_add(MemFile *compare, MemFile *current, const char *buf, unsi
 		}
 		compchunk = compchunk->next;
 	}
+	*compchunk_step = compchunk;
 	
 	/* not equal... */
 	if (curchunk->buf == NULL) {
 		curchunk->buf = MEM_mallocN(size, "Chunk buffer");
 		memcpy(curchunk->buf, buf, size);
-		current->size += size;
+		memfile->size += size;
 	}
 }
 
+/**
+ * Add a chunk of the previous memfile to \a memfile without comparing it,
+ * used for ID's which didn't change since the previous undo step (see #BLO_memfile_id_is_reusable).
+ */
+void memfile_chunk_add_shared(MemFile *memfile, const MemFileChunk *compchunk)
+{
+	MemFileChunk *curchunk = MEM_mallocN(sizeof(MemFileChunk), "MemFileChunk");
+	curchunk->size = compchunk->size;
+	curchunk->buf = compchunk->buf;
+	curchunk->ident = 1;
+	curchunk->id = compchunk->id;
+	BLI_addtail(&memfile->chunks, curchunk);
+}
+
+/**
+ * \return The first chunk written for \a id, its other chunks follow it.
+ */
+MemFileChunk *BLO_memfile_id_chunk_find(MemFile *memfile, const void *id)
+{
+	if (memfile->id_chunk_map == NULL) {
+		MemFileChunk *chunk;
+		const void *id_prev = NULL;
+
+		memfile->id_chunk_map = BLI_ghash_ptr_new(__func__);
+		for (chunk = memfile->chunks.first; chunk; chunk = chunk->next) {
+			if (chunk->id && chunk->id != id_prev) {
+				BLI_ghash_insert(memfile->id_chunk_map, (void *)chunk->id, chunk);
+			}
+			id_prev = chunk->id;
+		}
+	}
+	return BLI_ghash_lookup(memfile->id_chunk_map, id);
+}
+
+/**
+ * Whether the undo data of \a id can be shared with the previous undo step,
+ * instead of writing it again (and on undo, keeping the ID instead of reading it again).
+ *
+ * Only ID types which are reliably tagged when edited are handled
+ * (see #LIB_TAG_UNDO_CHANGED, set by depsgraph and RNA updates), others are always written.
+ */
+bool BLO_memfile_id_is_reusable(const ID *id)
+{
+	if ((id->tag & LIB_TAG_UNDO_CHANGED) || (id->lib != NULL)) {
+		return false;
+	}
+
+	switch ((ID_Type)GS(id->name)) {
+		case ID_OB:
+		{
+			/* Game logic is linked between objects through the global pointer map on reading. */
+			const Object *ob = (const Object *)id;
+			return BLI_listbase_is_empty(&ob->sensors) &&
+			       BLI_listbase_is_empty(&ob->controllers) &&
+			       BLI_listbase_is_empty(&ob->actuators);
+		}
+		case ID_ME:
+		case ID_CU:
+		case ID_MB:
+		case ID_LT:
+		case ID_AR:
+		case ID_CA:
+		case ID_SPK:
+		case ID_LP:
+		case ID_PA:
+			return true;
+		case ID_MA:
+		case ID_TE:
+		case ID_LA:
+		case ID_WO:
+		case ID_LS:
+			/* Node editor changes (moving nodes for e.g.) are not tagged. */
+			return ntreeFromID((ID *)id) == NULL;
+		default:
+			return false;
+	}
+}
@@ -161,6 +161,9 @@
 #include "BLI_blenlib.h"
 #include "BLI_linklist.h"
 #include "BLI_mempool.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+#include "BLI_trace.h"
 
 #include "BKE_action.h"
 #include "BKE_blender_version.h"
@@ -172,6 +175,7 @@
 #include "BKE_library.h" // for  set_listbasepointers
 #include "BKE_main.h"
 #include "BKE_node.h"
+#include "BKE_packedFile.h"
 #include "BKE_report.h"
 #include "BKE_sequencer.h"
 #include "BKE_subsurf.h"
@@ -192,6 +196,7 @@
 #include "BLO_blend_defs.h"
 
 #include "readfile.h"
+#include "framefile.h"
 
 /* for SDNA_TYPE_FROM_STRUCT() macro */
 #include "dna_type_offsets.h"
@@ -211,6 +216,8 @@
 typedef enum {
 	WW_WRAP_NONE = 1,
 	WW_WRAP_ZLIB,
+	WW_WRAP_FRAMES,
+	WW_WRAP_MEMFILE,
 } eWriteWrapType;
 
 typedef struct WriteWrap WriteWrap;
@@ -224,6 +231,8 @@ struct WriteWrap {
 	union {
 		int file_handle;
 		gzFile gz_handle;
+		FrameFileWriter *frames_handle;
+		MemFile *memfile_handle;
 	} _user_data;
 };
 
@@ -283,6 +292,56 @@ static size_t ww_write_zlib(WriteWrap *ww, const char *buf, size_t buf_len)
 }
 #undef FILE_HANDLE
 
+/* block compressed (see framefile.h) */
+#define FILE_HANDLE(ww) \
+	(ww)->_user_data.frames_handle
+
+static bool ww_open_frames(WriteWrap *ww, const char *filepath)
+{
+	FrameFileWriter *ffw;
+
+	ffw = blo_framefile_writer_open(filepath);
+
+	if (ffw != NULL) {
+		FILE_HANDLE(ww) = ffw;
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+static bool ww_close_frames(WriteWrap *ww)
+{
+	return blo_framefile_writer_close(FILE_HANDLE(ww));
+}
+static size_t ww_write_frames(WriteWrap *ww, const char *buf, size_t buf_len)
+{
+	return blo_framefile_writer_write(FILE_HANDLE(ww), buf, buf_len) ? buf_len : 0;
+}
+#undef FILE_HANDLE
+
+/* in memory, written to disk later (see BLO_write_file_snapshot) */
+#define FILE_HANDLE(ww) \
+	(ww)->_user_data.memfile_handle
+
+static bool ww_open_memfile(WriteWrap *UNUSED(ww), const char *UNUSED(filepath))
+{
+	/* the memfile is set by the caller */
+	return true;
+}
+static bool ww_close_memfile(WriteWrap *UNUSED(ww))
+{
+	return true;
+}
+static size_t ww_write_memfile(WriteWrap *ww, const char *buf, size_t buf_len)
+{
+	MemFileChunk *compchunk = NULL;
+
+	memfile_chunk_add(FILE_HANDLE(ww), buf, (unsigned int)buf_len, &compchunk, NULL);
+	return buf_len;
+}
+#undef FILE_HANDLE
+
 /* --- end compression types --- */
 
 static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
@@ -297,6 +356,20 @@ static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
 			r_ww->write = ww_write_zlib;
 			break;
 		}
+		case WW_WRAP_FRAMES:
+		{
+			r_ww->open  = ww_open_frames;
+			r_ww->close = ww_close_frames;
+			r_ww->write = ww_write_frames;
+			break;
+		}
+		case WW_WRAP_MEMFILE:
+		{
+			r_ww->open  = ww_open_memfile;
+			r_ww->close = ww_close_memfile;
+			r_ww->write = ww_write_memfile;
+			break;
+		}
 		default:
 		{
 			r_ww->open  = ww_open_none;
@@ -316,10 +389,17 @@ typedef struct {
 
 	unsigned char *buf;
 	MemFile *compare, *current;
+	/* Chunk of 'compare' to de-duplicate against, for data not owned by an ID and for 'current_id'. */
+	MemFileChunk *compare_chunk, *compare_chunk_id;
+	/* The ID being written to 'current', see #mywrite_id_begin. */
+	const ID *current_id;
 
 	int tot, count;
 	bool error;
 
+	/* Writing undo, deferred packed data is kept as a reference to the file it was loaded from. */
+	bool use_memfile;
+
 	/* Wrap writing, so we can use zlib or
 	 * other compression types later, see: G_FILE_COMPRESS
 	 * Will be NULL for UNDO. */
@@ -355,7 +435,12 @@ static void writedata_do_write(WriteData *wd, const void *mem, int memlen)
 
 	/* memory based save */
 	if (wd->current) {
-		memfile_chunk_add(NULL, wd->current, mem, memlen);
+		if (wd->current_id) {
+			memfile_chunk_add(wd->current, mem, memlen, &wd->compare_chunk_id, wd->current_id);
+		}
+		else {
+			memfile_chunk_add(wd->current, mem, memlen, &wd->compare_chunk, NULL);
+		}
 	}
 	else {
 		if (wd->ww->write(wd->ww, mem, memlen) != memlen) {
@@ -449,8 +534,9 @@ static WriteData *bgnwrite(WriteWrap *ww, MemFile *compare, MemFile *current)
 
 	wd->compare = compare;
 	wd->current = current;
+	wd->use_memfile = (current != NULL);
 	/* this inits comparing */
-	memfile_chunk_add(compare, NULL, NULL, 0);
+	wd->compare_chunk = compare ? compare->chunks.first : NULL;
 
 	return wd;
 }
@@ -474,6 +560,61 @@ static bool endwrite(WriteData *wd)
 	return err;
 }
 
+/**
+ * Undo only: write the undo data of \a id to its own chunks,
+ * so the next undo step can share them when \a id doesn't change (see #mywrite_id_reuse).
+ */
+static void mywrite_id_begin(WriteData *wd, const ID *id)
+{
+	mywrite_flush(wd);
+
+	wd->current_id = id;
+	wd->compare_chunk_id = wd->compare ? BLO_memfile_id_chunk_find(wd->compare, id) : NULL;
+}
+
+static void mywrite_id_end(WriteData *wd)
+{
+	mywrite_flush(wd);
+
+	wd->current_id = NULL;
+	wd->compare_chunk_id = NULL;
+}
+
+/**
+ * Undo only: share the chunks \a id was written to in the previous undo step instead of writing it,
+ * when it wasn't changed since.
+ *
+ * \return false when \a id has to be written.
+ */
+static bool mywrite_id_reuse(WriteData *wd, const ID *id)
+{
+	MemFileChunk *chunk;
+	const BHead *bh;
+
+	if (wd->compare == NULL || !BLO_memfile_id_is_reusable(id)) {
+		return false;
+	}
+
+	chunk = BLO_memfile_id_chunk_find(wd->compare, id);
+	if (chunk == NULL || chunk->size < sizeof(BHead) + sizeof(ID)) {
+		return false;
+	}
+
+	/* Check this is the same ID and not a new one allocated at the same address. */
+	bh = (const BHead *)chunk->buf;
+	if ((bh->old != id) || (bh->code != GS(id->name)) || !STREQ(((const ID *)(bh + 1))->name, id->name)) {
+		return false;
+	}
+
+	mywrite_flush(wd);
+
+	for (; chunk && (chunk->id == id); chunk = chunk->next) {
+		memfile_chunk_add_shared(wd->current, chunk);
+	}
+
+	return true;
+}
+
 /* ********** WRITE FILE ****************** */
 
 static void writestruct_at_address_nr(
@@ -1944,6 +2085,19 @@ static void write_object(WriteData *wd, Object *ob)
 }
 
 
+static void write_packedfile(WriteData *wd, PackedFile *pf)
+{
+	/* Deferred data is only read when writing to disk (see #BKE_packedfile_ensure_data_all),
+	 * undo keeps the reference so loading a file doesn't read all packed data for the first undo push. */
+	BLI_assert(wd->use_memfile || (pf->lazy == NULL));
+
+	writestruct(wd, DATA, PackedFile, 1, pf);
+	writedata(wd, DATA, pf->size, pf->data);
+	if (wd->use_memfile && pf->lazy) {
+		writestruct(wd, DATA, PackedFileLazy, 1, pf->lazy);
+	}
+}
+
 static void write_vfont(WriteData *wd, VFont *vf)
 {
 	if (vf->id.us > 0 || wd->current) {
@@ -1953,9 +2107,7 @@ static void write_vfont(WriteData *wd, VFont *vf)
 
 		/* direct data */
 		if (vf->packedfile) {
-			PackedFile *pf = vf->packedfile;
-			writestruct(wd, DATA, PackedFile, 1, pf);
-			writedata(wd, DATA, pf->size, pf->data);
+			write_packedfile(wd, vf->packedfile);
 		}
 	}
 }
@@ -2365,9 +2517,7 @@ static void write_image(WriteData *wd, Image *ima)
 		for (imapf = ima->packedfiles.first; imapf; imapf = imapf->next) {
 			writestruct(wd, DATA, ImagePackedFile, 1, imapf);
 			if (imapf->packedfile) {
-				PackedFile *pf = imapf->packedfile;
-				writestruct(wd, DATA, PackedFile, 1, pf);
-				writedata(wd, DATA, pf->size, pf->data);
+				write_packedfile(wd, imapf->packedfile);
 			}
 		}
 
@@ -3195,9 +3345,7 @@ static void write_sound(WriteData *wd, bSound *sound)
 		write_iddata(wd, &sound->id);
 
 		if (sound->packedfile) {
-			PackedFile *pf = sound->packedfile;
-			writestruct(wd, DATA, PackedFile, 1, pf);
-			writedata(wd, DATA, pf->size, pf->data);
+			write_packedfile(wd, sound->packedfile);
 		}
 	}
 }
@@ -3806,9 +3954,7 @@ static void write_libraries(WriteData *wd, Main *main)
 			write_iddata(wd, &main->curlib->id);
 
 			if (main->curlib->packedfile) {
-				PackedFile *pf = main->curlib->packedfile;
-				writestruct(wd, DATA, PackedFile, 1, pf);
-				writedata(wd, DATA, pf->size, pf->data);
+				write_packedfile(wd, main->curlib->packedfile);
 				if (wd->current == NULL) {
 					printf("write packed .blend: %s\n", main->curlib->name);
 				}
@@ -3893,6 +4039,264 @@ static void write_thumb(WriteData *wd, const BlendThumbnail *thumb)
 	}
 }
 
+static void write_id(WriteData *wd, ID *id)
+{
+	switch ((ID_Type)GS(id->name)) {
+		case ID_WM:
+			write_windowmanager(wd, (wmWindowManager *)id);
+			break;
+		case ID_WS:
+			write_workspace(wd, (WorkSpace *)id);
+			break;
+		case ID_SCR:
+			write_screen(wd, (bScreen *)id);
+			break;
+		case ID_MC:
+			write_movieclip(wd, (MovieClip *)id);
+			break;
+		case ID_MSK:
+			write_mask(wd, (Mask *)id);
+			break;
+		case ID_SCE:
+			write_scene(wd, (Scene *)id);
+			break;
+		case ID_CU:
+			write_curve(wd, (Curve *)id);
+			break;
+		case ID_MB:
+			write_mball(wd, (MetaBall *)id);
+			break;
+		case ID_IM:
+			write_image(wd, (Image *)id);
+			break;
+		case ID_CA:
+			write_camera(wd, (Camera *)id);
+			break;
+		case ID_LA:
+			write_lamp(wd, (Lamp *)id);
+			break;
+		case ID_LT:
+			write_lattice(wd, (Lattice *)id);
+			break;
+		case ID_VF:
+			write_vfont(wd, (VFont *)id);
+			break;
+		case ID_KE:
+			write_key(wd, (Key *)id);
+			break;
+		case ID_WO:
+			write_world(wd, (World *)id);
+			break;
+		case ID_TXT:
+			write_text(wd, (Text *)id);
+			break;
+		case ID_SPK:
+			write_speaker(wd, (Speaker *)id);
+			break;
+		case ID_LP:
+			write_probe(wd, (LightProbe *)id);
+			break;
+		case ID_SO:
+			write_sound(wd, (bSound *)id);
+			break;
+		case ID_GR:
+			write_group(wd, (Group *)id);
+			break;
+		case ID_AR:
+			write_armature(wd, (bArmature *)id);
+			break;
+		case ID_AC:
+			write_action(wd, (bAction *)id);
+			break;
+		case ID_OB:
+			write_object(wd, (Object *)id);
+			break;
+		case ID_MA:
+			write_material(wd, (Material *)id);
+			break;
+		case ID_TE:
+			write_texture(wd, (Tex *)id);
+			break;
+		case ID_ME:
+			write_mesh(wd, (Mesh *)id);
+			break;
+		case ID_PA:
+			write_particlesettings(wd, (ParticleSettings *)id);
+			break;
+		case ID_NT:
+			write_nodetree(wd, (bNodeTree *)id);
+			break;
+		case ID_BR:
+			write_brush(wd, (Brush *)id);
+			break;
+		case ID_PAL:
+			write_palette(wd, (Palette *)id);
+			break;
+		case ID_PC:
+			write_paintcurve(wd, (PaintCurve *)id);
+			break;
+		case ID_GD:
+			write_gpencil(wd, (bGPdata *)id);
+			break;
+		case ID_LS:
+			write_linestyle(wd, (FreestyleLineStyle *)id);
+			break;
+		case ID_CF:
+			write_cachefile(wd, (CacheFile *)id);
+			break;
+		case ID_LI:
+			/* Do nothing, handled below - and should never be reached. */
+			BLI_assert(0);
+			break;
+		case ID_IP:
+			/* Do nothing, deprecated. */
+			break;
+		default:
+			/* Should never be reached. */
+			BLI_assert(0);
+			break;
+	}
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Parallel ID Writing
+ *
+ * When writing a file (not undo), each ID is serialized into its own #MemFile by a task.
+ * The buffers are written out in the same order the IDs are written sequentially,
+ * so the file is unchanged. Writing to the #WriteWrap (disk I/O and compression)
+ * happens while the following IDs are still being serialized.
+ * \{ */
+
+typedef struct WriteIDTask {
+	ID *id;
+	MemFile memfile;
+	bool done;
+} WriteIDTask;
+
+typedef struct WriteIDTaskData {
+	WriteIDTask *tasks;
+#ifdef USE_BMESH_SAVE_AS_COMPAT
+	bool use_mesh_compat;
+#endif
+
+	ThreadMutex done_lock;
+	ThreadCondition done_cond;
+} WriteIDTaskData;
+
+static void write_id_task_run(TaskPool *__restrict pool, void *taskdata, int UNUSED(threadid))
+{
+	WriteIDTaskData *data = BLI_task_pool_userdata(pool);
+	WriteIDTask *task = taskdata;
+	WriteWrap ww;
+	WriteData *wd;
+
+	ww_handle_init(WW_WRAP_MEMFILE, &ww);
+	ww._user_data.memfile_handle = &task->memfile;
+
+	wd = bgnwrite(&ww, NULL, NULL);
+#ifdef USE_BMESH_SAVE_AS_COMPAT
+	wd->use_mesh_compat = data->use_mesh_compat;
+#endif
+
+	write_id(wd, task->id);
+
+	endwrite(wd);
+
+	BLI_mutex_lock(&data->done_lock);
+	task->done = true;
+	BLI_condition_notify_all(&data->done_cond);
+	BLI_mutex_unlock(&data->done_lock);
+}
+
+static bool write_ids_use_threads(const WriteData *wd)
+{
+	/* Undo compares against the previous step chunk by chunk, which is sequential. */
+	return (wd->current == NULL) && (BLI_task_scheduler_num_threads(BLI_task_scheduler_get()) > 1);
+}
+
+/**
+ * Write the IDs of \a lbarray (libraries excepted) in the same order as the sequential loop
+ * in #write_file_handle.
+ */
+static void write_ids_parallel(WriteData *wd, ListBase *lbarray[MAX_LIBARRAY], int lbarray_len)
+{
+	WriteIDTaskData data = {NULL};
+	TaskPool *pool;
+	int tasks_num = 0;
+	int a, i;
+
+	for (a = 0; a < lbarray_len; a++) {
+		ID *id = lbarray[a]->first;
+		if (id && GS(id->name) != ID_LI) {
+			tasks_num += BLI_listbase_count(lbarray[a]);
+		}
+	}
+
+	if (tasks_num == 0) {
+		return;
+	}
+
+	/* Type info tables are built on first use, do it here so the tasks don't race on it. */
+	get_fmodifier_typeinfo(FMODIFIER_TYPE_NULL);
+	BKE_constraint_typeinfo_from_type(CONSTRAINT_TYPE_NULL);
+	BKE_sequence_modifier_type_info_get(0);
+
+	data.tasks = MEM_callocN(sizeof(*data.tasks) * (size_t)tasks_num, __func__);
+#ifdef USE_BMESH_SAVE_AS_COMPAT
+	data.use_mesh_compat = wd->use_mesh_compat;
+#endif
+	BLI_mutex_init(&data.done_lock);
+	BLI_condition_init(&data.done_cond);
+
+	/* Background pool, since we wait on the tasks ourselves instead of working on them. */
+	pool = BLI_task_pool_create_background(BLI_task_scheduler_get(), &data);
+
+	i = 0;
+	a = lbarray_len;
+	while (a--) {
+		ID *id = lbarray[a]->first;
+
+		if (id && GS(id->name) == ID_LI) {
+			continue;  /* Libraries are handled separately. */
+		}
+
+		for (; id; id = id->next, i++) {
+			data.tasks[i].id = id;
+			BLI_task_pool_push(pool, write_id_task_run, &data.tasks[i], false, TASK_PRIORITY_LOW);
+		}
+	}
+	BLI_assert(i == tasks_num);
+
+	/* The tasks' chunks go after what was written so far. */
+	mywrite_flush(wd);
+
+	for (i = 0; i < tasks_num; i++) {
+		WriteIDTask *task = &data.tasks[i];
+		MemFileChunk *chunk;
+
+		BLI_mutex_lock(&data.done_lock);
+		while (!task->done) {
+			BLI_condition_wait(&data.done_cond, &data.done_lock);
+		}
+		BLI_mutex_unlock(&data.done_lock);
+
+		for (chunk = task->memfile.chunks.first; chunk; chunk = chunk->next) {
+			wd->tot += (int)chunk->size;
+			writedata_do_write(wd, chunk->buf, (int)chunk->size);
+		}
+		BLO_memfile_free(&task->memfile);
+	}
+
+	BLI_task_pool_work_and_wait(pool);
+	BLI_task_pool_free(pool);
+
+	BLI_condition_end(&data.done_cond);
+	BLI_mutex_end(&data.done_lock);
+	MEM_freeN(data.tasks);
+}
+
+/** \} */
+
 /* if MemFile * there's filesave to memory */
 static bool write_file_handle(
         Main *mainvar,
@@ -3938,132 +4342,35 @@ static bool write_file_handle(
 
 	ListBase *lbarray[MAX_LIBARRAY];
 	int a = set_listbasepointers(mainvar, lbarray);
-	while (a--) {
-		ID *id = lbarray[a]->first;
 
-		if (id && GS(id->name) == ID_LI) {
-			continue;  /* Libraries are handled separately below. */
-		}
+	if (write_ids_use_threads(wd)) {
+		write_ids_parallel(wd, lbarray, a);
+	}
+	else {
+		while (a--) {
+			ID *id = lbarray[a]->first;
 
-		for (; id; id = id->next) {
-			switch ((ID_Type)GS(id->name)) {
-				case ID_WM:
-					write_windowmanager(wd, (wmWindowManager *)id);
-					break;
-				case ID_WS:
-					write_workspace(wd, (WorkSpace *)id);
-					break;
-				case ID_SCR:
-					write_screen(wd, (bScreen *)id);
-					break;
-				case ID_MC:
-					write_movieclip(wd, (MovieClip *)id);
-					break;
-				case ID_MSK:
-					write_mask(wd, (Mask *)id);
-					break;
-				case ID_SCE:
-					write_scene(wd, (Scene *)id);
-					break;
-				case ID_CU:
-					write_curve(wd, (Curve *)id);
-					break;
-				case ID_MB:
-					write_mball(wd, (MetaBall *)id);
-					break;
-				case ID_IM:
-					write_image(wd, (Image *)id);
-					break;
-				case ID_CA:
-					write_camera(wd, (Camera *)id);
-					break;
-				case ID_LA:
-					write_lamp(wd, (Lamp *)id);
-					break;
-				case ID_LT:
-					write_lattice(wd, (Lattice *)id);
-					break;
-				case ID_VF:
-					write_vfont(wd, (VFont *)id);
-					break;
-				case ID_KE:
-					write_key(wd, (Key *)id);
-					break;
-				case ID_WO:
-					write_world(wd, (World *)id);
-					break;
-				case ID_TXT:
-					write_text(wd, (Text *)id);
-					break;
-				case ID_SPK:
-					write_speaker(wd, (Speaker *)id);
-					break;
-				case ID_LP:
-					write_probe(wd, (LightProbe *)id);
-					break;
-				case ID_SO:
-					write_sound(wd, (bSound *)id);
-					break;
-				case ID_GR:
-					write_group(wd, (Group *)id);
-					break;
-				case ID_AR:
-					write_armature(wd, (bArmature *)id);
-					break;
-				case ID_AC:
-					write_action(wd, (bAction *)id);
-					break;
-				case ID_OB:
-					write_object(wd, (Object *)id);
-					break;
-				case ID_MA:
-					write_material(wd, (Material *)id);
-					break;
-				case ID_TE:
-					write_texture(wd, (Tex *)id);
-					break;
-				case ID_ME:
-					write_mesh(wd, (Mesh *)id);
-					break;
-				case ID_PA:
-					write_particlesettings(wd, (ParticleSettings *)id);
-					break;
-				case ID_NT:
-					write_nodetree(wd, (bNodeTree *)id);
-					break;
-				case ID_BR:
-					write_brush(wd, (Brush *)id);
-					break;
-				case ID_PAL:
-					write_palette(wd, (Palette *)id);
-					break;
-				case ID_PC:
-					write_paintcurve(wd, (PaintCurve *)id);
-					break;
-				case ID_GD:
-					write_gpencil(wd, (bGPdata *)id);
-					break;
-				case ID_LS:
-					write_linestyle(wd, (FreestyleLineStyle *)id);
-					break;
-				case ID_CF:
-					write_cachefile(wd, (CacheFile *)id);
-					break;
-				case ID_LI:
-					/* Do nothing, handled below - and should never be reached. */
-					BLI_assert(0);
-					break;
-				case ID_IP:
-					/* Do nothing, deprecated. */
-					break;
-				default:
-					/* Should never be reached. */
-					BLI_assert(0);
-					break;
+			if (id && GS(id->name) == ID_LI) {
+				continue;  /* Libraries are handled separately below. */
 			}
-		}
 
-		mywrite_flush(wd);
+			for (; id; id = id->next) {
+				if (current) {
+					if (mywrite_id_reuse(wd, id)) {
+						continue;
+					}
+					mywrite_id_begin(wd, id);
+				}
+
+				write_id(wd, id);
+
+				if (current) {
+					mywrite_id_end(wd);
+				}
+			}
+
+			mywrite_flush(wd);
+		}
 	}
 
 	/* Special handling, operating over split Mains... */
@@ -4145,37 +4452,30 @@ static bool do_history(const char *name, ReportList *reports)
 	return 0;
 }
 
+static eWriteWrapType write_file_wrap_type(const int write_flags)
+{
+	if (write_flags & G_FILE_COMPRESS_FRAMES) {
+		return WW_WRAP_FRAMES;
+	}
+	else if (write_flags & G_FILE_COMPRESS) {
+		return WW_WRAP_ZLIB;
+	}
+	else {
+		return WW_WRAP_NONE;
+	}
+}
+
 /**
- * \return Success.
+ * Remap relative paths for writing \a mainvar to \a filepath.
+ *
+ * \return Paths to restore after writing (see #write_file_paths_restore), can be NULL.
  */
-bool BLO_write_file(
-        Main *mainvar, const char *filepath, int write_flags,
-        ReportList *reports, const BlendThumbnail *thumb)
+static void *write_file_paths_remap(Main *mainvar, const char *filepath, int *r_write_flags)
 {
-	char tempname[FILE_MAX + 1];
-	eWriteWrapType ww_type;
-	WriteWrap ww;
-
 	/* path backup/restore */
 	void     *path_list_backup = NULL;
 	const int path_list_flag = (BKE_BPATH_TRAVERSE_SKIP_LIBRARY | BKE_BPATH_TRAVERSE_SKIP_MULTIFILE);
-
-	/* open temporary file, so we preserve the original in case we crash */
-	BLI_snprintf(tempname, sizeof(tempname), "%s@", filepath);
-
-	if (write_flags & G_FILE_COMPRESS) {
-		ww_type = WW_WRAP_ZLIB;
-	}
-	else {
-		ww_type = WW_WRAP_NONE;
-	}
-
-	ww_handle_init(ww_type, &ww);
-
-	if (ww.open(&ww, tempname) == false) {
-		BKE_reportf(reports, RPT_ERROR, "Cannot open file %s for writing: %s", tempname, strerror(errno));
-		return 0;
-	}
+	int write_flags = *r_write_flags;
 
 	/* check if we need to backup and restore paths */
 	if (UNLIKELY((write_flags & G_FILE_RELATIVE_REMAP) && (G_FILE_SAVE_COPY & write_flags))) {
@@ -4212,23 +4512,38 @@ bool BLO_write_file(
 		BKE_bpath_relative_convert(mainvar, filepath, NULL);
 	}
 
-	/* actual file writing */
-	const bool err = write_file_handle(mainvar, &ww, NULL, NULL, write_flags, thumb);
+	*r_write_flags = write_flags;
+	return path_list_backup;
+}
 
-	ww.close(&ww);
+static void write_file_paths_restore(Main *mainvar, void *path_list_backup)
+{
+	const int path_list_flag = (BKE_BPATH_TRAVERSE_SKIP_LIBRARY | BKE_BPATH_TRAVERSE_SKIP_MULTIFILE);
 
 	if (UNLIKELY(path_list_backup)) {
 		BKE_bpath_list_restore(mainvar, path_list_flag, path_list_backup);
 		BKE_bpath_list_free(path_list_backup);
 	}
+}
 
-	if (err) {
-		BKE_report(reports, RPT_ERROR, strerror(errno));
-		remove(tempname);
-
-		return 0;
+/**
+ * Read deferred packed data before writing to disk, the written file may replace the one it's read from.
+ * Refuse to write when some data can't be read, instead of saving the file without it.
+ */
+static bool write_file_packed_data_ensure(Main *mainvar, const char *filepath, ReportList *reports)
+{
+	if (!BKE_packedfile_ensure_data_all(mainvar, reports)) {
+		BKE_reportf(reports, RPT_ERROR, "Cannot save '%s', some packed data could not be read", filepath);
+		return false;
 	}
+	return true;
+}
 
+/**
+ * Replace \a filepath with the written temporary file, doing the file history first.
+ */
+static bool write_file_finish(const char *tempname, const char *filepath, const int write_flags, ReportList *reports)
+{
 	/* file save to temporary file was successful */
 	/* now do reverse file history (move .blend1 -> .blend2, .blend -> .blend1) */
 	if (write_flags & G_FILE_HISTORY) {
@@ -4247,6 +4562,136 @@ bool BLO_write_file(
 	return 1;
 }
 
+/**
+ * \return Success.
+ */
+bool BLO_write_file(
+        Main *mainvar, const char *filepath, int write_flags,
+        ReportList *reports, const BlendThumbnail *thumb)
+{
+	char tempname[FILE_MAX + 1];
+	WriteWrap ww;
+	void *path_list_backup;
+
+	if (!write_file_packed_data_ensure(mainvar, filepath, reports)) {
+		return 0;
+	}
+
+	/* open temporary file, so we preserve the original in case we crash */
+	BLI_snprintf(tempname, sizeof(tempname), "%s@", filepath);
+
+	ww_handle_init(write_file_wrap_type(write_flags), &ww);
+
+	if (ww.open(&ww, tempname) == false) {
+		BKE_reportf(reports, RPT_ERROR, "Cannot open file %s for writing: %s", tempname, strerror(errno));
+		return 0;
+	}
+
+	path_list_backup = write_file_paths_remap(mainvar, filepath, &write_flags);
+
+	/* actual file writing */
+	BLI_TRACE_BEGIN("writefile", "write_file");
+	const bool err = write_file_handle(mainvar, &ww, NULL, NULL, write_flags, thumb);
+
+	ww.close(&ww);
+	BLI_TRACE_END();
+
+	write_file_paths_restore(mainvar, path_list_backup);
+
+	if (err) {
+		BKE_report(reports, RPT_ERROR, strerror(errno));
+		remove(tempname);
+
+		return 0;
+	}
+
+	return write_file_finish(tempname, filepath, write_flags, reports);
+}
+
+/**
+ * Write \a mainvar as it would be written to \a filepath, but into memory.
+ * The snapshot is written to disk with #BLO_write_file_from_snapshot,
+ * which doesn't access \a mainvar so it can run in another thread.
+ *
+ * \return Success.
+ */
+bool BLO_write_file_snapshot(
+        Main *mainvar, const char *filepath, int write_flags,
+        const BlendThumbnail *thumb, ReportList *reports, MemFile *r_snapshot)
+{
+	WriteWrap ww;
+	void *path_list_backup;
+
+	if (!write_file_packed_data_ensure(mainvar, filepath, reports)) {
+		return 0;
+	}
+
+	ww_handle_init(WW_WRAP_MEMFILE, &ww);
+	ww._user_data.memfile_handle = r_snapshot;
+
+	path_list_backup = write_file_paths_remap(mainvar, filepath, &write_flags);
+
+	BLI_TRACE_BEGIN("writefile", "write_file_snapshot");
+	const bool err = write_file_handle(mainvar, &ww, NULL, NULL, write_flags, thumb);
+	BLI_TRACE_END();
+
+	write_file_paths_restore(mainvar, path_list_backup);
+
+	if (err) {
+		BLO_memfile_free(r_snapshot);
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * Write a snapshot (see #BLO_write_file_snapshot) or an undo memfile to disk,
+ * \a write_flags only controls compression and file history here.
+ *
+ * \return Success.
+ */
+bool BLO_write_file_from_snapshot(
+        MemFile *snapshot, const char *filepath, const int write_flags,
+        ReportList *reports)
+{
+	char tempname[FILE_MAX + 1];
+	MemFileChunk *chunk;
+	WriteWrap ww;
+	bool err = false;
+
+	/* open temporary file, so we preserve the original in case we crash */
+	BLI_snprintf(tempname, sizeof(tempname), "%s@", filepath);
+
+	ww_handle_init(write_file_wrap_type(write_flags), &ww);
+
+	if (ww.open(&ww, tempname) == false) {
+		BKE_reportf(reports, RPT_ERROR, "Cannot open file %s for writing: %s", tempname, strerror(errno));
+		return 0;
+	}
+
+	BLI_TRACE_BEGIN("writefile", "write_file_from_snapshot");
+	for (chunk = snapshot->chunks.first; chunk; chunk = chunk->next) {
+		if (ww.write(&ww, chunk->buf, chunk->size) != chunk->size) {
+			err = true;
+			break;
+		}
+	}
+
+	if (ww.close(&ww) == false) {
+		err = true;
+	}
+	BLI_TRACE_END();
+
+	if (err) {
+		BKE_report(reports, RPT_ERROR, strerror(errno));
+		remove(tempname);
+
+		return 0;
+	}
+
+	return write_file_finish(tempname, filepath, write_flags, reports);
+}
+
 /**
  * \return Success.
  */
@@ -4254,7 +4699,9 @@ bool BLO_write_file_mem(Main *mainvar, MemFile *compare, MemFile *current, int w
 {
 	write_flags &= ~G_FILE_USERPREFS;
 
+	BLI_TRACE_BEGIN("writefile", "write_file_mem");
 	const bool err = write_file_handle(mainvar, NULL, compare, current, write_flags, NULL);
+	BLI_TRACE_END();
 
 	return (err == 0);
 }
@@ -240,6 +240,7 @@ extern "C" {
 #include "intern/bmesh_log.h"
 #include "intern/bmesh_marking.h"
 #include "intern/bmesh_mesh.h"
+#include "intern/bmesh_mesh_arrays.h"
 #include "intern/bmesh_mesh_conv.h"
 #include "intern/bmesh_mesh_validate.h"
 #include "intern/bmesh_mods.h"
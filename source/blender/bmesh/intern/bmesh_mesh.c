@@ -31,10 +31,12 @@
 #include "DNA_listBase.h"
 #include "DNA_object_types.h"
 
+#include "BLI_array.h"
 #include "BLI_linklist_stack.h"
 #include "BLI_listbase.h"
 #include "BLI_math.h"
 #include "BLI_stack.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #include "BKE_cdderivedmesh.h"
@@ -319,95 +321,181 @@ void BM_mesh_free(BMesh *bm)
 }
 
 /**
- * Helpers for #BM_mesh_normals_update and #BM_verts_calc_normal_vcos
+ * Helpers for #BM_mesh_normals_update, #BM_mesh_normals_update_verts and #BM_verts_calc_normal_vcos
  */
+
+typedef struct BMNormalsUpdateData {
+	BMesh *bm;
+	/* Edge directions, when NULL they are computed from the vertex coordinates. */
+	float (*edgevec)[3];
+	const float (*fnos)[3];
+	const float (*vcos)[3];
+	float (*vnos)[3];
+	/* Elements to update, only used by partial updates (full updates use the mesh tables). */
+	BMVert **verts;
+	BMFace **faces;
+} BMNormalsUpdateData;
+
+static void bm_mesh_edges_calc_vectors_cb(void *userdata, const int index)
+{
+	BMNormalsUpdateData *data = userdata;
+	BMEdge *e = data->bm->etable[index];
+
+	BM_elem_index_set(e, index); /* set_inline */
+
+	if (e->l) {
+		const float *v1_co = data->vcos ? data->vcos[BM_elem_index_get(e->v1)] : e->v1->co;
+		const float *v2_co = data->vcos ? data->vcos[BM_elem_index_get(e->v2)] : e->v2->co;
+		sub_v3_v3v3(data->edgevec[index], v2_co, v1_co);
+		normalize_v3(data->edgevec[index]);
+	}
+	else {
+		/* the edge vector will not be needed when the edge has no radial */
+	}
+}
+
 static void bm_mesh_edges_calc_vectors(BMesh *bm, float (*edgevec)[3], const float (*vcos)[3])
 {
-	BMIter eiter;
-	BMEdge *e;
-	int index;
+	BMNormalsUpdateData data = {.bm = bm, .edgevec = edgevec, .vcos = vcos};
 
 	if (vcos) {
 		BM_mesh_elem_index_ensure(bm, BM_VERT);
 	}
+	BM_mesh_elem_table_ensure(bm, BM_EDGE);
 
-	BM_ITER_MESH_INDEX (e, &eiter, bm, BM_EDGES_OF_MESH, index) {
-		BM_elem_index_set(e, index); /* set_inline */
-
-		if (e->l) {
-			const float *v1_co = vcos ? vcos[BM_elem_index_get(e->v1)] : e->v1->co;
-			const float *v2_co = vcos ? vcos[BM_elem_index_get(e->v2)] : e->v2->co;
-			sub_v3_v3v3(edgevec[index], v2_co, v1_co);
-			normalize_v3(edgevec[index]);
-		}
-		else {
-			/* the edge vector will not be needed when the edge has no radial */
-		}
-	}
+	BLI_task_parallel_range(0, bm->totedge, &data, bm_mesh_edges_calc_vectors_cb, (bm->totedge >= BM_OMP_LIMIT));
 	bm->elem_index_dirty &= ~BM_EDGE;
 }
 
-static void bm_mesh_verts_calc_normals(
-        BMesh *bm, const float (*edgevec)[3], const float (*fnos)[3],
-        const float (*vcos)[3], float (*vnos)[3])
+/**
+ * Calculate the normal of \a v from the angle weighted normals of the faces using it.
+ *
+ * Only reads the faces around \a v, so different vertices can be handled from different threads.
+ */
+static void bm_vert_calc_normal_impl(
+        BMVert *v, const float (*edgevec)[3], const float (*fnos)[3], const float (*vcos)[3],
+        float r_no[3])
 {
-	BM_mesh_elem_index_ensure(bm, (vnos) ? (BM_EDGE | BM_VERT) : BM_EDGE);
+	zero_v3(r_no);
 
-	/* add weighted face normals to vertices */
-	{
-		BMIter fiter;
-		BMFace *f;
-		int i;
+	if (v->e) {
+		BMEdge *e_first, *e_iter;
 
-		BM_ITER_MESH_INDEX (f, &fiter, bm, BM_FACES_OF_MESH, i) {
+		e_iter = e_first = v->e;
+		do {
 			BMLoop *l_first, *l_iter;
-			const float *f_no = fnos ? fnos[i] : f->no;
 
-			l_iter = l_first = BM_FACE_FIRST_LOOP(f);
+			if ((l_iter = l_first = e_iter->l) == NULL) {
+				continue;
+			}
 			do {
-				const float *e1diff, *e2diff;
-				float dotprod;
+				const float *f_no;
 				float fac;
-				float *v_no = vnos ? vnos[BM_elem_index_get(l_iter->v)] : l_iter->v->no;
-
-				/* calculate the dot product of the two edges that
-				 * meet at the loop's vertex */
-				e1diff = edgevec[BM_elem_index_get(l_iter->prev->e)];
-				e2diff = edgevec[BM_elem_index_get(l_iter->e)];
-				dotprod = dot_v3v3(e1diff, e2diff);
-
-				/* edge vectors are calculated from e->v1 to e->v2, so
-				 * adjust the dot product if one but not both loops
-				 * actually runs from from e->v2 to e->v1 */
-				if ((l_iter->prev->e->v1 == l_iter->prev->v) ^ (l_iter->e->v1 == l_iter->v)) {
-					dotprod = -dotprod;
+
+				/* each loop of the vertex uses one of its edges, only take it once */
+				if (l_iter->v != v) {
+					continue;
 				}
 
-				fac = saacos(-dotprod);
+				f_no = fnos ? fnos[BM_elem_index_get(l_iter->f)] : l_iter->f->no;
+
+				if (edgevec) {
+					/* calculate the dot product of the two edges that
+					 * meet at the loop's vertex */
+					const float *e1diff = edgevec[BM_elem_index_get(l_iter->prev->e)];
+					const float *e2diff = edgevec[BM_elem_index_get(l_iter->e)];
+					float dotprod = dot_v3v3(e1diff, e2diff);
+
+					/* edge vectors are calculated from e->v1 to e->v2, so
+					 * adjust the dot product if one but not both loops
+					 * actually runs from from e->v2 to e->v1 */
+					if ((l_iter->prev->e->v1 == l_iter->prev->v) ^ (l_iter->e->v1 == l_iter->v)) {
+						dotprod = -dotprod;
+					}
+
+					fac = saacos(-dotprod);
+				}
+				else {
+					/* no pre-computed edge vectors, use the directions from the vertex */
+					const float *co = vcos ? vcos[BM_elem_index_get(v)] : v->co;
+					const float *co_prev = vcos ? vcos[BM_elem_index_get(l_iter->prev->v)] : l_iter->prev->v->co;
+					const float *co_next = vcos ? vcos[BM_elem_index_get(l_iter->next->v)] : l_iter->next->v->co;
+					float vec_prev[3], vec_next[3];
+
+					sub_v3_v3v3(vec_prev, co_prev, co);
+					normalize_v3(vec_prev);
+					sub_v3_v3v3(vec_next, co_next, co);
+					normalize_v3(vec_next);
+
+					fac = saacos(dot_v3v3(vec_prev, vec_next));
+				}
 
 				/* accumulate weighted face normal into the vertex's normal */
-				madd_v3_v3fl(v_no, f_no, fac);
-			} while ((l_iter = l_iter->next) != l_first);
-		}
+				madd_v3_v3fl(r_no, f_no, fac);
+			} while ((l_iter = l_iter->radial_next) != l_first);
+		} while ((e_iter = BM_DISK_EDGE_NEXT(e_iter, v)) != e_first);
+	}
+
+	/* normalize the accumulated vertex normal */
+	if (UNLIKELY(normalize_v3(r_no) == 0.0f)) {
+		const float *v_co = vcos ? vcos[BM_elem_index_get(v)] : v->co;
+		normalize_v3_v3(r_no, v_co);
 	}
+}
 
+static void bm_mesh_verts_calc_normals_cb(void *userdata, const int index)
+{
+	BMNormalsUpdateData *data = userdata;
+	BMVert *v = data->bm->vtable[index];
+	float *v_no;
+
+	if (data->vnos) {
+		v_no = data->vnos[index];
+	}
+	else {
+		BM_elem_index_set(v, index); /* set_inline */
+		v_no = v->no;
+	}
+
+	bm_vert_calc_normal_impl(v, (const float(*)[3])data->edgevec, data->fnos, data->vcos, v_no);
+}
+
+static void bm_mesh_verts_calc_normals(
+        BMesh *bm, const float (*edgevec)[3], const float (*fnos)[3],
+        const float (*vcos)[3], float (*vnos)[3])
+{
+	BMNormalsUpdateData data = {
+	    .bm = bm, .edgevec = (float (*)[3])edgevec, .fnos = fnos, .vcos = vcos, .vnos = vnos,
+	};
 
-	/* normalize the accumulated vertex normals */
 	{
-		BMIter viter;
-		BMVert *v;
-		int i;
-
-		BM_ITER_MESH_INDEX (v, &viter, bm, BM_VERTS_OF_MESH, i) {
-			float *v_no = vnos ? vnos[i] : v->no;
-			if (UNLIKELY(normalize_v3(v_no) == 0.0f)) {
-				const float *v_co = vcos ? vcos[i] : v->co;
-				normalize_v3_v3(v_no, v_co);
-			}
+		char htype = BM_EDGE;
+		if (vnos || vcos) {
+			htype |= BM_VERT;
+		}
+		if (fnos) {
+			htype |= BM_FACE;
 		}
+		BM_mesh_elem_index_ensure(bm, htype);
+	}
+	BM_mesh_elem_table_ensure(bm, BM_VERT);
+
+	/* Each vertex gathers the normals of its own faces, no two tasks write to the same normal. */
+	BLI_task_parallel_range(0, bm->totvert, &data, bm_mesh_verts_calc_normals_cb, (bm->totvert >= BM_OMP_LIMIT));
+	if (vnos == NULL) {
+		bm->elem_index_dirty &= ~BM_VERT;
 	}
 }
 
+static void bm_mesh_faces_calc_normals_cb(void *userdata, const int index)
+{
+	BMNormalsUpdateData *data = userdata;
+	BMFace *f = data->bm->ftable[index];
+
+	BM_elem_index_set(f, index); /* set_inline */
+	BM_face_normal_update(f);
+}
+
 /**
  * \brief BMesh Compute Normals
  *
@@ -417,49 +505,107 @@ void BM_mesh_normals_update(BMesh *bm)
 {
 	float (*edgevec)[3] = MEM_mallocN(sizeof(*edgevec) * bm->totedge, __func__);
 
-#pragma omp parallel sections if (bm->totvert + bm->totedge + bm->totface >= BM_OMP_LIMIT)
+	/* calculate all face normals */
 	{
-#pragma omp section
-		{
-			/* calculate all face normals */
-			BMIter fiter;
-			BMFace *f;
-			int i;
-
-			BM_ITER_MESH_INDEX (f, &fiter, bm, BM_FACES_OF_MESH, i) {
-				BM_elem_index_set(f, i); /* set_inline */
-				BM_face_normal_update(f);
-			}
-			bm->elem_index_dirty &= ~BM_FACE;
-		}
-#pragma omp section
-		{
-			/* Zero out vertex normals */
-			BMIter viter;
-			BMVert *v;
-			int i;
-
-			BM_ITER_MESH_INDEX (v, &viter, bm, BM_VERTS_OF_MESH, i) {
-				BM_elem_index_set(v, i); /* set_inline */
-				zero_v3(v->no);
-			}
-			bm->elem_index_dirty &= ~BM_VERT;
-		}
-#pragma omp section
-		{
-			/* Compute normalized direction vectors for each edge.
-			 * Directions will be used for calculating the weights of the face normals on the vertex normals.
-			 */
-			bm_mesh_edges_calc_vectors(bm, edgevec, NULL);
-		}
+		BMNormalsUpdateData data = {.bm = bm};
+
+		BM_mesh_elem_table_ensure(bm, BM_FACE);
+		BLI_task_parallel_range(0, bm->totface, &data, bm_mesh_faces_calc_normals_cb, (bm->totface >= BM_OMP_LIMIT));
+		bm->elem_index_dirty &= ~BM_FACE;
 	}
-	/* end omp */
+
+	/* Compute normalized direction vectors for each edge.
+	 * Directions will be used for calculating the weights of the face normals on the vertex normals.
+	 */
+	bm_mesh_edges_calc_vectors(bm, edgevec, NULL);
 
 	/* Add weighted face normals to vertices, and normalize vert normals. */
 	bm_mesh_verts_calc_normals(bm, (const float(*)[3])edgevec, NULL, NULL, NULL);
 	MEM_freeN(edgevec);
 }
 
+static void bm_mesh_partial_faces_calc_normals_cb(void *userdata, const int index)
+{
+	BMNormalsUpdateData *data = userdata;
+	BM_face_normal_update(data->faces[index]);
+}
+
+static void bm_mesh_partial_verts_calc_normals_cb(void *userdata, const int index)
+{
+	BMNormalsUpdateData *data = userdata;
+	BMVert *v = data->verts[index];
+	bm_vert_calc_normal_impl(v, NULL, NULL, NULL, v->no);
+}
+
+/**
+ * \brief BMesh Compute Normals of Moved Vertices
+ *
+ * Updates the normals of the faces using \a verts, and the normals of all vertices of these faces,
+ * leaving the rest of the mesh untouched. Gives the same result as #BM_mesh_normals_update
+ * when only \a verts have been moved since the last normal update, for a fraction of the cost
+ * when they are a small part of the mesh (as when transforming a selection).
+ */
+void BM_mesh_normals_update_verts(BMesh *bm, BMVert **verts, const int verts_len)
+{
+	BMNormalsUpdateData data = {.bm = bm};
+	BMFace **faces = NULL;
+	BMVert **verts_update = NULL;
+	BLI_array_declare(faces);
+	BLI_array_declare(verts_update);
+	int i;
+
+	/* Gather the faces using the moved vertices, and all the vertices of those faces,
+	 * any other vertex only uses faces which did not change.
+	 * Elements are tagged with an API flag rather than by index, so only the elements
+	 * around \a verts are visited and the scratch arrays are sized by the selection. */
+	for (i = 0; i < verts_len; i++) {
+		BMVert *v = verts[i];
+		BMIter iter;
+		BMFace *f;
+
+		if (!BM_ELEM_API_FLAG_TEST(v, _FLAG_WALK)) {
+			BM_ELEM_API_FLAG_ENABLE(v, _FLAG_WALK);
+			BLI_array_append(verts_update, v);
+		}
+
+		BM_ITER_ELEM (f, &iter, v, BM_FACES_OF_VERT) {
+			BMLoop *l_first, *l_iter;
+
+			if (BM_ELEM_API_FLAG_TEST(f, _FLAG_WALK)) {
+				continue;
+			}
+			BM_ELEM_API_FLAG_ENABLE(f, _FLAG_WALK);
+			BLI_array_append(faces, f);
+
+			l_iter = l_first = BM_FACE_FIRST_LOOP(f);
+			do {
+				if (!BM_ELEM_API_FLAG_TEST(l_iter->v, _FLAG_WALK)) {
+					BM_ELEM_API_FLAG_ENABLE(l_iter->v, _FLAG_WALK);
+					BLI_array_append(verts_update, l_iter->v);
+				}
+			} while ((l_iter = l_iter->next) != l_first);
+		}
+	}
+
+	data.faces = faces;
+	data.verts = verts_update;
+	BLI_task_parallel_range(0, BLI_array_count(faces), &data, bm_mesh_partial_faces_calc_normals_cb,
+	                        (BLI_array_count(faces) >= BM_OMP_LIMIT));
+	BLI_task_parallel_range(0, BLI_array_count(verts_update), &data, bm_mesh_partial_verts_calc_normals_cb,
+	                        (BLI_array_count(verts_update) >= BM_OMP_LIMIT));
+
+	/* Keep the API flags clean. */
+	for (i = 0; i < BLI_array_count(faces); i++) {
+		BM_ELEM_API_FLAG_DISABLE(faces[i], _FLAG_WALK);
+	}
+	for (i = 0; i < BLI_array_count(verts_update); i++) {
+		BM_ELEM_API_FLAG_DISABLE(verts_update[i], _FLAG_WALK);
+	}
+
+	BLI_array_free(faces);
+	BLI_array_free(verts_update);
+}
+
 /**
  * \brief BMesh Compute Normals from/to external data.
  *
@@ -482,18 +628,73 @@ void BM_verts_calc_normal_vcos(BMesh *bm, const float (*fnos)[3], const float (*
 /**
  * Helpers for #BM_mesh_loop_normals_update and #BM_loops_calc_normals_vnos
  */
+
+typedef struct BMEdgesSharpTagData {
+	BMesh *bm;
+	const float (*vnos)[3];
+	const float (*fnos)[3];
+	float (*r_lnos)[3];
+	float split_angle;
+	bool check_angle;
+} BMEdgesSharpTagData;
+
+static void bm_mesh_edges_sharp_tag_cb(void *userdata, const int index)
+{
+	BMEdgesSharpTagData *data = userdata;
+	const float (*vnos)[3] = data->vnos;
+	const float (*fnos)[3] = data->fnos;
+	BMEdge *e = data->bm->etable[index];
+	BMLoop *l_a, *l_b;
+
+	BM_elem_index_set(e, index); /* set_inline */
+	BM_elem_flag_disable(e, BM_ELEM_TAG); /* Clear tag (means edge is sharp). */
+
+	/* An edge with only two loops, might be smooth... */
+	if (BM_edge_loop_pair(e, &l_a, &l_b)) {
+		bool is_angle_smooth = true;
+		if (data->check_angle) {
+			const float *no_a = fnos ? fnos[BM_elem_index_get(l_a->f)] : l_a->f->no;
+			const float *no_b = fnos ? fnos[BM_elem_index_get(l_b->f)] : l_b->f->no;
+			is_angle_smooth = (dot_v3v3(no_a, no_b) >= data->split_angle);
+		}
+
+		/* We only tag edges that are *really* smooth:
+		 * If the angle between both its polys' normals is below split_angle value,
+		 * and it is tagged as such,
+		 * and both its faces are smooth,
+		 * and both its faces have compatible (non-flipped) normals,
+		 * i.e. both loops on the same edge do not share the same vertex.
+		 */
+		if (is_angle_smooth &&
+		    BM_elem_flag_test(e, BM_ELEM_SMOOTH) &&
+		    BM_elem_flag_test(l_a->f, BM_ELEM_SMOOTH) &&
+		    BM_elem_flag_test(l_b->f, BM_ELEM_SMOOTH) &&
+		    l_a->v != l_b->v)
+		{
+			const float *no;
+			BM_elem_flag_enable(e, BM_ELEM_TAG);
+
+			/* linked vertices might be fully smooth, copy their normals to loop ones.
+			 * Each loop belongs to a single edge, so no other task writes these. */
+			no = vnos ? vnos[BM_elem_index_get(l_a->v)] : l_a->v->no;
+			copy_v3_v3(data->r_lnos[BM_elem_index_get(l_a)], no);
+			no = vnos ? vnos[BM_elem_index_get(l_b->v)] : l_b->v->no;
+			copy_v3_v3(data->r_lnos[BM_elem_index_get(l_b)], no);
+		}
+	}
+}
+
 static void bm_mesh_edges_sharp_tag(
         BMesh *bm, const float (*vnos)[3], const float (*fnos)[3], float split_angle,
         float (*r_lnos)[3])
 {
-	BMIter eiter;
-	BMEdge *e;
-	int i;
+	BMEdgesSharpTagData data = {
+	    .bm = bm, .vnos = vnos, .fnos = fnos, .r_lnos = r_lnos,
+	    .split_angle = split_angle, .check_angle = (split_angle < (float)M_PI),
+	};
 
-	const bool check_angle = (split_angle < (float)M_PI);
-
-	if (check_angle) {
-		split_angle = cosf(split_angle);
+	if (data.check_angle) {
+		data.split_angle = cosf(split_angle);
 	}
 
 	{
@@ -503,53 +704,17 @@ static void bm_mesh_edges_sharp_tag(
 		}
 		BM_mesh_elem_index_ensure(bm, htype);
 	}
+	BM_mesh_elem_table_ensure(bm, BM_EDGE);
 
 	/* This first loop checks which edges are actually smooth, and pre-populate lnos with vnos (as if they were
 	 * all smooth).
 	 */
-	BM_ITER_MESH_INDEX (e, &eiter, bm, BM_EDGES_OF_MESH, i) {
-		BMLoop *l_a, *l_b;
-
-		BM_elem_index_set(e, i); /* set_inline */
-		BM_elem_flag_disable(e, BM_ELEM_TAG); /* Clear tag (means edge is sharp). */
-
-		/* An edge with only two loops, might be smooth... */
-		if (BM_edge_loop_pair(e, &l_a, &l_b)) {
-			bool is_angle_smooth = true;
-			if (check_angle) {
-				const float *no_a = fnos ? fnos[BM_elem_index_get(l_a->f)] : l_a->f->no;
-				const float *no_b = fnos ? fnos[BM_elem_index_get(l_b->f)] : l_b->f->no;
-				is_angle_smooth = (dot_v3v3(no_a, no_b) >= split_angle);
-			}
-
-			/* We only tag edges that are *really* smooth:
-			 * If the angle between both its polys' normals is below split_angle value,
-			 * and it is tagged as such,
-			 * and both its faces are smooth,
-			 * and both its faces have compatible (non-flipped) normals,
-			 * i.e. both loops on the same edge do not share the same vertex.
-			 */
-			if (is_angle_smooth &&
-			    BM_elem_flag_test(e, BM_ELEM_SMOOTH) &&
-			    BM_elem_flag_test(l_a->f, BM_ELEM_SMOOTH) &&
-			    BM_elem_flag_test(l_b->f, BM_ELEM_SMOOTH) &&
-			    l_a->v != l_b->v)
-			{
-				const float *no;
-				BM_elem_flag_enable(e, BM_ELEM_TAG);
-
-				/* linked vertices might be fully smooth, copy their normals to loop ones. */
-				no = vnos ? vnos[BM_elem_index_get(l_a->v)] : l_a->v->no;
-				copy_v3_v3(r_lnos[BM_elem_index_get(l_a)], no);
-				no = vnos ? vnos[BM_elem_index_get(l_b->v)] : l_b->v->no;
-				copy_v3_v3(r_lnos[BM_elem_index_get(l_b)], no);
-			}
-		}
-	}
+	BLI_task_parallel_range(0, bm->totedge, &data, bm_mesh_edges_sharp_tag_cb, (bm->totedge >= BM_OMP_LIMIT));
 
 	bm->elem_index_dirty &= ~BM_EDGE;
 }
 
+
 /* Check whether gievn loop is part of an unknown-so-far cyclic smooth fan, or not.
  * Needed because cyclic smooth fans have no obvious 'entry point', and yet we need to walk them once, and only once. */
 static bool bm_mesh_loop_check_cyclic_smooth_fan(BMLoop *l_curr)
@@ -585,57 +750,317 @@ static bool bm_mesh_loop_check_cyclic_smooth_fan(BMLoop *l_curr)
 	}
 }
 
-/* BMesh version of BKE_mesh_normals_loop_split() in mesh_evaluate.c
- * Will use first clnors_data array, and fallback to cd_loop_clnors_offset (use NULL and -1 to not use clnors). */
-static void bm_mesh_loops_calc_normals(
-        BMesh *bm, const float (*vcos)[3], const float (*fnos)[3], float (*r_lnos)[3],
-        MLoopNorSpaceArray *r_lnors_spacearr, short (*clnors_data)[2], const int cd_loop_clnors_offset)
+#define BM_LOOP_SPLIT_TASK_BLOCK_SIZE 1024
+
+typedef struct BMLoopSplitTaskData {
+	/* We have to create those outside of tasks, since the memarena is not threadsafe. */
+	MLoopNorSpace *lnor_space;
+	/* A NULL loop tags the end of a block of tasks. */
+	BMLoop *l_curr;
+	/* Switch between single (both edges sharp) and fan process. */
+	bool is_fan;
+} BMLoopSplitTaskData;
+
+typedef struct BMLoopSplitTaskDataCommon {
+	/* Read/write.
+	 * Note we do not need to protect it, though, since two different tasks will *always* affect different
+	 * elements in the arrays. */
+	MLoopNorSpaceArray *lnors_spacearr;
+	float (*lnos)[3];
+	short (*clnors_data)[2];
+
+	/* Read-only. */
+	const float (*vcos)[3];
+	const float (*fnos)[3];
+	int cd_loop_clnors_offset;
+	bool has_clnors;
+} BMLoopSplitTaskDataCommon;
+
+/* Simple case (both edges around that vertex are sharp in related polygon),
+ * this vertex just takes its poly normal.
+ */
+static void bm_mesh_loops_split_single_do(BMLoopSplitTaskDataCommon *common_data, BMLoopSplitTaskData *data)
 {
-	BMIter fiter;
-	BMFace *f_curr;
-	const bool has_clnors = clnors_data || (cd_loop_clnors_offset != -1);
+	MLoopNorSpaceArray *r_lnors_spacearr = common_data->lnors_spacearr;
+	const float (*vcos)[3] = common_data->vcos;
+	const float (*fnos)[3] = common_data->fnos;
+	BMLoop *l_curr = data->l_curr;
+	const BMFace *f_curr = l_curr->f;
+
+	const int l_curr_index = BM_elem_index_get(l_curr);
+	const float *no = fnos ? fnos[BM_elem_index_get(f_curr)] : f_curr->no;
+	float *lnor = common_data->lnos[l_curr_index];
+	copy_v3_v3(lnor, no);
+
+	/* If needed, generate this (simple!) lnor space. */
+	if (r_lnors_spacearr) {
+		float vec_curr[3], vec_prev[3];
+		MLoopNorSpace *lnor_space = data->lnor_space;
 
-	MLoopNorSpaceArray _lnors_spacearr = {NULL};
+		{
+			const BMVert *v_pivot = l_curr->v;
+			const float *co_pivot = vcos ? vcos[BM_elem_index_get(v_pivot)] : v_pivot->co;
+			const BMVert *v_1 = BM_edge_other_vert(l_curr->e, v_pivot);
+			const float *co_1 = vcos ? vcos[BM_elem_index_get(v_1)] : v_1->co;
+			const BMVert *v_2 = BM_edge_other_vert(l_curr->prev->e, v_pivot);
+			const float *co_2 = vcos ? vcos[BM_elem_index_get(v_2)] : v_2->co;
+
+			sub_v3_v3v3(vec_curr, co_1, co_pivot);
+			normalize_v3(vec_curr);
+			sub_v3_v3v3(vec_prev, co_2, co_pivot);
+			normalize_v3(vec_prev);
+		}
+
+		BKE_lnor_space_define(lnor_space, lnor, vec_curr, vec_prev, NULL);
+		/* We know there is only one loop in this space, no need to create a linklist in this case... */
+		BKE_lnor_space_add_loop(r_lnors_spacearr, lnor_space, l_curr_index, false);
+
+		if (common_data->has_clnors) {
+			short (*clnor)[2] = common_data->clnors_data ? &common_data->clnors_data[l_curr_index] :
+			                    BM_ELEM_CD_GET_VOID_P(l_curr, common_data->cd_loop_clnors_offset);
+			BKE_lnor_space_custom_data_to_normal(lnor_space, *clnor, lnor);
+		}
+	}
+}
+
+/* We have to fan around current vertex, until we find the other non-smooth edge,
+ * and accumulate face normals into the vertex!
+ * Note in case this vertex has only one sharp edge, this is a waste because the normal is the same as
+ * the vertex normal, but I do not see any easy way to detect that (would need to count number
+ * of sharp edges per vertex, I doubt the additional memory usage would be worth it, especially as
+ * it should not be a common case in real-life meshes anyway).
+ */
+static void bm_mesh_loops_split_fan_do(
+        BMLoopSplitTaskDataCommon *common_data, BMLoopSplitTaskData *data, BLI_Stack *edge_vectors)
+{
+	MLoopNorSpaceArray *r_lnors_spacearr = common_data->lnors_spacearr;
+	float (*r_lnos)[3] = common_data->lnos;
+	short (*clnors_data)[2] = common_data->clnors_data;
+	const float (*vcos)[3] = common_data->vcos;
+	const float (*fnos)[3] = common_data->fnos;
+	const int cd_loop_clnors_offset = common_data->cd_loop_clnors_offset;
+	const bool has_clnors = common_data->has_clnors;
+
+	BMLoop *l_curr = data->l_curr;
+	BMVert *v_pivot = l_curr->v;
+	BMEdge *e_next;
+	const BMEdge *e_org = l_curr->e;
+	BMLoop *lfan_pivot, *lfan_pivot_next;
+	int lfan_pivot_index;
+	float lnor[3] = {0.0f, 0.0f, 0.0f};
+	float vec_curr[3], vec_next[3], vec_org[3];
+
+	/* We validate clnors data on the fly - cheapest way to do! */
+	int clnors_avg[2] = {0, 0};
+	short (*clnor_ref)[2] = NULL;
+	int clnors_nbr = 0;
+	bool clnors_invalid = false;
+
+	const float *co_pivot = vcos ? vcos[BM_elem_index_get(v_pivot)] : v_pivot->co;
+
+	MLoopNorSpace *lnor_space = data->lnor_space;
 
 	/* Temp normal stack. */
 	BLI_SMALLSTACK_DECLARE(normal, float *);
 	/* Temp clnors stack. */
 	BLI_SMALLSTACK_DECLARE(clnors, short *);
-	/* Temp edge vectors stack, only used when computing lnor spacearr. */
-	BLI_Stack *edge_vectors = NULL;
 
+	BLI_assert((edge_vectors == NULL) || BLI_stack_is_empty(edge_vectors));
+
+	lfan_pivot = l_curr;
+	lfan_pivot_index = BM_elem_index_get(lfan_pivot);
+	e_next = lfan_pivot->e;  /* Current edge here, actually! */
+
+	/* Only need to compute previous edge's vector once, then we can just reuse old current one! */
 	{
-		char htype = 0;
-		if (vcos) {
-			htype |= BM_VERT;
+		const BMVert *v_2 = BM_edge_other_vert(e_next, v_pivot);
+		const float *co_2 = vcos ? vcos[BM_elem_index_get(v_2)] : v_2->co;
+
+		sub_v3_v3v3(vec_org, co_2, co_pivot);
+		normalize_v3(vec_org);
+		copy_v3_v3(vec_curr, vec_org);
+
+		if (r_lnors_spacearr) {
+			BLI_stack_push(edge_vectors, vec_org);
 		}
-		/* Face/Loop indices are set inline below. */
-		BM_mesh_elem_index_ensure(bm, htype);
 	}
 
-	if (!r_lnors_spacearr && has_clnors) {
-		/* We need to compute lnor spacearr if some custom lnor data are given to us! */
-		r_lnors_spacearr = &_lnors_spacearr;
+	while (true) {
+		/* Much simpler than in sibling code with basic Mesh data! */
+		lfan_pivot_next = BM_vert_step_fan_loop(lfan_pivot, &e_next);
+		if (lfan_pivot_next) {
+			BLI_assert(lfan_pivot_next->v == v_pivot);
+		}
+		else {
+			/* next edge is non-manifold, we have to find it ourselves! */
+			e_next = (lfan_pivot->e == e_next) ? lfan_pivot->prev->e : lfan_pivot->e;
+		}
+
+		/* Compute edge vector.
+		 * NOTE: We could pre-compute those into an array, in the first iteration, instead of computing them
+		 *       twice (or more) here. However, time gained is not worth memory and time lost,
+		 *       given the fact that this code should not be called that much in real-life meshes...
+		 */
+		{
+			const BMVert *v_2 = BM_edge_other_vert(e_next, v_pivot);
+			const float *co_2 = vcos ? vcos[BM_elem_index_get(v_2)] : v_2->co;
+
+			sub_v3_v3v3(vec_next, co_2, co_pivot);
+			normalize_v3(vec_next);
+		}
+
+		{
+			/* Code similar to accumulate_vertex_normals_poly. */
+			/* Calculate angle between the two poly edges incident on this vertex. */
+			const BMFace *f = lfan_pivot->f;
+			const float fac = saacos(dot_v3v3(vec_next, vec_curr));
+			const float *no = fnos ? fnos[BM_elem_index_get(f)] : f->no;
+			/* Accumulate */
+			madd_v3_v3fl(lnor, no, fac);
+
+			if (has_clnors) {
+				/* Accumulate all clnors, if they are not all equal we have to fix that! */
+				short (*clnor)[2] = clnors_data ? &clnors_data[lfan_pivot_index] :
+				                                  BM_ELEM_CD_GET_VOID_P(lfan_pivot, cd_loop_clnors_offset);
+				if (clnors_nbr) {
+					clnors_invalid |= ((*clnor_ref)[0] != (*clnor)[0] || (*clnor_ref)[1] != (*clnor)[1]);
+				}
+				else {
+					clnor_ref = clnor;
+				}
+				clnors_avg[0] += (*clnor)[0];
+				clnors_avg[1] += (*clnor)[1];
+				clnors_nbr++;
+				/* We store here a pointer to all custom lnors processed. */
+				BLI_SMALLSTACK_PUSH(clnors, (short *)*clnor);
+			}
+		}
+
+		/* We store here a pointer to all loop-normals processed. */
+		BLI_SMALLSTACK_PUSH(normal, (float *)r_lnos[lfan_pivot_index]);
+
+		if (r_lnors_spacearr) {
+			/* Assign current lnor space to current 'vertex' loop. */
+			BKE_lnor_space_add_loop(r_lnors_spacearr, lnor_space, lfan_pivot_index, true);
+			if (e_next != e_org) {
+				/* We store here all edges-normalized vectors processed. */
+				BLI_stack_push(edge_vectors, vec_next);
+			}
+		}
+
+		if (!BM_elem_flag_test(e_next, BM_ELEM_TAG) || (e_next == e_org)) {
+			/* Next edge is sharp, we have finished with this fan of faces around this vert! */
+			break;
+		}
+
+		/* Copy next edge vector to current one. */
+		copy_v3_v3(vec_curr, vec_next);
+		/* Next pivot loop to current one. */
+		lfan_pivot = lfan_pivot_next;
+		lfan_pivot_index = BM_elem_index_get(lfan_pivot);
 	}
-	if (r_lnors_spacearr) {
-		BKE_lnor_spacearr_init(r_lnors_spacearr, bm->totloop);
-		edge_vectors = BLI_stack_new(sizeof(float[3]), __func__);
+
+	{
+		float lnor_len = normalize_v3(lnor);
+
+		/* If we are generating lnor spacearr, we can now define the one for this fan. */
+		if (r_lnors_spacearr) {
+			if (UNLIKELY(lnor_len == 0.0f)) {
+				/* Use vertex normal as fallback! */
+				copy_v3_v3(lnor, r_lnos[lfan_pivot_index]);
+				lnor_len = 1.0f;
+			}
+
+			BKE_lnor_space_define(lnor_space, lnor, vec_org, vec_next, edge_vectors);
+
+			if (has_clnors) {
+				if (clnors_invalid) {
+					short *clnor;
+
+					clnors_avg[0] /= clnors_nbr;
+					clnors_avg[1] /= clnors_nbr;
+					/* Fix/update all clnors of this fan with computed average value. */
+					printf("Invalid clnors in this fan!\n");
+					while ((clnor = BLI_SMALLSTACK_POP(clnors))) {
+						//print_v2("org clnor", clnor);
+						clnor[0] = (short)clnors_avg[0];
+						clnor[1] = (short)clnors_avg[1];
+					}
+					//print_v2("new clnors", clnors_avg);
+				}
+				/* Extra bonus: since smallstack is local to this func, no more need to empty it at all cost! */
+
+				BKE_lnor_space_custom_data_to_normal(lnor_space, *clnor_ref, lnor);
+			}
+		}
+
+		/* In case we get a zero normal here, just use vertex normal already set! */
+		if (LIKELY(lnor_len != 0.0f)) {
+			/* Copy back the final computed normal into all related loop-normals. */
+			float *nor;
+
+			while ((nor = BLI_SMALLSTACK_POP(normal))) {
+				copy_v3_v3(nor, lnor);
+			}
+		}
+		/* Extra bonus: since smallstack is local to this func, no more need to empty it at all cost! */
 	}
+}
 
-	/* Clear all loops' tags (means none are to be skipped for now). */
-	int index_face, index_loop = 0;
-	BM_ITER_MESH_INDEX (f_curr, &fiter, bm, BM_FACES_OF_MESH, index_face) {
-		BMLoop *l_curr, *l_first;
+static void bm_mesh_loops_split_worker_do(
+        BMLoopSplitTaskDataCommon *common_data, BMLoopSplitTaskData *data, BLI_Stack *edge_vectors)
+{
+	BLI_assert(data->l_curr);
+	if (data->is_fan) {
+		bm_mesh_loops_split_fan_do(common_data, data, edge_vectors);
+	}
+	else {
+		/* No need for edge_vectors for 'single' case! */
+		bm_mesh_loops_split_single_do(common_data, data);
+	}
+}
 
-		BM_elem_index_set(f_curr, index_face); /* set_inline */
+static void bm_mesh_loops_split_worker(TaskPool * __restrict pool, void *taskdata, int UNUSED(threadid))
+{
+	BMLoopSplitTaskDataCommon *common_data = BLI_task_pool_userdata(pool);
+	BMLoopSplitTaskData *data = taskdata;
 
-		l_curr = l_first = BM_FACE_FIRST_LOOP(f_curr);
-		do {
-			BM_elem_index_set(l_curr, index_loop++); /* set_inline */
-			BM_elem_flag_disable(l_curr, BM_ELEM_TAG);
-		} while ((l_curr = l_curr->next) != l_first);
+	/* Temp edge vectors stack, only used when computing lnor spacearr. */
+	BLI_Stack *edge_vectors = common_data->lnors_spacearr ? BLI_stack_new(sizeof(float[3]), __func__) : NULL;
+
+	for (int i = 0; i < BM_LOOP_SPLIT_TASK_BLOCK_SIZE; i++, data++) {
+		/* A NULL l_curr is used to tag ended data! */
+		if (data->l_curr == NULL) {
+			break;
+		}
+
+		bm_mesh_loops_split_worker_do(common_data, data, edge_vectors);
+	}
+
+	if (edge_vectors) {
+		BLI_stack_free(edge_vectors);
+	}
+}
+
+/* Walk all loops to find the single loops and the smooth fans to compute, in a deterministic order,
+ * and compute them directly (when pool is NULL) or push them in blocks to worker tasks. */
+static void bm_mesh_loops_split_generator(BMesh *bm, TaskPool *pool, BMLoopSplitTaskDataCommon *common_data)
+{
+	MLoopNorSpaceArray *r_lnors_spacearr = common_data->lnors_spacearr;
+	BMIter fiter;
+	BMFace *f_curr;
+
+	BMLoopSplitTaskData *data_buff = NULL;
+	int data_idx = 0;
+
+	/* Temp edge vectors stack, only used when computing lnor spacearr (and we are not multi-threading). */
+	BLI_Stack *edge_vectors = NULL;
+
+	if (!pool) {
+		if (r_lnors_spacearr) {
+			edge_vectors = BLI_stack_new(sizeof(float[3]), __func__);
+		}
 	}
-	bm->elem_index_dirty &= ~(BM_FACE | BM_LOOP);
 
 	/* We now know edges that can be smoothed (they are tagged), and edges that will be hard (they aren't).
 	 * Now, time to generate the normals.
@@ -645,6 +1070,8 @@ static void bm_mesh_loops_calc_normals(
 
 		l_curr = l_first = BM_FACE_FIRST_LOOP(f_curr);
 		do {
+			BMLoopSplitTaskData *data, data_local;
+
 			/* A smooth edge, we have to check for cyclic smooth fan case.
 			 * If we find a new, never-processed cyclic smooth fan, we can do it now using that loop/edge as
 			 * 'entry point', otherwise we can skip it. */
@@ -655,47 +1082,25 @@ static void bm_mesh_loops_calc_normals(
 			if (BM_elem_flag_test(l_curr->e, BM_ELEM_TAG) &&
 			    (BM_elem_flag_test(l_curr, BM_ELEM_TAG) || !bm_mesh_loop_check_cyclic_smooth_fan(l_curr)))
 			{
+				continue;
 			}
-			else if (!BM_elem_flag_test(l_curr->e, BM_ELEM_TAG) &&
-			         !BM_elem_flag_test(l_curr->prev->e, BM_ELEM_TAG))
-			{
-				/* Simple case (both edges around that vertex are sharp in related polygon),
-				 * this vertex just takes its poly normal.
-				 */
-				const int l_curr_index = BM_elem_index_get(l_curr);
-				const float *no = fnos ? fnos[BM_elem_index_get(f_curr)] : f_curr->no;
-				copy_v3_v3(r_lnos[l_curr_index], no);
-
-				/* If needed, generate this (simple!) lnor space. */
-				if (r_lnors_spacearr) {
-					float vec_curr[3], vec_prev[3];
-					MLoopNorSpace *lnor_space = BKE_lnor_space_create(r_lnors_spacearr);
-
-					{
-						const BMVert *v_pivot = l_curr->v;
-						const float *co_pivot = vcos ? vcos[BM_elem_index_get(v_pivot)] : v_pivot->co;
-						const BMVert *v_1 = BM_edge_other_vert(l_curr->e, v_pivot);
-						const float *co_1 = vcos ? vcos[BM_elem_index_get(v_1)] : v_1->co;
-						const BMVert *v_2 = BM_edge_other_vert(l_curr->prev->e, v_pivot);
-						const float *co_2 = vcos ? vcos[BM_elem_index_get(v_2)] : v_2->co;
-
-						sub_v3_v3v3(vec_curr, co_1, co_pivot);
-						normalize_v3(vec_curr);
-						sub_v3_v3v3(vec_prev, co_2, co_pivot);
-						normalize_v3(vec_prev);
-					}
 
-					BKE_lnor_space_define(lnor_space, r_lnos[l_curr_index], vec_curr, vec_prev, NULL);
-					/* We know there is only one loop in this space, no need to create a linklist in this case... */
-					BKE_lnor_space_add_loop(r_lnors_spacearr, lnor_space, l_curr_index, false);
-
-					if (has_clnors) {
-						short (*clnor)[2] = clnors_data ? &clnors_data[l_curr_index] :
-						                                  BM_ELEM_CD_GET_VOID_P(l_curr, cd_loop_clnors_offset);
-						BKE_lnor_space_custom_data_to_normal(lnor_space, *clnor, r_lnos[l_curr_index]);
-					}
+			if (pool) {
+				if (data_idx == 0) {
+					data_buff = MEM_callocN(sizeof(*data_buff) * BM_LOOP_SPLIT_TASK_BLOCK_SIZE, __func__);
 				}
+				data = &data_buff[data_idx];
+			}
+			else {
+				data = &data_local;
+				memset(data, 0, sizeof(*data));
+			}
+
+			data->l_curr = l_curr;
+			if (r_lnors_spacearr) {
+				data->lnor_space = BKE_lnor_space_create(r_lnors_spacearr);
 			}
+
 			/* We *do not need* to check/tag loops as already computed!
 			 * Due to the fact a loop only links to one of its two edges, a same fan *will never be walked more than
 			 * once!*
@@ -704,223 +1109,162 @@ static void bm_mesh_loops_calc_normals(
 			 * alternative (smooth curr_edge, sharp prev_edge).
 			 * All this due/thanks to link between normals and loop ordering.
 			 */
-			else {
-				/* We have to fan around current vertex, until we find the other non-smooth edge,
-				 * and accumulate face normals into the vertex!
-				 * Note in case this vertex has only one sharp edge, this is a waste because the normal is the same as
-				 * the vertex normal, but I do not see any easy way to detect that (would need to count number
-				 * of sharp edges per vertex, I doubt the additional memory usage would be worth it, especially as
-				 * it should not be a common case in real-life meshes anyway).
-				 */
-				BMVert *v_pivot = l_curr->v;
-				BMEdge *e_next;
-				const BMEdge *e_org = l_curr->e;
-				BMLoop *lfan_pivot, *lfan_pivot_next;
-				int lfan_pivot_index;
-				float lnor[3] = {0.0f, 0.0f, 0.0f};
-				float vec_curr[3], vec_next[3], vec_org[3];
-
-				/* We validate clnors data on the fly - cheapest way to do! */
-				int clnors_avg[2] = {0, 0};
-				short (*clnor_ref)[2] = NULL;
-				int clnors_nbr = 0;
-				bool clnors_invalid = false;
-
-				const float *co_pivot = vcos ? vcos[BM_elem_index_get(v_pivot)] : v_pivot->co;
-
-				MLoopNorSpace *lnor_space = r_lnors_spacearr ? BKE_lnor_space_create(r_lnors_spacearr) : NULL;
-
-				BLI_assert((edge_vectors == NULL) || BLI_stack_is_empty(edge_vectors));
-
-				lfan_pivot = l_curr;
-				lfan_pivot_index = BM_elem_index_get(lfan_pivot);
-				e_next = lfan_pivot->e;  /* Current edge here, actually! */
-
-				/* Only need to compute previous edge's vector once, then we can just reuse old current one! */
-				{
-					const BMVert *v_2 = BM_edge_other_vert(e_next, v_pivot);
-					const float *co_2 = vcos ? vcos[BM_elem_index_get(v_2)] : v_2->co;
-
-					sub_v3_v3v3(vec_org, co_2, co_pivot);
-					normalize_v3(vec_org);
-					copy_v3_v3(vec_curr, vec_org);
-
-					if (r_lnors_spacearr) {
-						BLI_stack_push(edge_vectors, vec_org);
-					}
+			if (BM_elem_flag_test(l_curr->e, BM_ELEM_TAG) ||
+			    BM_elem_flag_test(l_curr->prev->e, BM_ELEM_TAG))
+			{
+				data->is_fan = true;
+
+				/* Tag related vertex as sharp, to avoid fanning around it again (in case it was a smooth one).
+				 * Done here rather than in the worker, several fans may share the same vertex. */
+				if (r_lnors_spacearr) {
+					BM_elem_flag_enable(l_curr->v, BM_ELEM_TAG);
 				}
+			}
 
-				while (true) {
-					/* Much simpler than in sibling code with basic Mesh data! */
-					lfan_pivot_next = BM_vert_step_fan_loop(lfan_pivot, &e_next);
-					if (lfan_pivot_next) {
-						BLI_assert(lfan_pivot_next->v == v_pivot);
-					}
-					else {
-						/* next edge is non-manifold, we have to find it ourselves! */
-						e_next = (lfan_pivot->e == e_next) ? lfan_pivot->prev->e : lfan_pivot->e;
-					}
+			if (pool) {
+				data_idx++;
+				if (data_idx == BM_LOOP_SPLIT_TASK_BLOCK_SIZE) {
+					BLI_task_pool_push(pool, bm_mesh_loops_split_worker, data_buff, true, TASK_PRIORITY_LOW);
+					data_idx = 0;
+				}
+			}
+			else {
+				bm_mesh_loops_split_worker_do(common_data, data, edge_vectors);
+			}
+		} while ((l_curr = l_curr->next) != l_first);
+	}
 
-					/* Compute edge vector.
-					 * NOTE: We could pre-compute those into an array, in the first iteration, instead of computing them
-					 *       twice (or more) here. However, time gained is not worth memory and time lost,
-					 *       given the fact that this code should not be called that much in real-life meshes...
-					 */
-					{
-						const BMVert *v_2 = BM_edge_other_vert(e_next, v_pivot);
-						const float *co_2 = vcos ? vcos[BM_elem_index_get(v_2)] : v_2->co;
-
-						sub_v3_v3v3(vec_next, co_2, co_pivot);
-						normalize_v3(vec_next);
-					}
+	/* Last block of data... Since it is calloc'ed and we use first NULL item as stopper, everything is fine. */
+	if (pool && data_idx) {
+		BLI_task_pool_push(pool, bm_mesh_loops_split_worker, data_buff, true, TASK_PRIORITY_LOW);
+	}
 
-					{
-						/* Code similar to accumulate_vertex_normals_poly. */
-						/* Calculate angle between the two poly edges incident on this vertex. */
-						const BMFace *f = lfan_pivot->f;
-						const float fac = saacos(dot_v3v3(vec_next, vec_curr));
-						const float *no = fnos ? fnos[BM_elem_index_get(f)] : f->no;
-						/* Accumulate */
-						madd_v3_v3fl(lnor, no, fac);
-
-						if (has_clnors) {
-							/* Accumulate all clnors, if they are not all equal we have to fix that! */
-							short (*clnor)[2] = clnors_data ? &clnors_data[lfan_pivot_index] :
-							                                  BM_ELEM_CD_GET_VOID_P(lfan_pivot, cd_loop_clnors_offset);
-							if (clnors_nbr) {
-								clnors_invalid |= ((*clnor_ref)[0] != (*clnor)[0] || (*clnor_ref)[1] != (*clnor)[1]);
-							}
-							else {
-								clnor_ref = clnor;
-							}
-							clnors_avg[0] += (*clnor)[0];
-							clnors_avg[1] += (*clnor)[1];
-							clnors_nbr++;
-							/* We store here a pointer to all custom lnors processed. */
-							BLI_SMALLSTACK_PUSH(clnors, (short *)*clnor);
-						}
-					}
+	if (edge_vectors) {
+		BLI_stack_free(edge_vectors);
+	}
+}
+
+/* BMesh version of BKE_mesh_normals_loop_split() in mesh_evaluate.c
+ * Will use first clnors_data array, and fallback to cd_loop_clnors_offset (use NULL and -1 to not use clnors). */
+static void bm_mesh_loops_calc_normals(
+        BMesh *bm, const float (*vcos)[3], const float (*fnos)[3], float (*r_lnos)[3],
+        MLoopNorSpaceArray *r_lnors_spacearr, short (*clnors_data)[2], const int cd_loop_clnors_offset)
+{
+	BMIter fiter;
+	BMFace *f_curr;
+	const bool has_clnors = clnors_data || (cd_loop_clnors_offset != -1);
 
-					/* We store here a pointer to all loop-normals processed. */
-					BLI_SMALLSTACK_PUSH(normal, (float *)r_lnos[lfan_pivot_index]);
+	MLoopNorSpaceArray _lnors_spacearr = {NULL};
 
-					if (r_lnors_spacearr) {
-						/* Assign current lnor space to current 'vertex' loop. */
-						BKE_lnor_space_add_loop(r_lnors_spacearr, lnor_space, lfan_pivot_index, true);
-						if (e_next != e_org) {
-							/* We store here all edges-normalized vectors processed. */
-							BLI_stack_push(edge_vectors, vec_next);
-						}
-					}
+	{
+		char htype = 0;
+		if (vcos) {
+			htype |= BM_VERT;
+		}
+		/* Face/Loop indices are set inline below. */
+		BM_mesh_elem_index_ensure(bm, htype);
+	}
 
-					if (!BM_elem_flag_test(e_next, BM_ELEM_TAG) || (e_next == e_org)) {
-						/* Next edge is sharp, we have finished with this fan of faces around this vert! */
-						break;
-					}
+	if (!r_lnors_spacearr && has_clnors) {
+		/* We need to compute lnor spacearr if some custom lnor data are given to us! */
+		r_lnors_spacearr = &_lnors_spacearr;
+	}
+	if (r_lnors_spacearr) {
+		BKE_lnor_spacearr_init(r_lnors_spacearr, bm->totloop);
+	}
 
-					/* Copy next edge vector to current one. */
-					copy_v3_v3(vec_curr, vec_next);
-					/* Next pivot loop to current one. */
-					lfan_pivot = lfan_pivot_next;
-					lfan_pivot_index = BM_elem_index_get(lfan_pivot);
-				}
+	/* Clear all loops' tags (means none are to be skipped for now). */
+	int index_face, index_loop = 0;
+	BM_ITER_MESH_INDEX (f_curr, &fiter, bm, BM_FACES_OF_MESH, index_face) {
+		BMLoop *l_curr, *l_first;
 
-				{
-					float lnor_len = normalize_v3(lnor);
+		BM_elem_index_set(f_curr, index_face); /* set_inline */
 
-					/* If we are generating lnor spacearr, we can now define the one for this fan. */
-					if (r_lnors_spacearr) {
-						if (UNLIKELY(lnor_len == 0.0f)) {
-							/* Use vertex normal as fallback! */
-							copy_v3_v3(lnor, r_lnos[lfan_pivot_index]);
-							lnor_len = 1.0f;
-						}
+		l_curr = l_first = BM_FACE_FIRST_LOOP(f_curr);
+		do {
+			BM_elem_index_set(l_curr, index_loop++); /* set_inline */
+			BM_elem_flag_disable(l_curr, BM_ELEM_TAG);
+		} while ((l_curr = l_curr->next) != l_first);
+	}
+	bm->elem_index_dirty &= ~(BM_FACE | BM_LOOP);
 
-						BKE_lnor_space_define(lnor_space, lnor, vec_org, vec_next, edge_vectors);
-
-						if (has_clnors) {
-							if (clnors_invalid) {
-								short *clnor;
-
-								clnors_avg[0] /= clnors_nbr;
-								clnors_avg[1] /= clnors_nbr;
-								/* Fix/update all clnors of this fan with computed average value. */
-								printf("Invalid clnors in this fan!\n");
-								while ((clnor = BLI_SMALLSTACK_POP(clnors))) {
-									//print_v2("org clnor", clnor);
-									clnor[0] = (short)clnors_avg[0];
-									clnor[1] = (short)clnors_avg[1];
-								}
-								//print_v2("new clnors", clnors_avg);
-							}
-							else {
-								/* We still have to consume the stack! */
-								while (BLI_SMALLSTACK_POP(clnors));
-							}
-							BKE_lnor_space_custom_data_to_normal(lnor_space, *clnor_ref, lnor);
-						}
-					}
+	/* Init data common to all tasks. */
+	BMLoopSplitTaskDataCommon common_data = {
+	    .lnors_spacearr = r_lnors_spacearr,
+	    .lnos = r_lnos,
+	    .clnors_data = clnors_data,
+	    .vcos = vcos,
+	    .fnos = fnos,
+	    .cd_loop_clnors_offset = cd_loop_clnors_offset,
+	    .has_clnors = has_clnors,
+	};
+
+	if (bm->totloop < BM_LOOP_SPLIT_TASK_BLOCK_SIZE * 8) {
+		/* Not enough loops to be worth the whole threading overhead... */
+		bm_mesh_loops_split_generator(bm, NULL, &common_data);
+	}
+	else {
+		TaskScheduler *task_scheduler;
+		TaskPool *task_pool;
 
-					/* In case we get a zero normal here, just use vertex normal already set! */
-					if (LIKELY(lnor_len != 0.0f)) {
-						/* Copy back the final computed normal into all related loop-normals. */
-						float *nor;
+		task_scheduler = BLI_task_scheduler_get();
+		task_pool = BLI_task_pool_create(task_scheduler, &common_data);
 
-						while ((nor = BLI_SMALLSTACK_POP(normal))) {
-							copy_v3_v3(nor, lnor);
-						}
-					}
-					else {
-						/* We still have to consume the stack! */
-						while (BLI_SMALLSTACK_POP(normal));
-					}
-				}
+		bm_mesh_loops_split_generator(bm, task_pool, &common_data);
 
-				/* Tag related vertex as sharp, to avoid fanning around it again (in case it was a smooth one). */
-				if (r_lnors_spacearr) {
-					BM_elem_flag_enable(l_curr->v, BM_ELEM_TAG);
-				}
-			}
-		} while ((l_curr = l_curr->next) != l_first);
+		BLI_task_pool_work_and_wait(task_pool);
+
+		BLI_task_pool_free(task_pool);
 	}
 
 	if (r_lnors_spacearr) {
-		BLI_stack_free(edge_vectors);
 		if (r_lnors_spacearr == &_lnors_spacearr) {
 			BKE_lnor_spacearr_free(r_lnors_spacearr);
 		}
 	}
 }
 
+typedef struct BMLoopsCalcNormalsNoAutosmoothData {
+	BMesh *bm;
+	const float (*vnos)[3];
+	const float (*fnos)[3];
+	float (*r_lnos)[3];
+} BMLoopsCalcNormalsNoAutosmoothData;
+
+static void bm_mesh_loops_calc_normals_no_autosmooth_cb(void *userdata, const int index)
+{
+	BMLoopsCalcNormalsNoAutosmoothData *data = userdata;
+	const float (*vnos)[3] = data->vnos;
+	const float (*fnos)[3] = data->fnos;
+	BMFace *f_curr = data->bm->ftable[index];
+	BMLoop *l_curr, *l_first;
+	const bool is_face_flat = !BM_elem_flag_test(f_curr, BM_ELEM_SMOOTH);
+
+	l_curr = l_first = BM_FACE_FIRST_LOOP(f_curr);
+	do {
+		const float *no = is_face_flat ? (fnos ? fnos[index] : f_curr->no) :
+		                                 (vnos ? vnos[BM_elem_index_get(l_curr->v)] : l_curr->v->no);
+		copy_v3_v3(data->r_lnos[BM_elem_index_get(l_curr)], no);
+
+	} while ((l_curr = l_curr->next) != l_first);
+}
+
 static void bm_mesh_loops_calc_normals_no_autosmooth(
         BMesh *bm, const float (*vnos)[3], const float (*fnos)[3], float (*r_lnos)[3])
 {
-	BMIter fiter;
-	BMFace *f_curr;
+	BMLoopsCalcNormalsNoAutosmoothData data = {.bm = bm, .vnos = vnos, .fnos = fnos, .r_lnos = r_lnos};
 
 	{
 		char htype = BM_LOOP;
 		if (vnos) {
 			htype |= BM_VERT;
 		}
-		if (fnos) {
-			htype |= BM_FACE;
-		}
 		BM_mesh_elem_index_ensure(bm, htype);
 	}
+	BM_mesh_elem_table_ensure(bm, BM_FACE);
 
-	BM_ITER_MESH (f_curr, &fiter, bm, BM_FACES_OF_MESH) {
-		BMLoop *l_curr, *l_first;
-		const bool is_face_flat = !BM_elem_flag_test(f_curr, BM_ELEM_SMOOTH);
-
-		l_curr = l_first = BM_FACE_FIRST_LOOP(f_curr);
-		do {
-			const float *no = is_face_flat ? (fnos ? fnos[BM_elem_index_get(f_curr)] : f_curr->no) :
-			                                 (vnos ? vnos[BM_elem_index_get(l_curr->v)] : l_curr->v->no);
-			copy_v3_v3(r_lnos[BM_elem_index_get(l_curr)], no);
-
-		} while ((l_curr = l_curr->next) != l_first);
-	}
+	BLI_task_parallel_range(
+	        0, bm->totface, &data, bm_mesh_loops_calc_normals_no_autosmooth_cb, (bm->totface >= BM_OMP_LIMIT));
 }
 
 #if 0  /* Unused currently */
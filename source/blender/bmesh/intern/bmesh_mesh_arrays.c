@@ -0,0 +1,422 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2017 Blender Foundation.
+ * All rights reserved.
+ *
+ * Contributor(s): None Yet
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/bmesh/intern/bmesh_mesh_arrays.c
+ *  \ingroup bmesh
+ *
+ * Struct-of-arrays copy of a BMesh, see #BMeshArrays.
+ */
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_math.h"
+#include "BLI_task.h"
+#include "BLI_utildefines.h"
+
+#include "bmesh.h"
+
+/* -------------------------------------------------------------------- */
+/** \name Create/Free
+ * \{ */
+
+typedef struct BMeshArraysData {
+	BMesh *bm;
+	BMeshArrays *arrays;
+	/* Used by smoothing, coordinates to write to. */
+	float (*vert_co_dst)[3];
+	float fac;
+} BMeshArraysData;
+
+static void bm_mesh_arrays_verts_cb(void *userdata, const int i)
+{
+	BMeshArraysData *data = userdata;
+	BMeshArrays *arrays = data->arrays;
+	BMVert *v = data->bm->vtable[i];
+	int edges_len = 0, loops_len = 0;
+
+	copy_v3_v3(arrays->vert_co[i], v->co);
+	copy_v3_v3(arrays->vert_no[i], v->no);
+
+	/* Count adjacent elements, turned into offsets once all vertices are done. */
+	if (v->e) {
+		BMEdge *e_first, *e_iter;
+
+		e_iter = e_first = v->e;
+		do {
+			BMLoop *l_first, *l_iter;
+
+			edges_len++;
+			if ((l_iter = l_first = e_iter->l) == NULL) {
+				continue;
+			}
+			do {
+				if (l_iter->v == v) {
+					loops_len++;
+				}
+			} while ((l_iter = l_iter->radial_next) != l_first);
+		} while ((e_iter = BM_DISK_EDGE_NEXT(e_iter, v)) != e_first);
+	}
+
+	arrays->vert_edge_offset[i + 1] = edges_len;
+	arrays->vert_loop_offset[i + 1] = loops_len;
+}
+
+static void bm_mesh_arrays_verts_adjacency_cb(void *userdata, const int i)
+{
+	BMeshArraysData *data = userdata;
+	BMeshArrays *arrays = data->arrays;
+	BMVert *v = data->bm->vtable[i];
+	int *vert_edges = &arrays->vert_edges[arrays->vert_edge_offset[i]];
+	int *vert_loops = &arrays->vert_loops[arrays->vert_loop_offset[i]];
+
+	if (v->e) {
+		BMEdge *e_first, *e_iter;
+
+		e_iter = e_first = v->e;
+		do {
+			BMLoop *l_first, *l_iter;
+
+			*vert_edges++ = BM_elem_index_get(e_iter);
+			if ((l_iter = l_first = e_iter->l) == NULL) {
+				continue;
+			}
+			do {
+				if (l_iter->v == v) {
+					*vert_loops++ = BM_elem_index_get(l_iter);
+				}
+			} while ((l_iter = l_iter->radial_next) != l_first);
+		} while ((e_iter = BM_DISK_EDGE_NEXT(e_iter, v)) != e_first);
+	}
+
+	BLI_assert(vert_edges == &arrays->vert_edges[arrays->vert_edge_offset[i + 1]]);
+	BLI_assert(vert_loops == &arrays->vert_loops[arrays->vert_loop_offset[i + 1]]);
+}
+
+static void bm_mesh_arrays_edges_cb(void *userdata, const int i)
+{
+	BMeshArraysData *data = userdata;
+	BMEdge *e = data->bm->etable[i];
+
+	data->arrays->edge_verts[i][0] = BM_elem_index_get(e->v1);
+	data->arrays->edge_verts[i][1] = BM_elem_index_get(e->v2);
+}
+
+static void bm_mesh_arrays_faces_cb(void *userdata, const int i)
+{
+	BMeshArraysData *data = userdata;
+	BMeshArrays *arrays = data->arrays;
+	BMFace *f = data->bm->ftable[i];
+	BMLoop *l_first, *l_iter;
+
+	l_iter = l_first = BM_FACE_FIRST_LOOP(f);
+
+	/* loops are indexed in face order */
+	arrays->face_loopstart[i] = BM_elem_index_get(l_first);
+	arrays->face_len[i] = f->len;
+	copy_v3_v3(arrays->face_no[i], f->no);
+
+	do {
+		const int l_index = BM_elem_index_get(l_iter);
+		arrays->loop_vert[l_index] = BM_elem_index_get(l_iter->v);
+		arrays->loop_edge[l_index] = BM_elem_index_get(l_iter->e);
+		arrays->loop_face[l_index] = i;
+	} while ((l_iter = l_iter->next) != l_first);
+}
+
+/* Turn per element counts stored at [i + 1] into offsets. */
+static void bm_mesh_arrays_accumulate_offsets(int *offsets, const int len)
+{
+	int i;
+
+	offsets[0] = 0;
+	for (i = 0; i < len; i++) {
+		offsets[i + 1] += offsets[i];
+	}
+}
+
+/**
+ * Fill \a r_arrays from \a bm, ensuring its element indices and tables.
+ */
+void BM_mesh_arrays_create(BMesh *bm, BMeshArrays *r_arrays)
+{
+	BMeshArraysData data = {.bm = bm, .arrays = r_arrays};
+
+	BM_mesh_elem_index_ensure(bm, BM_VERT | BM_EDGE | BM_LOOP | BM_FACE);
+	BM_mesh_elem_table_ensure(bm, BM_VERT | BM_EDGE | BM_FACE);
+
+	r_arrays->totvert = bm->totvert;
+	r_arrays->totedge = bm->totedge;
+	r_arrays->totloop = bm->totloop;
+	r_arrays->totface = bm->totface;
+
+	r_arrays->vert_co = MEM_mallocN(sizeof(*r_arrays->vert_co) * (size_t)bm->totvert, __func__);
+	r_arrays->vert_no = MEM_mallocN(sizeof(*r_arrays->vert_no) * (size_t)bm->totvert, __func__);
+	r_arrays->vert_edge_offset = MEM_mallocN(sizeof(int) * (size_t)(bm->totvert + 1), __func__);
+	r_arrays->vert_loop_offset = MEM_mallocN(sizeof(int) * (size_t)(bm->totvert + 1), __func__);
+
+	r_arrays->edge_verts = MEM_mallocN(sizeof(*r_arrays->edge_verts) * (size_t)bm->totedge, __func__);
+
+	r_arrays->loop_vert = MEM_mallocN(sizeof(int) * (size_t)bm->totloop, __func__);
+	r_arrays->loop_edge = MEM_mallocN(sizeof(int) * (size_t)bm->totloop, __func__);
+	r_arrays->loop_face = MEM_mallocN(sizeof(int) * (size_t)bm->totloop, __func__);
+
+	r_arrays->face_loopstart = MEM_mallocN(sizeof(int) * (size_t)bm->totface, __func__);
+	r_arrays->face_len = MEM_mallocN(sizeof(int) * (size_t)bm->totface, __func__);
+	r_arrays->face_no = MEM_mallocN(sizeof(*r_arrays->face_no) * (size_t)bm->totface, __func__);
+
+	BLI_task_parallel_range(0, bm->totvert, &data, bm_mesh_arrays_verts_cb, (bm->totvert >= BM_OMP_LIMIT));
+	BLI_task_parallel_range(0, bm->totedge, &data, bm_mesh_arrays_edges_cb, (bm->totedge >= BM_OMP_LIMIT));
+	BLI_task_parallel_range(0, bm->totface, &data, bm_mesh_arrays_faces_cb, (bm->totface >= BM_OMP_LIMIT));
+
+	/* Vertex to edge and loop maps, each edge is used twice and each loop once. */
+	bm_mesh_arrays_accumulate_offsets(r_arrays->vert_edge_offset, bm->totvert);
+	bm_mesh_arrays_accumulate_offsets(r_arrays->vert_loop_offset, bm->totvert);
+	BLI_assert(r_arrays->vert_edge_offset[bm->totvert] == bm->totedge * 2);
+	BLI_assert(r_arrays->vert_loop_offset[bm->totvert] == bm->totloop);
+
+	r_arrays->vert_edges = MEM_mallocN(sizeof(int) * (size_t)bm->totedge * 2, __func__);
+	r_arrays->vert_loops = MEM_mallocN(sizeof(int) * (size_t)bm->totloop, __func__);
+
+	BLI_task_parallel_range(0, bm->totvert, &data, bm_mesh_arrays_verts_adjacency_cb, (bm->totvert >= BM_OMP_LIMIT));
+}
+
+void BM_mesh_arrays_free(BMeshArrays *arrays)
+{
+	MEM_SAFE_FREE(arrays->vert_co);
+	MEM_SAFE_FREE(arrays->vert_no);
+	MEM_SAFE_FREE(arrays->vert_edge_offset);
+	MEM_SAFE_FREE(arrays->vert_edges);
+	MEM_SAFE_FREE(arrays->vert_loop_offset);
+	MEM_SAFE_FREE(arrays->vert_loops);
+
+	MEM_SAFE_FREE(arrays->edge_verts);
+
+	MEM_SAFE_FREE(arrays->loop_vert);
+	MEM_SAFE_FREE(arrays->loop_edge);
+	MEM_SAFE_FREE(arrays->loop_face);
+
+	MEM_SAFE_FREE(arrays->face_loopstart);
+	MEM_SAFE_FREE(arrays->face_len);
+	MEM_SAFE_FREE(arrays->face_no);
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Sync with BMesh
+ *
+ * The BMesh topology must not have changed since the arrays were created.
+ * \{ */
+
+static void bm_mesh_arrays_update_coords_cb(void *userdata, const int i)
+{
+	BMeshArraysData *data = userdata;
+	copy_v3_v3(data->arrays->vert_co[i], data->bm->vtable[i]->co);
+}
+
+static void bm_mesh_arrays_apply_coords_cb(void *userdata, const int i)
+{
+	BMeshArraysData *data = userdata;
+	copy_v3_v3(data->bm->vtable[i]->co, data->arrays->vert_co[i]);
+}
+
+static void bm_mesh_arrays_apply_normals_verts_cb(void *userdata, const int i)
+{
+	BMeshArraysData *data = userdata;
+	copy_v3_v3(data->bm->vtable[i]->no, data->arrays->vert_no[i]);
+}
+
+static void bm_mesh_arrays_apply_normals_faces_cb(void *userdata, const int i)
+{
+	BMeshArraysData *data = userdata;
+	copy_v3_v3(data->bm->ftable[i]->no, data->arrays->face_no[i]);
+}
+
+/**
+ * Read vertex coordinates from \a bm again, after an operator moved them.
+ */
+void BM_mesh_arrays_update_coords(BMesh *bm, BMeshArrays *arrays)
+{
+	BMeshArraysData data = {.bm = bm, .arrays = arrays};
+
+	BLI_assert(bm->totvert == arrays->totvert);
+	BM_mesh_elem_table_ensure(bm, BM_VERT);
+
+	BLI_task_parallel_range(0, arrays->totvert, &data, bm_mesh_arrays_update_coords_cb,
+	                        (arrays->totvert >= BM_OMP_LIMIT));
+}
+
+void BM_mesh_arrays_apply_coords(const BMeshArrays *arrays, BMesh *bm)
+{
+	BMeshArraysData data = {.bm = bm, .arrays = (BMeshArrays *)arrays};
+
+	BLI_assert(bm->totvert == arrays->totvert);
+	BM_mesh_elem_table_ensure(bm, BM_VERT);
+
+	BLI_task_parallel_range(0, arrays->totvert, &data, bm_mesh_arrays_apply_coords_cb,
+	                        (arrays->totvert >= BM_OMP_LIMIT));
+}
+
+void BM_mesh_arrays_apply_normals(const BMeshArrays *arrays, BMesh *bm)
+{
+	BMeshArraysData data = {.bm = bm, .arrays = (BMeshArrays *)arrays};
+
+	BLI_assert(bm->totvert == arrays->totvert);
+	BLI_assert(bm->totface == arrays->totface);
+	BM_mesh_elem_table_ensure(bm, BM_VERT | BM_FACE);
+
+	BLI_task_parallel_range(0, arrays->totvert, &data, bm_mesh_arrays_apply_normals_verts_cb,
+	                        (arrays->totvert >= BM_OMP_LIMIT));
+	BLI_task_parallel_range(0, arrays->totface, &data, bm_mesh_arrays_apply_normals_faces_cb,
+	                        (arrays->totface >= BM_OMP_LIMIT));
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Bulk Operations
+ * \{ */
+
+static void bm_mesh_arrays_calc_normals_faces_cb(void *userdata, const int i)
+{
+	BMeshArraysData *data = userdata;
+	const BMeshArrays *arrays = data->arrays;
+	const int *loop_vert = &arrays->loop_vert[arrays->face_loopstart[i]];
+	const int len = arrays->face_len[i];
+	const float (*vert_co)[3] = (const float (*)[3])arrays->vert_co;
+	float *no = arrays->face_no[i];
+	const float *v_prev = vert_co[loop_vert[len - 1]];
+	int j;
+
+	/* Newell's Method, as #BM_face_calc_normal */
+	zero_v3(no);
+	for (j = 0; j < len; j++) {
+		const float *v_curr = vert_co[loop_vert[j]];
+		add_newell_cross_v3_v3v3(no, v_prev, v_curr);
+		v_prev = v_curr;
+	}
+
+	if (UNLIKELY(normalize_v3(no) == 0.0f)) {
+		no[2] = 1.0f; /* other axis set to 0.0 */
+	}
+}
+
+static void bm_mesh_arrays_calc_normals_verts_cb(void *userdata, const int i)
+{
+	BMeshArraysData *data = userdata;
+	const BMeshArrays *arrays = data->arrays;
+	const float (*vert_co)[3] = (const float (*)[3])arrays->vert_co;
+	const float *co = vert_co[i];
+	float *no = arrays->vert_no[i];
+	int j;
+
+	zero_v3(no);
+
+	/* accumulate the face normals weighted by the angle of the face corner */
+	for (j = arrays->vert_loop_offset[i]; j < arrays->vert_loop_offset[i + 1]; j++) {
+		const int l = arrays->vert_loops[j];
+		const int f = arrays->loop_face[l];
+		const int loopstart = arrays->face_loopstart[f];
+		const int loopend = loopstart + arrays->face_len[f] - 1;
+		const int l_prev = (l == loopstart) ? loopend : l - 1;
+		const int l_next = (l == loopend) ? loopstart : l + 1;
+		float vec_prev[3], vec_next[3];
+
+		sub_v3_v3v3(vec_prev, vert_co[arrays->loop_vert[l_prev]], co);
+		normalize_v3(vec_prev);
+		sub_v3_v3v3(vec_next, vert_co[arrays->loop_vert[l_next]], co);
+		normalize_v3(vec_next);
+
+		madd_v3_v3fl(no, arrays->face_no[f], saacos(dot_v3v3(vec_prev, vec_next)));
+	}
+
+	if (UNLIKELY(normalize_v3(no) == 0.0f)) {
+		normalize_v3_v3(no, co);
+	}
+}
+
+/**
+ * Compute face and vertex normals of the arrays, same as #BM_mesh_normals_update does for the BMesh.
+ */
+void BM_mesh_arrays_calc_normals(BMeshArrays *arrays)
+{
+	BMeshArraysData data = {.arrays = arrays};
+
+	BLI_task_parallel_range(0, arrays->totface, &data, bm_mesh_arrays_calc_normals_faces_cb,
+	                        (arrays->totface >= BM_OMP_LIMIT));
+	BLI_task_parallel_range(0, arrays->totvert, &data, bm_mesh_arrays_calc_normals_verts_cb,
+	                        (arrays->totvert >= BM_OMP_LIMIT));
+}
+
+static void bm_mesh_arrays_smooth_cb(void *userdata, const int i)
+{
+	BMeshArraysData *data = userdata;
+	const BMeshArrays *arrays = data->arrays;
+	const float (*vert_co)[3] = (const float (*)[3])arrays->vert_co;
+	const int edges_start = arrays->vert_edge_offset[i];
+	const int edges_len = arrays->vert_edge_offset[i + 1] - edges_start;
+	float *co_dst = data->vert_co_dst[i];
+	float co_avg[3] = {0.0f, 0.0f, 0.0f};
+	int j;
+
+	if (edges_len == 0) {
+		copy_v3_v3(co_dst, vert_co[i]);
+		return;
+	}
+
+	for (j = edges_start; j < edges_start + edges_len; j++) {
+		const int *e_verts = arrays->edge_verts[arrays->vert_edges[j]];
+		add_v3_v3(co_avg, vert_co[(e_verts[0] == i) ? e_verts[1] : e_verts[0]]);
+	}
+	mul_v3_fl(co_avg, 1.0f / (float)edges_len);
+
+	interp_v3_v3v3(co_dst, vert_co[i], co_avg, data->fac);
+}
+
+/**
+ * Laplacian smoothing, moves each vertex towards the average of its neighbors by \a fac,
+ * \a iterations times. Loose vertices are left in place.
+ */
+void BM_mesh_arrays_smooth(BMeshArrays *arrays, const float fac, const int iterations)
+{
+	BMeshArraysData data = {.arrays = arrays, .fac = fac};
+	int i;
+
+	data.vert_co_dst = MEM_mallocN(sizeof(*data.vert_co_dst) * (size_t)arrays->totvert, __func__);
+
+	for (i = 0; i < iterations; i++) {
+		BLI_task_parallel_range(0, arrays->totvert, &data, bm_mesh_arrays_smooth_cb,
+		                        (arrays->totvert >= BM_OMP_LIMIT));
+		{
+			float (*vert_co_src)[3] = arrays->vert_co;
+			arrays->vert_co = data.vert_co_dst;
+			data.vert_co_dst = vert_co_src;
+		}
+	}
+
+	MEM_freeN(data.vert_co_dst);
+}
+
+/** \} */
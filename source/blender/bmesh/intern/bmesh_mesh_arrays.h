@@ -0,0 +1,82 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2017 Blender Foundation.
+ * All rights reserved.
+ *
+ * Contributor(s): None Yet
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+#ifndef __BMESH_MESH_ARRAYS_H__
+#define __BMESH_MESH_ARRAYS_H__
+
+/** \file blender/bmesh/intern/bmesh_mesh_arrays.h
+ *  \ingroup bmesh
+ */
+
+/**
+ * Index based, struct-of-arrays copy of a BMesh.
+ *
+ * Topology is stored as indices and each attribute in its own array, so bulk operations
+ * (normals, smoothing...) become linear scans which can be split across threads and vectorized,
+ * instead of following element pointers.
+ *
+ * Indices match the element indices and tables of the BMesh the arrays were created from.
+ * BMesh operators keep running on the BMesh itself: write the arrays back with
+ * #BM_mesh_arrays_apply_coords before running them, then use #BM_mesh_arrays_update_coords when
+ * they only moved vertices, or create the arrays again when they changed the topology.
+ */
+typedef struct BMeshArrays {
+	int totvert, totedge, totloop, totface;
+
+	/* Vertex layers. */
+	float (*vert_co)[3];
+	float (*vert_no)[3];
+	/* Edges using vertex i are vert_edges[vert_edge_offset[i] .. vert_edge_offset[i + 1] - 1]. */
+	int *vert_edge_offset;
+	int *vert_edges;
+	/* Loops of vertex i are vert_loops[vert_loop_offset[i] .. vert_loop_offset[i + 1] - 1]. */
+	int *vert_loop_offset;
+	int *vert_loops;
+
+	/* Edge layers. */
+	int (*edge_verts)[2];
+
+	/* Loop layers, loops of a face are contiguous. */
+	int *loop_vert;
+	int *loop_edge;
+	int *loop_face;
+
+	/* Face layers. */
+	int *face_loopstart;
+	int *face_len;
+	float (*face_no)[3];
+} BMeshArrays;
+
+void BM_mesh_arrays_create(BMesh *bm, BMeshArrays *r_arrays);
+void BM_mesh_arrays_free(BMeshArrays *arrays);
+
+void BM_mesh_arrays_update_coords(BMesh *bm, BMeshArrays *arrays);
+void BM_mesh_arrays_apply_coords(const BMeshArrays *arrays, BMesh *bm);
+void BM_mesh_arrays_apply_normals(const BMeshArrays *arrays, BMesh *bm);
+
+void BM_mesh_arrays_calc_normals(BMeshArrays *arrays);
+void BM_mesh_arrays_smooth(BMeshArrays *arrays, const float fac, const int iterations);
+
+#endif /* __BMESH_MESH_ARRAYS_H__ */
@@ -51,6 +51,7 @@
 
 #include "BLI_kdopbvh.h"
 #include "BLI_buffer.h"
+#include "BLI_task.h"
 
 #include "bmesh.h"
 #include "intern/bmesh_private.h"
@@ -965,6 +966,97 @@ static int isect_bvhtree_point_v3(
 	return num_isect;
 }
 
+/**
+ * Check if all points of \a t_cos_b are on one side of the plane of \a t_cos_a,
+ * further away than any of the epsilon tests in #bm_isect_tri_tri reach.
+ */
+static bool isect_tri_tri_plane_separated(
+        const float *t_cos_a[3], const float *t_cos_b[3],
+        const struct ISectEpsilon *e)
+{
+	float plane[4];
+	float dist[3];
+	uint i;
+
+	if (normal_tri_v3(plane, UNPACK3(t_cos_a)) == 0.0f) {
+		/* degenerate, leave it to the full test */
+		return false;
+	}
+	plane[3] = -dot_v3v3(plane, t_cos_a[0]);
+
+	for (i = 0; i < 3; i++) {
+		dist[i] = plane_point_side_v3(plane, t_cos_b[i]);
+	}
+
+	const float dist_min = min_fff(UNPACK3(dist));
+	const float dist_max = max_fff(UNPACK3(dist));
+	/* vert-edge tests extend edges by 'eps' relative to their length */
+	const float margin = e->eps_margin + e->eps * (dist_max - dist_min);
+
+	return (dist_min > margin) || (dist_max < -margin);
+}
+
+struct ISectOverlapData {
+	BMLoop *(*looptris)[3];
+	const struct ISectEpsilon *epsilon;
+};
+
+/**
+ * Reject triangle pairs #bm_isect_tri_tri would skip or find no intersection for,
+ * runs from #BLI_bvhtree_overlap worker threads so it must not modify the mesh.
+ */
+static bool bm_isect_tri_tri_overlap_cb(void *userdata, int index_a, int index_b, int UNUSED(thread))
+{
+	const struct ISectOverlapData *data = userdata;
+	BMLoop **a = data->looptris[index_a];
+	BMLoop **b = data->looptris[index_b];
+	const BMVert *fv_a[3] = {UNPACK3_EX(, a, ->v)};
+	const BMVert *fv_b[3] = {UNPACK3_EX(, b, ->v)};
+
+	if (UNLIKELY(ELEM(fv_a[0], UNPACK3(fv_b)) ||
+	             ELEM(fv_a[1], UNPACK3(fv_b)) ||
+	             ELEM(fv_a[2], UNPACK3(fv_b))))
+	{
+		return false;
+	}
+
+	const float *f_a_cos[3] = {UNPACK3_EX(, fv_a, ->co)};
+	const float *f_b_cos[3] = {UNPACK3_EX(, fv_b, ->co)};
+
+	return !(isect_tri_tri_plane_separated(f_a_cos, f_b_cos, data->epsilon) ||
+	         isect_tri_tri_plane_separated(f_b_cos, f_a_cos, data->epsilon));
+}
+
+struct ISectGroupRaycastData {
+	BMFace **ftable;
+	const int *groups_array;
+	int (*group_index)[2];
+	BVHTree **tree_pair;
+	const float **looptri_coords;
+	/* per group: side from the test callback (-1 to skip) & number of hits */
+	const int *group_side;
+	int *group_hits;
+};
+
+static void bm_isect_group_raycast_cb(void *userdata, const int i)
+{
+	struct ISectGroupRaycastData *data = userdata;
+	const int side = data->group_side[i];
+
+	if (side == -1) {
+		return;
+	}
+
+	/* for now assume this is an OK face to test with (not degenerate!) */
+	BMFace *f = data->ftable[data->groups_array[data->group_index[i][0]]];
+	float co[3];
+
+	// BM_face_calc_center_mean(f, co);
+	BM_face_calc_point_in_face(f, co);
+
+	data->group_hits[i] = isect_bvhtree_point_v3(data->tree_pair[!side], data->looptri_coords, co);
+}
+
 #endif  /* USE_BVH */
 
 /**
@@ -1104,7 +1196,16 @@ bool BM_mesh_intersect(
 		tree_b = tree_a;
 	}
 
-	overlap = BLI_bvhtree_overlap(tree_b, tree_a, &tree_overlap_tot, NULL, NULL);
+	{
+		struct ISectOverlapData overlap_data = {
+			.looptris = looptris,
+			.epsilon = &s.epsilon,
+		};
+		/* cheap rejection of pairs in parallel, cutting the faces remains single threaded */
+		overlap = BLI_bvhtree_overlap(
+		        tree_b, tree_a, &tree_overlap_tot,
+		        bm_isect_tri_tri_overlap_cb, &overlap_data);
+	}
 
 	if (overlap) {
 		uint i;
@@ -1559,29 +1660,44 @@ bool BM_mesh_intersect(
 		printf("%s: Total face-groups: %d\n", __func__, group_tot);
 #endif
 
-		/* Check if island is inside/outside */
+		/* Check if island is inside/outside,
+		 * the test callback may not be thread-safe, only cast the rays in parallel. */
+		int *group_side = MEM_mallocN(sizeof(*group_side) * (size_t)group_tot, __func__);
+		int *group_hits = MEM_mallocN(sizeof(*group_hits) * (size_t)group_tot, __func__);
+
+		for (i = 0; i < group_tot; i++) {
+			group_side[i] = test_fn(ftable[groups_array[group_index[i][0]]], user_data);
+			BLI_assert(ELEM(group_side[i], -1, 0, 1));
+		}
+
+		{
+			struct ISectGroupRaycastData data = {
+				.ftable = ftable,
+				.groups_array = groups_array,
+				.group_index = group_index,
+				.tree_pair = tree_pair,
+				.looptri_coords = looptri_coords,
+				.group_side = group_side,
+				.group_hits = group_hits,
+			};
+			BLI_task_parallel_range(0, group_tot, &data, bm_isect_group_raycast_cb, (group_tot > 1));
+		}
+
 		for (i = 0; i < group_tot; i++) {
 			int fg     = group_index[i][0];
 			int fg_end = group_index[i][1] + fg;
 			bool do_remove, do_flip;
 
 			{
-				/* for now assyme this is an OK face to test with (not degenerate!) */
-				BMFace *f = ftable[groups_array[fg]];
-				float co[3];
 				int hits;
-				int side = test_fn(f, user_data);
+				int side = group_side[i];
 
 				if (side == -1) {
 					continue;
 				}
-				BLI_assert(ELEM(side, 0, 1));
 				side = !side;
 
-				// BM_face_calc_center_mean(f, co);
-				BM_face_calc_point_in_face(f, co);
-
-				hits = isect_bvhtree_point_v3(tree_pair[side], looptri_coords, co);
+				hits = group_hits[i];
 
 				switch (boolean_mode) {
 					case BMESH_ISECT_BOOLEAN_ISECT:
@@ -1615,6 +1731,8 @@ bool BM_mesh_intersect(
 			has_edit_boolean |= (do_flip || do_remove);
 		}
 
+		MEM_freeN(group_side);
+		MEM_freeN(group_hits);
 		MEM_freeN(groups_array);
 		MEM_freeN(group_index);
 
@@ -226,6 +226,18 @@ void DEG_evaluate_on_framechange(struct EvaluationContext *eval_ctx,
                                  Depsgraph *graph,
                                  float ctime);
 
+/* Frame changed recalculation of several graphs of the same scene at once,
+ * used for baking. Graphs are evaluated concurrently when every graph has its
+ * own copy-on-write data, see DEG_graph_is_frame_independent().
+ * < eval_ctx: context to perform evaluation for, one per graph
+ * < ctime: (frame) new frame to evaluate values on, one per graph
+ */
+void DEG_evaluate_on_framechange_multi(struct EvaluationContext **eval_ctx,
+                                       struct Main *bmain,
+                                       Depsgraph **graphs,
+                                       const float *ctime,
+                                       int num_graphs);
+
 /* Data changed recalculation entry point.
  * < context_type: context to perform evaluation for
  */
@@ -82,6 +82,33 @@ void DEG_stats_simple(const struct Depsgraph *graph,
                       size_t *r_operations,
                       size_t *r_relations);
 
+/* ************************************************ */
+/* Evaluation Timing */
+
+typedef struct DepsgraphOperationTiming {
+	char id_name[66];  /* MAX_ID_NAME */
+	char component[64];
+	char operation[64];
+	/* Seconds, relative to the start of the evaluation. */
+	double start_time, end_time;
+	/* Task scheduler thread which evaluated the operation. */
+	int thread_id;
+} DepsgraphOperationTiming;
+
+/* Record start and end time of every operation evaluated by the graph,
+ * only timings of the last evaluation are kept.
+ */
+void DEG_debug_timing_set_enabled(struct Depsgraph *graph, bool enabled);
+bool DEG_debug_timing_is_enabled(const struct Depsgraph *graph);
+
+int DEG_debug_timing_num_operations(const struct Depsgraph *graph);
+void DEG_debug_timing_get(const struct Depsgraph *graph,
+                          int index,
+                          DepsgraphOperationTiming *r_timing);
+
+/* Write timings in Chrome trace event format (chrome://tracing). */
+void DEG_debug_timing_chrome_trace(const struct Depsgraph *graph, FILE *stream);
+
 /* ************************************************ */
 /* Diagram-Based Graph Debugging */
 
@@ -55,6 +55,12 @@ bool DEG_id_type_tagged(struct Main *bmain, short id_type);
 /* Get additional evaluation flags for the given ID. */
 short DEG_get_eval_flags_for_id(struct Depsgraph *graph, struct ID *id);
 
+/* Check whether evaluation of the graph at a frame does not depend on
+ * evaluation of the previous frames (no simulations or point caches), so
+ * graphs can be evaluated at different frames concurrently.
+ */
+bool DEG_graph_is_frame_independent(struct Depsgraph *graph);
+
 /* Get scene the despgraph is created for. */
 struct Scene *DEG_get_evaluated_scene(struct Depsgraph *graph);
 
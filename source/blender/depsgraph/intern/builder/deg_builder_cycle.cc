@@ -43,49 +43,35 @@
 #include "intern/nodes/deg_node_operation.h"
 
 #include "intern/depsgraph.h"
+#include "intern/depsgraph_types.h"
 
 namespace DEG {
 
-void deg_graph_detect_cycles(Depsgraph *graph)
-{
-	enum {
-		/* Not is not visited at all during traversal. */
-		NODE_NOT_VISITED = 0,
-		/* Node has been visited during traversal and not in current stack. */
-		NODE_VISITED = 1,
-		/* Node has been visited during traversal and is in current stack. */
-		NODE_IN_STACK = 2,
-	};
-
-	struct StackEntry {
-		OperationDepsNode *node;
-		StackEntry *from;
-		DepsRelation *via_relation;
-	};
+namespace {
 
-	BLI_Stack *traversal_stack = BLI_stack_new(sizeof(StackEntry),
-	                                           "DEG detect cycles stack");
+enum {
+	/* Not is not visited at all during traversal. */
+	NODE_NOT_VISITED = 0,
+	/* Node has been visited during traversal and not in current stack. */
+	NODE_VISITED = 1,
+	/* Node has been visited during traversal and is in current stack. */
+	NODE_IN_STACK = 2,
+};
 
-	foreach (OperationDepsNode *node, graph->operations) {
-		bool has_inlinks = false;
-		foreach (DepsRelation *rel, node->inlinks) {
-			if (rel->from->type == DEG_NODE_TYPE_OPERATION) {
-				has_inlinks = true;
-			}
-		}
-		if (has_inlinks == false) {
-			StackEntry entry;
-			entry.node = node;
-			entry.from = NULL;
-			entry.via_relation = NULL;
-			BLI_stack_push(traversal_stack, &entry);
-			node->tag = NODE_IN_STACK;
-		}
-		else {
-			node->tag = NODE_NOT_VISITED;
-		}
-		node->done = 0;
-	}
+struct StackEntry {
+	OperationDepsNode *node;
+	StackEntry *from;
+	DepsRelation *via_relation;
+};
+
+void detect_cycles_traverse(BLI_Stack *traversal_stack, OperationDepsNode *root)
+{
+	StackEntry root_entry;
+	root_entry.node = root;
+	root_entry.from = NULL;
+	root_entry.via_relation = NULL;
+	BLI_stack_push(traversal_stack, &root_entry);
+	root->tag = NODE_IN_STACK;
 
 	while (!BLI_stack_is_empty(traversal_stack)) {
 		StackEntry *entry = (StackEntry *)BLI_stack_peek(traversal_stack);
@@ -132,8 +118,72 @@ void deg_graph_detect_cycles(Depsgraph *graph)
 			BLI_stack_discard(traversal_stack);
 		}
 	}
+}
+
+/* Traverse given nodes, which are expected to be tagged NODE_NOT_VISITED,
+ * starting from the ones which have no incoming relations from other
+ * nodes which are to be traversed.
+ */
+void detect_cycles(const vector<OperationDepsNode *> &nodes)
+{
+	BLI_Stack *traversal_stack = BLI_stack_new(sizeof(StackEntry),
+	                                           "DEG detect cycles stack");
+
+	foreach (OperationDepsNode *node, nodes) {
+		if (node->tag != NODE_NOT_VISITED) {
+			continue;
+		}
+		bool has_inlinks = false;
+		foreach (DepsRelation *rel, node->inlinks) {
+			if (rel->from->type == DEG_NODE_TYPE_OPERATION &&
+			    rel->from->tag != NODE_VISITED)
+			{
+				has_inlinks = true;
+			}
+		}
+		if (has_inlinks == false) {
+			detect_cycles_traverse(traversal_stack, node);
+		}
+	}
+	/* Nodes which are only reachable from cycles. */
+	foreach (OperationDepsNode *node, nodes) {
+		if (node->tag == NODE_NOT_VISITED) {
+			detect_cycles_traverse(traversal_stack, node);
+		}
+	}
 
 	BLI_stack_free(traversal_stack);
 }
 
+}  /* namespace */
+
+void deg_graph_detect_cycles(Depsgraph *graph)
+{
+	foreach (OperationDepsNode *node, graph->operations) {
+		node->tag = NODE_NOT_VISITED;
+		node->done = 0;
+	}
+	detect_cycles(graph->operations);
+}
+
+void deg_graph_detect_cycles_update(Depsgraph *graph,
+                                    const vector<OperationDepsNode *> &nodes)
+{
+	/* Nodes outside of the affected part of the graph are considered to be
+	 * traversed already, cycles they are part of did not change.
+	 */
+	foreach (OperationDepsNode *node, graph->operations) {
+		node->tag = NODE_VISITED;
+	}
+	foreach (OperationDepsNode *node, nodes) {
+		node->tag = NODE_NOT_VISITED;
+		node->done = 0;
+		/* Incoming relations from the nodes outside are not part of any cycle. */
+		foreach (DepsRelation *rel, node->inlinks) {
+			rel->flag &= ~DEPSREL_FLAG_CYCLIC;
+		}
+	}
+	detect_cycles(nodes);
+}
+
 }  // namespace DEG
@@ -30,11 +30,21 @@
 
 #pragma once
 
+#include "intern/depsgraph_types.h"
+
 namespace DEG {
 
 struct Depsgraph;
+struct OperationDepsNode;
 
 /* Detect and solve dependency cycles. */
 void deg_graph_detect_cycles(Depsgraph *graph);
 
+/* Detect and solve dependency cycles among the given operations, which are
+ * expected to include everything reachable from them. Used when relations of
+ * individual IDs were rebuilt.
+ */
+void deg_graph_detect_cycles_update(Depsgraph *graph,
+                                    const vector<OperationDepsNode *> &nodes);
+
 }  // namespace DEG
@@ -160,7 +160,8 @@ void free_copy_on_write_datablock(void *id_v)
 DepsgraphNodeBuilder::DepsgraphNodeBuilder(Main *bmain, Depsgraph *graph) :
     m_bmain(bmain),
     m_graph(graph),
-    m_cow_id_hash(NULL)
+    m_cow_id_hash(NULL),
+    m_is_update(false)
 {
 }
 
@@ -232,6 +233,9 @@ OperationDepsNode *DepsgraphNodeBuilder::add_operation_node(
 		op_node = comp_node->add_operation(op, opcode, name, name_tag);
 		m_graph->operations.push_back(op_node);
 	}
+	else if (m_is_update) {
+		/* Operation of a kept ID node, which is built from the updated ID. */
+	}
 	else {
 		fprintf(stderr,
 		        "add_operation: Operation already exists - %s has %s at %p\n",
@@ -380,6 +384,72 @@ void DepsgraphNodeBuilder::begin_build(Main *bmain) {
 	BLI_gset_clear(m_graph->entry_tags, NULL);
 }
 
+void DepsgraphNodeBuilder::begin_update(Main *bmain,
+                                        const vector<IDDepsNode *> &id_nodes)
+{
+	m_is_update = true;
+
+	/* Same as for the full build, LIB_TAG_DOIT indicates whether nodes for
+	 * given ID exist already, which is the case for all the kept ID nodes.
+	 */
+	BKE_main_id_tag_all(bmain, LIB_TAG_DOIT, false);
+	FOREACH_NODETREE(bmain, nodetree, id)
+	{
+		if (id != (ID *)nodetree) {
+			nodetree->id.tag &= ~LIB_TAG_DOIT;
+		}
+	}
+	FOREACH_NODETREE_END;
+
+	/* Tag operations of the removed ID nodes. */
+	foreach (OperationDepsNode *op_node, m_graph->operations) {
+		op_node->done = 0;
+	}
+	foreach (IDDepsNode *id_node, id_nodes) {
+		GHASH_FOREACH_BEGIN(ComponentDepsNode *, comp_node, id_node->components)
+		{
+			GHASH_FOREACH_BEGIN(OperationDepsNode *, op_node, comp_node->operations_map)
+			{
+				op_node->done = 1;
+				BLI_gset_remove(m_graph->entry_tags, op_node, NULL);
+			}
+			GHASH_FOREACH_END();
+		}
+		GHASH_FOREACH_END();
+	}
+	size_t num_kept_operations = 0;
+	foreach (OperationDepsNode *op_node, m_graph->operations) {
+		if (op_node->done == 0) {
+			m_graph->operations[num_kept_operations++] = op_node;
+		}
+	}
+	m_graph->operations.resize(num_kept_operations);
+
+#ifdef WITH_COPY_ON_WRITE
+	/* Objects and other datablocks might be referencing copy-on-write version
+	 * of the updated IDs, so those are re-used by the new ID nodes.
+	 */
+	m_cow_id_hash = BLI_ghash_ptr_new("Depsgraph id hash");
+#endif
+	foreach (IDDepsNode *id_node, id_nodes) {
+		ID *id_orig = id_node->id_orig;
+#ifdef WITH_COPY_ON_WRITE
+		if (id_node->id_cow != NULL && id_node->id_cow != id_orig) {
+			BLI_ghash_insert(m_cow_id_hash, id_orig, id_node->id_cow);
+			id_node->id_cow = NULL;
+		}
+#endif
+		BLI_ghash_remove(m_graph->id_hash, id_orig, NULL, NULL);
+		OBJECT_GUARDED_DELETE(id_node, IDDepsNode);
+	}
+
+	GHASH_FOREACH_BEGIN(IDDepsNode *, id_node, m_graph->id_hash)
+	{
+		id_node->id_orig->tag |= LIB_TAG_DOIT;
+	}
+	GHASH_FOREACH_END();
+}
+
 void DepsgraphNodeBuilder::build_group(Scene *scene, Group *group)
 {
 	ID *group_id = &group->id;
@@ -106,6 +106,11 @@ struct DepsgraphNodeBuilder {
 	}
 
 	void begin_build(Main *bmain);
+	/* Prepare for building nodes of the given IDs only, their current nodes
+	 * are removed from the graph while nodes of all other IDs are kept.
+	 * Relations of the given nodes are to be removed already.
+	 */
+	void begin_update(Main *bmain, const vector<IDDepsNode *> &id_nodes);
 
 	IDDepsNode *add_id_node(ID *id, bool do_tag = true);
 	TimeSourceDepsNode *add_time_source();
@@ -207,6 +212,10 @@ protected:
 	Main *m_bmain;
 	Depsgraph *m_graph;
 	GHash *m_cow_id_hash;
+	/* Only nodes of some IDs are being built, operations which exist already
+	 * belong to the nodes which are kept.
+	 */
+	bool m_is_update;
 };
 
 }  // namespace DEG
@@ -195,7 +195,9 @@ RNAPathKey::RNAPathKey(ID *id, const char *path) :
 }
 
 DepsgraphRelationBuilder::DepsgraphRelationBuilder(Depsgraph *graph) :
-    m_graph(graph)
+    m_graph(graph),
+    m_owner_id(NULL),
+    m_built_ids(NULL)
 {
 }
 
@@ -276,7 +278,13 @@ void DepsgraphRelationBuilder::add_time_relation(TimeSourceDepsNode *timesrc,
                                                  const char *description)
 {
 	if (timesrc && node_to) {
-		m_graph->add_new_relation(timesrc, node_to, description);
+		if (m_built_ids != NULL) {
+			DeferredRelation deferred = {timesrc, node_to, description, 0, m_owner_id};
+			m_deferred_relations.push_back(deferred);
+			return;
+		}
+		DepsRelation *rel = m_graph->add_new_relation(timesrc, node_to, description);
+		rel->owner_id = m_owner_id;
 	}
 	else {
 		DEG_DEBUG_PRINTF("add_time_relation(%p = %s, %p = %s, %s) Failed\n",
@@ -292,7 +300,13 @@ void DepsgraphRelationBuilder::add_operation_relation(
         const char *description)
 {
 	if (node_from && node_to) {
-		m_graph->add_new_relation(node_from, node_to, description);
+		if (m_built_ids != NULL) {
+			DeferredRelation deferred = {node_from, node_to, description, 0, m_owner_id};
+			m_deferred_relations.push_back(deferred);
+			return;
+		}
+		DepsRelation *rel = m_graph->add_new_relation(node_from, node_to, description);
+		rel->owner_id = m_owner_id;
 	}
 	else {
 		DEG_DEBUG_PRINTF("add_operation_relation(%p = %s, %p = %s, %s) Failed\n",
@@ -302,6 +316,36 @@ void DepsgraphRelationBuilder::add_operation_relation(
 	}
 }
 
+void DepsgraphRelationBuilder::add_customdata_mask(OperationDepsNode *node,
+                                                   uint64_t customdata_mask)
+{
+	if (m_built_ids != NULL) {
+		/* Same node might be requested by several threads. */
+		DeferredRelation deferred = {NULL, node, NULL, customdata_mask, m_owner_id};
+		m_deferred_relations.push_back(deferred);
+		return;
+	}
+	node->customdata_mask |= customdata_mask;
+}
+
+bool DepsgraphRelationBuilder::id_is_built(const ID *id) const
+{
+	if (id->tag & LIB_TAG_DOIT) {
+		return true;
+	}
+	return (m_built_ids != NULL) && BLI_gset_haskey(m_built_ids, id);
+}
+
+void DepsgraphRelationBuilder::id_tag_built(ID *id)
+{
+	if (m_built_ids != NULL) {
+		BLI_gset_add(m_built_ids, id);
+	}
+	else {
+		id->tag |= LIB_TAG_DOIT;
+	}
+}
+
 void DepsgraphRelationBuilder::add_collision_relations(const OperationKey &key, Scene *scene, Object *ob, Group *group, bool dupli, const char *name)
 {
 	unsigned int numcollobj;
@@ -394,7 +438,7 @@ void DepsgraphRelationBuilder::build_group(Main *bmain,
                                            Group *group)
 {
 	ID *group_id = &group->id;
-	bool group_done = (group_id->tag & LIB_TAG_DOIT) != 0;
+	bool group_done = id_is_built(group_id);
 	OperationKey object_local_transform_key(&object->id,
 	                                        DEG_NODE_TYPE_TRANSFORM,
 	                                        DEG_OPCODE_TRANSFORM_LOCAL);
@@ -405,15 +449,16 @@ void DepsgraphRelationBuilder::build_group(Main *bmain,
 		ComponentKey dupli_transform_key(&go->ob->id, DEG_NODE_TYPE_TRANSFORM);
 		add_relation(dupli_transform_key, object_local_transform_key, "Dupligroup");
 	}
-	group_id->tag |= LIB_TAG_DOIT;
+	id_tag_built(group_id);
 }
 
 void DepsgraphRelationBuilder::build_object(Main *bmain, Scene *scene, Object *ob)
 {
-	if (ob->id.tag & LIB_TAG_DOIT) {
+	if (id_is_built(&ob->id)) {
 		return;
 	}
-	ob->id.tag |= LIB_TAG_DOIT;
+	id_tag_built(&ob->id);
+	OwnerScope owner_scope(this, &ob->id);
 
 	/* Object Transforms */
 	eDepsOperation_Code base_op = (ob->parent) ? DEG_OPCODE_TRANSFORM_PARENT : DEG_OPCODE_TRANSFORM_LOCAL;
@@ -558,7 +603,7 @@ void DepsgraphRelationBuilder::build_object(Main *bmain, Scene *scene, Object *o
 
 	/* Object that this is a proxy for. */
 	if (ob->proxy != NULL) {
-		ob->proxy->proxy_from = ob;
+		/* NOTE: ob->proxy->proxy_from is set by the node builder. */
 		build_object(bmain, scene, ob->proxy);
 		/* TODO(sergey): This is an inverted relation, matches old depsgraph
 		 * behavior and need to be investigated if it still need to be inverted.
@@ -602,7 +647,7 @@ void DepsgraphRelationBuilder::build_object_parent(Object *ob)
 			/* XXX not sure what this is for or how you could be done properly - lukas */
 			OperationDepsNode *parent_node = find_operation_node(parent_key);
 			if (parent_node != NULL) {
-				parent_node->customdata_mask |= CD_MASK_ORIGINDEX;
+				add_customdata_mask(parent_node, CD_MASK_ORIGINDEX);
 			}
 
 			ComponentKey transform_key(&ob->parent->id, DEG_NODE_TYPE_TRANSFORM);
@@ -775,7 +820,7 @@ void DepsgraphRelationBuilder::build_constraints(Scene *scene, ID *id, eDepsNode
 					if (ct->tar->type == OB_MESH) {
 						OperationDepsNode *node2 = find_operation_node(target_key);
 						if (node2 != NULL) {
-							node2->customdata_mask |= CD_MASK_MDEFORMVERT;
+							add_customdata_mask(node2, CD_MASK_MDEFORMVERT);
 						}
 					}
 				}
@@ -1147,10 +1192,11 @@ void DepsgraphRelationBuilder::build_driver(ID *id, FCurve *fcu)
 void DepsgraphRelationBuilder::build_world(World *world)
 {
 	ID *world_id = &world->id;
-	if (world_id->tag & LIB_TAG_DOIT) {
+	if (id_is_built(world_id)) {
 		return;
 	}
-	world_id->tag |= LIB_TAG_DOIT;
+	id_tag_built(world_id);
+	OwnerScope owner_scope(this, world_id);
 
 	build_animdata(world_id);
 
@@ -1393,10 +1439,11 @@ void DepsgraphRelationBuilder::build_particles(Scene *scene, Object *ob)
 void DepsgraphRelationBuilder::build_particle_settings(ParticleSettings *part)
 {
 	ID *part_id = &part->id;
-	if (part_id->tag & LIB_TAG_DOIT) {
+	if (id_is_built(part_id)) {
 		return;
 	}
-	part_id->tag |= LIB_TAG_DOIT;
+	id_tag_built(part_id);
+	OwnerScope owner_scope(this, part_id);
 
 	/* Animation data relations. */
 	build_animdata(&part->id);
@@ -1567,10 +1614,11 @@ void DepsgraphRelationBuilder::build_obdata_geom(Main *bmain, Scene *scene, Obje
 		add_relation(geom_init_key, obdata_ubereval_key, "Object Geometry UberEval");
 	}
 
-	if (obdata->tag & LIB_TAG_DOIT) {
+	if (id_is_built(obdata)) {
 		return;
 	}
-	obdata->tag |= LIB_TAG_DOIT;
+	id_tag_built(obdata);
+	OwnerScope owner_scope(this, obdata);
 
 	/* Link object data evaluation node to exit operation. */
 	OperationKey obdata_geom_eval_key(obdata, DEG_NODE_TYPE_GEOMETRY, DEG_OPCODE_PLACEHOLDER, "Geometry Eval");
@@ -1671,10 +1719,11 @@ void DepsgraphRelationBuilder::build_camera(Object *ob)
 {
 	Camera *cam = (Camera *)ob->data;
 	ID *camera_id = &cam->id;
-	if (camera_id->tag & LIB_TAG_DOIT) {
+	if (id_is_built(camera_id)) {
 		return;
 	}
-	camera_id->tag |= LIB_TAG_DOIT;
+	id_tag_built(camera_id);
+	OwnerScope owner_scope(this, camera_id);
 
 	ComponentKey parameters_key(camera_id, DEG_NODE_TYPE_PARAMETERS);
 
@@ -1696,10 +1745,11 @@ void DepsgraphRelationBuilder::build_lamp(Object *ob)
 {
 	Lamp *la = (Lamp *)ob->data;
 	ID *lamp_id = &la->id;
-	if (lamp_id->tag & LIB_TAG_DOIT) {
+	if (id_is_built(lamp_id)) {
 		return;
 	}
-	lamp_id->tag |= LIB_TAG_DOIT;
+	id_tag_built(lamp_id);
+	OwnerScope owner_scope(this, lamp_id);
 
 	ComponentKey parameters_key(lamp_id, DEG_NODE_TYPE_PARAMETERS);
 
@@ -1740,6 +1790,7 @@ void DepsgraphRelationBuilder::build_nodetree(bNodeTree *ntree)
 		return;
 
 	ID *ntree_id = &ntree->id;
+	OwnerScope owner_scope(this, ntree_id);
 
 	build_animdata(ntree_id);
 
@@ -1758,9 +1809,9 @@ void DepsgraphRelationBuilder::build_nodetree(bNodeTree *ntree)
 			}
 			else if (bnode->type == NODE_GROUP) {
 				bNodeTree *group_ntree = (bNodeTree *)bnode->id;
-				if ((group_ntree->id.tag & LIB_TAG_DOIT) == 0) {
+				if (!id_is_built(&group_ntree->id)) {
 					build_nodetree(group_ntree);
-					group_ntree->id.tag |= LIB_TAG_DOIT;
+					id_tag_built(&group_ntree->id);
 				}
 				OperationKey group_parameters_key(&group_ntree->id,
 				                                  DEG_NODE_TYPE_PARAMETERS,
@@ -1785,10 +1836,11 @@ void DepsgraphRelationBuilder::build_nodetree(bNodeTree *ntree)
 void DepsgraphRelationBuilder::build_material(Material *ma)
 {
 	ID *ma_id = &ma->id;
-	if (ma_id->tag & LIB_TAG_DOIT) {
+	if (id_is_built(ma_id)) {
 		return;
 	}
-	ma_id->tag |= LIB_TAG_DOIT;
+	id_tag_built(ma_id);
+	OwnerScope owner_scope(this, ma_id);
 
 	/* animation */
 	build_animdata(ma_id);
@@ -1813,10 +1865,11 @@ void DepsgraphRelationBuilder::build_material(Material *ma)
 void DepsgraphRelationBuilder::build_texture(Tex *tex)
 {
 	ID *tex_id = &tex->id;
-	if (tex_id->tag & LIB_TAG_DOIT) {
+	if (id_is_built(tex_id)) {
 		return;
 	}
-	tex_id->tag |= LIB_TAG_DOIT;
+	id_tag_built(tex_id);
+	OwnerScope owner_scope(this, tex_id);
 
 	/* texture itself */
 	build_animdata(tex_id);
@@ -1882,10 +1935,11 @@ void DepsgraphRelationBuilder::build_lightprobe(Object *object)
 {
 	LightProbe *probe = (LightProbe *)object->data;
 	ID *probe_id = &probe->id;
-	if (probe_id->tag & LIB_TAG_DOIT) {
+	if (id_is_built(probe_id)) {
 		return;
 	}
-	probe_id->tag |= LIB_TAG_DOIT;
+	id_tag_built(probe_id);
+	OwnerScope owner_scope(this, probe_id);
 	build_animdata(&probe->id);
 
 	OperationKey probe_key(probe_id,
@@ -1935,13 +1989,15 @@ void DepsgraphRelationBuilder::build_copy_on_write_relations(IDDepsNode *id_node
 		 */
 		OperationDepsNode *op_entry = comp_node->get_entry_operation();
 		if (op_entry != NULL) {
-			m_graph->add_new_relation(op_cow, op_entry, "CoW Dependency");
+			DepsRelation *rel = m_graph->add_new_relation(op_cow, op_entry, "CoW Dependency");
+			rel->owner_id = id_orig;
 		}
 		/* All dangling operations should also be executed after copy-on-write. */
 		GHASH_FOREACH_BEGIN(OperationDepsNode *, op_node, comp_node->operations_map)
 		{
 			if (op_node->inlinks.size() == 0) {
-				m_graph->add_new_relation(op_cow, op_node, "CoW Dependency");
+				DepsRelation *rel = m_graph->add_new_relation(op_cow, op_node, "CoW Dependency");
+				rel->owner_id = id_orig;
 			}
 		}
 		GHASH_FOREACH_END();
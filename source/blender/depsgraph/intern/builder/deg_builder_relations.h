@@ -50,6 +50,7 @@ struct bGPdata;
 struct CacheFile;
 struct ListBase;
 struct GHash;
+struct GSet;
 struct ID;
 struct FCurve;
 struct Group;
@@ -187,6 +188,7 @@ struct DepsgraphRelationBuilder
 	                              const char *description);
 
 	void build_scene(Main *bmain, Scene *scene);
+	void build_objects(Main *bmain, Scene *scene, const vector<Object *> &objects);
 	void build_group(Main *bmain, Scene *scene, Object *object, Group *group);
 	void build_object(Main *bmain, Scene *scene, Object *ob);
 	void build_object_parent(Object *ob);
@@ -252,6 +254,9 @@ struct DepsgraphRelationBuilder
 	void build_copy_on_write_relations();
 	void build_copy_on_write_relations(IDDepsNode *id_node);
 
+	/* Flush customdata mask requested by operations to their objects. */
+	void flush_customdata_masks();
+
 	template <typename KeyType>
 	OperationDepsNode *find_operation_node(const KeyType &key);
 
@@ -270,6 +275,14 @@ protected:
 	void add_operation_relation(OperationDepsNode *node_from,
 	                            OperationDepsNode *node_to,
 	                            const char *description);
+	void add_customdata_mask(OperationDepsNode *node, uint64_t customdata_mask);
+
+	/* Check whether relations of the ID were already built, and mark them as
+	 * built. LIB_TAG_DOIT is used for this unless the builder runs on a worker
+	 * thread, see build_objects().
+	 */
+	bool id_is_built(const ID *id) const;
+	void id_tag_built(ID *id);
 
 	template <typename KeyType>
 	DepsNodeHandle create_node_handle(const KeyType& key,
@@ -277,8 +290,53 @@ protected:
 
 	bool needs_animdata_node(ID *id);
 
+	/* Relations added while the scope exists are owned by the given ID,
+	 * used by the ID build functions once they passed their LIB_TAG_DOIT check.
+	 */
+	struct OwnerScope {
+		OwnerScope(DepsgraphRelationBuilder *builder, ID *id)
+		  : builder(builder),
+		    prev_owner_id(builder->m_owner_id)
+		{
+			builder->m_owner_id = id;
+			if (builder->m_built_ids != NULL) {
+				/* Embedded node trees have no check of their own. */
+				builder->id_tag_built(id);
+			}
+		}
+		~OwnerScope()
+		{
+			builder->m_owner_id = prev_owner_id;
+		}
+		DepsgraphRelationBuilder *builder;
+		ID *prev_owner_id;
+	};
+
+	/* Relation or customdata mask which is applied to the graph once all the
+	 * worker threads are done, see build_objects().
+	 */
+	struct DeferredRelation {
+		DepsNode *from;
+		DepsNode *to;
+		const char *description;
+		uint64_t customdata_mask;
+		ID *owner_id;
+	};
+
+	void begin_deferred_build();
+	void end_deferred_build(GSet *built_ids);
+	static void build_objects_task(void *userdata, int chunk);
+
 private:
 	Depsgraph *m_graph;
+	/* ID which relations are currently being built, see DepsRelation::owner_id. */
+	ID *m_owner_id;
+	/* IDs which relations were built by this builder, only used when building
+	 * on a worker thread, NULL otherwise.
+	 */
+	GSet *m_built_ids;
+	/* Changes to the graph made by the builder running on a worker thread. */
+	vector<DeferredRelation> m_deferred_relations;
 };
 
 struct DepsNodeHandle
@@ -119,7 +119,7 @@ void DepsgraphRelationBuilder::build_ik_pose(Object *ob,
 			if (data->tar->type == OB_MESH) {
 				OperationDepsNode *node2 = find_operation_node(target_key);
 				if (node2 != NULL) {
-					node2->customdata_mask |= CD_MASK_MDEFORMVERT;
+					add_customdata_mask(node2, CD_MASK_MDEFORMVERT);
 				}
 			}
 		}
@@ -154,7 +154,7 @@ void DepsgraphRelationBuilder::build_ik_pose(Object *ob,
 			if (data->poletar->type == OB_MESH) {
 				OperationDepsNode *node2 = find_operation_node(target_key);
 				if (node2 != NULL) {
-					node2->customdata_mask |= CD_MASK_MDEFORMVERT;
+					add_customdata_mask(node2, CD_MASK_MDEFORMVERT);
 				}
 			}
 		}
@@ -204,8 +204,6 @@ void DepsgraphRelationBuilder::build_ik_pose(Object *ob,
 			OperationKey final_transforms_key(&ob->id, DEG_NODE_TYPE_BONE, parchan->name, DEG_OPCODE_BONE_DONE);
 			add_relation(solver_key, final_transforms_key, "IK Solver Result");
 		}
-		parchan->flag |= POSE_DONE;
-
 
 		root_map->add_bone(parchan->name, rootchan->name);
 
@@ -250,7 +248,6 @@ void DepsgraphRelationBuilder::build_splineik_pose(Object *ob,
 		add_relation(target_key, pose_key, "[Curve.Path -> Spline IK] DepsRel");
 	}
 
-	pchan->flag |= POSE_DONE;
 	OperationKey final_transforms_key(&ob->id, DEG_NODE_TYPE_BONE, pchan->name, DEG_OPCODE_BONE_DONE);
 	add_relation(solver_key, final_transforms_key, "Spline IK Result");
 
@@ -274,8 +271,6 @@ void DepsgraphRelationBuilder::build_splineik_pose(Object *ob,
 			OperationKey done_key(&ob->id, DEG_NODE_TYPE_BONE, parchan->name, DEG_OPCODE_BONE_DONE);
 			add_relation(solver_key, done_key, "IK Chain Result");
 		}
-		parchan->flag |= POSE_DONE;
-
 		OperationKey final_transforms_key(&ob->id, DEG_NODE_TYPE_BONE, parchan->name, DEG_OPCODE_BONE_DONE);
 		add_relation(solver_key, final_transforms_key, "Spline IK Solver Result");
 
@@ -379,7 +374,6 @@ void DepsgraphRelationBuilder::build_rig(Main *bmain, Scene *scene, Object *ob)
 		OperationKey bone_pose_key(&ob->id, DEG_NODE_TYPE_BONE, pchan->name, DEG_OPCODE_BONE_POSE_PARENT);
 		OperationKey bone_ready_key(&ob->id, DEG_NODE_TYPE_BONE, pchan->name, DEG_OPCODE_BONE_READY);
 		OperationKey bone_done_key(&ob->id, DEG_NODE_TYPE_BONE, pchan->name, DEG_OPCODE_BONE_DONE);
-		pchan->flag &= ~POSE_DONE;
 		/* Pose init to bone local. */
 		add_relation(init_key, bone_local_key, "PoseEval Source-Bone Link");
 		/* Local to pose parenting operation. */
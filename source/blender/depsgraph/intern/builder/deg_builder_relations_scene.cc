@@ -40,12 +40,16 @@
 
 #include "BLI_utildefines.h"
 #include "BLI_blenlib.h"
+#include "BLI_ghash.h"
+#include "BLI_math_base.h"
+#include "BLI_task.h"
 
 extern "C" {
 #include "DNA_node_types.h"
 #include "DNA_object_types.h"
 #include "DNA_scene_types.h"
 
+#include "BKE_global.h"
 #include "BKE_layer.h"
 #include "BKE_main.h"
 #include "BKE_node.h"
@@ -68,25 +72,46 @@ extern "C" {
 
 namespace DEG {
 
+/* Number of objects which relations are built by a single task. Objects are
+ * split into chunks of fixed size, so the resulting graph does not depend on
+ * the number of threads.
+ */
+#define BUILD_OBJECTS_CHUNK_SIZE 64
+
+namespace {
+
+struct BuildObjectsData {
+	Main *bmain;
+	Scene *scene;
+	const vector<Object *> *objects;
+	vector<DepsgraphRelationBuilder *> *builders;
+};
+
+}  /* namespace */
+
 void DepsgraphRelationBuilder::build_scene(Main *bmain, Scene *scene)
 {
 	if (scene->set) {
 		build_scene(bmain, scene->set);
 	}
 
+	OwnerScope owner_scope(this, &scene->id);
+
 	/* XXX store scene to access from DAG_get_scene */
 	m_graph->bmain = bmain;
 	m_graph->scene = scene;
 
 	/* scene objects */
+	vector<Object *> objects;
 	for (SceneLayer *sl = (SceneLayer *)scene->render_layers.first; sl; sl = sl->next) {
 		for (Base *base = (Base *)sl->object_bases.first; base; base = base->next) {
-			build_object(bmain, scene, base->object);
+			objects.push_back(base->object);
 		}
 	}
 	if (scene->camera != NULL) {
-		build_object(bmain, scene, scene->camera);
+		objects.push_back(scene->camera);
 	}
+	build_objects(bmain, scene, objects);
 
 	/* rigidbody */
 	if (scene->rigidbody_world) {
@@ -126,6 +151,118 @@ void DepsgraphRelationBuilder::build_scene(Main *bmain, Scene *scene)
 	/* Collections. */
 	build_scene_layer_collections(scene);
 
+	flush_customdata_masks();
+}
+
+/* Build relations of the objects, using a builder per chunk of objects when
+ * there are enough of them.
+ *
+ * Builders running on worker threads don't touch the graph nor LIB_TAG_DOIT,
+ * they collect relations and IDs they built instead. Those are applied to the
+ * graph afterwards in the order of the chunks. IDs which are used by several
+ * chunks get their relations built by each of them, only relations from the
+ * first chunk are kept.
+ */
+void DepsgraphRelationBuilder::build_objects(Main *bmain,
+                                             Scene *scene,
+                                             const vector<Object *> &objects)
+{
+	const int num_chunks = (objects.size() + BUILD_OBJECTS_CHUNK_SIZE - 1) /
+	                       BUILD_OBJECTS_CHUNK_SIZE;
+	if (num_chunks < 2 ||
+	    m_built_ids != NULL ||
+	    (G.debug & G_DEBUG_DEPSGRAPH_NO_THREADS))
+	{
+		foreach (Object *object, objects) {
+			build_object(bmain, scene, object);
+		}
+		return;
+	}
+
+	vector<DepsgraphRelationBuilder *> builders;
+	for (int i = 0; i < num_chunks; ++i) {
+		builders.push_back(OBJECT_GUARDED_NEW(DepsgraphRelationBuilder, m_graph));
+	}
+	BuildObjectsData data;
+	data.bmain = bmain;
+	data.scene = scene;
+	data.objects = &objects;
+	data.builders = &builders;
+	BLI_task_parallel_range(0, num_chunks, &data, build_objects_task, true);
+
+	GSet *built_ids = BLI_gset_ptr_new("Depsgraph built ids");
+	foreach (DepsgraphRelationBuilder *builder, builders) {
+		builder->end_deferred_build(built_ids);
+		OBJECT_GUARDED_DELETE(builder, DepsgraphRelationBuilder);
+	}
+	GSET_FOREACH_BEGIN(ID *, id, built_ids)
+	{
+		id_tag_built(id);
+	}
+	GSET_FOREACH_END();
+	BLI_gset_free(built_ids, NULL);
+}
+
+void DepsgraphRelationBuilder::build_objects_task(void *userdata, int chunk)
+{
+	BuildObjectsData *data = (BuildObjectsData *)userdata;
+	DepsgraphRelationBuilder *builder = (*data->builders)[chunk];
+	const int start = chunk * BUILD_OBJECTS_CHUNK_SIZE;
+	const int end = min_ii((int)data->objects->size(),
+	                       start + BUILD_OBJECTS_CHUNK_SIZE);
+	builder->begin_deferred_build();
+	for (int i = start; i < end; ++i) {
+		builder->build_object(data->bmain, data->scene, (*data->objects)[i]);
+	}
+}
+
+void DepsgraphRelationBuilder::begin_deferred_build()
+{
+	BLI_assert(m_built_ids == NULL);
+	m_built_ids = BLI_gset_ptr_new("Depsgraph deferred built ids");
+}
+
+/* Apply the collected changes to the graph, skipping relations of IDs which
+ * are already in built_ids, and add IDs built by this builder to built_ids.
+ */
+void DepsgraphRelationBuilder::end_deferred_build(GSet *built_ids)
+{
+	BLI_assert(m_built_ids != NULL);
+	foreach (const DeferredRelation &deferred, m_deferred_relations) {
+		if (deferred.from == NULL) {
+			((OperationDepsNode *)deferred.to)->customdata_mask |= deferred.customdata_mask;
+			continue;
+		}
+		if (deferred.owner_id != NULL &&
+		    BLI_gset_haskey(built_ids, deferred.owner_id))
+		{
+			continue;
+		}
+		DepsRelation *rel;
+		if (deferred.from->type == DEG_NODE_TYPE_OPERATION) {
+			rel = m_graph->add_new_relation((OperationDepsNode *)deferred.from,
+			                                (OperationDepsNode *)deferred.to,
+			                                deferred.description);
+		}
+		else {
+			rel = m_graph->add_new_relation(deferred.from,
+			                                deferred.to,
+			                                deferred.description);
+		}
+		rel->owner_id = deferred.owner_id;
+	}
+	m_deferred_relations.clear();
+	GSET_FOREACH_BEGIN(ID *, id, m_built_ids)
+	{
+		BLI_gset_add(built_ids, id);
+	}
+	GSET_FOREACH_END();
+	BLI_gset_free(m_built_ids, NULL);
+	m_built_ids = NULL;
+}
+
+void DepsgraphRelationBuilder::flush_customdata_masks()
+{
 	/* TODO(sergey): Do this flush on CoW object? */
 	for (Depsgraph::OperationNodes::const_iterator it_op = m_graph->operations.begin();
 	     it_op != m_graph->operations.end();
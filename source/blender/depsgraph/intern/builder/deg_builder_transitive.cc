@@ -37,6 +37,7 @@
 #include "intern/nodes/deg_node_operation.h"
 
 #include "intern/depsgraph.h"
+#include "intern/depsgraph_types.h"
 
 #include "util/deg_util_foreach.h"
 
@@ -77,43 +78,82 @@ static void deg_graph_tag_paths_recursive(DepsNode *node)
 	}
 }
 
+static void deg_graph_transitive_reduction_target(Depsgraph *graph,
+                                                  OperationDepsNode *target)
+{
+	/* Clear tags. */
+	foreach (OperationDepsNode *node, graph->operations) {
+		node->done = 0;
+	}
+
+	/* mark nodes from which we can reach the target
+	 * start with children, so the target node and direct children are not
+	 * flagged.
+	 */
+	target->done |= OP_VISITED;
+	foreach (DepsRelation *rel, target->inlinks) {
+		deg_graph_tag_paths_recursive(rel->from);
+	}
+
+	/* Remove redundant paths to the target. */
+	for (size_t i = 0; i < target->inlinks.size(); ) {
+		DepsRelation *rel = target->inlinks[i];
+		if (rel->from->type == DEG_NODE_TYPE_TIMESOURCE) {
+			/* HACK: time source nodes don't get "done" flag set/cleared. */
+			/* TODO: there will be other types in future, so iterators above
+			 * need modifying.
+			 */
+			++i;
+		}
+		else if (rel->from->done & OP_REACHABLE) {
+			/* Keep the relation aside, so it can be restored when relations
+			 * of individual IDs are rebuilt.
+			 */
+			rel->unlink();
+			graph->transitive_relations.push_back(rel);
+		}
+		else {
+			++i;
+		}
+	}
+}
+
 void deg_graph_transitive_reduction(Depsgraph *graph)
 {
 	foreach (OperationDepsNode *target, graph->operations) {
-		/* Clear tags. */
-		foreach (OperationDepsNode *node, graph->operations) {
-			node->done = 0;
-		}
+		deg_graph_transitive_reduction_target(graph, target);
+	}
+}
 
-		/* mark nodes from which we can reach the target
-		 * start with children, so the target node and direct children are not
-		 * flagged.
-		 */
-		target->done |= OP_VISITED;
-		foreach (DepsRelation *rel, target->inlinks) {
-			deg_graph_tag_paths_recursive(rel->from);
+void deg_graph_transitive_relations_restore(Depsgraph *graph,
+                                            const vector<OperationDepsNode *> &targets)
+{
+	foreach (OperationDepsNode *node, graph->operations) {
+		node->tag = 0;
+	}
+	foreach (OperationDepsNode *target, targets) {
+		target->tag = 1;
+	}
+	vector<DepsRelation *> transitive_relations;
+	transitive_relations.swap(graph->transitive_relations);
+	foreach (DepsRelation *rel, transitive_relations) {
+		if (rel->to->type == DEG_NODE_TYPE_OPERATION && rel->to->tag == 1) {
+			rel->flag &= ~DEPSREL_FLAG_CYCLIC;
+			rel->from->outlinks.push_back(rel);
+			rel->to->inlinks.push_back(rel);
 		}
-
-		/* Remove redundant paths to the target. */
-		for (DepsNode::Relations::const_iterator it_rel = target->inlinks.begin();
-		     it_rel != target->inlinks.end();
-		     )
-		{
-			DepsRelation *rel = *it_rel;
-			/* Increment in advance, so we can safely remove the relation. */
-			++it_rel;
-
-			if (rel->from->type == DEG_NODE_TYPE_TIMESOURCE) {
-				/* HACK: time source nodes don't get "done" flag set/cleared. */
-				/* TODO: there will be other types in future, so iterators above
-				 * need modifying.
-				 */
-			}
-			else if (rel->from->done & OP_REACHABLE) {
-				OBJECT_GUARDED_DELETE(rel, DepsRelation);
-			}
+		else {
+			graph->transitive_relations.push_back(rel);
 		}
 	}
 }
 
+void deg_graph_transitive_reduction_update(Depsgraph *graph,
+                                           const vector<OperationDepsNode *> &targets)
+{
+	foreach (OperationDepsNode *target, targets) {
+		deg_graph_transitive_reduction_target(graph, target);
+	}
+}
+
 }  // namespace DEG
@@ -30,11 +30,26 @@
 
 #pragma once
 
+#include "intern/depsgraph_types.h"
+
 namespace DEG {
 
 struct Depsgraph;
+struct OperationDepsNode;
 
 /* Performs a transitive reduction to remove redundant relations. */
 void deg_graph_transitive_reduction(Depsgraph *graph);
 
+/* Put back relations removed by the reduction which lead to the given
+ * operations, the paths which made them redundant might have changed.
+ */
+void deg_graph_transitive_relations_restore(Depsgraph *graph,
+                                            const vector<OperationDepsNode *> &targets);
+
+/* Same as deg_graph_transitive_reduction(), but only for relations leading to
+ * the given operations, used when relations of individual IDs were rebuilt.
+ */
+void deg_graph_transitive_reduction_update(Depsgraph *graph,
+                                           const vector<OperationDepsNode *> &targets);
+
 }  // namespace DEG
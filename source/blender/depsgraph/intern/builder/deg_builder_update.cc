@@ -0,0 +1,342 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2017 Blender Foundation.
+ * All rights reserved.
+ *
+ * Contributor(s): None Yet
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/depsgraph/intern/builder/deg_builder_update.cc
+ *  \ingroup depsgraph
+ *
+ * Partial rebuild of the graph for the IDs which relations were tagged for
+ * update.
+ *
+ * Nodes of the tagged IDs are rebuilt from scratch. Relations are rebuilt for
+ * the tagged IDs and for all IDs which added relations to the nodes of the
+ * tagged IDs, since those relations are removed together with the nodes.
+ * Which ID added a relation is stored in DepsRelation::owner_id by the
+ * relation builder.
+ */
+
+#include "intern/builder/deg_builder_update.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_ghash.h"
+
+extern "C" {
+#include "DNA_ID.h"
+#include "DNA_object_types.h"
+#include "DNA_scene_types.h"
+
+#include "BKE_global.h"
+} /* extern "C" */
+
+#include "DEG_depsgraph.h"
+
+#include "intern/builder/deg_builder_cycle.h"
+#include "intern/builder/deg_builder_nodes.h"
+#include "intern/builder/deg_builder_relations.h"
+#include "intern/builder/deg_builder_transitive.h"
+#include "intern/nodes/deg_node.h"
+#include "intern/nodes/deg_node_component.h"
+#include "intern/nodes/deg_node_operation.h"
+#include "intern/depsgraph.h"
+#include "intern/depsgraph_intern.h"
+#include "intern/depsgraph_types.h"
+
+#include "util/deg_util_foreach.h"
+
+namespace DEG {
+
+namespace {
+
+bool node_is_in_ids(const DepsNode *node, GSet *ids)
+{
+	if (node->type != DEG_NODE_TYPE_OPERATION) {
+		/* Time source. */
+		return false;
+	}
+	const OperationDepsNode *op_node = (const OperationDepsNode *)node;
+	return BLI_gset_haskey(ids, op_node->owner->owner->id_orig);
+}
+
+bool add_owner_id(Depsgraph *graph, ID *owner_id, GSet *owner_ids)
+{
+	if (owner_id == NULL) {
+		/* Relation was not added by any of the ID build functions. */
+		return false;
+	}
+	if (BLI_gset_haskey(owner_ids, owner_id)) {
+		return true;
+	}
+	/* Only objects have their relations rebuilt individually, anything else
+	 * (the scene for example) is built in the context of the whole graph.
+	 */
+	if (GS(owner_id->name) != ID_OB || graph->find_id_node(owner_id) == NULL) {
+		return false;
+	}
+	BLI_gset_insert(owner_ids, owner_id);
+	return true;
+}
+
+bool add_owner_ids(Depsgraph *graph, IDDepsNode *id_node, GSet *owner_ids)
+{
+	GHASH_FOREACH_BEGIN(ComponentDepsNode *, comp_node, id_node->components)
+	{
+		foreach (OperationDepsNode *op_node, comp_node->operations) {
+			foreach (DepsRelation *rel, op_node->inlinks) {
+				if (!add_owner_id(graph, rel->owner_id, owner_ids)) {
+					return false;
+				}
+			}
+			foreach (DepsRelation *rel, op_node->outlinks) {
+				if (!add_owner_id(graph, rel->owner_id, owner_ids)) {
+					return false;
+				}
+			}
+		}
+	}
+	GHASH_FOREACH_END();
+	return true;
+}
+
+bool relation_is_rebuilt(const DepsRelation *rel, GSet *ids, GSet *owner_ids)
+{
+	return BLI_gset_haskey(owner_ids, rel->owner_id) ||
+	       node_is_in_ids(rel->from, ids) ||
+	       node_is_in_ids(rel->to, ids);
+}
+
+/* Remove relations which are going to be rebuilt, the targets of the removed
+ * relations which stay in the graph are added to the seeds.
+ */
+void remove_relations(Depsgraph *graph,
+                      GSet *ids,
+                      GSet *owner_ids,
+                      vector<OperationDepsNode *> *seeds)
+{
+	vector<DepsRelation *> relations;
+	foreach (OperationDepsNode *op_node, graph->operations) {
+		foreach (DepsRelation *rel, op_node->inlinks) {
+			if (relation_is_rebuilt(rel, ids, owner_ids)) {
+				relations.push_back(rel);
+			}
+		}
+	}
+	foreach (DepsRelation *rel, relations) {
+		if (!node_is_in_ids(rel->to, ids)) {
+			seeds->push_back((OperationDepsNode *)rel->to);
+		}
+		rel->unlink();
+		OBJECT_GUARDED_DELETE(rel, DepsRelation);
+	}
+
+	/* Relations kept aside by transitive reduction. */
+	vector<DepsRelation *> transitive_relations;
+	transitive_relations.swap(graph->transitive_relations);
+	foreach (DepsRelation *rel, transitive_relations) {
+		if (relation_is_rebuilt(rel, ids, owner_ids)) {
+			OBJECT_GUARDED_DELETE(rel, DepsRelation);
+		}
+		else {
+			graph->transitive_relations.push_back(rel);
+		}
+	}
+}
+
+/* All operations reachable from the seeds, cycles and redundant relations can
+ * only change there.
+ */
+void collect_affected_operations(Depsgraph *graph,
+                                 const vector<OperationDepsNode *> &seeds,
+                                 vector<OperationDepsNode *> *r_operations)
+{
+	foreach (OperationDepsNode *op_node, graph->operations) {
+		op_node->done = 0;
+	}
+	vector<OperationDepsNode *> stack(seeds);
+	while (!stack.empty()) {
+		OperationDepsNode *op_node = stack.back();
+		stack.pop_back();
+		if (op_node->done) {
+			continue;
+		}
+		op_node->done = 1;
+		r_operations->push_back(op_node);
+		foreach (DepsRelation *rel, op_node->outlinks) {
+			if (rel->to->type == DEG_NODE_TYPE_OPERATION && !rel->to->done) {
+				stack.push_back((OperationDepsNode *)rel->to);
+			}
+		}
+	}
+}
+
+}  /* namespace */
+
+bool deg_graph_update_tagged_relations(Depsgraph *graph,
+                                       Main *bmain,
+                                       Scene *scene)
+{
+	if (scene->set != NULL) {
+		/* Objects of the background set are built in the context of their
+		 * own scene.
+		 */
+		return false;
+	}
+
+	/* Collect ID nodes to be rebuilt and IDs which relations are affected. */
+	vector<ID *> ids_vector;
+	vector<IDDepsNode *> id_nodes;
+	GSet *ids = BLI_gset_ptr_new("Depsgraph update ids");
+	GSet *owner_ids = BLI_gset_ptr_new("Depsgraph update owner ids");
+	bool is_partial = true;
+	GSET_FOREACH_BEGIN(ID *, id, graph->id_relations_tags)
+	{
+		IDDepsNode *id_node = graph->find_id_node(id);
+		if (id_node == NULL || GS(id->name) != ID_OB) {
+			is_partial = false;
+			break;
+		}
+		ids_vector.push_back(id);
+		id_nodes.push_back(id_node);
+		BLI_gset_insert(ids, id);
+		BLI_gset_insert(owner_ids, id);
+	}
+	GSET_FOREACH_END();
+	if (is_partial) {
+		foreach (IDDepsNode *id_node, id_nodes) {
+			if (!add_owner_ids(graph, id_node, owner_ids)) {
+				is_partial = false;
+				break;
+			}
+		}
+	}
+	if (!is_partial) {
+		BLI_gset_free(ids, NULL);
+		BLI_gset_free(owner_ids, NULL);
+		return false;
+	}
+
+	DEG_DEBUG_PRINTF("%s: Rebuilding %d ID nodes, relations of %d IDs.\n",
+	                 __func__, (int)id_nodes.size(), (int)BLI_gset_size(owner_ids));
+
+	graph->clear_time_operations();
+	graph->clear_timings();
+
+	/* 1) Remove relations which are to be rebuilt. Operations which are left
+	 *    in the graph and lose relations are used to find the part of the
+	 *    graph where cycles might have changed.
+	 */
+	vector<OperationDepsNode *> seeds;
+	remove_relations(graph, ids, owner_ids, &seeds);
+
+	/* 2) Replace nodes of the tagged IDs. */
+	DepsgraphNodeBuilder node_builder(bmain, graph);
+	node_builder.begin_update(bmain, id_nodes);
+	id_nodes.clear();
+	GSet *kept_ids = BLI_gset_ptr_new("Depsgraph update kept ids");
+	GHASH_FOREACH_BEGIN(IDDepsNode *, id_node, graph->id_hash)
+	{
+		BLI_gset_insert(kept_ids, id_node->id_orig);
+	}
+	GHASH_FOREACH_END();
+	foreach (ID *id, ids_vector) {
+		node_builder.build_object(scene, (Object *)id);
+	}
+
+	/* 3) Rebuild relations of the affected IDs and of the IDs which nodes
+	 *    were created by the node builder.
+	 */
+	DepsgraphRelationBuilder relation_builder(graph);
+	relation_builder.begin_build(bmain);
+	GHASH_FOREACH_BEGIN(IDDepsNode *, id_node, graph->id_hash)
+	{
+		ID *id = id_node->id_orig;
+		if (BLI_gset_haskey(kept_ids, id) && !BLI_gset_haskey(owner_ids, id)) {
+			id->tag |= LIB_TAG_DOIT;
+		}
+	}
+	GHASH_FOREACH_END();
+	GSET_FOREACH_BEGIN(ID *, id, owner_ids)
+	{
+		relation_builder.build_object(bmain, scene, (Object *)id);
+	}
+	GSET_FOREACH_END();
+#ifdef WITH_COPY_ON_WRITE
+	GHASH_FOREACH_BEGIN(IDDepsNode *, id_node, graph->id_hash)
+	{
+		ID *id = id_node->id_orig;
+		if (!BLI_gset_haskey(kept_ids, id) || BLI_gset_haskey(owner_ids, id)) {
+			relation_builder.build_copy_on_write_relations(id_node);
+		}
+	}
+	GHASH_FOREACH_END();
+#endif
+	relation_builder.flush_customdata_masks();
+
+	/* 4) Detect cycles and remove redundant relations, only in the part of
+	 *    the graph reachable from the changed relations.
+	 */
+	foreach (OperationDepsNode *op_node, graph->operations) {
+		if (!BLI_gset_haskey(kept_ids, op_node->owner->owner->id_orig)) {
+			seeds.push_back(op_node);
+			continue;
+		}
+		foreach (DepsRelation *rel, op_node->inlinks) {
+			if (!BLI_gset_haskey(kept_ids, rel->owner_id) ||
+			    BLI_gset_haskey(owner_ids, rel->owner_id))
+			{
+				seeds.push_back(op_node);
+				break;
+			}
+		}
+	}
+	vector<OperationDepsNode *> affected_operations;
+	collect_affected_operations(graph, seeds, &affected_operations);
+
+	deg_graph_transitive_relations_restore(graph, affected_operations);
+	deg_graph_detect_cycles_update(graph, affected_operations);
+	if (G.debug_value == 799) {
+		deg_graph_transitive_reduction_update(graph, affected_operations);
+	}
+
+	/* 5) Finalize new nodes, and make sure they are evaluated. */
+	GHASH_FOREACH_BEGIN(IDDepsNode *, id_node, graph->id_hash)
+	{
+		id_node->finalize_build(graph);
+		if (!BLI_gset_haskey(kept_ids, id_node->id_orig)) {
+			id_node->tag_update(graph);
+#ifdef WITH_COPY_ON_WRITE
+			DEG_id_tag_update_ex(graph->bmain, id_node->id_orig, DEG_TAG_COPY_ON_WRITE);
+#endif
+		}
+	}
+	GHASH_FOREACH_END();
+
+	BLI_gset_free(ids, NULL);
+	BLI_gset_free(owner_ids, NULL);
+	BLI_gset_free(kept_ids, NULL);
+	return true;
+}
+
+}  // namespace DEG
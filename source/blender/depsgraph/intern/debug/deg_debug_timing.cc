@@ -0,0 +1,154 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2017 Blender Foundation.
+ * All rights reserved.
+ *
+ * Contributor(s): None Yet
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/depsgraph/intern/debug/deg_debug_timing.cc
+ *  \ingroup depsgraph
+ *
+ * Access to timings of the operations evaluated by the last evaluation.
+ */
+
+#include "BLI_utildefines.h"
+#include "BLI_string.h"
+
+extern "C" {
+#include "DNA_ID.h"
+}  /* extern "C" */
+
+#include "DEG_depsgraph.h"
+#include "DEG_depsgraph_debug.h"
+
+#include "intern/nodes/deg_node.h"
+#include "intern/nodes/deg_node_component.h"
+#include "intern/nodes/deg_node_operation.h"
+#include "intern/depsgraph.h"
+#include "intern/depsgraph_intern.h"
+
+/* ****************** */
+/* Evaluation Timings */
+
+namespace DEG {
+
+static string timing_component_name(const ComponentDepsNode *comp_node)
+{
+	DepsNodeFactory *factory = deg_get_node_factory(comp_node->type);
+	const char *tname = factory->tname();
+	if (comp_node->name == tname) {
+		return comp_node->name;
+	}
+	return string(tname) + " | " + comp_node->name;
+}
+
+/* Write string as JSON string literal. */
+static void timing_write_json_string(FILE *stream, const char *str)
+{
+	fputc('"', stream);
+	for (const char *c = str; *c != '\0'; c++) {
+		if (*c == '"' || *c == '\\') {
+			fprintf(stream, "\\%c", *c);
+		}
+		else if ((unsigned char)*c < 0x20) {
+			fprintf(stream, "\\u%04x", (unsigned int)*c);
+		}
+		else {
+			fputc(*c, stream);
+		}
+	}
+	fputc('"', stream);
+}
+
+}  // namespace DEG
+
+void DEG_debug_timing_set_enabled(Depsgraph *graph, bool enabled)
+{
+	DEG::Depsgraph *deg_graph = reinterpret_cast<DEG::Depsgraph *>(graph);
+	deg_graph->use_timing = enabled;
+	if (!enabled) {
+		deg_graph->clear_timings();
+	}
+}
+
+bool DEG_debug_timing_is_enabled(const Depsgraph *graph)
+{
+	const DEG::Depsgraph *deg_graph = reinterpret_cast<const DEG::Depsgraph *>(graph);
+	return deg_graph->use_timing;
+}
+
+int DEG_debug_timing_num_operations(const Depsgraph *graph)
+{
+	const DEG::Depsgraph *deg_graph = reinterpret_cast<const DEG::Depsgraph *>(graph);
+	/* Counter is not clamped by the worker threads. */
+	const uint32_t num_timings = deg_graph->num_timings;
+	return (int)((num_timings < deg_graph->timings_size) ? num_timings : deg_graph->timings_size);
+}
+
+void DEG_debug_timing_get(const Depsgraph *graph,
+                          int index,
+                          DepsgraphOperationTiming *r_timing)
+{
+	const DEG::Depsgraph *deg_graph = reinterpret_cast<const DEG::Depsgraph *>(graph);
+	BLI_assert(index >= 0 && index < DEG_debug_timing_num_operations(graph));
+	const DEG::OperationTiming *timing = &deg_graph->timings[index];
+	const DEG::OperationDepsNode *op_node = timing->node;
+	const DEG::ComponentDepsNode *comp_node = op_node->owner;
+	BLI_strncpy(r_timing->id_name,
+	            comp_node->owner->id_orig->name,
+	            sizeof(r_timing->id_name));
+	BLI_strncpy(r_timing->component,
+	            DEG::timing_component_name(comp_node).c_str(),
+	            sizeof(r_timing->component));
+	BLI_strncpy(r_timing->operation,
+	            op_node->identifier().c_str(),
+	            sizeof(r_timing->operation));
+	r_timing->start_time = timing->start_time;
+	r_timing->end_time = timing->end_time;
+	r_timing->thread_id = timing->thread_id;
+}
+
+/* Complete events ("ph": "X") with timestamps in microseconds, one row per
+ * thread.
+ */
+void DEG_debug_timing_chrome_trace(const Depsgraph *graph, FILE *stream)
+{
+	const int num_operations = DEG_debug_timing_num_operations(graph);
+	fprintf(stream, "{\"traceEvents\": [\n");
+	for (int i = 0; i < num_operations; i++) {
+		DepsgraphOperationTiming timing;
+		DEG_debug_timing_get(graph, i, &timing);
+		char name[sizeof(timing.id_name) + sizeof(timing.operation) + 2];
+		BLI_snprintf(name, sizeof(name), "%s %s", timing.id_name + 2, timing.operation);
+		fprintf(stream, "  {\"name\": ");
+		DEG::timing_write_json_string(stream, name);
+		fprintf(stream, ", \"cat\": ");
+		DEG::timing_write_json_string(stream, timing.component);
+		fprintf(stream,
+		        ", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 0, \"tid\": %d, \"args\": {\"id\": ",
+		        timing.start_time * 1e6,
+		        (timing.end_time - timing.start_time) * 1e6,
+		        timing.thread_id);
+		DEG::timing_write_json_string(stream, timing.id_name);
+		fprintf(stream, "}}%s\n", (i != num_operations - 1) ? "," : "");
+	}
+	fprintf(stream, "],\n\"displayTimeUnit\": \"ms\"}\n");
+}
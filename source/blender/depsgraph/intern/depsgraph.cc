@@ -49,6 +49,7 @@ extern "C" {
 #include "RNA_access.h"
 }
 
+#include <algorithm>
 #include <cstring>
 
 #include "DEG_depsgraph.h"
@@ -70,18 +71,28 @@ static DEG_EditorUpdateScenePreCb deg_editor_update_scene_pre_cb = NULL;
 
 Depsgraph::Depsgraph()
   : time_source(NULL),
-    need_update(false)
+    need_update(false),
+    time_operations_valid(false),
+    use_timing(false),
+    timing_start(0.0),
+    timings(NULL),
+    num_timings(0),
+    timings_size(0)
 {
 	BLI_spin_init(&lock);
 	id_hash = BLI_ghash_ptr_new("Depsgraph id hash");
 	entry_tags = BLI_gset_ptr_new("Depsgraph entry_tags");
+	id_relations_tags = BLI_gset_ptr_new("Depsgraph id_relations_tags");
 }
 
 Depsgraph::~Depsgraph()
 {
+	clear_transitive_relations();
+	clear_timings();
 	clear_id_nodes();
 	BLI_ghash_free(id_hash, NULL, NULL);
 	BLI_gset_free(entry_tags, NULL);
+	BLI_gset_free(id_relations_tags, NULL);
 	if (time_source != NULL) {
 		OBJECT_GUARDED_DELETE(time_source, TimeSourceDepsNode);
 	}
@@ -375,7 +386,8 @@ DepsRelation::DepsRelation(DepsNode *from,
   : from(from),
     to(to),
     name(description),
-    flag(0)
+    flag(0),
+    owner_id(NULL)
 {
 #ifndef NDEBUG
 /*
@@ -419,6 +431,22 @@ DepsRelation::~DepsRelation()
 	BLI_assert(this->from && this->to);
 }
 
+static void relations_remove(DepsNode::Relations *relations, DepsRelation *rel)
+{
+	DepsNode::Relations::iterator it = std::find(relations->begin(),
+	                                             relations->end(),
+	                                             rel);
+	if (it != relations->end()) {
+		relations->erase(it);
+	}
+}
+
+void DepsRelation::unlink()
+{
+	relations_remove(&from->outlinks, this);
+	relations_remove(&to->inlinks, this);
+}
+
 /* Low level tagging -------------------------------------- */
 
 /* Tag a specific node as needing updates. */
@@ -434,8 +462,33 @@ void Depsgraph::add_entry_tag(OperationDepsNode *node)
 	BLI_gset_insert(entry_tags, node);
 }
 
+void Depsgraph::clear_transitive_relations()
+{
+	foreach (DepsRelation *rel, transitive_relations) {
+		OBJECT_GUARDED_DELETE(rel, DepsRelation);
+	}
+	transitive_relations.clear();
+}
+
+void Depsgraph::clear_time_operations()
+{
+	time_operations.clear();
+	time_components.clear();
+	time_operations_valid = false;
+}
+
+void Depsgraph::clear_timings()
+{
+	MEM_SAFE_FREE(timings);
+	num_timings = 0;
+	timings_size = 0;
+}
+
 void Depsgraph::clear_all_nodes()
 {
+	clear_transitive_relations();
+	clear_time_operations();
+	clear_timings();
 	clear_id_nodes();
 	BLI_ghash_clear(id_hash, NULL, NULL);
 	if (time_source != NULL) {
@@ -81,11 +81,32 @@ struct DepsRelation {
 
 	int flag;                     /* (eDepsRelation_Flag) */
 
+	/* ID which builder added the relation, used to know which relations to
+	 * remove when relations of individual IDs are rebuilt.
+	 */
+	ID *owner_id;
+
 	DepsRelation(DepsNode *from,
 	             DepsNode *to,
 	             const char *description);
 
 	~DepsRelation();
+
+	/* Remove relation from the nodes it connects. */
+	void unlink();
+};
+
+/* ****************** */
+/* Evaluation Timings */
+
+/* Operation evaluated by the last evaluation of the graph. */
+struct OperationTiming {
+	OperationDepsNode *node;
+	/* Seconds, relative to the start of the evaluation. */
+	double start_time;
+	double end_time;
+	/* Task scheduler thread which evaluated the operation. */
+	int thread_id;
 };
 
 /* ********* */
@@ -132,6 +153,15 @@ struct Depsgraph {
 	/* Clear storage used by all nodes. */
 	void clear_all_nodes();
 
+	/* Clear relations removed by transitive reduction. */
+	void clear_transitive_relations();
+
+	/* Forget operations cached for frame change updates. */
+	void clear_time_operations();
+
+	/* Free timings of the last evaluation, see use_timing. */
+	void clear_timings();
+
 	/* Copy-on-Write Functionality ........ */
 
 	/* For given original ID get ID which is created by CoW system. */
@@ -149,6 +179,17 @@ struct Depsgraph {
 	/* Indicates whether relations needs to be updated. */
 	bool need_update;
 
+	/* IDs which relations are to be rebuilt, when the whole graph does not
+	 * need update (see DEG_id_relations_tag_update()).
+	 */
+	GSet *id_relations_tags;
+
+	/* Relations removed by transitive reduction. They are kept aside so they
+	 * can be restored when relations of individual IDs are rebuilt and the
+	 * paths which made them redundant are changed.
+	 */
+	vector<DepsRelation *> transitive_relations;
+
 	/* Quick-Access Temp Data ............. */
 
 	/* Nodes which have been tagged as "directly modified". */
@@ -160,6 +201,24 @@ struct Depsgraph {
 	/* All operation nodes, sorted in order of single-thread traversal order. */
 	OperationNodes operations;
 
+	/* Operations and components which are tagged for update by a frame change
+	 * when nothing else is tagged, see deg_graph_flush_time_updates().
+	 * Filled in by the first such frame change after the graph was built.
+	 */
+	OperationNodes time_operations;
+	vector<ComponentDepsNode *> time_components;
+	bool time_operations_valid;
+
+	/* Per-operation timings of the last evaluation, only recorded when
+	 * use_timing is set (see DEG_debug_timing_set_enabled()). Filled in by
+	 * the worker threads, num_timings is incremented atomically.
+	 */
+	bool use_timing;
+	double timing_start;
+	OperationTiming *timings;
+	uint32_t num_timings;
+	uint32_t timings_size;
+
 	/* Spin lock for threading-critical operations.
 	 * Mainly used by graph evaluation.
 	 */
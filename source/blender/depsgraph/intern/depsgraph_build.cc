@@ -37,6 +37,8 @@
 #include "BLI_utildefines.h"
 #include "BLI_ghash.h"
 
+#include "atomic_ops.h"
+
 #ifdef DEBUG_TIME
 #  include "PIL_time.h"
 #  include "PIL_time_utildefines.h"
@@ -63,6 +65,7 @@ extern "C" {
 #include "builder/deg_builder_nodes.h"
 #include "builder/deg_builder_relations.h"
 #include "builder/deg_builder_transitive.h"
+#include "builder/deg_builder_update.h"
 
 #include "intern/nodes/deg_node.h"
 #include "intern/nodes/deg_node_component.h"
@@ -185,7 +188,8 @@ void DEG_add_special_eval_flag(Depsgraph *graph, ID *id, short flag)
 		BLI_assert(!"ID should always be valid");
 		return;
 	}
-	id_node->eval_flags |= flag;
+	/* Modifiers request flags while relations are built on multiple threads. */
+	atomic_fetch_and_or_uint32((uint32_t *)&id_node->eval_flags, flag);
 }
 
 /* ******************** */
@@ -205,6 +209,9 @@ void DEG_graph_build_from_scene(Depsgraph *graph, Main *bmain, Scene *scene)
 
 	DEG::Depsgraph *deg_graph = reinterpret_cast<DEG::Depsgraph *>(graph);
 
+	/* Whole graph is rebuilt, partial updates are not needed anymore. */
+	BLI_gset_clear(deg_graph->id_relations_tags, NULL);
+
 	/* 1) Generate all the nodes in the graph first */
 	DEG::DepsgraphNodeBuilder node_builder(bmain, deg_graph);
 	node_builder.begin_build(bmain);
@@ -268,6 +275,39 @@ void DEG_relations_tag_update(Main *bmain)
 	}
 }
 
+/* Tag relations of the given ID for update.
+ *
+ * Only nodes and relations of this ID and relations of IDs which depend on it
+ * are rebuilt when possible, otherwise the whole graph is tagged for update.
+ */
+void DEG_id_relations_tag_update(Main *bmain, ID *id)
+{
+	DEG_DEBUG_PRINTF("%s: Tagging relations of %s for update.\n",
+	                 __func__, id->name);
+	for (Scene *scene = (Scene *)bmain->scene.first;
+	     scene != NULL;
+	     scene = (Scene *)scene->id.next)
+	{
+		if (scene->depsgraph_legacy == NULL) {
+			continue;
+		}
+		DEG::Depsgraph *graph =
+		        reinterpret_cast<DEG::Depsgraph *>(scene->depsgraph_legacy);
+		if (graph->need_update) {
+			/* Whole graph is to be rebuilt anyway. */
+			continue;
+		}
+		if (GS(id->name) != ID_OB || graph->find_id_node(id) == NULL) {
+			/* Only objects which are already in the graph can be updated
+			 * partially.
+			 */
+			graph->need_update = true;
+			continue;
+		}
+		BLI_gset_add(graph->id_relations_tags, id);
+	}
+}
+
 /* Create new graph if didn't exist yet,
  * or update relations if graph was tagged for update.
  */
@@ -282,8 +322,17 @@ void DEG_scene_relations_update(Main *bmain, Scene *scene)
 
 	DEG::Depsgraph *graph = reinterpret_cast<DEG::Depsgraph *>(scene->depsgraph_legacy);
 	if (!graph->need_update) {
-		/* Graph is up to date, nothing to do. */
-		return;
+		if (BLI_gset_size(graph->id_relations_tags) == 0) {
+			/* Graph is up to date, nothing to do. */
+			return;
+		}
+		/* Try to only rebuild the tagged IDs. */
+		const bool updated =
+		        DEG::deg_graph_update_tagged_relations(graph, bmain, scene);
+		BLI_gset_clear(graph->id_relations_tags, NULL);
+		if (updated) {
+			return;
+		}
 	}
 
 	/* Build new nodes and relations. */
@@ -49,9 +49,6 @@ extern "C" {
 
 #include "intern/depsgraph.h"
 
-/* Unfinished and unused, and takes quite some pre-processing time. */
-#undef USE_EVAL_PRIORITY
-
 /* ****************** */
 /* Evaluation Context */
 
@@ -114,12 +111,53 @@ void DEG_evaluate_on_framechange(EvaluationContext *eval_ctx,
 	/* Update time on primary timesource. */
 	DEG::TimeSourceDepsNode *tsrc = deg_graph->find_time_source();
 	tsrc->cfra = ctime;
+	const bool only_time_changed = (BLI_gset_size(deg_graph->entry_tags) == 0);
 	tsrc->tag_update(deg_graph);
+	if (only_time_changed) {
+		/* Only operations which depend on time are to be updated, no need
+		 * to traverse the whole graph.
+		 */
+		DEG::deg_graph_flush_time_updates(bmain, deg_graph);
+		DEG::deg_evaluate_time_operations(eval_ctx, deg_graph);
+		return;
+	}
 	DEG::deg_graph_flush_updates(bmain, deg_graph);
 	/* Perform recalculation updates. */
 	DEG::deg_evaluate_on_refresh(eval_ctx, deg_graph);
 }
 
+/* Frame-change happened for several graphs of the same scene, each of them
+ * is evaluated at its own frame.
+ */
+void DEG_evaluate_on_framechange_multi(EvaluationContext **eval_ctx,
+                                       Main *bmain,
+                                       Depsgraph **graphs,
+                                       const float *ctime,
+                                       int num_graphs)
+{
+#ifdef WITH_COPY_ON_WRITE
+	DEG::Depsgraph **deg_graphs = reinterpret_cast<DEG::Depsgraph **>(graphs);
+	/* Flushing tags original datablocks and informs editors, so it's done
+	 * for one graph after another.
+	 */
+	for (int i = 0; i < num_graphs; i++) {
+		DEG::TimeSourceDepsNode *tsrc = deg_graphs[i]->find_time_source();
+		tsrc->cfra = ctime[i];
+		tsrc->tag_update(deg_graphs[i]);
+		DEG::deg_graph_flush_updates(bmain, deg_graphs[i]);
+	}
+	/* Every graph evaluates into its own copy of datablocks. */
+	DEG::deg_evaluate_on_refresh_multi(eval_ctx, deg_graphs, num_graphs);
+#else
+	/* All graphs evaluate into the original datablocks, can't be done
+	 * concurrently.
+	 */
+	for (int i = 0; i < num_graphs; i++) {
+		DEG_evaluate_on_framechange(eval_ctx[i], bmain, graphs[i], ctime[i]);
+	}
+#endif
+}
+
 bool DEG_needs_eval(Depsgraph *graph)
 {
 	DEG::Depsgraph *deg_graph = reinterpret_cast<DEG::Depsgraph *>(graph);
@@ -33,11 +33,14 @@
 #include "MEM_guardedalloc.h"
 
 extern "C" {
+#include "BLI_ghash.h"
+#include "BLI_listbase.h"
 #include "BLI_math.h"
 #include "BKE_anim.h"
 #include "BKE_idcode.h"
 #include "BKE_layer.h"
 #include "BKE_main.h"
+#include "BKE_pointcache.h"
 } /* extern "C" */
 
 #include "DNA_object_types.h"
@@ -81,6 +84,30 @@ short DEG_get_eval_flags_for_id(Depsgraph *graph, ID *id)
 	return id_node->eval_flags;
 }
 
+bool DEG_graph_is_frame_independent(Depsgraph *graph)
+{
+	DEG::Depsgraph *deg_graph = reinterpret_cast<DEG::Depsgraph *>(graph);
+	Scene *scene = deg_graph->scene;
+	if (scene != NULL && scene->rigidbody_world != NULL) {
+		return false;
+	}
+	GHASH_FOREACH_BEGIN(DEG::IDDepsNode *, id_node, deg_graph->id_hash)
+	{
+		if (GS(id_node->id_orig->name) != ID_OB) {
+			continue;
+		}
+		ListBase pidlist;
+		BKE_ptcache_ids_from_object(&pidlist, (Object *)id_node->id_orig, scene, 0);
+		const bool has_cache = !BLI_listbase_is_empty(&pidlist);
+		BLI_freelistN(&pidlist);
+		if (has_cache) {
+			return false;
+		}
+	}
+	GHASH_FOREACH_END();
+	return true;
+}
+
 Scene *DEG_get_evaluated_scene(Depsgraph *graph)
 {
 	DEG::Depsgraph *deg_graph = reinterpret_cast<DEG::Depsgraph *>(graph);
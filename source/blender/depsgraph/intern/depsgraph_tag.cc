@@ -39,6 +39,7 @@
 #include "BLI_listbase.h"
 
 extern "C" {
+#include "DNA_key_types.h"
 #include "DNA_object_types.h"
 #include "DNA_particle_types.h"
 #include "DNA_screen_types.h"
@@ -46,6 +47,7 @@ extern "C" {
 
 
 #include "BKE_idcode.h"
+#include "BKE_key.h"
 #include "BKE_library.h"
 #include "BKE_main.h"
 #include "BKE_node.h"
@@ -266,6 +268,21 @@ void id_tag_update_copy_on_write(Depsgraph *graph, IDDepsNode *id_node)
 	OperationDepsNode *cow_node = cow_comp->get_entry_operation();
 	cow_node->tag_update(graph);
 }
+
+/* Copy-on-write shape keys reference key-block data of the original ones,
+ * which is re-allocated together with the geometry of their owner.
+ */
+void id_tag_update_copy_on_write_key(Depsgraph *graph, ID *id)
+{
+	Key *key = BKE_key_from_id(id);
+	if (key == NULL) {
+		return;
+	}
+	IDDepsNode *key_node = graph->find_id_node(&key->id);
+	if (key_node != NULL) {
+		id_tag_update_copy_on_write(graph, key_node);
+	}
+}
 #endif
 
 void deg_graph_id_tag_update(Main *bmain, Depsgraph *graph, ID *id, int flag)
@@ -281,6 +298,9 @@ void deg_graph_id_tag_update(Main *bmain, Depsgraph *graph, ID *id, int flag)
 	/* Tag components based on flags. */
 	if (flag == 0) {
 		id_tag_update_special_zero_flag(graph, id_node);
+#ifdef WITH_COPY_ON_WRITE
+		id_tag_update_copy_on_write_key(graph, id);
+#endif
 		return;
 	}
 	if (flag & OB_RECALC_OB) {
@@ -311,6 +331,7 @@ void deg_graph_id_tag_update(Main *bmain, Depsgraph *graph, ID *id, int flag)
 #ifdef WITH_COPY_ON_WRITE
 	if (flag & DEG_TAG_COPY_ON_WRITE) {
 		id_tag_update_copy_on_write(graph, id_node);
+		id_tag_update_copy_on_write_key(graph, id);
 	}
 #endif
 }
@@ -375,6 +396,14 @@ void DEG_id_tag_update_ex(Main *bmain, ID *id, int flag)
 		return;
 	}
 	DEG_DEBUG_PRINTF("%s: id=%s flag=%d\n", __func__, id->name, flag);
+	/* The ID can't share its undo data with the previous undo step anymore. */
+	BKE_id_tag_set_atomic(id, LIB_TAG_UNDO_CHANGED);
+	if ((GS(id->name) == ID_OB) && (flag & OB_RECALC_DATA)) {
+		Object *object = (Object *)id;
+		if (object->data != NULL) {
+			BKE_id_tag_set_atomic((ID *)object->data, LIB_TAG_UNDO_CHANGED);
+		}
+	}
 	DEG::deg_id_tag_update(bmain, id, flag);
 }
 
@@ -32,11 +32,17 @@
 
 #include "intern/eval/deg_eval.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include "PIL_time.h"
 
+#include "MEM_guardedalloc.h"
+
 #include "BLI_utildefines.h"
 #include "BLI_task.h"
 #include "BLI_ghash.h"
+#include "BLI_trace.h"
 
 #include "DNA_object_types.h"
 
@@ -54,9 +60,6 @@
 #include "intern/depsgraph_intern.h"
 #include "util/deg_util_foreach.h"
 
-/* Unfinished and unused, and takes quite some pre-processing time. */
-#undef USE_EVAL_PRIORITY
-
 /* Use integrated debugger to keep track how much each of the nodes was
  * evaluating.
  */
@@ -67,17 +70,92 @@ namespace DEG {
 /* ********************** */
 /* Evaluation Entrypoints */
 
+/* Cost of operations which were never evaluated yet, in seconds. */
+#define DEG_EVAL_COST_DEFAULT 1e-6f
+
+/* Weight of the last measurement in the running average of operation costs. */
+#define DEG_EVAL_COST_FACTOR 0.25f
+
+/* Operations which became ready for evaluation during scheduling,
+ * they are pushed to the task pool at once so the ones on the longest
+ * path to the end of evaluation are picked up first.
+ */
+struct ScheduleBatch {
+	ScheduleBatch() : nodes(nodes_static), num(0), size(ARRAY_SIZE(nodes_static)) {}
+	~ScheduleBatch()
+	{
+		if (nodes != nodes_static) {
+			MEM_freeN(nodes);
+		}
+	}
+
+	void add(OperationDepsNode *node)
+	{
+		if (num == size) {
+			size *= 2;
+			if (nodes == nodes_static) {
+				nodes = (OperationDepsNode **)MEM_mallocN(sizeof(*nodes) * size, "ScheduleBatch");
+				memcpy(nodes, nodes_static, sizeof(nodes_static));
+			}
+			else {
+				nodes = (OperationDepsNode **)MEM_reallocN(nodes, sizeof(*nodes) * size);
+			}
+		}
+		nodes[num++] = node;
+	}
+
+	OperationDepsNode **nodes;
+	int num, size;
+	OperationDepsNode *nodes_static[32];
+};
+
 /* Forward declarations. */
 static void schedule_children(TaskPool *pool,
                               Depsgraph *graph,
                               OperationDepsNode *node,
-                              const int thread_id);
+                              ScheduleBatch *batch);
+static void schedule_batch_push(TaskPool *pool,
+                                ScheduleBatch *batch,
+                                const bool use_local_queue,
+                                const int thread_id);
 
 struct DepsgraphEvalState {
 	EvaluationContext *eval_ctx;
 	Depsgraph *graph;
 };
 
+/* Keep track of the evaluated operations, see Depsgraph::use_timing. */
+static void deg_timing_begin(Depsgraph *graph, const size_t num_operations)
+{
+	if (graph->timings_size < num_operations) {
+		MEM_SAFE_FREE(graph->timings);
+		graph->timings = (OperationTiming *)MEM_mallocN(
+		        sizeof(OperationTiming) * num_operations, "Depsgraph timings");
+		graph->timings_size = num_operations;
+	}
+	graph->num_timings = 0;
+	graph->timing_start = PIL_check_seconds_timer();
+}
+
+static void deg_timing_record(Depsgraph *graph,
+                              OperationDepsNode *node,
+                              const double start_time,
+                              const double end_time,
+                              const int thread_id)
+{
+	const uint32_t index = atomic_fetch_and_add_uint32(&graph->num_timings, 1);
+	if (index >= graph->timings_size) {
+		/* Should not happen, every operation is scheduled once. */
+		BLI_assert(!"More operations evaluated than scheduled");
+		return;
+	}
+	OperationTiming *timing = &graph->timings[index];
+	timing->node = node;
+	timing->start_time = start_time - graph->timing_start;
+	timing->end_time = end_time - graph->timing_start;
+	timing->thread_id = thread_id;
+}
+
 static void deg_task_run_func(TaskPool *pool,
                               void *taskdata,
                               int thread_id)
@@ -104,38 +182,49 @@ static void deg_task_run_func(TaskPool *pool,
 	 * but that's all fine, we'll just scheduler it's children.
 	 */
 	if (node->evaluate) {
-			/* Take note of current time. */
+		/* Take note of current time. */
+		const double start_time = PIL_check_seconds_timer();
 #ifdef USE_DEBUGGER
-		double start_time = PIL_check_seconds_timer();
 		DepsgraphDebug::task_started(state->graph, node);
 #endif
 
 		/* Perform operation. */
+		BLI_TRACE_BEGIN(DEG_OPNAMES[node->opcode], node->owner->owner->name);
 		node->evaluate(state->eval_ctx);
-
-			/* Note how long this took. */
+		BLI_TRACE_END();
+
+		/* Note how long this took, used for the evaluation priority. */
+		const double end_time = PIL_check_seconds_timer();
+		const float eval_time = (float)(end_time - start_time);
+		node->eval_cost = (node->eval_cost == 0.0f) ?
+		        eval_time :
+		        node->eval_cost + (eval_time - node->eval_cost) * DEG_EVAL_COST_FACTOR;
+		if (state->graph->use_timing) {
+			deg_timing_record(state->graph, node, start_time, end_time, thread_id);
+		}
 #ifdef USE_DEBUGGER
-		double end_time = PIL_check_seconds_timer();
 		DepsgraphDebug::task_completed(state->graph,
 		                               node,
 		                               end_time - start_time);
 #endif
 	}
 
+	ScheduleBatch batch;
+	schedule_children(pool, state->graph, node, &batch);
+
 	BLI_task_pool_delayed_push_begin(pool, thread_id);
-	schedule_children(pool, state->graph, node, thread_id);
+	schedule_batch_push(pool, &batch, true, thread_id);
 	BLI_task_pool_delayed_push_end(pool, thread_id);
 }
 
 typedef struct CalculatePengindData {
-	Depsgraph *graph;
+	const Depsgraph::OperationNodes *operations;
 } CalculatePengindData;
 
 static void calculate_pending_func(void *data_v, int i)
 {
 	CalculatePengindData *data = (CalculatePengindData *)data_v;
-	Depsgraph *graph = data->graph;
-	OperationDepsNode *node = graph->operations[i];
+	OperationDepsNode *node = (*data->operations)[i];
 
 	node->num_links_pending = 0;
 	node->scheduled = false;
@@ -155,12 +244,12 @@ static void calculate_pending_func(void *data_v, int i)
 	}
 }
 
-static void calculate_pending_parents(Depsgraph *graph)
+static void calculate_pending_parents(const Depsgraph::OperationNodes &operations)
 {
-	const int num_operations = graph->operations.size();
+	const int num_operations = operations.size();
 	const bool do_threads = num_operations > 256;
 	CalculatePengindData data;
-	data.graph = graph;
+	data.operations = &operations;
 	BLI_task_parallel_range(0,
 	                        num_operations,
 	                        &data,
@@ -168,40 +257,132 @@ static void calculate_pending_parents(Depsgraph *graph)
 	                        do_threads);
 }
 
-#ifdef USE_EVAL_PRIORITY
-static void calculate_eval_priority(OperationDepsNode *node)
+/* Relations followed by evaluation, see calculate_pending_func(). */
+BLI_INLINE bool eval_relation_is_followed(const DepsRelation *rel)
 {
-	if (node->done) {
-		return;
+	if (rel->from->type != DEG_NODE_TYPE_OPERATION ||
+	    rel->to->type != DEG_NODE_TYPE_OPERATION ||
+	    (rel->flag & DEPSREL_FLAG_CYCLIC) != 0)
+	{
+		return false;
+	}
+	const OperationDepsNode *from = (const OperationDepsNode *)rel->from;
+	const OperationDepsNode *to = (const OperationDepsNode *)rel->to;
+	return ((from->flag & DEPSOP_FLAG_NEEDS_UPDATE) != 0) &&
+	       ((to->flag & DEPSOP_FLAG_NEEDS_UPDATE) != 0);
+}
+
+BLI_INLINE float eval_operation_cost(const OperationDepsNode *node)
+{
+	if (node->is_noop()) {
+		return 0.0f;
 	}
-	node->done = 1;
+	return (node->eval_cost != 0.0f) ? node->eval_cost : DEG_EVAL_COST_DEFAULT;
+}
 
-	if (node->flag & DEPSOP_FLAG_NEEDS_UPDATE) {
-		/* XXX standard cost of a node, could be estimated somewhat later on */
-		const float cost = 1.0f;
-		/* NOOP nodes have no cost */
-		node->eval_priority = node->is_noop() ? cost : 0.0f;
+/* The priority of an operation is the length of the longest (critical) path from it
+ * to the end of evaluation, using the measured cost of the operations.
+ *
+ * Operations are visited from the end of the graph, once all their children are known,
+ * node->done counts the children still to be visited.
+ */
+static void calculate_eval_priority(const Depsgraph::OperationNodes &operations)
+{
+	vector<OperationDepsNode *> stack;
 
+	foreach (OperationDepsNode *node, operations) {
+		node->eval_priority = 0.0f;
+		node->done = 0;
+		if ((node->flag & DEPSOP_FLAG_NEEDS_UPDATE) == 0) {
+			continue;
+		}
 		foreach (DepsRelation *rel, node->outlinks) {
-			OperationDepsNode *to = (OperationDepsNode *)rel->to;
-			BLI_assert(to->type == DEG_NODE_TYPE_OPERATION);
-			calculate_eval_priority(to);
-			node->eval_priority += to->eval_priority;
+			if (eval_relation_is_followed(rel)) {
+				++node->done;
+			}
+		}
+		if (node->done == 0) {
+			stack.push_back(node);
 		}
 	}
-	else {
-		node->eval_priority = 0.0f;
+
+	while (!stack.empty()) {
+		OperationDepsNode *node = stack.back();
+		stack.pop_back();
+
+		float children_priority = 0.0f;
+		foreach (DepsRelation *rel, node->outlinks) {
+			if (eval_relation_is_followed(rel)) {
+				OperationDepsNode *child = (OperationDepsNode *)rel->to;
+				children_priority = std::max(children_priority, child->eval_priority);
+			}
+		}
+		node->eval_priority = eval_operation_cost(node) + children_priority;
+
+		foreach (DepsRelation *rel, node->inlinks) {
+			if (eval_relation_is_followed(rel)) {
+				OperationDepsNode *parent = (OperationDepsNode *)rel->from;
+				BLI_assert(parent->done > 0);
+				if (--parent->done == 0) {
+					stack.push_back(parent);
+				}
+			}
+		}
 	}
 }
-#endif
+
+static bool eval_priority_greater(const OperationDepsNode *a, const OperationDepsNode *b)
+{
+	return a->eval_priority > b->eval_priority;
+}
+
+/* Push the operations of the batch, highest priority first.
+ *
+ * The first task pushed from a task goes to the thread's local queue and is evaluated next
+ * by the same thread, so it continues along the critical path. The other tasks are added to
+ * the head of the pool's queue (delayed and suspended pushes alike), so they are pushed by
+ * increasing priority to end up with the highest priority one at the head.
+ */
+static void schedule_batch_push(TaskPool *pool,
+                                ScheduleBatch *batch,
+                                const bool use_local_queue,
+                                const int thread_id)
+{
+	if (batch->num == 0) {
+		return;
+	}
+
+	std::sort(batch->nodes, batch->nodes + batch->num, eval_priority_greater);
+
+	int start = 0;
+	if (use_local_queue) {
+		BLI_task_pool_push_from_thread(pool,
+		                               deg_task_run_func,
+		                               batch->nodes[0],
+		                               false,
+		                               TASK_PRIORITY_HIGH,
+		                               thread_id);
+		start = 1;
+	}
+	for (int i = batch->num - 1; i >= start; i--) {
+		BLI_task_pool_push_from_thread(pool,
+		                               deg_task_run_func,
+		                               batch->nodes[i],
+		                               false,
+		                               TASK_PRIORITY_HIGH,
+		                               thread_id);
+	}
+	batch->num = 0;
+}
 
 /* Schedule a node if it needs evaluation.
  *   dec_parents: Decrement pending parents count, true when child nodes are
  *                scheduled after a task has been completed.
+ *   batch: Receives the node when it is ready to be evaluated.
  */
 static void schedule_node(TaskPool *pool, Depsgraph *graph,
                           OperationDepsNode *node, bool dec_parents,
-                          const int thread_id)
+                          ScheduleBatch *batch)
 {
 	if ((node->flag & DEPSOP_FLAG_NEEDS_UPDATE) != 0) {
 		if (dec_parents) {
@@ -215,33 +396,32 @@ static void schedule_node(TaskPool *pool, Depsgraph *graph,
 			if (!is_scheduled) {
 				if (node->is_noop()) {
 					/* skip NOOP node, schedule children right away */
-					schedule_children(pool, graph, node, thread_id);
+					schedule_children(pool, graph, node, batch);
 				}
 				else {
 					/* children are scheduled once this task is completed */
-					BLI_task_pool_push_from_thread(pool,
-					                               deg_task_run_func,
-					                               node,
-					                               false,
-					                               TASK_PRIORITY_HIGH,
-					                               thread_id);
+					batch->add(node);
 				}
 			}
 		}
 	}
 }
 
-static void schedule_graph(TaskPool *pool, Depsgraph *graph)
+static void schedule_graph(TaskPool *pool,
+                           Depsgraph *graph,
+                           const Depsgraph::OperationNodes &operations)
 {
-	foreach (OperationDepsNode *node, graph->operations) {
-		schedule_node(pool, graph, node, false, 0);
+	ScheduleBatch batch;
+	foreach (OperationDepsNode *node, operations) {
+		schedule_node(pool, graph, node, false, &batch);
 	}
+	schedule_batch_push(pool, &batch, false, 0);
 }
 
 static void schedule_children(TaskPool *pool,
                               Depsgraph *graph,
                               OperationDepsNode *node,
-                              const int thread_id)
+                              ScheduleBatch *batch)
 {
 	foreach (DepsRelation *rel, node->outlinks) {
 		OperationDepsNode *child = (OperationDepsNode *)rel->to;
@@ -254,81 +434,175 @@ static void schedule_children(TaskPool *pool,
 		              graph,
 		              child,
 		              (rel->flag & DEPSREL_FLAG_CYCLIC) == 0,
-		              thread_id);
+		              batch);
 	}
 }
 
-/**
- * Evaluate all nodes tagged for updating,
- * \warning This is usually done as part of main loop, but may also be
- * called from frame-change update.
+static TaskScheduler *deg_evaluate_task_scheduler_get(bool *r_need_free)
+{
+	if (G.debug & G_DEBUG_DEPSGRAPH_NO_THREADS) {
+		*r_need_free = true;
+		return BLI_task_scheduler_create(1);
+	}
+	*r_need_free = false;
+	return BLI_task_scheduler_get();
+}
+
+/* Prepare and schedule evaluation of the given operations.
  *
- * \note Time sources should be all valid!
+ * Tasks of a suspended pool are only started once the pool is waited for in
+ * deg_evaluate_end(), otherwise they are started right away.
  */
-void deg_evaluate_on_refresh(EvaluationContext *eval_ctx,
-                             Depsgraph *graph)
+static TaskPool *deg_evaluate_begin(DepsgraphEvalState *state,
+                                    TaskScheduler *task_scheduler,
+                                    const Depsgraph::OperationNodes &operations,
+                                    const bool suspended)
 {
-	/* Generate base evaluation context, upon which all the others are derived. */
-	// TODO: this needs both main and scene access...
-
-	/* Nothing to update, early out. */
-	if (BLI_gset_size(graph->entry_tags) == 0) {
-		return;
-	}
+	EvaluationContext *eval_ctx = state->eval_ctx;
+	Depsgraph *graph = state->graph;
 
 	/* Set time for the current graph evaluation context. */
 	TimeSourceDepsNode *time_src = graph->find_time_source();
 	eval_ctx->scene_layer = DEG_get_evaluated_scene_layer((::Depsgraph *)graph);
 	eval_ctx->ctime = time_src->cfra;
 
-	/* XXX could use a separate pool for each eval context */
-	DepsgraphEvalState state;
-	state.eval_ctx = eval_ctx;
-	state.graph = graph;
+	TaskPool *task_pool = suspended ?
+	        BLI_task_pool_create_suspended(task_scheduler, state) :
+	        BLI_task_pool_create(task_scheduler, state);
 
-	TaskScheduler *task_scheduler;
-	bool need_free_scheduler;
+	calculate_pending_parents(operations);
 
-	if (G.debug & G_DEBUG_DEPSGRAPH_NO_THREADS) {
-		task_scheduler = BLI_task_scheduler_create(1);
-		need_free_scheduler = true;
-	}
-	else {
-		task_scheduler = BLI_task_scheduler_get();
-		need_free_scheduler = false;
+	/* Calculate priority for operation nodes, only useful when evaluating in parallel. */
+	if (BLI_task_scheduler_num_threads(task_scheduler) > 1) {
+		calculate_eval_priority(operations);
 	}
 
-	TaskPool *task_pool = BLI_task_pool_create_suspended(task_scheduler, &state);
-
-	calculate_pending_parents(graph);
-
 	/* Clear tags. */
-	foreach (OperationDepsNode *node, graph->operations) {
+	foreach (OperationDepsNode *node, operations) {
 		node->done = 0;
 	}
 
-	/* Calculate priority for operation nodes. */
-#ifdef USE_EVAL_PRIORITY
-	foreach (OperationDepsNode *node, graph->operations) {
-		calculate_eval_priority(node);
+	DepsgraphDebug::eval_begin(eval_ctx);
+
+	if (graph->use_timing) {
+		deg_timing_begin(graph, operations.size());
 	}
-#endif
 
-	DepsgraphDebug::eval_begin(eval_ctx);
+	schedule_graph(task_pool, graph, operations);
 
-	schedule_graph(task_pool, graph);
+	return task_pool;
+}
 
+/* Wait for the scheduled evaluation to be finished. */
+static void deg_evaluate_end(DepsgraphEvalState *state,
+                             TaskPool *task_pool,
+                             const Depsgraph::OperationNodes &operations)
+{
 	BLI_task_pool_work_and_wait(task_pool);
 	BLI_task_pool_free(task_pool);
 
-	DepsgraphDebug::eval_end(eval_ctx);
+	DepsgraphDebug::eval_end(state->eval_ctx);
 
 	/* Clear any uncleared tags - just in case. */
-	deg_graph_clear_tags(graph);
+	deg_graph_clear_tags(state->graph, operations);
+}
+
+/* Evaluate given operations which are tagged for update, operations which
+ * are not in the list are expected to not need update.
+ */
+static void deg_evaluate_operations(EvaluationContext *eval_ctx,
+                                    Depsgraph *graph,
+                                    const Depsgraph::OperationNodes &operations)
+{
+	/* XXX could use a separate pool for each eval context */
+	DepsgraphEvalState state;
+	state.eval_ctx = eval_ctx;
+	state.graph = graph;
+
+	bool need_free_scheduler;
+	TaskScheduler *task_scheduler =
+	        deg_evaluate_task_scheduler_get(&need_free_scheduler);
+
+	TaskPool *task_pool = deg_evaluate_begin(&state, task_scheduler, operations, true);
+	deg_evaluate_end(&state, task_pool, operations);
+
+	if (need_free_scheduler) {
+		BLI_task_scheduler_free(task_scheduler);
+	}
+}
+
+/**
+ * Evaluate all nodes tagged for updating,
+ * \warning This is usually done as part of main loop, but may also be
+ * called from frame-change update.
+ *
+ * \note Time sources should be all valid!
+ */
+void deg_evaluate_on_refresh(EvaluationContext *eval_ctx,
+                             Depsgraph *graph)
+{
+	/* Generate base evaluation context, upon which all the others are derived. */
+	// TODO: this needs both main and scene access...
+
+	/* Nothing to update, early out. */
+	if (BLI_gset_size(graph->entry_tags) == 0) {
+		return;
+	}
+
+	deg_evaluate_operations(eval_ctx, graph, graph->operations);
+}
+
+/* Evaluate all nodes tagged for updating in several graphs at once.
+ *
+ * Operations of all graphs are scheduled before waiting for any of them, so
+ * the graphs are evaluated concurrently by the threads of the scheduler.
+ * Graphs are not to share any data which is modified by evaluation.
+ */
+void deg_evaluate_on_refresh_multi(EvaluationContext **eval_ctx,
+                                   Depsgraph **graphs,
+                                   const int num_graphs)
+{
+	bool need_free_scheduler;
+	TaskScheduler *task_scheduler =
+	        deg_evaluate_task_scheduler_get(&need_free_scheduler);
+
+	vector<DepsgraphEvalState> states(num_graphs);
+	vector<TaskPool *> task_pools(num_graphs, NULL);
+	for (int i = 0; i < num_graphs; i++) {
+		/* Nothing to update, skip. */
+		if (BLI_gset_size(graphs[i]->entry_tags) == 0) {
+			continue;
+		}
+		states[i].eval_ctx = eval_ctx[i];
+		states[i].graph = graphs[i];
+		task_pools[i] = deg_evaluate_begin(&states[i],
+		                                   task_scheduler,
+		                                   graphs[i]->operations,
+		                                   false);
+	}
+	for (int i = 0; i < num_graphs; i++) {
+		if (task_pools[i] != NULL) {
+			deg_evaluate_end(&states[i], task_pools[i], graphs[i]->operations);
+		}
+	}
 
 	if (need_free_scheduler) {
 		BLI_task_scheduler_free(task_scheduler);
 	}
 }
 
+/* Evaluate operations tagged by deg_graph_flush_time_updates(). */
+void deg_evaluate_time_operations(EvaluationContext *eval_ctx,
+                                  Depsgraph *graph)
+{
+	BLI_assert(graph->time_operations_valid);
+
+	/* Nothing to update, early out. */
+	if (BLI_gset_size(graph->entry_tags) == 0) {
+		return;
+	}
+
+	deg_evaluate_operations(eval_ctx, graph, graph->time_operations);
+}
+
 }  // namespace DEG
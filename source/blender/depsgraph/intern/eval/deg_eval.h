@@ -48,4 +48,13 @@ struct Depsgraph;
 void deg_evaluate_on_refresh(EvaluationContext *eval_ctx,
                              Depsgraph *graph);
 
+/* Evaluate all nodes tagged for updating in several graphs concurrently. */
+void deg_evaluate_on_refresh_multi(EvaluationContext **eval_ctx,
+                                   Depsgraph **graphs,
+                                   const int num_graphs);
+
+/* Evaluate operations tagged for update by deg_graph_flush_time_updates(). */
+void deg_evaluate_time_operations(EvaluationContext *eval_ctx,
+                                  Depsgraph *graph);
+
 }  // namespace DEG
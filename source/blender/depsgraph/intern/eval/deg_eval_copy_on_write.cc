@@ -74,7 +74,9 @@ extern "C" {
 
 #include "BKE_action.h"
 #include "BKE_editmesh.h"
+#include "BKE_key.h"
 #include "BKE_library_query.h"
+#include "BKE_mesh.h"
 #include "BKE_object.h"
 }
 
@@ -250,6 +252,26 @@ struct ValidateData {
 	bool is_valid;
 };
 
+/* Copy geometry datablocks, referencing the original geometry arrays instead
+ * of duplicating them. Arrays are only duplicated when evaluation modifies
+ * them, see CustomData_duplicate_referenced_layer().
+ *
+ * NOTE: Relies on the copy being updated whenever the original geometry is
+ * re-allocated, which is ensured by tagging the ID for copy-on-write update.
+ */
+bool id_copy_geometry_shared(Main *bmain, const ID *id, ID **newid)
+{
+	switch (GS(id->name)) {
+		case ID_ME:
+			*newid = (ID *)BKE_mesh_copy_ex(bmain, (const Mesh *)id, true);
+			return true;
+		case ID_KE:
+			*newid = (ID *)BKE_key_copy_ex(bmain, (const Key *)id, true);
+			return true;
+	}
+	return false;
+}
+
 /* Similar to generic id_copy() but does not require main.
  *
  * TODO(sergey): Get rid of this once T51804 is handled.
@@ -267,7 +289,8 @@ bool id_copy_no_main(const ID *id, ID **newid)
 	id_for_copy = nested_id_hack_get_discarded_pointers(&id_hack_storage, id);
 #endif
 
-	bool result = id_copy(&temp_bmain, (ID *)id_for_copy, newid, false);
+	bool result = id_copy_geometry_shared(&temp_bmain, id_for_copy, newid) ||
+	              id_copy(&temp_bmain, (ID *)id_for_copy, newid, false);
 
 #ifdef NESTED_ID_NASTY_WORKAROUND
 	if (result) {
@@ -669,9 +692,6 @@ ID *deg_expand_copy_on_write_datablock(const Depsgraph *depsgraph,
 	}
 	// BLI_assert(check_datablock_expanded(id_cow) == false);
 	/* Copy data from original ID to a copied version. */
-	/* TODO(sergey): Avoid doing full ID copy somehow, make Mesh to reference
-	 * original geometry arrays for until those are modified.
-	 */
 	/* TODO(sergey): We do some trickery with temp bmain and extra ID pointer
 	 * just to be able to use existing API. Ideally we need to replace this with
 	 * in-place copy from existing datablock to a prepared memory.
@@ -702,8 +722,8 @@ ID *deg_expand_copy_on_write_datablock(const Depsgraph *depsgraph,
 		}
 		case ID_ME:
 		{
-			/* TODO(sergey): Ideally we want to handle meshes in a special
-			 * manner here to avoid initial copy of all the geometry arrays.
+			/* Geometry arrays are referenced from the original mesh, see
+			 * id_copy_geometry_shared().
 			 */
 			break;
 		}
@@ -70,6 +70,92 @@ static void flush_init_func(void *data_v, int i)
 	node->scheduled = false;
 }
 
+/* Editors and legacy tags update of an ID which is affected by the flush. */
+static void flush_handle_id_node(Main *bmain,
+                                 Depsgraph *graph,
+                                 IDDepsNode *id_node)
+{
+	/* TODO(sergey): Do we need to pass original or evaluated ID here? */
+	ID *id = id_node->id_orig;
+	deg_editors_id_update(bmain, id);
+	lib_id_recalc_tag(bmain, id);
+	/* TODO(sergey): For until we've got proper data nodes in the graph. */
+	lib_id_recalc_data_tag(bmain, id);
+
+#ifdef WITH_COPY_ON_WRITE
+	/* Currently this is needed to get ob->mesh to be replaced with
+	 * original mesh (rather than being evaluated_mesh).
+	 *
+	 * TODO(sergey): This is something we need to avoid.
+	 */
+	ComponentDepsNode *cow_comp =
+	        id_node->find_component(DEG_NODE_TYPE_COPY_ON_WRITE);
+	cow_comp->tag_update(graph);
+#else
+	(void) graph;
+#endif
+}
+
+/* Tag all operations of the component, and translate the update to object's
+ * recalc flags.
+ */
+static void flush_handle_component_node(IDDepsNode *id_node,
+                                        ComponentDepsNode *comp_node)
+{
+	foreach (OperationDepsNode *op, comp_node->operations) {
+		/* We don't want to flush tags in "upstream" direction for
+		 * certain types of operations.
+		 *
+		 * TODO(sergey): Need a more generic solution for this.
+		 */
+		if (op->opcode == DEG_OPCODE_PARTICLE_SETTINGS_EVAL) {
+			continue;
+		}
+		op->flag |= DEPSOP_FLAG_NEEDS_UPDATE;
+	}
+	ID *id = id_node->id_orig;
+	if (GS(id->name) != ID_OB) {
+		return;
+	}
+	Object *object = (Object *)id;
+	/* This code is used to preserve those areas which does
+	 * direct object update,
+	 *
+	 * Plus it ensures visibility changes and relations and
+	 * layers visibility update has proper flags to work with.
+	 */
+	switch (comp_node->type) {
+		case DEG_NODE_TYPE_UNDEFINED:
+		case DEG_NODE_TYPE_OPERATION:
+		case DEG_NODE_TYPE_TIMESOURCE:
+		case DEG_NODE_TYPE_ID_REF:
+		case DEG_NODE_TYPE_PARAMETERS:
+		case DEG_NODE_TYPE_SEQUENCER:
+		case DEG_NODE_TYPE_LAYER_COLLECTIONS:
+		case DEG_NODE_TYPE_COPY_ON_WRITE:
+			/* Ignore, does not translate to object component. */
+			break;
+		case DEG_NODE_TYPE_ANIMATION:
+			object->recalc |= OB_RECALC_TIME;
+			break;
+		case DEG_NODE_TYPE_TRANSFORM:
+			object->recalc |= OB_RECALC_OB;
+			break;
+		case DEG_NODE_TYPE_GEOMETRY:
+		case DEG_NODE_TYPE_EVAL_POSE:
+		case DEG_NODE_TYPE_BONE:
+		case DEG_NODE_TYPE_EVAL_PARTICLES:
+		case DEG_NODE_TYPE_SHADING:
+		case DEG_NODE_TYPE_CACHE:
+		case DEG_NODE_TYPE_PROXY:
+			object->recalc |= OB_RECALC_DATA;
+			break;
+	}
+
+	/* TODO : replace with more granular flags */
+	object->deg_update_flag |= DEG_RUNTIME_DATA_UPDATE;
+}
+
 /* Flush updates from tagged nodes outwards until all affected nodes
  * are tagged.
  */
@@ -121,83 +207,15 @@ void deg_graph_flush_updates(Main *bmain, Depsgraph *graph)
 			ComponentDepsNode *comp_node = node->owner;
 			IDDepsNode *id_node = comp_node->owner;
 
-			/* TODO(sergey): Do we need to pass original or evaluated ID here? */
-			ID *id = id_node->id_orig;
 			if (id_node->done == 0) {
-				deg_editors_id_update(bmain, id);
-				lib_id_recalc_tag(bmain, id);
-				/* TODO(sergey): For until we've got proper data nodes in the graph. */
-				lib_id_recalc_data_tag(bmain, id);
-
-#ifdef WITH_COPY_ON_WRITE
-				/* Currently this is needed to get ob->mesh to be replaced with
-				 * original mesh (rather than being evaluated_mesh).
-				 *
-				 * TODO(sergey): This is something we need to avoid.
-				 */
-				ComponentDepsNode *cow_comp =
-				        id_node->find_component(DEG_NODE_TYPE_COPY_ON_WRITE);
-				cow_comp->tag_update(graph);
-#endif
+				flush_handle_id_node(bmain, graph, id_node);
 			}
 
 			if (comp_node->done == 0) {
-				Object *object = NULL;
-				if (GS(id->name) == ID_OB) {
-					object = (Object *)id;
-					if (id_node->done == 0) {
-						++num_flushed_objects;
-					}
-				}
-				foreach (OperationDepsNode *op, comp_node->operations) {
-					/* We don't want to flush tags in "upstream" direction for
-					 * certain types of operations.
-					 *
-					 * TODO(sergey): Need a more generic solution for this.
-					 */
-					if (op->opcode == DEG_OPCODE_PARTICLE_SETTINGS_EVAL) {
-						continue;
-					}
-					op->flag |= DEPSOP_FLAG_NEEDS_UPDATE;
-				}
-				if (object != NULL) {
-					/* This code is used to preserve those areas which does
-					 * direct object update,
-					 *
-					 * Plus it ensures visibility changes and relations and
-					 * layers visibility update has proper flags to work with.
-					 */
-					switch (comp_node->type) {
-						case DEG_NODE_TYPE_UNDEFINED:
-						case DEG_NODE_TYPE_OPERATION:
-						case DEG_NODE_TYPE_TIMESOURCE:
-						case DEG_NODE_TYPE_ID_REF:
-						case DEG_NODE_TYPE_PARAMETERS:
-						case DEG_NODE_TYPE_SEQUENCER:
-						case DEG_NODE_TYPE_LAYER_COLLECTIONS:
-						case DEG_NODE_TYPE_COPY_ON_WRITE:
-							/* Ignore, does not translate to object component. */
-							break;
-						case DEG_NODE_TYPE_ANIMATION:
-							object->recalc |= OB_RECALC_TIME;
-							break;
-						case DEG_NODE_TYPE_TRANSFORM:
-							object->recalc |= OB_RECALC_OB;
-							break;
-						case DEG_NODE_TYPE_GEOMETRY:
-						case DEG_NODE_TYPE_EVAL_POSE:
-						case DEG_NODE_TYPE_BONE:
-						case DEG_NODE_TYPE_EVAL_PARTICLES:
-						case DEG_NODE_TYPE_SHADING:
-						case DEG_NODE_TYPE_CACHE:
-						case DEG_NODE_TYPE_PROXY:
-							object->recalc |= OB_RECALC_DATA;
-							break;
-					}
-
-					/* TODO : replace with more granular flags */
-					object->deg_update_flag |= DEG_RUNTIME_DATA_UPDATE;
+				if (GS(id_node->id_orig->name) == ID_OB && id_node->done == 0) {
+					++num_flushed_objects;
 				}
+				flush_handle_component_node(id_node, comp_node);
 			}
 
 			id_node->done = 1;
@@ -234,23 +252,114 @@ void deg_graph_flush_updates(Main *bmain, Depsgraph *graph)
 	DEG_DEBUG_PRINTF("Update flushed to %d objects\n", num_flushed_objects);
 }
 
+/* Remember the result of flushing the time source update, so the following
+ * frame changes don't need to traverse the graph.
+ */
+static void flush_store_time_operations(Depsgraph *graph)
+{
+	graph->clear_time_operations();
+	foreach (OperationDepsNode *op_node, graph->operations) {
+		if ((op_node->flag & DEPSOP_FLAG_NEEDS_UPDATE) != 0) {
+			graph->time_operations.push_back(op_node);
+		}
+	}
+	/* Component flags are only initialized when anything was flushed. */
+	if (!graph->time_operations.empty()) {
+		GHASH_FOREACH_BEGIN(IDDepsNode *, id_node, graph->id_hash)
+		{
+			GHASH_FOREACH_BEGIN(ComponentDepsNode *, comp_node, id_node->components)
+			{
+				if (comp_node->done) {
+					graph->time_components.push_back(comp_node);
+				}
+			}
+			GHASH_FOREACH_END();
+		}
+		GHASH_FOREACH_END();
+	}
+	graph->time_operations_valid = true;
+}
+
+/* Flush update of the time source, when nothing else is tagged for update.
+ *
+ * Result of the first flush is cached in the graph, following ones only tag
+ * the operations which depend on time instead of traversing the graph.
+ */
+void deg_graph_flush_time_updates(Main *bmain, Depsgraph *graph)
+{
+	if (!graph->time_operations_valid) {
+		deg_graph_flush_updates(bmain, graph);
+		flush_store_time_operations(graph);
+		return;
+	}
+	foreach (ComponentDepsNode *comp_node, graph->time_components) {
+		comp_node->done = 0;
+		comp_node->owner->done = 0;
+	}
+	foreach (ComponentDepsNode *comp_node, graph->time_components) {
+		IDDepsNode *id_node = comp_node->owner;
+		if (id_node->done == 0) {
+			flush_handle_id_node(bmain, graph, id_node);
+			id_node->done = 1;
+		}
+		flush_handle_component_node(id_node, comp_node);
+		comp_node->done = 1;
+	}
+	foreach (OperationDepsNode *op_node, graph->time_operations) {
+		op_node->flag |= DEPSOP_FLAG_NEEDS_UPDATE;
+	}
+	DEG_DEBUG_PRINTF("Time update flushed to %d operations\n",
+	                 (int)graph->time_operations.size());
+}
+
 static void graph_clear_func(void *data_v, int i)
 {
-	Depsgraph *graph = (Depsgraph *)data_v;
-	OperationDepsNode *node = graph->operations[i];
+	const Depsgraph::OperationNodes *operations =
+	        (const Depsgraph::OperationNodes *)data_v;
+	OperationDepsNode *node = (*operations)[i];
 	/* Clear node's "pending update" settings. */
 	node->flag &= ~(DEPSOP_FLAG_DIRECTLY_MODIFIED | DEPSOP_FLAG_NEEDS_UPDATE);
 }
 
-/* Clear tags from all operation nodes. */
-void deg_graph_clear_tags(Depsgraph *graph)
+/* Clear tags from given operation nodes. */
+void deg_graph_clear_tags(Depsgraph *graph,
+                          const Depsgraph::OperationNodes &operations)
 {
 	/* Go over all operation nodes, clearing tags. */
-	const int num_operations = graph->operations.size();
+	const int num_operations = operations.size();
 	const bool do_threads = num_operations > 256;
-	BLI_task_parallel_range(0, num_operations, graph, graph_clear_func, do_threads);
-	/* Clear any entry tags which haven't been flushed. */
+	BLI_task_parallel_range(0,
+	                        num_operations,
+	                        (void *)&operations,
+	                        graph_clear_func,
+	                        do_threads);
+	/* Clear any entry tags which haven't been flushed. Operations might have
+	 * been tagged during evaluation while not being in the given subset, their
+	 * flags are to be cleared together with the entry tags, otherwise they
+	 * would never be tagged (and evaluated) again.
+	 */
+	GSET_FOREACH_BEGIN(OperationDepsNode *, op_node, graph->entry_tags)
+	{
+		op_node->flag &= ~(DEPSOP_FLAG_DIRECTLY_MODIFIED |
+		                   DEPSOP_FLAG_NEEDS_UPDATE);
+	}
+	GSET_FOREACH_END();
 	BLI_gset_clear(graph->entry_tags, NULL);
+#ifndef NDEBUG
+	/* Operations outside of the subset are only tagged via entry tags. */
+	if (&operations != &graph->operations) {
+		foreach (OperationDepsNode *op_node, graph->operations) {
+			BLI_assert((op_node->flag & (DEPSOP_FLAG_DIRECTLY_MODIFIED |
+			                             DEPSOP_FLAG_NEEDS_UPDATE)) == 0);
+		}
+	}
+#endif
+}
+
+/* Clear tags from all operation nodes. */
+void deg_graph_clear_tags(Depsgraph *graph)
+{
+	deg_graph_clear_tags(graph, graph->operations);
 }
 
 }  // namespace DEG
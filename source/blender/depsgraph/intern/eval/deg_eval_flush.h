@@ -32,18 +32,27 @@
 
 #pragma once
 
+#include "intern/depsgraph.h"
+
 struct Main;
 
 namespace DEG {
 
-struct Depsgraph;
-
 /* Flush updates from tagged nodes outwards until all affected nodes
  * are tagged.
  */
 void deg_graph_flush_updates(struct Main *bmain, struct Depsgraph *graph);
 
+/* Flush update of the time source, using operations cached in the graph
+ * when nothing but the time source is tagged for update.
+ */
+void deg_graph_flush_time_updates(struct Main *bmain, struct Depsgraph *graph);
+
 /* Clear tags from all operation nodes. */
 void deg_graph_clear_tags(struct Depsgraph *graph);
 
+/* Clear tags from given operation nodes. */
+void deg_graph_clear_tags(struct Depsgraph *graph,
+                          const Depsgraph::OperationNodes &operations);
+
 }  // namespace DEG
@@ -141,12 +141,9 @@ void ComponentDepsNode::init(const ID * /*id*/,
 /* Free 'component' node */
 ComponentDepsNode::~ComponentDepsNode()
 {
-	clear_operations();
-	if (operations_map != NULL) {
-		BLI_ghash_free(operations_map,
-		               comp_node_hash_key_free,
-		               comp_node_hash_value_free);
-	}
+	BLI_ghash_free(operations_map,
+	               comp_node_hash_key_free,
+	               comp_node_hash_value_free);
 }
 
 string ComponentDepsNode::identifier() const
@@ -239,14 +236,10 @@ void ComponentDepsNode::set_exit_operation(OperationDepsNode *op_node)
 
 void ComponentDepsNode::clear_operations()
 {
-	if (operations_map != NULL) {
-		BLI_ghash_clear(operations_map,
-		                comp_node_hash_key_free,
-		                comp_node_hash_value_free);
-	}
-	foreach (OperationDepsNode *op_node, operations) {
-		OBJECT_GUARDED_DELETE(op_node, OperationDepsNode);
-	}
+	/* Operations vector is filled from the map on build finalization. */
+	BLI_ghash_clear(operations_map,
+	                comp_node_hash_key_free,
+	                comp_node_hash_value_free);
 	operations.clear();
 }
 
@@ -256,17 +249,12 @@ void ComponentDepsNode::tag_update(Depsgraph *graph)
 	if (entry_op != NULL && entry_op->flag & DEPSOP_FLAG_NEEDS_UPDATE) {
 		return;
 	}
-	foreach (OperationDepsNode *op_node, operations) {
+	/* It is possible that tag happens before finalization, so use the map. */
+	GHASH_FOREACH_BEGIN(OperationDepsNode *, op_node, operations_map)
+	{
 		op_node->tag_update(graph);
 	}
-	// It is possible that tag happens before finalization.
-	if (operations_map != NULL) {
-		GHASH_FOREACH_BEGIN(OperationDepsNode *, op_node, operations_map)
-		{
-			op_node->tag_update(graph);
-		}
-		GHASH_FOREACH_END();
-	}
+	GHASH_FOREACH_END();
 }
 
 OperationDepsNode *ComponentDepsNode::get_entry_operation()
@@ -274,7 +262,10 @@ OperationDepsNode *ComponentDepsNode::get_entry_operation()
 	if (entry_operation) {
 		return entry_operation;
 	}
-	else if (operations_map != NULL && BLI_ghash_size(operations_map) == 1) {
+	else if (BLI_ghash_size(operations_map) == 1) {
+		if (operations.size() == 1) {
+			return operations[0];
+		}
 		OperationDepsNode *op_node = NULL;
 		/* TODO(sergey): This is somewhat slow. */
 		GHASH_FOREACH_BEGIN(OperationDepsNode *, tmp, operations_map)
@@ -282,13 +273,8 @@ OperationDepsNode *ComponentDepsNode::get_entry_operation()
 			op_node = tmp;
 		}
 		GHASH_FOREACH_END();
-		/* Cache for the subsequent usage. */
-		entry_operation = op_node;
 		return op_node;
 	}
-	else if (operations.size() == 1) {
-		return operations[0];
-	}
 	return NULL;
 }
 
@@ -297,7 +283,10 @@ OperationDepsNode *ComponentDepsNode::get_exit_operation()
 	if (exit_operation) {
 		return exit_operation;
 	}
-	else if (operations_map != NULL && BLI_ghash_size(operations_map) == 1) {
+	else if (BLI_ghash_size(operations_map) == 1) {
+		if (operations.size() == 1) {
+			return operations[0];
+		}
 		OperationDepsNode *op_node = NULL;
 		/* TODO(sergey): This is somewhat slow. */
 		GHASH_FOREACH_BEGIN(OperationDepsNode *, tmp, operations_map)
@@ -305,28 +294,26 @@ OperationDepsNode *ComponentDepsNode::get_exit_operation()
 			op_node = tmp;
 		}
 		GHASH_FOREACH_END();
-		/* Cache for the subsequent usage. */
-		exit_operation = op_node;
 		return op_node;
 	}
-	else if (operations.size() == 1) {
-		return operations[0];
-	}
 	return NULL;
 }
 
 void ComponentDepsNode::finalize_build(Depsgraph * /*graph*/)
 {
+	/* Operations are never removed from a component, so the vector is only
+	 * outdated when new operations were added since the last finalization.
+	 */
+	if (operations.size() == BLI_ghash_size(operations_map)) {
+		return;
+	}
+	operations.clear();
 	operations.reserve(BLI_ghash_size(operations_map));
 	GHASH_FOREACH_BEGIN(OperationDepsNode *, op_node, operations_map)
 	{
 		operations.push_back(op_node);
 	}
 	GHASH_FOREACH_END();
-	BLI_ghash_free(operations_map,
-	               comp_node_hash_key_free,
-	               NULL);
-	operations_map = NULL;
 }
 
 /* Parameter Component Defines ============================ */
@@ -138,7 +138,8 @@ struct ComponentDepsNode : public DepsNode {
 	/* ** Inner nodes for this component ** */
 
 	/* Operations stored as a hash map, for faster build.
-	 * This hash map will be freed when graph is fully built.
+	 * This hash map is kept after the graph is built, so relations of
+	 * individual IDs can be rebuilt later on.
 	 */
 	GHash *operations_map;
 
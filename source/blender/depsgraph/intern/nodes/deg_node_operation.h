@@ -74,7 +74,10 @@ struct OperationDepsNode : public DepsNode {
 
 	/* How many inlinks are we still waiting on before we can be evaluated. */
 	uint32_t num_links_pending;
+	/* Length of the longest path to the end of evaluation, in seconds (see calculate_eval_priority). */
 	float eval_priority;
+	/* Running average of the evaluation time, in seconds. */
+	float eval_cost;
 	bool scheduled;
 
 	/* Identifier for the operation being performed. */
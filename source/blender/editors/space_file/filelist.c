@@ -69,6 +69,7 @@
 #include "BKE_icons.h"
 #include "BKE_idcode.h"
 #include "BKE_main.h"
+#include "BLO_blend_index.h"
 #include "BLO_readfile.h"
 
 #include "DNA_space_types.h"
@@ -328,6 +329,7 @@ enum {
 	FL_IS_PENDING     = 1 << 2,
 	FL_NEED_SORTING   = 1 << 3,
 	FL_NEED_FILTERING = 1 << 4,
+	FL_NEED_INDEXING  = 1 << 5,
 };
 
 #define SPECIAL_IMG_SIZE 48
@@ -2256,7 +2258,7 @@ static int filelist_readjob_list_lib(const char *root, ListBase *entries, const
 	char dir[FILE_MAX_LIBEXTRA], *group;
 	bool ok;
 
-	struct BlendHandle *libfiledata = NULL;
+	BlendIndex *libindex = NULL;
 
 	/* name test */
 	ok = BLO_library_path_explode(root, dir, &group, NULL);
@@ -2264,23 +2266,23 @@ static int filelist_readjob_list_lib(const char *root, ListBase *entries, const
 		return nbr_entries;
 	}
 
-	/* there we go */
-	libfiledata = BLO_blendhandle_from_file(dir, NULL);
-	if (libfiledata == NULL) {
+	/* there we go, the index avoids re-scanning the whole .blend file each time it's browsed */
+	libindex = BLO_blendindex_get(dir, false, NULL);
+	if (libindex == NULL) {
 		return nbr_entries;
 	}
 
 	/* memory for strings is passed into filelist[i].entry->relpath and freed in filelist_entry_free. */
 	if (group) {
 		idcode = groupname_to_code(group);
-		names = BLO_blendhandle_get_datablock_names(libfiledata, idcode, &nnames);
+		names = BLO_blendindex_get_datablock_names(libindex, idcode, &nnames);
 	}
 	else {
-		names = BLO_blendhandle_get_linkable_groups(libfiledata);
+		names = BLO_blendindex_get_linkable_groups(libindex);
 		nnames = BLI_linklist_count(names);
 	}
 
-	BLO_blendhandle_close(libfiledata);
+	BLO_blendindex_free(libindex);
 
 	if (!skip_currpar) {
 		entry = MEM_callocN(sizeof(*entry), __func__);
@@ -2677,6 +2679,10 @@ static void filelist_readjob_endjob(void *flrjv)
 
 	flrj->filelist->flags &= ~FL_IS_PENDING;
 	flrj->filelist->flags |= FL_IS_READY;
+
+	if (flrj->filelist->read_jobf == filelist_readjob_lib) {
+		flrj->filelist->flags |= FL_NEED_INDEXING;
+	}
 }
 
 static void filelist_readjob_free(void *flrjv)
@@ -2710,7 +2716,7 @@ void filelist_readjob_start(FileList *filelist, const bContext *C)
 	flrj->filelist = filelist;
 	BLI_strncpy(flrj->main_name, G.main->name, sizeof(flrj->main_name));
 
-	filelist->flags &= ~(FL_FORCE_RESET | FL_IS_READY);
+	filelist->flags &= ~(FL_FORCE_RESET | FL_IS_READY | FL_NEED_INDEXING);
 	filelist->flags |= FL_IS_PENDING;
 
 	BLI_mutex_init(&flrj->lock);
@@ -2729,9 +2735,88 @@ void filelist_readjob_start(FileList *filelist, const bContext *C)
 void filelist_readjob_stop(wmWindowManager *wm, ScrArea *sa)
 {
 	WM_jobs_kill_type(wm, sa, WM_JOB_TYPE_FILESEL_READDIR);
+	WM_jobs_kill_type(wm, sa, WM_JOB_TYPE_FILESEL_INDEX);
 }
 
 int filelist_readjob_running(wmWindowManager *wm, ScrArea *sa)
 {
 	return WM_jobs_test(wm, sa, WM_JOB_TYPE_FILESEL_READDIR);
 }
+
+/* ********** Library Indexing ********** */
+
+/* Keeps the index of the listed .blend files up to date (see BLO_blend_index.h),
+ * so browsing into them doesn't have to scan the files. */
+
+typedef struct FileListIndexJob {
+	LinkNode *paths;  /* .blend files to index. */
+	int paths_num;
+} FileListIndexJob;
+
+static void filelist_indexjob_startjob(void *flijv, short *stop, short *UNUSED(do_update), float *progress)
+{
+	FileListIndexJob *flij = flijv;
+	LinkNode *ln;
+	int i;
+
+	BLO_blendindex_cache_cleanup();
+
+	for (i = 0, ln = flij->paths; ln && !(*stop); i++, ln = ln->next) {
+		BLO_blendindex_ensure(ln->link);
+		*progress = (float)(i + 1) / (float)flij->paths_num;
+	}
+}
+
+static void filelist_indexjob_free(void *flijv)
+{
+	FileListIndexJob *flij = flijv;
+
+	BLI_linklist_freeN(flij->paths);
+	MEM_freeN(flij);
+}
+
+/**
+ * Start indexing the .blend files of a library listing, once it's done.
+ */
+void filelist_indexjob_start(FileList *filelist, const bContext *C)
+{
+	wmJob *wm_job;
+	FileListIndexJob *flij;
+	FileListInternEntry *entry;
+	LinkNode *paths = NULL;
+	int paths_num = 0;
+
+	if ((filelist->flags & FL_NEED_INDEXING) == 0) {
+		return;
+	}
+	filelist->flags &= ~FL_NEED_INDEXING;
+
+	for (entry = filelist->filelist_intern.entries.first; entry; entry = entry->next) {
+		/* Only libraries we can browse into, this skips the current file. */
+		if ((entry->typeflag & (FILE_TYPE_BLENDER | FILE_TYPE_DIR)) == (FILE_TYPE_BLENDER | FILE_TYPE_DIR) &&
+		    (entry->typeflag & FILE_TYPE_BLENDERLIB) == 0)
+		{
+			char path[FILE_MAX];
+
+			BLI_join_dirfile(path, sizeof(path), filelist->filelist.root, entry->relpath);
+			BLI_linklist_prepend(&paths, BLI_strdup(path));
+			paths_num++;
+		}
+	}
+
+	if (paths == NULL) {
+		return;
+	}
+
+	flij = MEM_callocN(sizeof(*flij), __func__);
+	flij->paths = paths;
+	flij->paths_num = paths_num;
+
+	wm_job = WM_jobs_get(CTX_wm_manager(C), CTX_wm_window(C), CTX_wm_area(C), "Indexing Libraries...",
+	                     0, WM_JOB_TYPE_FILESEL_INDEX);
+	WM_jobs_customdata_set(wm_job, flij, filelist_indexjob_free);
+	WM_jobs_timer(wm_job, 0.1, 0, 0);
+	WM_jobs_callbacks(wm_job, filelist_indexjob_startjob, NULL, NULL, NULL);
+
+	WM_jobs_start(CTX_wm_manager(C), wm_job);
+}
@@ -118,6 +118,8 @@ void                filelist_readjob_start(struct FileList *filelist, const stru
 void                filelist_readjob_stop(struct wmWindowManager *wm, struct ScrArea *sa);
 int                 filelist_readjob_running(struct wmWindowManager *wm, struct ScrArea *sa);
 
+void                filelist_indexjob_start(struct FileList *filelist, const struct bContext *C);
+
 bool                filelist_cache_previews_update(struct FileList *filelist);
 void                filelist_cache_previews_set(struct FileList *filelist, const bool use_previews);
 bool                filelist_cache_previews_running(struct FileList *filelist);
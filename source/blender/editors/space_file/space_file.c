@@ -247,6 +247,9 @@ static void file_refresh(const bContext *C, ScrArea *sa)
 			filelist_readjob_start(sfile->files, C);
 		}
 	}
+	else if (filelist_is_ready(sfile->files)) {
+		filelist_indexjob_start(sfile->files, C);
+	}
 
 	filelist_sort(sfile->files);
 	filelist_filter(sfile->files);
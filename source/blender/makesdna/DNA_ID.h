@@ -353,6 +353,9 @@ enum {
 	/* RESET_AFTER_USE tag newly duplicated/copied IDs.
 	 * Also used internally in readfile.c to mark datablocks needing do_versions. */
 	LIB_TAG_NEW             = 1 << 8,
+	/* RESET_AFTER_USE datablock was changed since the last global undo step was written,
+	 * its undo data can't be shared with the previous step (see memfile undo). */
+	LIB_TAG_UNDO_CHANGED    = 1 << 9,
 	/* RESET_BEFORE_USE free test flag.
      * TODO make it a RESET_AFTER_USE too. */
 	LIB_TAG_DOIT            = 1 << 10,
@@ -132,7 +132,9 @@ enum {
 enum {
 	KEYBLOCK_MUTE       = (1 << 0),
 	KEYBLOCK_SEL        = (1 << 1),
-	KEYBLOCK_LOCKED     = (1 << 2)
+	KEYBLOCK_LOCKED     = (1 << 2),
+	/* Runtime, data is owned by the key-block of another key (copy-on-write). */
+	KEYBLOCK_DATA_NOFREE = (1 << 3),
 };
 
 #endif /* __DNA_KEY_TYPES_H__  */
@@ -38,8 +38,19 @@ typedef struct PackedFile {
 	int   size;
 	int   seek;
 	void *data;
+	/* When set, 'data' hasn't been read from the .blend file yet, see BKE_packedfile_ensure_data() */
+	struct PackedFileLazy *lazy;
 } PackedFile;
 
+/* Location of packed data in the .blend file it was loaded from (see BLO_READ_DEFER_PACKED). */
+typedef struct PackedFileLazy {
+	char filepath[1024];  /* 1024 = FILE_MAX */
+	uint64_t offset;  /* of the data's BHead in the (decompressed) file */
+	uint64_t old;  /* BHead.old of the data, to detect the file has been overwritten */
+	int is_framed;  /* block compressed file, see G_FILE_COMPRESS_FRAMES */
+	int pad;
+} PackedFileLazy;
+
 enum PF_FileStatus {
 	PF_EQUAL = 0,
 	PF_DIFFERS = 1,
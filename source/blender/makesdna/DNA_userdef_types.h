@@ -627,6 +627,7 @@ typedef enum eUserPref_Flag {
 	USER_NONEGFRAMES		= (1 << 24),
 	USER_TXT_TABSTOSPACES_DISABLE	= (1 << 25),
 	USER_TOOLTIPS_PYTHON    = (1 << 26),
+	USER_FILE_DEFER_PACKED	= (1 << 27),
 } eUserPref_Flag;
 
 /* bPathCompare.flag */
@@ -699,6 +700,7 @@ typedef enum eUserpref_UI_Flag2 {
 	USER_KEEP_SESSION			= (1 << 0),
 	USER_REGION_OVERLAP			= (1 << 1),
 	USER_TRACKPAD_NATURAL		= (1 << 2),
+	USER_GLOBALUNDO_LEGACY		= (1 << 3),
 } eUserpref_UI_Flag2;
 	
 /* Auto-Keying mode.
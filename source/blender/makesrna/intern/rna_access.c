@@ -239,6 +239,16 @@ static void rna_idproperty_touch(IDProperty *idprop)
 	idprop->flag &= ~IDP_FLAG_GHOST;
 }
 
+/* the ID of 'ptr' is modified, it can't share its undo data with the previous undo step */
+static void rna_property_tag_undo_changed(PointerRNA *ptr)
+{
+	ID *id = ptr->id.data;
+
+	if (id && !(id->tag & LIB_TAG_UNDO_CHANGED)) {
+		BKE_id_tag_set_atomic(id, LIB_TAG_UNDO_CHANGED);
+	}
+}
+
 /* return a UI local ID prop definition for this prop */
 static IDProperty *rna_idproperty_ui(PropertyRNA *prop)
 {
@@ -1810,6 +1820,8 @@ static void rna_property_update(bContext *C, Main *bmain, Scene *scene, PointerR
 	const bool is_rna = (prop->magic == RNA_MAGIC);
 	prop = rna_ensure_property(prop);
 
+	rna_property_tag_undo_changed(ptr);
+
 	if (is_rna) {
 		if (prop->update) {
 			/* ideally no context would be needed for update, but there's some
@@ -2007,6 +2019,8 @@ void RNA_property_boolean_set(PointerRNA *ptr, PropertyRNA *prop, int value)
 	BLI_assert(RNA_property_array_check(prop) == false);
 	BLI_assert(ELEM(value, false, true));
 
+	rna_property_tag_undo_changed(ptr);
+
 	/* just in case other values are passed */
 	if (value) value = 1;
 
@@ -2095,6 +2109,8 @@ void RNA_property_boolean_set_array(PointerRNA *ptr, PropertyRNA *prop, const in
 	BLI_assert(RNA_property_type(prop) == PROP_BOOLEAN);
 	BLI_assert(RNA_property_array_check(prop) != false);
 
+	rna_property_tag_undo_changed(ptr);
+
 	if ((idprop = rna_idproperty_check(&prop, ptr))) {
 		if (prop->arraydimension == 0)
 			IDP_Int(idprop) = values[0];
@@ -2136,6 +2152,8 @@ void RNA_property_boolean_set_index(PointerRNA *ptr, PropertyRNA *prop, int inde
 	BLI_assert(index < len);
 	BLI_assert(ELEM(value, false, true));
 
+	rna_property_tag_undo_changed(ptr);
+
 	if (len <= RNA_MAX_ARRAY_LENGTH) {
 		RNA_property_boolean_get_array(ptr, prop, tmp);
 		tmp[index] = value;
@@ -2232,6 +2250,8 @@ void RNA_property_int_set(PointerRNA *ptr, PropertyRNA *prop, int value)
 	/* useful to check on bad values but set function should clamp */
 	/* BLI_assert(RNA_property_int_clamp(ptr, prop, &value) == 0); */
 
+	rna_property_tag_undo_changed(ptr);
+
 	if ((idprop = rna_idproperty_check(&prop, ptr))) {
 		RNA_property_int_clamp(ptr, prop, &value);
 		IDP_Int(idprop) = value;
@@ -2353,6 +2373,8 @@ void RNA_property_int_set_array(PointerRNA *ptr, PropertyRNA *prop, const int *v
 	BLI_assert(RNA_property_type(prop) == PROP_INT);
 	BLI_assert(RNA_property_array_check(prop) != false);
 
+	rna_property_tag_undo_changed(ptr);
+
 	if ((idprop = rna_idproperty_check(&prop, ptr))) {
 		BLI_assert(idprop->len == RNA_property_array_length(ptr, prop) || (prop->flag & PROP_IDPROPERTY));
 		if (prop->arraydimension == 0)
@@ -2396,6 +2418,8 @@ void RNA_property_int_set_index(PointerRNA *ptr, PropertyRNA *prop, int index, i
 	BLI_assert(index >= 0);
 	BLI_assert(index < len);
 
+	rna_property_tag_undo_changed(ptr);
+
 	if (len <= RNA_MAX_ARRAY_LENGTH) {
 		RNA_property_int_get_array(ptr, prop, tmp);
 		tmp[index] = value;
@@ -2491,6 +2515,8 @@ void RNA_property_float_set(PointerRNA *ptr, PropertyRNA *prop, float value)
 	/* useful to check on bad values but set function should clamp */
 	/* BLI_assert(RNA_property_float_clamp(ptr, prop, &value) == 0); */
 
+	rna_property_tag_undo_changed(ptr);
+
 	if ((idprop = rna_idproperty_check(&prop, ptr))) {
 		RNA_property_float_clamp(ptr, prop, &value);
 		if (idprop->type == IDP_FLOAT)
@@ -2625,6 +2651,8 @@ void RNA_property_float_set_array(PointerRNA *ptr, PropertyRNA *prop, const floa
 	BLI_assert(RNA_property_type(prop) == PROP_FLOAT);
 	BLI_assert(RNA_property_array_check(prop) != false);
 
+	rna_property_tag_undo_changed(ptr);
+
 	if ((idprop = rna_idproperty_check(&prop, ptr))) {
 		BLI_assert(idprop->len == RNA_property_array_length(ptr, prop) || (prop->flag & PROP_IDPROPERTY));
 		if (prop->arraydimension == 0) {
@@ -2679,6 +2707,8 @@ void RNA_property_float_set_index(PointerRNA *ptr, PropertyRNA *prop, int index,
 	BLI_assert(index >= 0);
 	BLI_assert(index < len);
 
+	rna_property_tag_undo_changed(ptr);
+
 	if (len <= RNA_MAX_ARRAY_LENGTH) {
 		RNA_property_float_get_array(ptr, prop, tmp);
 		tmp[index] = value;
@@ -2846,6 +2876,8 @@ void RNA_property_string_set(PointerRNA *ptr, PropertyRNA *prop, const char *val
 
 	BLI_assert(RNA_property_type(prop) == PROP_STRING);
 
+	rna_property_tag_undo_changed(ptr);
+
 	if ((idprop = rna_idproperty_check(&prop, ptr))) {
 		/* both IDP_STRING_SUB_BYTE / IDP_STRING_SUB_UTF8 */
 		IDP_AssignString(idprop, value, RNA_property_string_maxlength(prop) - 1);
@@ -2926,6 +2958,8 @@ void RNA_property_enum_set(PointerRNA *ptr, PropertyRNA *prop, int value)
 
 	BLI_assert(RNA_property_type(prop) == PROP_ENUM);
 
+	rna_property_tag_undo_changed(ptr);
+
 	if ((idprop = rna_idproperty_check(&prop, ptr))) {
 		IDP_Int(idprop) = value;
 		rna_idproperty_touch(idprop);
@@ -3050,6 +3084,8 @@ void RNA_property_pointer_set(PointerRNA *ptr, PropertyRNA *prop, PointerRNA ptr
 		return;
 	}
 
+	rna_property_tag_undo_changed(ptr);
+
 	/* RNA */
 	if (pprop->set &&
 	    !((prop->flag & PROP_NEVER_NULL) && ptr_value.data == NULL) &&
@@ -3086,6 +3122,8 @@ void RNA_property_pointer_add(PointerRNA *ptr, PropertyRNA *prop)
 
 	BLI_assert(RNA_property_type(prop) == PROP_POINTER);
 
+	rna_property_tag_undo_changed(ptr);
+
 	if ((/*idprop=*/ rna_idproperty_check(&prop, ptr))) {
 		/* already exists */
 	}
@@ -3109,6 +3147,8 @@ void RNA_property_pointer_remove(PointerRNA *ptr, PropertyRNA *prop)
 
 	BLI_assert(RNA_property_type(prop) == PROP_POINTER);
 
+	rna_property_tag_undo_changed(ptr);
+
 	if ((idprop = rna_idproperty_check(&prop, ptr))) {
 		group = RNA_struct_idprops(ptr, 0);
 		
@@ -3237,6 +3277,8 @@ void RNA_property_collection_add(PointerRNA *ptr, PropertyRNA *prop, PointerRNA
 
 	BLI_assert(RNA_property_type(prop) == PROP_COLLECTION);
 
+	rna_property_tag_undo_changed(ptr);
+
 	if ((idprop = rna_idproperty_check(&prop, ptr))) {
 		IDPropertyTemplate val = {0};
 		IDProperty *item;
@@ -3300,6 +3342,8 @@ bool RNA_property_collection_remove(PointerRNA *ptr, PropertyRNA *prop, int key)
 
 	BLI_assert(RNA_property_type(prop) == PROP_COLLECTION);
 
+	rna_property_tag_undo_changed(ptr);
+
 	if ((idprop = rna_idproperty_check(&prop, ptr))) {
 		IDProperty tmp, *array;
 		int len;
@@ -3351,6 +3395,8 @@ bool RNA_property_collection_move(PointerRNA *ptr, PropertyRNA *prop, int key, i
 
 	BLI_assert(RNA_property_type(prop) == PROP_COLLECTION);
 
+	rna_property_tag_undo_changed(ptr);
+
 	if ((idprop = rna_idproperty_check(&prop, ptr))) {
 		IDProperty tmp, *array;
 		int len;
@@ -3382,6 +3428,8 @@ void RNA_property_collection_clear(PointerRNA *ptr, PropertyRNA *prop)
 
 	BLI_assert(RNA_property_type(prop) == PROP_COLLECTION);
 
+	rna_property_tag_undo_changed(ptr);
+
 	if ((idprop = rna_idproperty_check(&prop, ptr))) {
 		IDP_ResizeIDPArray(idprop, 0);
 		rna_idproperty_touch(idprop);
@@ -5507,6 +5555,7 @@ void RNA_property_unset(PointerRNA *ptr, PropertyRNA *prop)
 {
 	prop = rna_ensure_property(prop);
 	if (prop->flag & PROP_IDPROPERTY) {
+		rna_property_tag_undo_changed(ptr);
 		rna_idproperty_free(ptr, prop->identifier);
 	}
 }
@@ -160,6 +160,29 @@ static void rna_Depsgraph_debug_stats(Depsgraph *graph, ReportList *reports)
 	            ops, rels, outer);
 }
 
+static int rna_Depsgraph_use_debug_timing_get(PointerRNA *ptr)
+{
+	return DEG_debug_timing_is_enabled((Depsgraph *)ptr->data);
+}
+
+static void rna_Depsgraph_use_debug_timing_set(PointerRNA *ptr, int value)
+{
+	DEG_debug_timing_set_enabled((Depsgraph *)ptr->data, value != 0);
+}
+
+static void rna_Depsgraph_debug_timing_export(Depsgraph *graph, ReportList *reports, const char *filename)
+{
+	FILE *f = fopen(filename, "w");
+	if (f == NULL) {
+		BKE_reportf(reports, RPT_ERROR, "Could not open file '%s' for writing", filename);
+		return;
+	}
+
+	DEG_debug_timing_chrome_trace(graph, f);
+
+	fclose(f);
+}
+
 /* Iteration over objects, simple version */
 
 static void rna_Depsgraph_objects_begin(CollectionPropertyIterator *iter, PointerRNA *ptr)
@@ -318,6 +341,19 @@ static void rna_def_depsgraph(BlenderRNA *brna)
 	RNA_def_function_ui_description(func, "Report the number of elements in the Dependency Graph");
 	RNA_def_function_flag(func, FUNC_USE_REPORTS);
 
+	prop = RNA_def_property(srna, "use_debug_timing", PROP_BOOLEAN, PROP_NONE);
+	RNA_def_property_clear_flag(prop, PROP_ANIMATABLE);
+	RNA_def_property_boolean_funcs(prop, "rna_Depsgraph_use_debug_timing_get", "rna_Depsgraph_use_debug_timing_set");
+	RNA_def_property_ui_text(prop, "Debug Timing",
+	                         "Record how long each operation took in the last evaluation, and which thread ran it");
+
+	func = RNA_def_function(srna, "debug_timing_export", "rna_Depsgraph_debug_timing_export");
+	RNA_def_function_ui_description(func, "Write timings of the last evaluation in Chrome trace format");
+	RNA_def_function_flag(func, FUNC_USE_REPORTS);
+	parm = RNA_def_string_file_path(func, "filename", NULL, FILE_MAX, "File Name",
+	                                "File in which to store the trace (open with chrome://tracing)");
+	RNA_def_parameter_flags(parm, 0, PARM_REQUIRED);
+
 	prop = RNA_def_property(srna, "objects", PROP_COLLECTION, PROP_NONE);
 	RNA_def_property_struct_type(prop, "Object");
 	RNA_def_property_collection_funcs(prop,
@@ -45,16 +45,26 @@ EnumPropertyItem rna_enum_unpack_method_items[] = {
 
 #ifdef RNA_RUNTIME
 
+#include "BKE_packedFile.h"
+
 static void rna_PackedImage_data_get(PointerRNA *ptr, char *value)
 {
 	PackedFile *pf = (PackedFile *)ptr->data;
-	memcpy(value, pf->data, (size_t)pf->size);
-	value[pf->size] = '\0';
+	if (BKE_packedfile_ensure_data(pf, NULL)) {
+		memcpy(value, pf->data, (size_t)pf->size);
+		value[pf->size] = '\0';
+	}
+	else {
+		value[0] = '\0';
+	}
 }
 
 static int rna_PackedImage_data_len(PointerRNA *ptr)
 {
 	PackedFile *pf = (PackedFile *)ptr->data;
+	if (!BKE_packedfile_ensure_data(pf, NULL)) {
+		return 0;
+	}
 	return pf->size;  /* No need to include trailing NULL char here! */
 }
 
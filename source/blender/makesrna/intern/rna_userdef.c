@@ -3634,6 +3634,12 @@ static void rna_def_userdef_edit(BlenderRNA *brna)
 	                         "Global undo works by keeping a full copy of the file itself in memory, "
 	                         "so takes extra memory");
 
+	prop = RNA_def_property(srna, "use_global_undo_legacy", PROP_BOOLEAN, PROP_NONE);
+	RNA_def_property_boolean_sdna(prop, NULL, "uiflag2", USER_GLOBALUNDO_LEGACY);
+	RNA_def_property_ui_text(prop, "Legacy Global Undo",
+	                         "Read the whole file on each undo step, instead of keeping data which didn't change "
+	                         "(slower, for troubleshooting)");
+
 	/* auto keyframing */
 	prop = RNA_def_property(srna, "use_auto_keying", PROP_BOOLEAN, PROP_NONE);
 	RNA_def_property_boolean_sdna(prop, NULL, "autokey_mode", AUTOKEY_ON);
@@ -4481,6 +4487,12 @@ static void rna_def_userdef_filepaths(BlenderRNA *brna)
 	RNA_def_property_boolean_sdna(prop, NULL, "flag", USER_FILECOMPRESS);
 	RNA_def_property_ui_text(prop, "Compress File", "Enable file compression when saving .blend files");
 
+	prop = RNA_def_property(srna, "use_load_packed_deferred", PROP_BOOLEAN, PROP_NONE);
+	RNA_def_property_boolean_sdna(prop, NULL, "flag", USER_FILE_DEFER_PACKED);
+	RNA_def_property_ui_text(prop, "Load Packed Data on Demand",
+	                         "Read packed files (images, sounds, fonts) from .blend files when they're first used, "
+	                         "instead of when the file is opened");
+
 	prop = RNA_def_property(srna, "use_load_ui", PROP_BOOLEAN, PROP_NONE);
 	RNA_def_property_boolean_negative_sdna(prop, NULL, "flag", USER_FILENOUI);
 	RNA_def_property_ui_text(prop, "Load UI", "Load user interface setup when loading .blend files");
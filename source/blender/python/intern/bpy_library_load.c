@@ -38,6 +38,7 @@
 #include "BLI_linklist.h"
 #include "BLI_path_util.h"
 
+#include "BLO_blend_index.h"
 #include "BLO_readfile.h"
 
 #include "BKE_main.h"
@@ -216,13 +217,13 @@ static PyObject *bpy_lib_load(PyObject *UNUSED(self), PyObject *args, PyObject *
 	return (PyObject *)ret;
 }
 
-static PyObject *_bpy_names(BPy_Library *self, int blocktype)
+static PyObject *_bpy_names(const BlendIndex *index, int blocktype)
 {
 	PyObject *list;
 	LinkNode *l, *names;
 	int totnames;
 
-	names = BLO_blendhandle_get_datablock_names(self->blo_handle, blocktype, &totnames);
+	names = BLO_blendindex_get_datablock_names(index, blocktype, &totnames);
 	list = PyList_New(totnames);
 
 	if (names) {
@@ -257,7 +258,22 @@ static PyObject *bpy_lib_enter(BPy_Library *self, PyObject *UNUSED(args))
 		return NULL;
 	}
 	else {
+		/* List names from the index, so the file isn't scanned once per ID type,
+		 * when the index isn't cached yet it's made from the already open file. */
+		BlendIndex *index = BLO_blendindex_get_from_handle(self->blo_handle, self->abspath, false);
 		int i = 0, code;
+
+		if (index == NULL) {
+			BLO_blendhandle_close(self->blo_handle);
+			self->blo_handle = NULL;
+			Py_DECREF(from_dict);
+			BKE_reports_clear(&reports);
+			PyErr_Format(PyExc_IOError,
+			             "load: %s failed to read blend file",
+			             self->abspath);
+			return NULL;
+		}
+
 		while ((code = BKE_idcode_iter_step(&i))) {
 			if (BKE_idcode_is_linkable(code)) {
 				const char *name_plural = BKE_idcode_to_name_plural(code);
@@ -266,12 +282,14 @@ static PyObject *bpy_lib_enter(BPy_Library *self, PyObject *UNUSED(args))
 
 				PyDict_SetItem(self->dict, str, item = PyList_New(0));
 				Py_DECREF(item);
-				PyDict_SetItem(from_dict, str, item = _bpy_names(self, code));
+				PyDict_SetItem(from_dict, str, item = _bpy_names(index, code));
 				Py_DECREF(item);
 
 				Py_DECREF(str);
 			}
 		}
+
+		BLO_blendindex_free(index);
 	}
 
 	/* create a dummy */
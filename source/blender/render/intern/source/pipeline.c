@@ -54,6 +54,7 @@
 #include "BLI_timecode.h"
 #include "BLI_fileops.h"
 #include "BLI_threads.h"
+#include "BLI_trace.h"
 #include "BLI_rand.h"
 #include "BLI_callbacks.h"
 
@@ -1376,9 +1377,9 @@ static void threaded_tile_processor(Render *re)
 	/* set threadsafe break */
 	R.test_break = thread_break;
 	
-	/* create and fill work queue */
-	workqueue = BLI_thread_queue_init();
-	donequeue = BLI_thread_queue_init();
+	/* create and fill work queue, all parts fit so pushing never waits */
+	workqueue = BLI_thread_queue_init_lockfree((unsigned int)BLI_listbase_count(&re->parts));
+	donequeue = BLI_thread_queue_init_lockfree((unsigned int)BLI_listbase_count(&re->parts));
 	
 	/* for panorama we loop over slices */
 	while (find_next_pano_slice(re, &slice, &minx, &viewplane)) {
@@ -2793,6 +2794,8 @@ static void do_render_all_options(Render *re)
 	Object *camera;
 	bool render_seq = false;
 
+	BLI_TRACE_BEGIN("render", "render_frame");
+
 	re->current_scene_update(re->suh, re->scene);
 
 	BKE_scene_camera_switch_update(re->scene);
@@ -2809,7 +2812,9 @@ static void do_render_all_options(Render *re)
 	else if (RE_seq_render_active(re->scene, &re->r)) {
 		/* note: do_render_seq() frees rect32 when sequencer returns float images */
 		if (!re->test_break(re->tbh)) {
+			BLI_TRACE_BEGIN("render", "sequencer");
 			do_render_seq(re);
+			BLI_TRACE_END();
 			render_seq = true;
 		}
 		
@@ -2819,7 +2824,9 @@ static void do_render_all_options(Render *re)
 	else {
 		re->pool = BKE_image_pool_new();
 
+		BLI_TRACE_BEGIN("render", "render_composite");
 		do_render_composite_fields_blur_3d(re);
+		BLI_TRACE_END();
 
 		BKE_image_pool_free(re->pool);
 		re->pool = NULL;
@@ -2842,6 +2849,8 @@ static void do_render_all_options(Render *re)
 			re->display_update(re->duh, re->result, NULL);
 		}
 	}
+
+	BLI_TRACE_END();
 }
 
 bool RE_force_single_renderlayer(Scene *scene)
@@ -3471,6 +3480,8 @@ static int do_write_image_or_movie(Render *re, Main *bmain, Scene *scene, bMovie
 	double render_time;
 	bool ok = true;
 
+	BLI_TRACE_BEGIN("render", "write_image");
+
 	RE_AcquireResultImageViews(re, &rres);
 
 	/* write movie or image */
@@ -3491,6 +3502,8 @@ static int do_write_image_or_movie(Render *re, Main *bmain, Scene *scene, bMovie
 	
 	RE_ReleaseResultImageViews(re, &rres);
 
+	BLI_TRACE_END();
+
 	render_time = re->i.lastframetime;
 	re->i.lastframetime = PIL_check_seconds_timer() - re->i.starttime;
 	
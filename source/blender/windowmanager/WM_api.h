@@ -464,6 +464,7 @@ enum {
 	WM_JOB_TYPE_OBJECT_BAKE_TEXTURE,
 	WM_JOB_TYPE_OBJECT_BAKE,
 	WM_JOB_TYPE_FILESEL_READDIR,
+	WM_JOB_TYPE_FILESEL_INDEX,
 	WM_JOB_TYPE_CLIP_BUILD_PROXY,
 	WM_JOB_TYPE_CLIP_TRACK_MARKERS,
 	WM_JOB_TYPE_CLIP_SOLVE_CAMERA,
@@ -473,6 +474,7 @@ enum {
 	WM_JOB_TYPE_POINTCACHE,
 	WM_JOB_TYPE_DPAINT_BAKE,
 	WM_JOB_TYPE_ALEMBIC,
+	WM_JOB_TYPE_FILE_WRITE,
 	/* add as needed, screencast, seq proxy build
 	 * if having hard coded values is a problem */
 };
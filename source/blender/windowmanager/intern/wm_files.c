@@ -89,6 +89,7 @@
 #include "BKE_workspace.h"
 
 #include "BLO_readfile.h"
+#include "BLO_undofile.h"
 #include "BLO_writefile.h"
 
 #include "RNA_access.h"
@@ -369,7 +370,7 @@ static int wm_read_exotic(const char *name)
 {
 	int len;
 	gzFile gzfile;
-	char header[7];
+	char header[8];
 	int retval;
 
 	/* make sure we're not trying to read a directory.... */
@@ -386,7 +387,8 @@ static int wm_read_exotic(const char *name)
 		else {
 			len = gzread(gzfile, header, sizeof(header));
 			gzclose(gzfile);
-			if (len == sizeof(header) && STREQLEN(header, "BLENDER", 7)) {
+			/* plain/gzip or block compressed (see: G_FILE_COMPRESS_FRAMES) */
+			if ((len == sizeof(header)) && (STREQLEN(header, "BLENDER", 7) || STREQLEN(header, "BLENDFRM", 8))) {
 				retval = BKE_READ_EXOTIC_OK_BLEND;
 			}
 			else {
@@ -564,7 +566,9 @@ bool WM_file_read(bContext *C, const char *filepath, ReportList *reports)
 		
 		/* confusing this global... */
 		G.relbase_valid = 1;
-		retval = BKE_blendfile_read(C, filepath, reports, 0);
+		retval = BKE_blendfile_read(
+		        C, filepath, reports,
+		        (U.flag & USER_FILE_DEFER_PACKED) ? BLO_READ_DEFER_PACKED : 0);
 		/* when loading startup.blend's, we can be left with a blank path */
 		if (G.main->name[0]) {
 			G.save_over = 1;
@@ -1078,14 +1082,121 @@ bool write_crash_blend(void)
 	}
 }
 
+/************************ file write job ****************************/
+
+/* Writing a snapshot of the file (see #BLO_write_file_snapshot) to disk, the main thread continues meanwhile. */
+typedef struct FileWriteJob {
+	MemFile snapshot;
+	char filepath[FILE_MAX];
+	int fileflags;
+	/* written after the file (owned by the job) */
+	ImBuf *ibuf_thumb;
+	bool is_autosave;
+
+	ReportList reports;
+	bool success;
+} FileWriteJob;
+
+static void wm_file_write_job_startjob(void *customdata, short *UNUSED(stop), short *UNUSED(do_update), float *UNUSED(progress))
+{
+	FileWriteJob *fwj = customdata;
+
+	/* Never stopped halfway, waiting for the job (see #WM_jobs_kill_type) makes sure the file is written. */
+	fwj->success = BLO_write_file_from_snapshot(&fwj->snapshot, fwj->filepath, fwj->fileflags, &fwj->reports);
+	BLO_memfile_free(&fwj->snapshot);
+
+	if (fwj->success && fwj->ibuf_thumb) {
+		IMB_thumb_delete(fwj->filepath, THB_FAIL); /* without this a failed thumb overrides */
+		fwj->ibuf_thumb = IMB_thumb_create(fwj->filepath, THB_LARGE, THB_SOURCE_BLEND, fwj->ibuf_thumb);
+	}
+}
+
+static void wm_file_write_job_endjob(void *customdata)
+{
+	FileWriteJob *fwj = customdata;
+
+	if (fwj->is_autosave) {
+		/* Error reporting into console */
+		BKE_reports_print(&fwj->reports, RPT_ERROR);
+	}
+	else if (fwj->success) {
+		BLI_callback_exec(G.main, NULL, BLI_CB_EVT_SAVE_POST);
+	}
+	else {
+		wmWindowManager *wm = G.main->wm.first;
+		Report *report;
+
+		/* the file was marked as saved when the write started */
+		if (wm) {
+			wm->file_saved = 0;
+		}
+		WM_main_add_notifier(NC_WM | ND_DATACHANGED, NULL);
+
+		for (report = fwj->reports.list.first; report; report = report->next) {
+			WM_reportf(report->type, "%s (%s)", report->message, fwj->filepath);
+		}
+	}
+}
+
+static void wm_file_write_job_free(void *customdata)
+{
+	FileWriteJob *fwj = customdata;
+
+	BLO_memfile_free(&fwj->snapshot);
+	if (fwj->ibuf_thumb) {
+		IMB_freeImBuf(fwj->ibuf_thumb);
+	}
+	BKE_reports_clear(&fwj->reports);
+	MEM_freeN(fwj);
+}
+
+static FileWriteJob *wm_file_write_job_new(const char *filepath, int fileflags, bool is_autosave)
+{
+	FileWriteJob *fwj = MEM_callocN(sizeof(*fwj), __func__);
+
+	BLI_strncpy(fwj->filepath, filepath, sizeof(fwj->filepath));
+	fwj->fileflags = fileflags;
+	fwj->is_autosave = is_autosave;
+	BKE_reports_init(&fwj->reports, RPT_STORE);
+
+	return fwj;
+}
+
 /**
+ * Write the snapshot of \a fwj in a job, takes ownership of \a fwj.
+ */
+static void wm_file_write_job_start(wmWindowManager *wm, FileWriteJob *fwj)
+{
+	wmJob *wm_job;
+
+	wm_job = WM_jobs_get(wm, NULL, wm, "Saving", 0, WM_JOB_TYPE_FILE_WRITE);
+	WM_jobs_customdata_set(wm_job, fwj, wm_file_write_job_free);
+	WM_jobs_timer(wm_job, 0.1, 0, 0);
+	WM_jobs_callbacks(wm_job, wm_file_write_job_startjob, NULL, NULL, wm_file_write_job_endjob);
+
+	WM_jobs_start(wm, wm_job);
+}
+
+/**
+ * Finish writing files in progress, one file is written at a time.
+ */
+static void wm_file_write_job_wait(wmWindowManager *wm)
+{
+	WM_jobs_kill_type(wm, wm, WM_JOB_TYPE_FILE_WRITE);
+}
+
+/**
+ * \param use_job: Only take a snapshot of the file, compression and disk access happen in a job,
+ * so the UI doesn't wait for the file write. Not for scripts which expect the file to exist afterwards.
+ *
  * \see #wm_homefile_write_exec wraps #BLO_write_file in a similar way.
  */
-static int wm_file_write(bContext *C, const char *filepath, int fileflags, ReportList *reports)
+static int wm_file_write(bContext *C, const char *filepath, int fileflags, ReportList *reports, const bool use_job)
 {
 	Library *li;
 	int len;
 	int ret = -1;
+	bool success = false;
 	BlendThumbnail *thumb, *main_thumb;
 	ImBuf *ibuf_thumb = NULL;
 
@@ -1151,8 +1262,29 @@ static int wm_file_write(bContext *C, const char *filepath, int fileflags, Repor
 
 	/* XXX temp solution to solve bug, real fix coming (ton) */
 	G.main->recovered = 0;
-	
-	if (BLO_write_file(CTX_data_main(C), filepath, fileflags, reports, thumb)) {
+
+	if (use_job) {
+		FileWriteJob *fwj = wm_file_write_job_new(filepath, fileflags, false);
+
+		wm_file_write_job_wait(CTX_wm_manager(C));
+
+		if (BLO_write_file_snapshot(CTX_data_main(C), filepath, fileflags, thumb, reports, &fwj->snapshot)) {
+			/* the thumbnail is written by the job too */
+			SWAP(ImBuf *, fwj->ibuf_thumb, ibuf_thumb);
+			wm_file_write_job_start(CTX_wm_manager(C), fwj);
+			success = true;
+		}
+		else {
+			BKE_reportf(reports, RPT_ERROR, "Cannot save blend file '%s'", filepath);
+			wm_file_write_job_free(fwj);
+			success = false;
+		}
+	}
+	else {
+		success = BLO_write_file(CTX_data_main(C), filepath, fileflags, reports, thumb);
+	}
+
+	if (success) {
 		const bool do_history = (G.background == false) && (CTX_wm_manager(C)->op_undo_depth == 0);
 
 		if (!(fileflags & G_FILE_SAVE_COPY)) {
@@ -1163,6 +1295,7 @@ static int wm_file_write(bContext *C, const char *filepath, int fileflags, Repor
 		}
 
 		BKE_BIT_TEST_SET(G.fileflags, fileflags & G_FILE_COMPRESS, G_FILE_COMPRESS);
+		BKE_BIT_TEST_SET(G.fileflags, fileflags & G_FILE_COMPRESS_FRAMES, G_FILE_COMPRESS_FRAMES);
 		BKE_BIT_TEST_SET(G.fileflags, fileflags & G_FILE_AUTOPLAY, G_FILE_AUTOPLAY);
 
 		/* prevent background mode scripts from clobbering history */
@@ -1170,7 +1303,10 @@ static int wm_file_write(bContext *C, const char *filepath, int fileflags, Repor
 			wm_history_file_update();
 		}
 
-		BLI_callback_exec(G.main, NULL, BLI_CB_EVT_SAVE_POST);
+		/* the job does this once the file is written */
+		if (!use_job) {
+			BLI_callback_exec(G.main, NULL, BLI_CB_EVT_SAVE_POST);
+		}
 
 		/* run this function after because the file cant be written before the blend is */
 		if (ibuf_thumb) {
@@ -1243,38 +1379,60 @@ void wm_autosave_timer(const bContext *C, wmWindowManager *wm, wmTimer *UNUSED(w
 {
 	wmWindow *win;
 	wmEventHandler *handler;
+	FileWriteJob *fwj;
 	char filepath[FILE_MAX];
+	bool success;
 	
 	WM_event_remove_timer(wm, NULL, wm->autosavetimer);
 
-	/* if a modal operator is running, don't autosave, but try again in 10 seconds */
-	for (win = wm->windows.first; win; win = win->next) {
-		for (handler = win->modalhandlers.first; handler; handler = handler->next) {
-			if (handler->op) {
-				wm->autosavetimer = WM_event_add_timer(wm, NULL, TIMERAUTOSAVE, 10.0);
-				if (G.debug) {
-					printf("Skipping auto-save, modal operator running, retrying in ten seconds...\n");
-				}
-				return;
-			}
-		}
+	/* if a file is still being written, try again in 10 seconds */
+	if (WM_jobs_test(wm, wm, WM_JOB_TYPE_FILE_WRITE)) {
+		wm->autosavetimer = WM_event_add_timer(wm, NULL, TIMERAUTOSAVE, 10.0);
+		return;
 	}
 
 	wm_autosave_location(filepath);
 
-	if (U.uiflag & USER_GLOBALUNDO) {
-		/* fast save of last undobuffer, now with UI */
-		BKE_undo_save_file(filepath);
+	/* Compression and disk access happen in a job, not compressed since it's a temporary file. */
+	fwj = wm_file_write_job_new(filepath, 0, true);
+
+	/* Undo keeps deferred packed data as a reference to the file it was loaded from,
+	 * save the data itself in the auto-save file. */
+	if ((U.uiflag & USER_GLOBALUNDO) && !BKE_packedfile_has_deferred(CTX_data_main(C))) {
+		/* fast copy of last undobuffer, now with UI,
+		 * this doesn't access main so it's fine while modal operators run */
+		success = BKE_undo_memfile_copy(&fwj->snapshot);
 	}
 	else {
+		/* if a modal operator is running, don't autosave, but try again in 10 seconds */
+		for (win = wm->windows.first; win; win = win->next) {
+			for (handler = win->modalhandlers.first; handler; handler = handler->next) {
+				if (handler->op) {
+					wm->autosavetimer = WM_event_add_timer(wm, NULL, TIMERAUTOSAVE, 10.0);
+					if (G.debug) {
+						printf("Skipping auto-save, modal operator running, retrying in ten seconds...\n");
+					}
+					wm_file_write_job_free(fwj);
+					return;
+				}
+			}
+		}
+
 		/*  save as regular blend file */
-		int fileflags = G.fileflags & ~(G_FILE_COMPRESS | G_FILE_AUTOPLAY | G_FILE_HISTORY);
+		int fileflags = G.fileflags & ~(G_FILE_COMPRESS | G_FILE_COMPRESS_FRAMES | G_FILE_AUTOPLAY | G_FILE_HISTORY);
 
 		ED_editors_flush_edits(C, false);
 
-		/* Error reporting into console */
-		BLO_write_file(CTX_data_main(C), filepath, fileflags, NULL, NULL);
+		success = BLO_write_file_snapshot(CTX_data_main(C), filepath, fileflags, NULL, NULL, &fwj->snapshot);
+	}
+
+	if (success) {
+		wm_file_write_job_start(wm, fwj);
+	}
+	else {
+		wm_file_write_job_free(fwj);
 	}
+
 	/* do timer after file write, just in case file write takes a long time */
 	wm->autosavetimer = WM_event_add_timer(wm, NULL, TIMERAUTOSAVE, U.savetime * 60.0);
 }
@@ -1395,7 +1553,7 @@ static int wm_homefile_write_exec(bContext *C, wmOperator *op)
 	ED_editors_flush_edits(C, false);
 
 	/*  force save as regular blend file */
-	fileflags = G.fileflags & ~(G_FILE_COMPRESS | G_FILE_AUTOPLAY | G_FILE_HISTORY);
+	fileflags = G.fileflags & ~(G_FILE_COMPRESS | G_FILE_COMPRESS_FRAMES | G_FILE_AUTOPLAY | G_FILE_HISTORY);
 
 	if (BLO_write_file(CTX_data_main(C), filepath, fileflags | G_FILE_USERPREFS, op->reports, NULL) == 0) {
 		printf("fail\n");
@@ -2015,6 +2173,13 @@ static void save_set_compress(wmOperator *op)
 			RNA_property_boolean_set(op->ptr, prop, (U.flag & USER_FILECOMPRESS) != 0);
 		}
 	}
+
+	prop = RNA_struct_find_property(op->ptr, "compress_frames");
+	if (!RNA_property_is_set(op->ptr, prop)) {
+		if (G.save_over) {  /* keep flag for existing file */
+			RNA_property_boolean_set(op->ptr, prop, (G.fileflags & G_FILE_COMPRESS_FRAMES) != 0);
+		}
+	}
 }
 
 static void save_set_filepath(wmOperator *op)
@@ -2054,6 +2219,7 @@ static int wm_save_as_mainfile_exec(bContext *C, wmOperator *op)
 {
 	char path[FILE_MAX];
 	int fileflags;
+	bool use_job;
 
 	save_set_compress(op);
 
@@ -2070,6 +2236,8 @@ static int wm_save_as_mainfile_exec(bContext *C, wmOperator *op)
 	/* set compression flag */
 	BKE_BIT_TEST_SET(fileflags, RNA_boolean_get(op->ptr, "compress"),
 	                 G_FILE_COMPRESS);
+	BKE_BIT_TEST_SET(fileflags, RNA_boolean_get(op->ptr, "compress_frames"),
+	                 G_FILE_COMPRESS_FRAMES);
 	BKE_BIT_TEST_SET(fileflags, RNA_boolean_get(op->ptr, "relative_remap"),
 	                 G_FILE_RELATIVE_REMAP);
 	BKE_BIT_TEST_SET(fileflags,
@@ -2086,7 +2254,11 @@ static int wm_save_as_mainfile_exec(bContext *C, wmOperator *op)
 #  error "don't remove by accident"
 #endif
 
-	if (wm_file_write(C, path, fileflags, op->reports) != 0)
+	/* Interactive saves are written in the background,
+	 * scripts expect the file once the operator is done (undo depth is only set when called from python). */
+	use_job = (G.background == false) && (CTX_wm_manager(C)->op_undo_depth == 0);
+
+	if (wm_file_write(C, path, fileflags, op->reports, use_job) != 0)
 		return OPERATOR_CANCELLED;
 
 	WM_event_add_notifier(C, NC_WM | ND_FILESAVE, NULL);
@@ -2126,6 +2298,8 @@ void WM_OT_save_as_mainfile(wmOperatorType *ot)
 	        ot, FILE_TYPE_FOLDER | FILE_TYPE_BLENDER, FILE_BLENDER, FILE_SAVE,
 	        WM_FILESEL_FILEPATH, FILE_DEFAULTDISPLAY, FILE_SORT_ALPHA);
 	RNA_def_boolean(ot->srna, "compress", false, "Compress", "Write compressed .blend file");
+	RNA_def_boolean(ot->srna, "compress_frames", false, "Multithreaded Compression",
+	                "Compress in independent blocks (instead of a single stream), faster to save and load but not readable by older versions");
 	RNA_def_boolean(ot->srna, "relative_remap", true, "Remap Relative",
 	                "Remap relative paths when saving in a different directory");
 	prop = RNA_def_boolean(ot->srna, "copy", false, "Save Copy",
@@ -2192,6 +2366,8 @@ void WM_OT_save_mainfile(wmOperatorType *ot)
 	        ot, FILE_TYPE_FOLDER | FILE_TYPE_BLENDER, FILE_BLENDER, FILE_SAVE,
 	        WM_FILESEL_FILEPATH, FILE_DEFAULTDISPLAY, FILE_SORT_ALPHA);
 	RNA_def_boolean(ot->srna, "compress", false, "Compress", "Write compressed .blend file");
+	RNA_def_boolean(ot->srna, "compress_frames", false, "Multithreaded Compression",
+	                "Compress in independent blocks (instead of a single stream), faster to save and load but not readable by older versions");
 	RNA_def_boolean(ot->srna, "relative_remap", false, "Remap Relative",
 	                "Remap relative paths when saving in a different directory");
 }
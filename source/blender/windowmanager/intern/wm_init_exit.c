@@ -50,6 +50,7 @@
 #include "BLI_path_util.h"
 #include "BLI_string.h"
 #include "BLI_threads.h"
+#include "BLI_trace.h"
 #include "BLI_utildefines.h"
 
 #include "BLO_writefile.h"
@@ -66,6 +67,7 @@
 #include "BKE_main.h"
 #include "BKE_mball_tessellate.h"
 #include "BKE_node.h"
+#include "BKE_packedFile.h"
 #include "BKE_report.h"
 #include "BKE_font.h"
 
@@ -459,11 +461,13 @@ void WM_exit_ext(bContext *C, const bool do_python)
 				/* save the undo state as quit.blend */
 				char filename[FILE_MAX];
 				bool has_edited;
-				int fileflags = G.fileflags & ~(G_FILE_COMPRESS | G_FILE_AUTOPLAY | G_FILE_HISTORY);
+				int fileflags = G.fileflags & ~(G_FILE_COMPRESS | G_FILE_COMPRESS_FRAMES | G_FILE_AUTOPLAY | G_FILE_HISTORY);
 
 				BLI_make_file_string("/", filename, BKE_tempdir_base(), BLENDER_QUIT_FILE);
 
 				has_edited = ED_editors_flush_edits(C, false);
+				/* undo keeps deferred packed data as a reference, write the data itself */
+				has_edited |= BKE_packedfile_has_deferred(CTX_data_main(C));
 
 				if ((has_edited && BLO_write_file(CTX_data_main(C), filename, fileflags, NULL, NULL)) ||
 				    BKE_undo_save_file(filename))
@@ -596,6 +600,9 @@ void WM_exit_ext(bContext *C, const bool do_python)
 
 	DNA_sdna_current_free();
 
+	/* Write profile (when enabled with '--profile'), all threads are done at this point. */
+	BLI_trace_exit();
+
 	BLI_threadapi_exit();
 
 	/* No need to call this early, rather do it late so that other pieces of Blender using sound may exit cleanly,
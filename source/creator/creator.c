@@ -265,7 +265,7 @@ int main(
 
 	/* NOTE: Special exception for guarded allocator type switch:
 	 *       we need to perform switch from lock-free to fully
-	 *       guarded allocator before any allocation happened.
+	 *       guarded (or slab) allocator before any allocation happened.
 	 */
 	{
 		int i;
@@ -277,6 +277,10 @@ int main(
 				MEM_use_guarded_allocator();
 				break;
 			}
+			else if (STREQ(argv[i], "--alloc-slab")) {
+				/* Keep looking, the guarded allocator takes precedence. */
+				MEM_use_slab_allocator();
+			}
 			else if (STREQ(argv[i], "--")) {
 				break;
 			}
@@ -43,6 +43,7 @@
 #include "BLI_path_util.h"
 #include "BLI_fileops.h"
 #include "BLI_mempool.h"
+#include "BLI_trace.h"
 
 #include "BKE_blender_version.h"
 #include "BKE_context.h"
@@ -552,6 +553,10 @@ static int arg_handle_print_help(int UNUSED(argc), const char **UNUSED(argv), vo
 	BLI_argsPrintArgDoc(ba, "--debug-all");
 	BLI_argsPrintArgDoc(ba, "--debug-io");
 
+	printf("\n");
+	BLI_argsPrintArgDoc(ba, "--profile");
+	BLI_argsPrintArgDoc(ba, "--alloc-slab");
+
 	printf("\n");
 	BLI_argsPrintArgDoc(ba, "--debug-fpe");
 	BLI_argsPrintArgDoc(ba, "--disable-crash-handler");
@@ -829,6 +834,33 @@ static int arg_handle_debug_value_set(int argc, const char **argv, void *UNUSED(
 	}
 }
 
+static const char arg_handle_profile_set_doc[] =
+"<filename>\n"
+"\tRecord profiling events (depsgraph, modifiers, file read/write, render stages)\n"
+"\tand write them to <filename> on exit, in Chrome trace format (chrome://tracing)."
+;
+static int arg_handle_profile_set(int argc, const char **argv, void *UNUSED(data))
+{
+	if (argc > 1) {
+		BLI_trace_init(argv[1]);
+		return 1;
+	}
+	else {
+		printf("\nError: you must specify a filename after '--profile'.\n");
+		return 0;
+	}
+}
+
+static const char arg_handle_alloc_slab_set_doc[] =
+"\n\tUse the size-class slab memory allocator for small allocations\n"
+"\t(ignored when the fully guarded allocator is used)."
+;
+static int arg_handle_alloc_slab_set(int UNUSED(argc), const char **UNUSED(argv), void *UNUSED(data))
+{
+	/* Handled in main(), the allocator must be set before any allocation. */
+	return 0;
+}
+
 static const char arg_handle_debug_fpe_set_doc[] =
 "\n\tEnable floating point exceptions"
 ;
@@ -1806,6 +1838,9 @@ void main_args_setup(bContext *C, bArgs *ba, SYS_SystemHandle *syshandle)
 	BLI_argsAdd(ba, 1, NULL, "--debug-gpumem",
 	            CB_EX(arg_handle_debug_mode_generic_set, gpumem), (void *)G_DEBUG_GPU_MEM);
 
+	BLI_argsAdd(ba, 1, NULL, "--profile", CB(arg_handle_profile_set), NULL);
+	BLI_argsAdd(ba, 1, NULL, "--alloc-slab", CB(arg_handle_alloc_slab_set), NULL);
+
 	BLI_argsAdd(ba, 1, NULL, "--verbose", CB(arg_handle_verbosity_set), NULL);
 
 	BLI_argsAdd(ba, 1, NULL, "--factory-startup", CB(arg_handle_factory_startup_set), NULL);
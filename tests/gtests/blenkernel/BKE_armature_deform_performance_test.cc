@@ -0,0 +1,143 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_listbase.h"
+#include "BLI_math.h"
+#include "BLI_rand.h"
+#include "BLI_string.h"
+#include "PIL_time.h"
+
+#include "DNA_action_types.h"
+#include "DNA_armature_types.h"
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_object_types.h"
+
+#include "BKE_lattice.h"
+}
+
+#define DEFORM_NUM_VERTS 500000
+#define DEFORM_NUM_BONES 128
+#define DEFORM_NUM_WEIGHTS 4
+#define DEFORM_NUM_ITERS 10
+
+/* Armature object with a pose, and a mesh object skinned to it with vertex
+ * groups, without going through Main. */
+struct DeformTestData {
+	Object arm_ob, target;
+	bArmature arm;
+	bPose pose;
+	Mesh me;
+	Bone bones[DEFORM_NUM_BONES];
+	bPoseChannel pchans[DEFORM_NUM_BONES];
+	bDeformGroup defgroups[DEFORM_NUM_BONES];
+	float (*cos)[3];
+};
+
+static DeformTestData *deform_data_create()
+{
+	DeformTestData *data = (DeformTestData *)MEM_callocN(sizeof(DeformTestData), __func__);
+	RNG *rng = BLI_rng_new(0);
+
+	data->arm_ob.type = OB_ARMATURE;
+	data->arm_ob.data = &data->arm;
+	data->arm_ob.pose = &data->pose;
+	unit_m4(data->arm_ob.obmat);
+
+	for (int i = 0; i < DEFORM_NUM_BONES; i++) {
+		Bone *bone = &data->bones[i];
+		bPoseChannel *pchan = &data->pchans[i];
+		bDeformGroup *dg = &data->defgroups[i];
+
+		BLI_snprintf(bone->name, sizeof(bone->name), "Bone.%03d", i);
+		bone->segments = 1;
+		bone->length = 1.0f;
+		unit_m4(bone->arm_mat);
+		bone->arm_mat[3][1] = (float)i;
+		copy_v3_v3(bone->arm_head, bone->arm_mat[3]);
+		add_v3_v3v3(bone->arm_tail, bone->arm_head, bone->arm_mat[1]);
+
+		BLI_strncpy(pchan->name, bone->name, sizeof(pchan->name));
+		pchan->bone = bone;
+		/* Some rotation and translation, as a posed rig would have. */
+		float eul[3] = {0.1f * i, 0.05f * i, 0.02f * i};
+		eul_to_mat4(pchan->chan_mat, eul);
+		pchan->chan_mat[3][0] = 0.01f * i;
+		BLI_addtail(&data->pose.chanbase, pchan);
+
+		BLI_strncpy(dg->name, bone->name, sizeof(dg->name));
+		BLI_addtail(&data->target.defbase, dg);
+	}
+
+	data->target.type = OB_MESH;
+	data->target.data = &data->me;
+	unit_m4(data->target.obmat);
+
+	data->me.totvert = DEFORM_NUM_VERTS;
+	data->me.dvert = (MDeformVert *)MEM_callocN(sizeof(MDeformVert) * DEFORM_NUM_VERTS, __func__);
+	data->cos = (float (*)[3])MEM_mallocN(sizeof(float[3]) * DEFORM_NUM_VERTS, __func__);
+	for (int i = 0; i < DEFORM_NUM_VERTS; i++) {
+		MDeformVert *dvert = &data->me.dvert[i];
+		dvert->totweight = DEFORM_NUM_WEIGHTS;
+		dvert->dw = (MDeformWeight *)MEM_callocN(sizeof(MDeformWeight) * DEFORM_NUM_WEIGHTS, __func__);
+		for (int j = 0; j < DEFORM_NUM_WEIGHTS; j++) {
+			dvert->dw[j].def_nr = BLI_rng_get_int(rng) % DEFORM_NUM_BONES;
+			dvert->dw[j].weight = BLI_rng_get_float(rng);
+		}
+		BLI_rng_get_float_unit_v3(rng, data->cos[i]);
+		mul_v3_fl(data->cos[i], (float)DEFORM_NUM_BONES);
+	}
+
+	BLI_rng_free(rng);
+	return data;
+}
+
+static void deform_data_free(DeformTestData *data)
+{
+	for (int i = 0; i < DEFORM_NUM_VERTS; i++) {
+		MEM_freeN(data->me.dvert[i].dw);
+	}
+	MEM_freeN(data->me.dvert);
+	MEM_freeN(data->cos);
+	MEM_freeN(data);
+}
+
+static void deform_performance(const char *name, const int deformflag)
+{
+	DeformTestData *data = deform_data_create();
+	float (*cos)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * DEFORM_NUM_VERTS, __func__);
+
+	double time = 0.0;
+	for (int iter = 0; iter < DEFORM_NUM_ITERS; iter++) {
+		memcpy(cos, data->cos, sizeof(float[3]) * DEFORM_NUM_VERTS);
+		const double start_time = PIL_check_seconds_timer();
+		armature_deform_verts(&data->arm_ob, &data->target, NULL, cos, NULL,
+		                      DEFORM_NUM_VERTS, deformflag, NULL, "");
+		time += PIL_check_seconds_timer() - start_time;
+	}
+
+	for (int i = 0; i < DEFORM_NUM_VERTS; i++) {
+		EXPECT_TRUE(is_finite_v3(cos[i]));
+	}
+
+	printf("%s: %d vertices, %d bones, %d weights per vertex: %.2f Mvertices/s\n",
+	       name, DEFORM_NUM_VERTS, DEFORM_NUM_BONES, DEFORM_NUM_WEIGHTS,
+	       (double)DEFORM_NUM_VERTS * DEFORM_NUM_ITERS / time * 1e-6);
+
+	MEM_freeN(cos);
+	deform_data_free(data);
+}
+
+TEST(armature_deform, LinearPerformance)
+{
+	deform_performance("Linear", ARM_DEF_VGROUP);
+}
+
+TEST(armature_deform, DualQuaternionPerformance)
+{
+	deform_performance("Dual quaternion", ARM_DEF_VGROUP | ARM_DEF_QUATERNION);
+}
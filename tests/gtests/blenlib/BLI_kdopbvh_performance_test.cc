@@ -0,0 +1,136 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "BLI_compiler_attrs.h"
+#include "BLI_kdopbvh.h"
+#include "BLI_rand.h"
+#include "BLI_math_vector.h"
+#include "MEM_guardedalloc.h"
+#include "PIL_time_utildefines.h"
+}
+
+/* -------------------------------------------------------------------- */
+/* Helper Functions */
+
+static void rng_v3_round(
+        float *coords, int coords_len,
+        struct RNG *rng, int round, float scale)
+{
+	for (int i = 0; i < coords_len; i++) {
+		float f = BLI_rng_get_float(rng) * 2.0f - 1.0f;
+		coords[i] = ((float)((int)(f * round)) / (float)round) * scale;
+	}
+}
+
+static BVHTree *bvhtree_from_random_points(float (*points)[3], int points_len, struct RNG *rng)
+{
+	BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 8, 8);
+	for (int i = 0; i < points_len; i++) {
+		rng_v3_round(points[i], 3, rng, 1000, 1.0f);
+		BLI_bvhtree_insert(tree, i, points[i], 1);
+	}
+	BLI_bvhtree_balance(tree);
+	return tree;
+}
+
+/* -------------------------------------------------------------------- */
+/* Performance
+ *
+ * Timings only, compare the single query loop with the batched (threaded) versions. */
+
+#define PERF_POINTS_LEN 100000
+#define PERF_QUERY_LEN 10000
+
+TEST(kdopbvh, PerfBalance)
+{
+	struct RNG *rng = BLI_rng_new(1);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * PERF_POINTS_LEN, __func__);
+
+	for (int i = 0; i < PERF_POINTS_LEN; i++) {
+		rng_v3_round(points[i], 3, rng, 100000, 1.0f);
+	}
+
+	BVHTree *tree = BLI_bvhtree_new(PERF_POINTS_LEN, 0.0, 8, 8);
+	for (int i = 0; i < PERF_POINTS_LEN; i++) {
+		BLI_bvhtree_insert(tree, i, points[i], 1);
+	}
+	TIMEIT_START(bvhtree_balance);
+	BLI_bvhtree_balance(tree);
+	TIMEIT_END(bvhtree_balance);
+	EXPECT_EQ(PERF_POINTS_LEN, BLI_bvhtree_get_size(tree));
+
+	BLI_bvhtree_free(tree);
+	BLI_rng_free(rng);
+	MEM_freeN(points);
+}
+
+TEST(kdopbvh, PerfQueries)
+{
+	struct RNG *rng = BLI_rng_new(2);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * PERF_POINTS_LEN, __func__);
+	float (*co)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * PERF_QUERY_LEN, __func__);
+	BVHTreeNearest *nearest = (BVHTreeNearest *)MEM_mallocN(sizeof(*nearest) * PERF_QUERY_LEN, __func__);
+	BVHTreeRay *rays = (BVHTreeRay *)MEM_mallocN(sizeof(*rays) * PERF_QUERY_LEN, __func__);
+	BVHTreeRayHit *hits = (BVHTreeRayHit *)MEM_mallocN(sizeof(*hits) * PERF_QUERY_LEN, __func__);
+	BVHTree *tree = bvhtree_from_random_points(points, PERF_POINTS_LEN, rng);
+
+	for (int i = 0; i < PERF_QUERY_LEN; i++) {
+		rng_v3_round(co[i], 3, rng, 100000, 1.0f);
+		copy_v3_v3(rays[i].origin, co[i]);
+		rays[i].origin[2] = -2.0f;
+		copy_v3_fl3(rays[i].direction, 0.0f, 0.0f, 1.0f);
+		rays[i].radius = 0.01f;
+	}
+
+#define RESET_RESULTS \
+	for (int i = 0; i < PERF_QUERY_LEN; i++) { \
+		nearest[i].index = -1; \
+		nearest[i].dist_sq = FLT_MAX; \
+		hits[i].index = -1; \
+		hits[i].dist = BVH_RAYCAST_DIST_MAX; \
+	} ((void)0)
+
+	RESET_RESULTS;
+	TIMEIT_START(find_nearest_single);
+	for (int i = 0; i < PERF_QUERY_LEN; i++) {
+		BLI_bvhtree_find_nearest(tree, co[i], &nearest[i], NULL, NULL);
+	}
+	TIMEIT_END(find_nearest_single);
+
+	RESET_RESULTS;
+	TIMEIT_START(find_nearest_batch);
+	BLI_bvhtree_find_nearest_batch(tree, co, nearest, PERF_QUERY_LEN, NULL, NULL);
+	TIMEIT_END(find_nearest_batch);
+
+	RESET_RESULTS;
+	TIMEIT_START(ray_cast_single);
+	for (int i = 0; i < PERF_QUERY_LEN; i++) {
+		BLI_bvhtree_ray_cast(tree, rays[i].origin, rays[i].direction, rays[i].radius, &hits[i], NULL, NULL);
+	}
+	TIMEIT_END(ray_cast_single);
+
+	RESET_RESULTS;
+	TIMEIT_START(ray_cast_batch);
+	BLI_bvhtree_ray_cast_batch(tree, rays, hits, PERF_QUERY_LEN, NULL, NULL, BVH_RAYCAST_DEFAULT);
+	TIMEIT_END(ray_cast_batch);
+
+	RESET_RESULTS;
+	TIMEIT_START(ray_cast_batch_packet);
+	BLI_bvhtree_ray_cast_batch(tree, rays, hits, PERF_QUERY_LEN, NULL, NULL, BVH_RAYCAST_DEFAULT | BVH_RAYCAST_PACKET);
+	TIMEIT_END(ray_cast_batch_packet);
+
+#undef RESET_RESULTS
+
+	BLI_bvhtree_free(tree);
+	BLI_rng_free(rng);
+	MEM_freeN(points);
+	MEM_freeN(co);
+	MEM_freeN(nearest);
+	MEM_freeN(rays);
+	MEM_freeN(hits);
+}
+
+#undef PERF_POINTS_LEN
+#undef PERF_QUERY_LEN
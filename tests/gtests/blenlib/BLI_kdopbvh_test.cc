@@ -5,9 +5,12 @@
 /* TODO: ray intersection, overlap ... etc.*/
 
 extern "C" {
+#include "BLI_utildefines.h"
 #include "BLI_compiler_attrs.h"
 #include "BLI_kdopbvh.h"
 #include "BLI_rand.h"
+#include "BLI_threads.h"
+#include "BLI_math_base.h"
 #include "BLI_math_vector.h"
 #include "MEM_guardedalloc.h"
 }
@@ -93,3 +96,180 @@ static void find_nearest_points_test(int points_len, float scale, int round, int
 TEST(kdopbvh, FindNearest_1)		{ find_nearest_points_test(1, 1.0, 1000, 1234); }
 TEST(kdopbvh, FindNearest_2)		{ find_nearest_points_test(2, 1.0, 1000, 123); }
 TEST(kdopbvh, FindNearest_500)		{ find_nearest_points_test(500, 1.0, 1000, 12); }
+
+/* -------------------------------------------------------------------- */
+/* Batched Queries */
+
+static BVHTree *bvhtree_from_random_points(float (*points)[3], int points_len, struct RNG *rng)
+{
+	BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 8, 8);
+	for (int i = 0; i < points_len; i++) {
+		rng_v3_round(points[i], 3, rng, 1000, 1.0f);
+		BLI_bvhtree_insert(tree, i, points[i], 1);
+	}
+	BLI_bvhtree_balance(tree);
+	return tree;
+}
+
+static void find_nearest_batch_test(int points_len, int random_seed)
+{
+	struct RNG *rng = BLI_rng_new(random_seed);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+	BVHTreeNearest *nearest = (BVHTreeNearest *)MEM_mallocN(sizeof(*nearest) * points_len, __func__);
+	BVHTree *tree = bvhtree_from_random_points(points, points_len, rng);
+
+	for (int i = 0; i < points_len; i++) {
+		nearest[i].index = -1;
+		nearest[i].dist_sq = FLT_MAX;
+	}
+	BLI_bvhtree_find_nearest_batch(tree, points, nearest, points_len, NULL, NULL);
+
+	for (int i = 0; i < points_len; i++) {
+		const int j = BLI_bvhtree_find_nearest(tree, points[i], NULL, NULL, NULL);
+		EXPECT_EQ(j, nearest[i].index);
+	}
+
+	BLI_bvhtree_free(tree);
+	BLI_rng_free(rng);
+	MEM_freeN(points);
+	MEM_freeN(nearest);
+}
+
+TEST(kdopbvh, FindNearestBatch_500)		{ find_nearest_batch_test(500, 12); }
+TEST(kdopbvh, FindNearestBatch_5000)	{ find_nearest_batch_test(5000, 42); }
+
+/**
+ * Rays are cast in coherent rows (as a bake or shrinkwrap would) so packets are exercised,
+ * every batched result must match the single ray-cast.
+ */
+static void ray_cast_batch_test(int points_len, int rays_len, int flag, int random_seed)
+{
+	struct RNG *rng = BLI_rng_new(random_seed);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+	BVHTreeRay *rays = (BVHTreeRay *)MEM_mallocN(sizeof(*rays) * rays_len, __func__);
+	BVHTreeRayHit *hits = (BVHTreeRayHit *)MEM_mallocN(sizeof(*hits) * rays_len, __func__);
+	BVHTree *tree = bvhtree_from_random_points(points, points_len, rng);
+
+	for (int i = 0; i < rays_len; i++) {
+		const float fac = (float)i / (float)rays_len;
+		rays[i].origin[0] = fac * 2.0f - 1.0f;
+		rays[i].origin[1] = (float)(i % 17) / 8.5f - 1.0f;
+		rays[i].origin[2] = -2.0f;
+		rays[i].direction[0] = BLI_rng_get_float(rng) * 0.01f;
+		rays[i].direction[1] = 0.0f;
+		rays[i].direction[2] = 1.0f;
+		normalize_v3(rays[i].direction);
+		/* points are tiny, use a radius so some rays hit */
+		rays[i].radius = 0.05f;
+
+		hits[i].index = -1;
+		hits[i].dist = BVH_RAYCAST_DIST_MAX;
+	}
+
+	BLI_bvhtree_ray_cast_batch(tree, rays, hits, rays_len, NULL, NULL, flag);
+
+	for (int i = 0; i < rays_len; i++) {
+		BVHTreeRayHit hit;
+		hit.index = -1;
+		hit.dist = BVH_RAYCAST_DIST_MAX;
+		BLI_bvhtree_ray_cast_ex(tree, rays[i].origin, rays[i].direction, rays[i].radius, &hit, NULL, NULL, flag);
+		EXPECT_EQ(hit.index, hits[i].index);
+		if (hit.index != -1) {
+			EXPECT_FLOAT_EQ(hit.dist, hits[i].dist);
+		}
+	}
+
+	BLI_bvhtree_free(tree);
+	BLI_rng_free(rng);
+	MEM_freeN(points);
+	MEM_freeN(rays);
+	MEM_freeN(hits);
+}
+
+TEST(kdopbvh, RayCastBatch_500)			{ ray_cast_batch_test(500, 500, BVH_RAYCAST_DEFAULT, 12); }
+TEST(kdopbvh, RayCastBatch_5000)		{ ray_cast_batch_test(5000, 5000, BVH_RAYCAST_DEFAULT, 42); }
+TEST(kdopbvh, RayCastBatchPacket_13)	{ ray_cast_batch_test(500, 13, BVH_RAYCAST_DEFAULT | BVH_RAYCAST_PACKET, 12); }
+TEST(kdopbvh, RayCastBatchPacket_5000)	{ ray_cast_batch_test(5000, 5000, BVH_RAYCAST_DEFAULT | BVH_RAYCAST_PACKET, 42); }
+
+/* -------------------------------------------------------------------- */
+/* Bounds
+ *
+ * Enough points for the top levels of the tree to be fitted by threads
+ * (see #KDOPBVH_THREAD_LEAF_THRESHOLD), the bounds of the root must be exactly
+ * the union of the bounds of all leafs, for the axes used by each k-DOP type. */
+
+typedef struct BoundsWalkData {
+	BVHTreeAxisRange root[13];
+	BVHTreeAxisRange leafs[13];
+	bool root_done;
+} BoundsWalkData;
+
+static bool bounds_walk_parent_cb(const BVHTreeAxisRange *bounds, void *userdata)
+{
+	BoundsWalkData *data = (BoundsWalkData *)userdata;
+	if (!data->root_done) {
+		memcpy(data->root, bounds, sizeof(data->root));
+		data->root_done = true;
+	}
+	return true;
+}
+
+static bool bounds_walk_leaf_cb(const BVHTreeAxisRange *bounds, int UNUSED(index), void *userdata)
+{
+	BoundsWalkData *data = (BoundsWalkData *)userdata;
+	for (int i = 0; i < 13; i++) {
+		data->leafs[i].min = min_ff(data->leafs[i].min, bounds[i].min);
+		data->leafs[i].max = max_ff(data->leafs[i].max, bounds[i].max);
+	}
+	return true;
+}
+
+static bool bounds_walk_order_cb(const BVHTreeAxisRange *UNUSED(bounds), char UNUSED(axis), void *UNUSED(userdata))
+{
+	return true;
+}
+
+static void root_bounds_test(int points_len, char axis, int start_axis, int stop_axis, int random_seed)
+{
+	/* Keep the points away from the origin, so the bounds don't contain zero on any axis. */
+	const float offset[3] = {100.0f, 10.0f, 1.0f};
+	const int num_threads_override = BLI_system_num_threads_override_get();
+	struct RNG *rng = BLI_rng_new(random_seed);
+	BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 8, axis);
+	BoundsWalkData data;
+
+	/* The threaded fitting is used for the levels with fewer branches than threads,
+	 * make sure it runs on machines with few cores too. */
+	BLI_system_num_threads_override_set(16);
+
+	for (int i = 0; i < points_len; i++) {
+		float co[3];
+		rng_v3_round(co, 3, rng, 1000, 1.0f);
+		add_v3_v3(co, offset);
+		BLI_bvhtree_insert(tree, i, co, 1);
+	}
+	BLI_bvhtree_balance(tree);
+	BLI_system_num_threads_override_set(num_threads_override);
+
+	data.root_done = false;
+	for (int i = 0; i < 13; i++) {
+		data.leafs[i].min = FLT_MAX;
+		data.leafs[i].max = -FLT_MAX;
+	}
+	BLI_bvhtree_walk_dfs(tree, bounds_walk_parent_cb, bounds_walk_leaf_cb, bounds_walk_order_cb, &data);
+
+	EXPECT_TRUE(data.root_done);
+	for (int i = start_axis; i < stop_axis; i++) {
+		EXPECT_EQ(data.leafs[i].min, data.root[i].min);
+		EXPECT_EQ(data.leafs[i].max, data.root[i].max);
+	}
+
+	BLI_bvhtree_free(tree);
+	BLI_rng_free(rng);
+}
+
+TEST(kdopbvh, RootBounds6DOP_5000)		{ root_bounds_test(5000, 6, 0, 3, 12); }
+TEST(kdopbvh, RootBounds8DOP_5000)		{ root_bounds_test(5000, 8, 0, 4, 12); }
+TEST(kdopbvh, RootBounds14DOP_5000)		{ root_bounds_test(5000, 14, 0, 7, 12); }
+TEST(kdopbvh, RootBounds18DOP_5000)		{ root_bounds_test(5000, 18, 7, 13, 12); }
+TEST(kdopbvh, RootBounds26DOP_5000)		{ root_bounds_test(5000, 26, 0, 13, 12); }
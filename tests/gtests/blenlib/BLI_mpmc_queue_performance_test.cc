@@ -0,0 +1,55 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <pthread.h>
+#include <vector>
+
+extern "C" {
+#include "BLI_utildefines.h"
+#include "BLI_compiler_attrs.h"
+#include "BLI_threads.h"
+#include "MEM_guardedalloc.h"
+#include "PIL_time.h"
+}
+
+#include "BLI_mpmc_queue_test_utils.h"
+
+/* Total number of items passed through the queue for each run. */
+#define ITEMS_TOTAL 2000000
+
+static double thread_queue_throughput(ThreadQueue *queue, const int threads_num)
+{
+	/* half of the threads produce, half consume */
+	const int producers_num = MAX2(threads_num / 2, 1);
+	const int consumers_num = MAX2(threads_num - producers_num, 1);
+	const int items_num = ITEMS_TOTAL / producers_num;
+	double time;
+	bool ok;
+
+	time = PIL_check_seconds_timer();
+	ok = thread_queue_producer_consumer_test(queue, producers_num, consumers_num, items_num);
+	time = PIL_check_seconds_timer() - time;
+
+	EXPECT_TRUE(ok);
+	return (double)(items_num * producers_num) / time;
+}
+
+TEST(mpmc_queue, ThroughputPerformance)
+{
+	printf("\n========== ThreadQueue throughput (items/s) ==========\n");
+	printf("%8s %16s %16s\n", "threads", "mutex", "lockfree");
+
+	for (int threads_num = 2; threads_num <= 64; threads_num *= 2) {
+		ThreadQueue *queue_mutex = BLI_thread_queue_init();
+		ThreadQueue *queue_lockfree = BLI_thread_queue_init_lockfree(4096);
+
+		const double throughput_mutex = thread_queue_throughput(queue_mutex, threads_num);
+		const double throughput_lockfree = thread_queue_throughput(queue_lockfree, threads_num);
+
+		printf("%8d %16.0f %16.0f\n", threads_num, throughput_mutex, throughput_lockfree);
+
+		BLI_thread_queue_free(queue_mutex);
+		BLI_thread_queue_free(queue_lockfree);
+	}
+}
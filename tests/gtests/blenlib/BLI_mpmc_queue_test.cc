@@ -0,0 +1,125 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <pthread.h>
+#include <vector>
+
+extern "C" {
+#include "BLI_utildefines.h"
+#include "BLI_compiler_attrs.h"
+#include "BLI_mpmc_queue.h"
+#include "BLI_threads.h"
+#include "MEM_guardedalloc.h"
+}
+
+#include "BLI_mpmc_queue_test_utils.h"
+
+TEST(mpmc_queue, Empty)
+{
+	MPMCQueue *queue = BLI_mpmc_queue_new(sizeof(int), 10);
+	int item = 0;
+
+	EXPECT_EQ(16u, BLI_mpmc_queue_capacity(queue));
+	EXPECT_TRUE(BLI_mpmc_queue_is_empty(queue));
+	EXPECT_EQ(0u, BLI_mpmc_queue_size(queue));
+	EXPECT_FALSE(BLI_mpmc_queue_try_pop(queue, &item));
+	EXPECT_FALSE(BLI_mpmc_queue_pop_timeout(queue, &item, 1));
+
+	BLI_mpmc_queue_nowait(queue);
+	EXPECT_FALSE(BLI_mpmc_queue_pop(queue, &item));
+
+	BLI_mpmc_queue_free(queue);
+}
+
+TEST(mpmc_queue, Order)
+{
+	const unsigned int capacity = 64;
+	MPMCQueue *queue = BLI_mpmc_queue_new(sizeof(int), capacity);
+	int item;
+
+	/* go around the ring a few times */
+	for (int lap = 0; lap < 4; lap++) {
+		for (int i = 0; i < (int)capacity; i++) {
+			item = lap * 1000 + i;
+			EXPECT_TRUE(BLI_mpmc_queue_try_push(queue, &item));
+		}
+		item = -1;
+		EXPECT_FALSE(BLI_mpmc_queue_try_push(queue, &item));
+		EXPECT_EQ(capacity, BLI_mpmc_queue_size(queue));
+
+		for (int i = 0; i < (int)capacity; i++) {
+			EXPECT_TRUE(BLI_mpmc_queue_try_pop(queue, &item));
+			EXPECT_EQ(lap * 1000 + i, item);
+		}
+		EXPECT_TRUE(BLI_mpmc_queue_is_empty(queue));
+	}
+
+	BLI_mpmc_queue_free(queue);
+}
+
+TEST(mpmc_queue, ElemSize)
+{
+	struct Elem {
+		char str[13];
+	};
+	MPMCQueue *queue = BLI_mpmc_queue_new(sizeof(Elem), 4);
+	Elem elem_a = {"hello world!"}, elem_b = {"second elem"}, elem;
+
+	EXPECT_TRUE(BLI_mpmc_queue_try_push(queue, &elem_a));
+	EXPECT_TRUE(BLI_mpmc_queue_try_push(queue, &elem_b));
+	EXPECT_TRUE(BLI_mpmc_queue_try_pop(queue, &elem));
+	EXPECT_STREQ(elem_a.str, elem.str);
+	EXPECT_TRUE(BLI_mpmc_queue_try_pop(queue, &elem));
+	EXPECT_STREQ(elem_b.str, elem.str);
+
+	BLI_mpmc_queue_free(queue);
+}
+
+/* Small capacity, so producers have to wait for consumers. */
+TEST(mpmc_queue, ThreadsLockfree)
+{
+	ThreadQueue *queue = BLI_thread_queue_init_lockfree(16);
+	EXPECT_TRUE(thread_queue_producer_consumer_test(queue, 4, 4, 100000));
+	BLI_thread_queue_free(queue);
+}
+
+TEST(mpmc_queue, ThreadsLockfreeSingleConsumer)
+{
+	ThreadQueue *queue = BLI_thread_queue_init_lockfree(1024);
+	EXPECT_TRUE(thread_queue_producer_consumer_test(queue, 8, 1, 50000));
+	BLI_thread_queue_free(queue);
+}
+
+TEST(mpmc_queue, ThreadsMutex)
+{
+	ThreadQueue *queue = BLI_thread_queue_init();
+	EXPECT_TRUE(thread_queue_producer_consumer_test(queue, 4, 4, 100000));
+	BLI_thread_queue_free(queue);
+}
+
+TEST(mpmc_queue, WaitFinish)
+{
+	ThreadQueue *queue = BLI_thread_queue_init_lockfree(1024);
+	ThreadQueueTestConsumer consumer;
+	pthread_t thread;
+
+	for (intptr_t i = 1; i <= 1000; i++) {
+		BLI_thread_queue_push(queue, (void *)i);
+	}
+
+	consumer.queue = queue;
+	consumer.producers_num = 1;
+	consumer.items_num = 1000;
+	pthread_create(&thread, NULL, thread_queue_test_consume, &consumer);
+
+	BLI_thread_queue_wait_finish(queue);
+	EXPECT_TRUE(BLI_thread_queue_is_empty(queue));
+
+	BLI_thread_queue_nowait(queue);
+	pthread_join(thread, NULL);
+	EXPECT_EQ((size_t)1000, consumer.items.size());
+	EXPECT_TRUE(consumer.is_ordered);
+
+	BLI_thread_queue_free(queue);
+}
@@ -0,0 +1,106 @@
+/* Apache License, Version 2.0 */
+
+#ifndef __BLI_MPMC_QUEUE_TEST_UTILS_H__
+#define __BLI_MPMC_QUEUE_TEST_UTILS_H__
+
+/* Producer/consumer threads sharing a ThreadQueue, used by the tests and benchmarks.
+ *
+ * Items are 'producer_index * THREAD_QUEUE_TEST_STRIDE + i + 1' (never NULL),
+ * consumers pop until the queue is emptied after #BLI_thread_queue_nowait. */
+
+#define THREAD_QUEUE_TEST_STRIDE (1 << 24)
+
+struct ThreadQueueTestProducer {
+	ThreadQueue *queue;
+	int index;
+	int items_num;
+};
+
+struct ThreadQueueTestConsumer {
+	ThreadQueue *queue;
+	int producers_num;
+	int items_num;
+	std::vector<intptr_t> items;
+	/* items of each producer were popped in the order they were pushed */
+	bool is_ordered;
+};
+
+static void *thread_queue_test_produce(void *data_v)
+{
+	ThreadQueueTestProducer *data = (ThreadQueueTestProducer *)data_v;
+	for (int i = 0; i < data->items_num; i++) {
+		BLI_thread_queue_push(data->queue, (void *)((intptr_t)data->index * THREAD_QUEUE_TEST_STRIDE + i + 1));
+	}
+	return NULL;
+}
+
+static void *thread_queue_test_consume(void *data_v)
+{
+	ThreadQueueTestConsumer *data = (ThreadQueueTestConsumer *)data_v;
+	std::vector<intptr_t> last(data->producers_num, 0);
+	void *work;
+
+	data->is_ordered = true;
+	while ((work = BLI_thread_queue_pop(data->queue))) {
+		const intptr_t item = (intptr_t)work;
+		const int producer = (int)(item / THREAD_QUEUE_TEST_STRIDE);
+		if (item <= last[producer]) {
+			data->is_ordered = false;
+		}
+		last[producer] = item;
+		data->items.push_back(item);
+	}
+	return NULL;
+}
+
+/**
+ * Run \a producers_num threads pushing \a items_num items each,
+ * \return true when all items were popped once, in order.
+ */
+static bool thread_queue_producer_consumer_test(
+        ThreadQueue *queue, const int producers_num, const int consumers_num, const int items_num)
+{
+	std::vector<ThreadQueueTestProducer> producers(producers_num);
+	std::vector<ThreadQueueTestConsumer> consumers(consumers_num);
+	std::vector<pthread_t> producer_threads(producers_num);
+	std::vector<pthread_t> consumer_threads(consumers_num);
+	std::vector<int> counts((size_t)producers_num * items_num, 0);
+	bool ok = true;
+
+	for (int i = 0; i < consumers_num; i++) {
+		consumers[i].queue = queue;
+		consumers[i].producers_num = producers_num;
+		consumers[i].items_num = items_num;
+		pthread_create(&consumer_threads[i], NULL, thread_queue_test_consume, &consumers[i]);
+	}
+	for (int i = 0; i < producers_num; i++) {
+		producers[i].queue = queue;
+		producers[i].index = i;
+		producers[i].items_num = items_num;
+		pthread_create(&producer_threads[i], NULL, thread_queue_test_produce, &producers[i]);
+	}
+
+	for (int i = 0; i < producers_num; i++) {
+		pthread_join(producer_threads[i], NULL);
+	}
+	BLI_thread_queue_nowait(queue);
+	for (int i = 0; i < consumers_num; i++) {
+		pthread_join(consumer_threads[i], NULL);
+	}
+
+	for (int i = 0; i < consumers_num; i++) {
+		ok = ok && consumers[i].is_ordered;
+		for (size_t j = 0; j < consumers[i].items.size(); j++) {
+			const intptr_t item = consumers[i].items[j];
+			const int producer = (int)(item / THREAD_QUEUE_TEST_STRIDE);
+			const int index = (int)(item % THREAD_QUEUE_TEST_STRIDE) - 1;
+			counts[(size_t)producer * items_num + index]++;
+		}
+	}
+	for (size_t i = 0; i < counts.size(); i++) {
+		ok = ok && (counts[i] == 1);
+	}
+	return ok;
+}
+
+#endif  /* __BLI_MPMC_QUEUE_TEST_UTILS_H__ */
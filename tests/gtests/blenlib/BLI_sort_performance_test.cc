@@ -0,0 +1,97 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <vector>
+
+extern "C" {
+#include "BLI_utildefines.h"
+#include "BLI_compiler_attrs.h"
+#include "BLI_sort.h"
+#include "BLI_sort_utils.h"
+#include "BLI_rand.h"
+#include "MEM_guardedalloc.h"
+#include "PIL_time_utildefines.h"
+}
+
+#define SORT_SIZE 10000000
+
+static int cmp_int(const void *a_, const void *b_, void *UNUSED(thunk))
+{
+	return BLI_sortutil_cmp_int(a_, b_);
+}
+
+static int cmp_float(const void *a_, const void *b_, void *UNUSED(thunk))
+{
+	return BLI_sortutil_cmp_float(a_, b_);
+}
+
+static std::vector<SortIntByInt> sort_data_int(const int len)
+{
+	RNG *rng = BLI_rng_new(0);
+	std::vector<SortIntByInt> data(len);
+	for (int i = 0; i < len; i++) {
+		data[i].sort_value = (int)BLI_rng_get_uint(rng);
+		data[i].data = i;
+	}
+	BLI_rng_free(rng);
+	return data;
+}
+
+static std::vector<SortIntByFloat> sort_data_float(const int len)
+{
+	RNG *rng = BLI_rng_new(1);
+	std::vector<SortIntByFloat> data(len);
+	for (int i = 0; i < len; i++) {
+		data[i].sort_value = BLI_rng_get_float(rng) - 0.5f;
+		data[i].data = i;
+	}
+	BLI_rng_free(rng);
+	return data;
+}
+
+TEST(sort, IntPerformance)
+{
+	std::vector<SortIntByInt> data_src = sort_data_int(SORT_SIZE);
+	std::vector<SortIntByInt> data;
+
+	printf("\n========== %d int keys ==========\n", SORT_SIZE);
+
+	data = data_src;
+	TIMEIT_START(qsort_r);
+	BLI_qsort_r(&data[0], data.size(), sizeof(data[0]), cmp_int, &data);
+	TIMEIT_END(qsort_r);
+
+	data = data_src;
+	TIMEIT_START(mergesort_r);
+	BLI_mergesort_r(&data[0], data.size(), sizeof(data[0]), cmp_int, NULL);
+	TIMEIT_END(mergesort_r);
+
+	data = data_src;
+	TIMEIT_START(radix_sort_by_key);
+	BLI_radix_sort_by_key(&data[0], data.size(), sizeof(data[0]), 0, BLI_SORT_KEY_INT);
+	TIMEIT_END(radix_sort_by_key);
+}
+
+TEST(sort, FloatPerformance)
+{
+	std::vector<SortIntByFloat> data_src = sort_data_float(SORT_SIZE);
+	std::vector<SortIntByFloat> data;
+
+	printf("\n========== %d float keys ==========\n", SORT_SIZE);
+
+	data = data_src;
+	TIMEIT_START(qsort_r);
+	BLI_qsort_r(&data[0], data.size(), sizeof(data[0]), cmp_float, &data);
+	TIMEIT_END(qsort_r);
+
+	data = data_src;
+	TIMEIT_START(mergesort_r);
+	BLI_mergesort_r(&data[0], data.size(), sizeof(data[0]), cmp_float, NULL);
+	TIMEIT_END(mergesort_r);
+
+	data = data_src;
+	TIMEIT_START(radix_sort_by_key);
+	BLI_radix_sort_by_key(&data[0], data.size(), sizeof(data[0]), 0, BLI_SORT_KEY_FLOAT);
+	TIMEIT_END(radix_sort_by_key);
+}
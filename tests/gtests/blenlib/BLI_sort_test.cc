@@ -0,0 +1,190 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <vector>
+
+extern "C" {
+#include "BLI_utildefines.h"
+#include "BLI_compiler_attrs.h"
+#include "BLI_sort.h"
+#include "BLI_rand.h"
+#include "MEM_guardedalloc.h"
+}
+
+/* Large enough to use threads. */
+#define SORT_SIZE_BIG 1000000
+
+/* -------------------------------------------------------------------- */
+/* helper functions */
+
+struct SortElem {
+	int key;
+	int index;
+};
+
+static int cmp_sort_elem(const void *a_, const void *b_, void *UNUSED(thunk))
+{
+	const SortElem *a = (const SortElem *)a_;
+	const SortElem *b = (const SortElem *)b_;
+	if      (a->key > b->key) return  1;
+	else if (a->key < b->key) return -1;
+	return 0;
+}
+
+static bool sort_elem_stable_less(const SortElem &a, const SortElem &b)
+{
+	return (a.key < b.key) || (a.key == b.key && a.index < b.index);
+}
+
+/* Few distinct keys, so stability is tested too. */
+static std::vector<SortElem> sort_elems_random(const int len, const int key_range, const unsigned int seed)
+{
+	RNG *rng = BLI_rng_new(seed);
+	std::vector<SortElem> elems(len);
+	for (int i = 0; i < len; i++) {
+		elems[i].key = (int)(BLI_rng_get_uint(rng) % (unsigned int)key_range) - key_range / 2;
+		elems[i].index = i;
+	}
+	BLI_rng_free(rng);
+	return elems;
+}
+
+static void mergesort_test(const int len, const int key_range)
+{
+	std::vector<SortElem> elems = sort_elems_random(len, key_range, (unsigned int)len);
+	std::vector<SortElem> elems_ref = elems;
+
+	BLI_mergesort_r(&elems[0], elems.size(), sizeof(SortElem), cmp_sort_elem, NULL);
+	std::sort(elems_ref.begin(), elems_ref.end(), sort_elem_stable_less);
+
+	for (int i = 0; i < len; i++) {
+		EXPECT_EQ(elems_ref[i].key, elems[i].key);
+		EXPECT_EQ(elems_ref[i].index, elems[i].index);
+	}
+}
+
+static void radix_sort_by_key_test(const int len, const int key_range)
+{
+	std::vector<SortElem> elems = sort_elems_random(len, key_range, (unsigned int)len + 1);
+	std::vector<SortElem> elems_ref = elems;
+
+	BLI_radix_sort_by_key(&elems[0], elems.size(), sizeof(SortElem), offsetof(SortElem, key), BLI_SORT_KEY_INT);
+	std::sort(elems_ref.begin(), elems_ref.end(), sort_elem_stable_less);
+
+	for (int i = 0; i < len; i++) {
+		EXPECT_EQ(elems_ref[i].key, elems[i].key);
+		EXPECT_EQ(elems_ref[i].index, elems[i].index);
+	}
+}
+
+/* -------------------------------------------------------------------- */
+/* tests */
+
+TEST(sort, MergeSortEmpty)
+{
+	SortElem elem = {1, 0};
+	BLI_mergesort_r(&elem, 0, sizeof(SortElem), cmp_sort_elem, NULL);
+	BLI_mergesort_r(&elem, 1, sizeof(SortElem), cmp_sort_elem, NULL);
+	EXPECT_EQ(1, elem.key);
+}
+
+TEST(sort, MergeSortSmall)         { mergesort_test(10, 5); }
+TEST(sort, MergeSortMedium)        { mergesort_test(1000, 100); }
+TEST(sort, MergeSortBig)           { mergesort_test(SORT_SIZE_BIG, 1000); }
+TEST(sort, MergeSortBigOdd)        { mergesort_test(SORT_SIZE_BIG + 7, 1 << 30); }
+
+TEST(sort, RadixSortByKeySmall)    { radix_sort_by_key_test(10, 5); }
+TEST(sort, RadixSortByKeyMedium)   { radix_sort_by_key_test(1000, 100); }
+TEST(sort, RadixSortByKeyBig)      { radix_sort_by_key_test(SORT_SIZE_BIG, 1000); }
+TEST(sort, RadixSortByKeyBigOdd)   { radix_sort_by_key_test(SORT_SIZE_BIG + 7, 1 << 30); }
+
+TEST(sort, RadixSortUInt)
+{
+	RNG *rng = BLI_rng_new(0);
+	std::vector<unsigned int> data(SORT_SIZE_BIG);
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = BLI_rng_get_uint(rng);
+	}
+	data[0] = 0;
+	data[1] = UINT_MAX;
+	BLI_rng_free(rng);
+
+	std::vector<unsigned int> data_ref = data;
+	BLI_radix_sort_uint(&data[0], data.size());
+	std::sort(data_ref.begin(), data_ref.end());
+	EXPECT_TRUE(data == data_ref);
+}
+
+TEST(sort, RadixSortInt)
+{
+	RNG *rng = BLI_rng_new(1);
+	std::vector<int> data(SORT_SIZE_BIG);
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = (int)BLI_rng_get_uint(rng);
+	}
+	data[0] = INT_MIN;
+	data[1] = INT_MAX;
+	data[2] = 0;
+	data[3] = -1;
+	BLI_rng_free(rng);
+
+	std::vector<int> data_ref = data;
+	BLI_radix_sort_int(&data[0], data.size());
+	std::sort(data_ref.begin(), data_ref.end());
+	EXPECT_TRUE(data == data_ref);
+}
+
+TEST(sort, RadixSortFloat)
+{
+	RNG *rng = BLI_rng_new(2);
+	std::vector<float> data(SORT_SIZE_BIG);
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = (BLI_rng_get_float(rng) - 0.5f) * 1e6f;
+	}
+	data[0] = -FLT_MAX;
+	data[1] = FLT_MAX;
+	data[2] = 0.0f;
+	data[3] = FLT_MIN;
+	data[4] = -FLT_MIN;
+	BLI_rng_free(rng);
+
+	std::vector<float> data_ref = data;
+	BLI_radix_sort_float(&data[0], data.size());
+	std::sort(data_ref.begin(), data_ref.end());
+	EXPECT_TRUE(data == data_ref);
+}
+
+struct SortPtr {
+	int index;
+	void *ptr;
+};
+
+TEST(sort, RadixSortPtr)
+{
+	const int len = 10000;
+	std::vector<SortPtr> data(len);
+	for (int i = 0; i < len; i++) {
+		/* reversed address order */
+		data[i].index = i;
+		data[i].ptr = (void *)((uintptr_t)(len - i) * 16);
+	}
+
+	BLI_radix_sort_by_key(&data[0], data.size(), sizeof(SortPtr), offsetof(SortPtr, ptr), BLI_SORT_KEY_PTR);
+	for (int i = 0; i < len; i++) {
+		EXPECT_EQ(len - 1 - i, data[i].index);
+	}
+}
+
+/* Equal keys skip all radix passes. */
+TEST(sort, RadixSortEqual)
+{
+	std::vector<unsigned int> data(SORT_SIZE_BIG, 42);
+	BLI_radix_sort_uint(&data[0], data.size());
+	for (size_t i = 0; i < data.size(); i++) {
+		EXPECT_EQ(42u, data[i]);
+	}
+}
@@ -0,0 +1,89 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_fileops.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+#include "BLI_threads.h"
+
+#include "DNA_genfile.h"
+#include "DNA_text_types.h"
+
+#include "BKE_appdir.h"
+#include "BKE_library.h"
+#include "BKE_main.h"
+#include "BKE_text.h"
+
+#include "BLO_readfile.h"
+#include "BLO_writefile.h"
+}
+
+#define TEXT_BODY "first line\nsecond line\n\nlast line"
+#define THUMB_SIZE 4
+
+/* Write a file with a text (its lines are DATA blocks) and a thumbnail (the TEST block),
+ * then read it back, uncompressed files are mapped so their structs are read ahead in parallel. */
+TEST(blo_readfile, DataAndTestBlocks)
+{
+	char filepath[FILE_MAX];
+
+	BLI_threadapi_init();
+	DNA_sdna_current_init();
+	BKE_tempdir_init(NULL);
+	BLI_make_file_string("/", filepath, BKE_tempdir_base(), "blo_readfile_test.blend");
+
+	{
+		Main *bmain = BKE_main_new();
+		BLI_strncpy(bmain->name, filepath, sizeof(bmain->name));
+
+		Text *text = BKE_text_add(bmain, "Text");
+		txt_insert_buf(text, TEXT_BODY);
+
+		BlendThumbnail *thumb = (BlendThumbnail *)MEM_callocN(BLEN_THUMB_MEMSIZE(THUMB_SIZE, THUMB_SIZE), __func__);
+		thumb->width = thumb->height = THUMB_SIZE;
+		for (int i = 0; i < THUMB_SIZE * THUMB_SIZE; i++) {
+			((int *)thumb->rect)[i] = i;
+		}
+
+		EXPECT_TRUE(BLO_write_file(bmain, filepath, 0, NULL, thumb));
+
+		MEM_freeN(thumb);
+		BKE_main_free(bmain);
+	}
+
+	{
+		BlendFileData *bfd = BLO_read_from_file(filepath, NULL, BLO_READ_SKIP_NONE);
+		ASSERT_TRUE(bfd != NULL);
+
+		Text *text = (Text *)bfd->main->text.first;
+		ASSERT_TRUE(text != NULL);
+		EXPECT_STREQ("Text", text->id.name + 2);
+		EXPECT_EQ(text, bfd->main->text.last);
+
+		char *buf = txt_to_buf(text);
+		EXPECT_STREQ(TEXT_BODY, buf);
+		MEM_freeN(buf);
+
+		BLO_blendfiledata_free(bfd);
+	}
+
+	{
+		BlendThumbnail *thumb = BLO_thumbnail_from_file(filepath);
+		ASSERT_TRUE(thumb != NULL);
+		EXPECT_EQ(THUMB_SIZE, thumb->width);
+		EXPECT_EQ(THUMB_SIZE, thumb->height);
+		for (int i = 0; i < THUMB_SIZE * THUMB_SIZE; i++) {
+			EXPECT_EQ(i, ((int *)thumb->rect)[i]);
+		}
+		MEM_freeN(thumb);
+	}
+
+	BLI_delete(filepath, false, false);
+	BKE_tempdir_session_purge();
+	DNA_sdna_current_free();
+	BLI_threadapi_exit();
+}
@@ -1,5 +1,7 @@
 #include "testing/testing.h"
 
+#include "MEM_guardedalloc.h"
+
 #include "BLI_utildefines.h"
 #include "bmesh.h"
 #include "BLI_math.h"
@@ -37,3 +39,121 @@ TEST(bmesh_core, BMVertCreate) {
 	EXPECT_EQ(BM_mesh_elem_count(bm, BM_VERT), 3);
 	BM_mesh_free(bm);
 }
+
+/* Wavy grid of quads, so normals are not all the same.
+ * Vertex (x, y) is at index y * grid_size + x of the vertex table. */
+static BMesh *bm_wavy_grid_create(int grid_size)
+{
+	BMesh *bm;
+	BMVert **verts;
+
+	BMeshCreateParams bm_params;
+	bm_params.use_toolflags = false;
+	bm = BM_mesh_create(&bm_mesh_allocsize_default, &bm_params);
+
+	verts = (BMVert **)MEM_mallocN(sizeof(*verts) * grid_size * grid_size, __func__);
+	for (int y = 0; y < grid_size; y++) {
+		for (int x = 0; x < grid_size; x++) {
+			const float co[3] = {(float)x, (float)y, sinf((float)(x * y))};
+			verts[y * grid_size + x] = BM_vert_create(bm, co, NULL, BM_CREATE_NOP);
+		}
+	}
+	for (int y = 0; y < grid_size - 1; y++) {
+		for (int x = 0; x < grid_size - 1; x++) {
+			BMVert *quad[4] = {
+			    verts[y * grid_size + x], verts[y * grid_size + x + 1],
+			    verts[(y + 1) * grid_size + x + 1], verts[(y + 1) * grid_size + x]};
+			BM_face_create_verts(bm, quad, 4, NULL, BM_CREATE_NOP, true);
+		}
+	}
+	MEM_freeN(verts);
+
+	BM_mesh_elem_table_ensure(bm, BM_VERT);
+	return bm;
+}
+
+TEST(bmesh_core, NormalsUpdateVerts) {
+	const int grid_size = 16;
+	BMesh *bm;
+	BMVert *moved[2];
+	float (*vnos)[3];
+	float (*fnos)[3];
+	BMIter iter;
+	BMVert *v;
+	BMFace *f;
+	int i;
+
+	bm = bm_wavy_grid_create(grid_size);
+	BM_mesh_normals_update(bm);
+
+	/* Move an inner and a boundary vertex, and only update the normals around them. */
+	moved[0] = bm->vtable[5 * grid_size + 7];
+	moved[1] = bm->vtable[grid_size - 1];
+	moved[0]->co[2] += 1.0f;
+	moved[1]->co[0] -= 0.5f;
+	BM_mesh_normals_update_verts(bm, moved, 2);
+
+	vnos = (float (*)[3])MEM_mallocN(sizeof(*vnos) * bm->totvert, __func__);
+	fnos = (float (*)[3])MEM_mallocN(sizeof(*fnos) * bm->totface, __func__);
+	BM_ITER_MESH_INDEX (v, &iter, bm, BM_VERTS_OF_MESH, i) {
+		copy_v3_v3(vnos[i], v->no);
+	}
+	BM_ITER_MESH_INDEX (f, &iter, bm, BM_FACES_OF_MESH, i) {
+		copy_v3_v3(fnos[i], f->no);
+	}
+
+	/* The partial update must give the same result as a full one. */
+	BM_mesh_normals_update(bm);
+	BM_ITER_MESH_INDEX (v, &iter, bm, BM_VERTS_OF_MESH, i) {
+		EXPECT_V3_NEAR(vnos[i], v->no, 1e-5f);
+	}
+	BM_ITER_MESH_INDEX (f, &iter, bm, BM_FACES_OF_MESH, i) {
+		EXPECT_V3_NEAR(fnos[i], f->no, 1e-5f);
+	}
+
+	MEM_freeN(vnos);
+	MEM_freeN(fnos);
+	BM_mesh_free(bm);
+}
+
+TEST(bmesh_core, MeshArraysNormals) {
+	const int grid_size = 16;
+	BMesh *bm;
+	BMeshArrays arrays;
+	BMIter iter;
+	BMVert *v;
+	BMFace *f;
+	int i;
+
+	bm = bm_wavy_grid_create(grid_size);
+	/* A loose vertex. */
+	{
+		const float co[3] = {-1.0f, -1.0f, 1.0f};
+		BM_vert_create(bm, co, NULL, BM_CREATE_NOP);
+	}
+
+	BM_mesh_arrays_create(bm, &arrays);
+	EXPECT_EQ(arrays.totvert, bm->totvert);
+	EXPECT_EQ(arrays.totloop, bm->totloop);
+	EXPECT_EQ(arrays.vert_edge_offset[arrays.totvert], bm->totedge * 2);
+	EXPECT_EQ(arrays.vert_loop_offset[arrays.totvert], bm->totloop);
+
+	/* Normals computed on the arrays match the ones computed on the BMesh. */
+	BM_mesh_arrays_calc_normals(&arrays);
+	BM_mesh_normals_update(bm);
+	BM_ITER_MESH_INDEX (v, &iter, bm, BM_VERTS_OF_MESH, i) {
+		EXPECT_V3_NEAR(arrays.vert_no[i], v->no, 1e-5f);
+	}
+	BM_ITER_MESH_INDEX (f, &iter, bm, BM_FACES_OF_MESH, i) {
+		EXPECT_V3_NEAR(arrays.face_no[i], f->no, 1e-5f);
+	}
+
+	/* Smoothing flattens the grid towards its average height, the loose vertex stays in place. */
+	BM_mesh_arrays_smooth(&arrays, 0.5f, 200);
+	BM_mesh_arrays_apply_coords(&arrays, bm);
+	EXPECT_EQ(bm->vtable[grid_size * grid_size]->co[2], 1.0f);
+	EXPECT_LT(fabsf(bm->vtable[8 * grid_size + 8]->co[2] - bm->vtable[7 * grid_size + 8]->co[2]), 0.01f);
+
+	BM_mesh_arrays_free(&arrays);
+	BM_mesh_free(bm);
+}
@@ -0,0 +1,62 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "BLI_utildefines.h"
+#include "BLI_compiler_attrs.h"
+#include "BLI_rand.h"
+#include "BLI_task.h"
+#include "PIL_time.h"
+}
+
+#include "MEM_guardedalloc.h"
+
+/* Run the same allocation heavy workload with the default (lock-free) allocator
+ * and the slab allocator, in a single test since the allocator can't be switched back. */
+
+#define PERF_ITER_LEN 64
+#define PERF_BLOCKS_LEN 20000
+
+static void alloc_workload_cb(void *UNUSED(userdata), int iter)
+{
+	RNG *rng = BLI_rng_new((unsigned int)iter);
+	void **blocks = (void **)MEM_mallocN(sizeof(void *) * PERF_BLOCKS_LEN, __func__);
+
+	/* Mostly small blocks of mixed sizes, freed in a different order, similar to BMesh operators. */
+	for (int pass = 0; pass < 4; pass++) {
+		for (int i = 0; i < PERF_BLOCKS_LEN; i++) {
+			blocks[i] = MEM_mallocN((size_t)BLI_rng_get_int(rng) % 256, __func__);
+		}
+		for (int i = 0; i < PERF_BLOCKS_LEN; i += 2) {
+			MEM_freeN(blocks[i]);
+		}
+		for (int i = 1; i < PERF_BLOCKS_LEN; i += 2) {
+			MEM_freeN(blocks[i]);
+		}
+	}
+
+	MEM_freeN(blocks);
+	BLI_rng_free(rng);
+}
+
+static double alloc_workload_time(bool use_threading)
+{
+	const double time_start = PIL_check_seconds_timer();
+	BLI_task_parallel_range(0, PERF_ITER_LEN, NULL, alloc_workload_cb, use_threading);
+	return PIL_check_seconds_timer() - time_start;
+}
+
+TEST(guardedalloc, SlabPerf)
+{
+	const double time_lockfree_single = alloc_workload_time(false);
+	const double time_lockfree_threaded = alloc_workload_time(true);
+
+	MEM_use_slab_allocator();
+
+	const double time_slab_single = alloc_workload_time(false);
+	const double time_slab_threaded = alloc_workload_time(true);
+
+	printf("lock-free: %.4fs single, %.4fs threaded\n", time_lockfree_single, time_lockfree_threaded);
+	printf("slab:      %.4fs single, %.4fs threaded\n", time_slab_single, time_slab_threaded);
+}
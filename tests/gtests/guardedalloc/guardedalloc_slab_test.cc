@@ -0,0 +1,179 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "BLI_utildefines.h"
+#include "BLI_compiler_attrs.h"
+#include "BLI_task.h"
+}
+
+#include "MEM_guardedalloc.h"
+
+#define ALIGN_4(len) (((len) + 3) & ~(size_t)3)
+
+/* Each test switches to the slab allocator itself (which is a no-op when already in use),
+ * so they don't depend on the order they run in, the performance test lives in
+ * guardedalloc_slab_performance_test.cc since the allocator can't be switched back. */
+
+static unsigned int slab_test_begin(void)
+{
+	MEM_use_slab_allocator();
+	return MEM_get_memory_blocks_in_use();
+}
+
+static void slab_test_end(const unsigned int blocks_in_use)
+{
+	EXPECT_EQ(blocks_in_use, MEM_get_memory_blocks_in_use());
+}
+
+/* -------------------------------------------------------------------- */
+/* Correctness */
+
+TEST(guardedalloc, SlabAllocLen)
+{
+	const unsigned int blocks_in_use = slab_test_begin();
+	const size_t memory_in_use = MEM_get_memory_in_use();
+	size_t memory_expect = memory_in_use;
+	void *blocks[2048];
+
+	/* Sizes around the largest slab class are passed on to the lock-free allocator. */
+	for (size_t len = 0; len < ARRAY_SIZE(blocks); len++) {
+		blocks[len] = MEM_mallocN(len, __func__);
+		EXPECT_EQ(ALIGN_4(len), MEM_allocN_len(blocks[len]));
+		EXPECT_EQ(0, (uintptr_t)blocks[len] % sizeof(void *));
+		memset(blocks[len], (int)(len & 0xff), len);
+		memory_expect += ALIGN_4(len);
+	}
+
+	EXPECT_EQ(blocks_in_use + ARRAY_SIZE(blocks), MEM_get_memory_blocks_in_use());
+	EXPECT_EQ(memory_expect, MEM_get_memory_in_use());
+	EXPECT_LE(memory_expect, MEM_get_peak_memory());
+
+	for (size_t len = 0; len < ARRAY_SIZE(blocks); len++) {
+		const unsigned char *data = (const unsigned char *)blocks[len];
+		for (size_t i = 0; i < len; i++) {
+			if (data[i] != (len & 0xff)) {
+				ADD_FAILURE() << "block " << len << " overwritten at " << i;
+				break;
+			}
+		}
+		MEM_freeN(blocks[len]);
+	}
+
+	EXPECT_EQ(memory_in_use, MEM_get_memory_in_use());
+	slab_test_end(blocks_in_use);
+}
+
+TEST(guardedalloc, SlabCalloc)
+{
+	const unsigned int blocks_in_use = slab_test_begin();
+
+	/* Dirty a slot first, so it's reused by the calloc. */
+	void *block = MEM_mallocN(100, __func__);
+	memset(block, 0xff, 100);
+	MEM_freeN(block);
+
+	const unsigned char *data = (const unsigned char *)MEM_callocN(100, __func__);
+	for (int i = 0; i < 100; i++) {
+		EXPECT_EQ(0, data[i]);
+	}
+	MEM_freeN((void *)data);
+	slab_test_end(blocks_in_use);
+}
+
+TEST(guardedalloc, SlabRealloc)
+{
+	const unsigned int blocks_in_use = slab_test_begin();
+
+	const size_t memory_in_use = MEM_get_memory_in_use();
+	int *data = (int *)MEM_mallocN(sizeof(int) * 3, __func__);
+	for (int i = 0; i < 3; i++) {
+		data[i] = i;
+	}
+
+	/* Within the same slot, from a slab to a large block and back. */
+	const size_t lengths[] = {4, 100, 2000, 10, 3};
+	for (size_t j = 0; j < ARRAY_SIZE(lengths); j++) {
+		const size_t len = lengths[j];
+		const size_t len_prev = MEM_allocN_len(data) / sizeof(int);
+		const size_t len_init = (len_prev < 3) ? len_prev : 3;
+		data = (int *)MEM_recallocN(data, sizeof(int) * len);
+		EXPECT_EQ(sizeof(int) * len, MEM_allocN_len(data));
+		for (size_t i = 0; i < len; i++) {
+			EXPECT_EQ((i < len_init) ? (int)i : 0, data[i]);
+		}
+	}
+
+	int *data_dup = (int *)MEM_dupallocN(data);
+	EXPECT_EQ(MEM_allocN_len(data), MEM_allocN_len(data_dup));
+	EXPECT_EQ(0, memcmp(data, data_dup, MEM_allocN_len(data)));
+
+	MEM_freeN(data);
+	MEM_freeN(data_dup);
+	EXPECT_EQ(memory_in_use, MEM_get_memory_in_use());
+	slab_test_end(blocks_in_use);
+}
+
+TEST(guardedalloc, SlabAligned)
+{
+	const unsigned int blocks_in_use = slab_test_begin();
+
+	int *data = (int *)MEM_mallocN_aligned(sizeof(int) * 10, 16, __func__);
+	EXPECT_EQ(0, (uintptr_t)data % 16);
+	data = (int *)MEM_reallocN(data, sizeof(int) * 5);
+	EXPECT_EQ(0, (uintptr_t)data % 16);
+	int *data_dup = (int *)MEM_dupallocN(data);
+	EXPECT_EQ(0, (uintptr_t)data_dup % 16);
+	MEM_freeN(data_dup);
+	MEM_freeN(data);
+	slab_test_end(blocks_in_use);
+}
+
+/* Blocks allocated by one thread and freed by others. */
+#define THREADS_BLOCKS_LEN 100000
+
+static void free_blocks_cb(void *userdata, int i)
+{
+	void **blocks = (void **)userdata;
+	EXPECT_EQ((unsigned int)i, *(unsigned int *)blocks[i]);
+	MEM_freeN(blocks[i]);
+}
+
+/* Mixed sizes allocated and freed within each thread, exercising the thread caches. */
+#define THREADS_ITER_LEN 64
+#define THREADS_MIXED_LEN 2000
+
+static void alloc_mixed_cb(void *UNUSED(userdata), int iter)
+{
+	void *blocks[THREADS_MIXED_LEN];
+
+	for (int i = 0; i < THREADS_MIXED_LEN; i++) {
+		blocks[i] = MEM_mallocN((size_t)((i * 7 + iter) % 256), __func__);
+	}
+	for (int i = 0; i < THREADS_MIXED_LEN; i += 2) {
+		MEM_freeN(blocks[i]);
+	}
+	for (int i = 1; i < THREADS_MIXED_LEN; i += 2) {
+		MEM_freeN(blocks[i]);
+	}
+}
+
+TEST(guardedalloc, SlabThreads)
+{
+	const unsigned int blocks_in_use = slab_test_begin();
+	void **blocks = (void **)MEM_mallocN(sizeof(void *) * THREADS_BLOCKS_LEN, __func__);
+
+	for (int pass = 0; pass < 2; pass++) {
+		for (unsigned int i = 0; i < THREADS_BLOCKS_LEN; i++) {
+			blocks[i] = MEM_mallocN(sizeof(unsigned int) + (i % 64), __func__);
+			*(unsigned int *)blocks[i] = i;
+		}
+		BLI_task_parallel_range(0, THREADS_BLOCKS_LEN, blocks, free_blocks_cb, true);
+	}
+
+	BLI_task_parallel_range(0, THREADS_ITER_LEN, NULL, alloc_mixed_cb, true);
+
+	MEM_freeN(blocks);
+	slab_test_end(blocks_in_use);
+}